@@ -0,0 +1,36 @@
+# - try to find the zstd compression library
+#
+# Cache Variables: (probably not for direct use in your scripts)
+#  ZSTD_INCLUDE_DIR
+#  ZSTD_LIBRARY
+#
+# Non-cache variables you might use in your CMakeLists.txt:
+#  ZSTD_FOUND
+#  ZSTD_INCLUDE_DIRS
+#  ZSTD_LIBRARIES
+
+find_package(PkgConfig QUIET)
+if (PKG_CONFIG_FOUND)
+  pkg_check_modules(ZSTD_PKG QUIET libzstd)
+endif()
+
+find_path(ZSTD_INCLUDE_DIR
+  NAMES zstd.h zdict.h
+  HINTS ${ZSTD_PKG_INCLUDE_DIRS})
+
+find_library(ZSTD_LIBRARY
+  NAMES zstd
+  HINTS ${ZSTD_PKG_LIBRARY_DIRS})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd
+  DEFAULT_MSG
+  ZSTD_LIBRARY
+  ZSTD_INCLUDE_DIR)
+
+if(ZSTD_FOUND)
+  set(ZSTD_INCLUDE_DIRS "${ZSTD_INCLUDE_DIR}")
+  set(ZSTD_LIBRARIES "${ZSTD_LIBRARY}")
+endif()
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
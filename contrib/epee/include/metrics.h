@@ -0,0 +1,137 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "time_helper.h"
+
+namespace epee
+{
+namespace metrics
+{
+  //! Number of copies kept of each counter and histogram, threads are spread over them
+  constexpr const std::size_t shard_count = 8;
+
+  //! Upper bounds of the histogram buckets, in nanoseconds
+  constexpr const std::uint64_t histogram_bounds_ns[] = {
+    10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000,
+    100000000, 500000000, 1000000000, 5000000000, 10000000000
+  };
+  constexpr const std::size_t histogram_bucket_count = sizeof(histogram_bounds_ns) / sizeof(histogram_bounds_ns[0]) + 1;
+
+  //! \return Index of the shard the calling thread updates.
+  std::size_t thread_shard() noexcept;
+
+  /*! A monotonically increasing count. Each thread adds to its own shard so
+      hot paths do not contend on one cache line, the shards are only summed
+      when the value is read. */
+  class counter
+  {
+    struct alignas(64) shard
+    {
+      std::atomic<std::uint64_t> value{0};
+    };
+    shard shards_[shard_count];
+
+  public:
+    void inc(const std::uint64_t n = 1) noexcept
+    {
+      shards_[thread_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    std::uint64_t value() const noexcept;
+  };
+
+  //! A value that goes up and down, like a queue depth.
+  class gauge
+  {
+    std::atomic<std::int64_t> value_{0};
+
+  public:
+    void set(const std::int64_t v) noexcept { value_.store(v, std::memory_order_relaxed); }
+    void add(const std::int64_t n) noexcept { value_.fetch_add(n, std::memory_order_relaxed); }
+    void sub(const std::int64_t n) noexcept { value_.fetch_sub(n, std::memory_order_relaxed); }
+    std::int64_t value() const noexcept { return value_.load(std::memory_order_relaxed); }
+  };
+
+  //! Distribution of durations over `histogram_bounds_ns`, sharded like `counter`.
+  class histogram
+  {
+    struct alignas(64) shard
+    {
+      std::atomic<std::uint64_t> buckets[histogram_bucket_count];
+      std::atomic<std::uint64_t> sum_ns{0};
+      shard() noexcept { for (auto &b: buckets) b.store(0, std::memory_order_relaxed); }
+    };
+    shard shards_[shard_count];
+
+  public:
+    struct snapshot
+    {
+      std::uint64_t buckets[histogram_bucket_count]; //!< Not cumulative
+      std::uint64_t count;
+      std::uint64_t sum_ns;
+    };
+
+    void observe_ns(std::uint64_t ns) noexcept;
+    snapshot get() const noexcept;
+  };
+
+  /*! Find or create a metric. `name` must be a valid Prometheus metric name,
+      and `labels` empty or a list of `key="value"` pairs separated by commas.
+      Every label set is a separate metric, so labels must only ever take a
+      small, fixed set of values. The returned reference is valid until the
+      process exits, callers on hot paths should keep it in a static.
+      \throw std::logic_error if `name` was registered with another type. */
+  counter& get_counter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+  gauge& get_gauge(const std::string &name, const std::string &help, const std::string &labels = std::string());
+  histogram& get_histogram(const std::string &name, const std::string &help, const std::string &labels = std::string());
+
+  //! \return Every metric, in the Prometheus text exposition format.
+  std::string dump();
+
+  //! Adds the time from construction to destruction to a histogram.
+  class scoped_timer
+  {
+    histogram &histogram_;
+    const std::uint64_t start_;
+
+  public:
+    explicit scoped_timer(histogram &h) noexcept
+      : histogram_(h), start_(misc_utils::get_ns_count())
+    {}
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+    ~scoped_timer() { histogram_.observe_ns(misc_utils::get_ns_count() - start_); }
+  };
+} // metrics
+} // epee
@@ -105,7 +105,7 @@
       handled = true; \
       uint64_t ticks = epee::misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
-      bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), epee::strspan<uint8_t>(query_info.m_body)); \
+      bool parse_res = epee::serialization::load_t_from_binary_direct(static_cast<command_type::request&>(req), epee::strspan<uint8_t>(query_info.m_body)); \
       if (!parse_res) \
       { \
          MERROR("Failed to parse bin body data, body size=" << query_info.m_body.size()); \
@@ -127,7 +127,7 @@
       } \
       uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
       epee::byte_slice buffer; \
-      epee::serialization::store_t_to_binary(static_cast<command_type::response&>(resp), buffer, 64 * 1024); \
+      epee::serialization::store_t_to_binary_direct(static_cast<command_type::response&>(resp), buffer, 64 * 1024); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_body.assign(reinterpret_cast<const char*>(buffer.data()), buffer.size()); \
       response_info.m_mime_tipe = " application/octet-stream"; \
@@ -135,6 +135,25 @@
       MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
     }
 
+#define MAP_URI_TEXT2_IF(s_pattern, callback_f, mime, cond) \
+    else if((query_info.m_URI == s_pattern) && (cond)) \
+    { \
+      handled = true; \
+      MINFO(m_conn_context << "calling " << s_pattern); \
+      bool res = false; \
+      try { res = callback_f(response_info.m_body, &m_conn_context); } \
+      catch (const std::exception &e) { MERROR(m_conn_context << "Failed to " << #callback_f << "(): " << e.what()); } \
+      if (!res) \
+      { \
+        response_info.m_body.clear(); \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      response_info.m_mime_tipe = mime; \
+      response_info.m_header_info.m_content_type = " " mime; \
+    }
+
 #define END_URI_MAP2() return handled;}
 
 
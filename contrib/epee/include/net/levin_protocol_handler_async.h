@@ -39,6 +39,7 @@
 #include "syncobj.h"
 #include "time_helper.h"
 #include "int-util.h"
+#include "metrics.h"
 
 #include <random>
 #include <chrono>
@@ -57,12 +58,41 @@ void on_levin_traffic(const context_t &context, bool initiator, bool sent, bool
       << " for category " << category << " initiated by " << (initiator ? "us" : "peer"));
 }
 
+// Commands get their own label only in the first ids of the p2p (1000) and
+// cryptonote (2000) command pools, which is where the known commands are.
+// Responses echo the peer's command id, so anything else is counted as
+// "other" rather than growing the label set.
+#define LEVIN_TRAFFIC_POOL_COMMANDS 32
+
+inline epee::metrics::counter &levin_traffic_counter(int command, bool sent)
+{
+  static std::atomic<epee::metrics::counter*> counters[2][2 * LEVIN_TRAFFIC_POOL_COMMANDS + 1];
+  size_t slot = 2 * LEVIN_TRAFFIC_POOL_COMMANDS;
+  if (command > 1000 && command < 1000 + LEVIN_TRAFFIC_POOL_COMMANDS)
+    slot = command - 1000;
+  else if (command > 2000 && command < 2000 + LEVIN_TRAFFIC_POOL_COMMANDS)
+    slot = LEVIN_TRAFFIC_POOL_COMMANDS + command - 2000;
+
+  std::atomic<epee::metrics::counter*> &cached = counters[sent][slot];
+  epee::metrics::counter *counter = cached.load(std::memory_order_acquire);
+  if (!counter)
+  {
+    // racing threads get the same counter back
+    const std::string label = slot == 2 * LEVIN_TRAFFIC_POOL_COMMANDS ? std::string("other") : std::to_string(command);
+    counter = &epee::metrics::get_counter("monero_levin_bytes_total", "Levin payload bytes by command and direction",
+        "command=\"" + label + (sent ? "\",direction=\"out\"" : "\",direction=\"in\""));
+    cached.store(counter, std::memory_order_release);
+  }
+  return *counter;
+}
+
 template<typename context_t>
 void on_levin_traffic(const context_t &context, bool initiator, bool sent, bool error, size_t bytes, int command)
 {
   char buf[32];
   snprintf(buf, sizeof(buf),  "command-%u", command);
   on_levin_traffic(context, initiator, sent, error, bytes, buf);
+  levin_traffic_counter(command, sent).inc(bytes);
 }
 
 namespace epee
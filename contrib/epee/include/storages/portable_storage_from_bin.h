@@ -161,7 +161,7 @@ namespace epee
     }
     
     template<>
-    void throwable_buffer_reader::read<bool>(bool& pod_val)
+    inline void throwable_buffer_reader::read<bool>(bool& pod_val)
     {
       RECURSION_LIMITATION();
       static_assert(std::is_pod<bool>::value, "POD type expected");
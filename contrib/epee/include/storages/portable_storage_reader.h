@@ -0,0 +1,487 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <boost/mpl/contains.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "span.h"
+#include "portable_storage.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "serialization"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Loads KV_SERIALIZE structs directly from a binary portable storage   */
+    /* blob, without building a portable_storage tree first.                */
+    /*                                                                      */
+    /* load_from_binary() validates the whole blob with the same rules and  */
+    /* limits as portable_storage, and records where every field starts.    */
+    /* Values are only decoded when the struct asks for them, straight into */
+    /* their destination. The blob must outlive the reader.                 */
+    /************************************************************************/
+    class portable_storage_reader
+    {
+    public:
+      struct node
+      {
+        const uint8_t* name;
+        const uint8_t* entry;       // type byte, null for elements of section arrays
+        const uint8_t* value;       // payload, past the element count for arrays
+        size_t count;               // fields of a section, elements of an array
+        size_t first;               // index of the first child node
+        mutable const uint8_t* next;// array iteration state
+        mutable size_t left;
+        uint8_t name_len;
+        uint8_t type;
+      };
+
+      typedef const node* hsection;
+      typedef const node* harray;
+      typedef storage_entry meta_entry;
+      typedef portable_storage::limits_t limits_t;
+
+      portable_storage_reader(): m_end(nullptr) {}
+
+      bool load_from_binary(const epee::span<const uint8_t> source, const limits_t *limits = nullptr);
+
+      hsection open_section(const boost::string_ref section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool get_value(const boost::string_ref value_name, t_value& val, hsection hparent_section);
+      bool get_value(const boost::string_ref value_name, storage_entry& val, hsection hparent_section);
+
+      template<class t_value>
+      harray get_first_value(const boost::string_ref value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const boost::string_ref section_name, hsection& h_child_section, hsection hparent_section);
+      bool get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      struct index_state
+      {
+        const uint8_t* ptr;
+        size_t recursion;
+        size_t objects;
+        size_t fields;
+        size_t strings;
+        size_t max_objects;
+        size_t max_fields;
+        size_t max_strings;
+      };
+
+      static size_t read_varint(const uint8_t*& ptr, const uint8_t* end);
+      template<class t_pod_type>
+      static t_pod_type read_pod(const uint8_t* ptr);
+      static size_t pod_size(uint8_t type);
+      template<class t_value>
+      const uint8_t* read_element(uint8_t type, const uint8_t* ptr, t_value& target) const;
+      void read_string(const uint8_t*& ptr, std::string& target) const;
+      template<class t_value>
+      void read_string(const uint8_t*& ptr, t_value& target) const;
+
+      void index_section(index_state& st, node& sec);
+      void index_entry(index_state& st, node& nd, uint8_t type);
+      void index_array(index_state& st, node& nd, uint8_t type);
+      const node* find(const boost::string_ref name, hsection hparent_section) const;
+
+      std::vector<node> m_nodes;
+      const uint8_t* m_end;
+    };
+
+    //---------------------------------------------------------------------------------------------------------------
+    inline size_t portable_storage_reader::read_varint(const uint8_t*& ptr, const uint8_t* end)
+    {
+      CHECK_AND_ASSERT_THROW_MES(ptr < end, "empty buff, expected place for varint");
+      size_t v = 0;
+      switch (*ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE: v = *ptr; ptr += 1; return v >> 2;
+      case PORTABLE_RAW_SIZE_MARK_WORD:
+        CHECK_AND_ASSERT_THROW_MES(end - ptr >= 2, "varint goes out of remain storage len");
+        v = read_pod<uint16_t>(ptr); ptr += 2; return v >> 2;
+      case PORTABLE_RAW_SIZE_MARK_DWORD:
+        CHECK_AND_ASSERT_THROW_MES(end - ptr >= 4, "varint goes out of remain storage len");
+        v = read_pod<uint32_t>(ptr); ptr += 4; return v >> 2;
+      default:
+        CHECK_AND_ASSERT_THROW_MES(end - ptr >= 8, "varint goes out of remain storage len");
+        v = read_pod<uint64_t>(ptr); ptr += 8; return v >> 2;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type>
+    t_pod_type portable_storage_reader::read_pod(const uint8_t* ptr)
+    {
+      t_pod_type v;
+      memcpy(&v, ptr, sizeof(v));
+      return CONVERT_POD(v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline size_t portable_storage_reader::pod_size(const uint8_t type)
+    {
+      switch (type)
+      {
+      case SERIALIZE_TYPE_INT64:
+      case SERIALIZE_TYPE_UINT64:
+      case SERIALIZE_TYPE_DOUBLE: return 8;
+      case SERIALIZE_TYPE_INT32:
+      case SERIALIZE_TYPE_UINT32: return 4;
+      case SERIALIZE_TYPE_INT16:
+      case SERIALIZE_TYPE_UINT16: return 2;
+      case SERIALIZE_TYPE_INT8:
+      case SERIALIZE_TYPE_UINT8:
+      case SERIALIZE_TYPE_BOOL: return 1;
+      default: return 0;
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    const uint8_t* portable_storage_reader::read_element(const uint8_t type, const uint8_t* ptr, t_value& target) const
+    {
+      switch (type)
+      {
+      case SERIALIZE_TYPE_INT64:  convert_t(read_pod<int64_t>(ptr), target); return ptr + 8;
+      case SERIALIZE_TYPE_INT32:  convert_t(read_pod<int32_t>(ptr), target); return ptr + 4;
+      case SERIALIZE_TYPE_INT16:  convert_t(read_pod<int16_t>(ptr), target); return ptr + 2;
+      case SERIALIZE_TYPE_INT8:   convert_t(read_pod<int8_t>(ptr), target); return ptr + 1;
+      case SERIALIZE_TYPE_UINT64: convert_t(read_pod<uint64_t>(ptr), target); return ptr + 8;
+      case SERIALIZE_TYPE_UINT32: convert_t(read_pod<uint32_t>(ptr), target); return ptr + 4;
+      case SERIALIZE_TYPE_UINT16: convert_t(read_pod<uint16_t>(ptr), target); return ptr + 2;
+      case SERIALIZE_TYPE_UINT8:  convert_t(read_pod<uint8_t>(ptr), target); return ptr + 1;
+      case SERIALIZE_TYPE_DOUBLE: convert_t(read_pod<double>(ptr), target); return ptr + 8;
+      case SERIALIZE_TYPE_BOOL:   convert_t(bool(*ptr != 0), target); return ptr + 1;
+      case SERIALIZE_TYPE_STRING: read_string(ptr, target); return ptr;
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from storage type " << unsigned(type) << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_reader::read_string(const uint8_t*& ptr, std::string& target) const
+    {
+      const size_t len = read_varint(ptr, m_end);
+      target.assign(reinterpret_cast<const char*>(ptr), len);
+      ptr += len;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_reader::read_string(const uint8_t*& ptr, t_value& target) const
+    {
+      std::string s;
+      read_string(ptr, s);
+      convert_t(s, target);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage_reader::load_from_binary(const epee::span<const uint8_t> source, const limits_t *limits)
+    {
+      m_nodes.clear();
+      m_end = nullptr;
+      static constexpr const size_t header_size = 2 * sizeof(uint32_t) + 1;
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format, packet size = " << source.size() << " less than expected header size " << header_size);
+        return false;
+      }
+      if(read_pod<uint32_t>(source.data()) != PORTABLE_STORAGE_SIGNATUREA ||
+        read_pod<uint32_t>(source.data() + sizeof(uint32_t)) != PORTABLE_STORAGE_SIGNATUREB
+        )
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format - signature mismatch");
+        return false;
+      }
+      if(source[2 * sizeof(uint32_t)] != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage_reader: wrong binary format - unknown format ver = " << unsigned(source[2 * sizeof(uint32_t)]));
+        return false;
+      }
+      TRY_ENTRY();
+      index_state st{};
+      st.ptr = source.data() + header_size;
+      st.max_objects = limits ? limits->n_objects : std::numeric_limits<size_t>::max();
+      st.max_fields = limits ? limits->n_fields : std::numeric_limits<size_t>::max();
+      st.max_strings = limits ? limits->n_strings : std::numeric_limits<size_t>::max();
+      m_end = source.data() + source.size();
+      CHECK_AND_ASSERT_THROW_MES(st.ptr < m_end, "portable_storage_reader: empty root section");
+
+      // the root is node 0, so a null hsection always means the root
+      node root{};
+      root.type = SERIALIZE_TYPE_OBJECT;
+      m_nodes.resize(1);
+      index_section(st, root);
+      m_nodes[0] = root;
+      return true;
+      CATCH_ENTRY("portable_storage_reader::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_reader::index_section(index_state& st, node& sec)
+    {
+      CHECK_AND_ASSERT_THROW_MES(++st.recursion < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      const size_t count = read_varint(st.ptr, m_end);
+      CHECK_AND_ASSERT_THROW_MES(count <= st.max_fields - st.fields, "Too many object fields");
+      // a field takes at least a name length, a one byte name and a type
+      CHECK_AND_ASSERT_THROW_MES(count <= size_t(m_end - st.ptr) / 3, "Size sanity check failed");
+      st.fields += count;
+
+      // children are indexed depth first, so m_nodes may grow while this
+      // section is being filled in: only ever address it by index
+      sec.first = m_nodes.size();
+      sec.count = count;
+      m_nodes.resize(sec.first + count);
+      for (size_t i = 0; i < count; ++i)
+      {
+        node nd{};
+        CHECK_AND_ASSERT_THROW_MES(st.ptr < m_end, "attempt to read section name past the end of the storage");
+        nd.name_len = *st.ptr++;
+        CHECK_AND_ASSERT_THROW_MES(nd.name_len > 0, "Section name is missing");
+        CHECK_AND_ASSERT_THROW_MES(size_t(m_end - st.ptr) > nd.name_len, "section name goes out of remain storage len");
+        nd.name = st.ptr;
+        st.ptr += nd.name_len;
+        nd.entry = st.ptr;
+        const uint8_t type = *st.ptr++;
+        index_entry(st, nd, type);
+        m_nodes[sec.first + i] = nd;
+      }
+
+      const auto name_less = [](const node& a, const node& b) {
+        const int r = memcmp(a.name, b.name, std::min(a.name_len, b.name_len));
+        return r < 0 || (r == 0 && a.name_len < b.name_len);
+      };
+      const auto begin = m_nodes.begin() + sec.first;
+      const auto end = begin + count;
+      std::sort(begin, end, name_less);
+      const auto dup = std::adjacent_find(begin, end, [](const node& a, const node& b) {
+        return a.name_len == b.name_len && memcmp(a.name, b.name, a.name_len) == 0;
+      });
+      CHECK_AND_ASSERT_THROW_MES(dup == end, "duplicate key: " << std::string(reinterpret_cast<const char*>(dup->name), dup->name_len));
+      --st.recursion;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_reader::index_entry(index_state& st, node& nd, uint8_t type)
+    {
+      if (type == SERIALIZE_TYPE_ARRAY)
+      {
+        CHECK_AND_ASSERT_THROW_MES(st.ptr < m_end, "empty buff, expected array type");
+        type = *st.ptr++;
+        CHECK_AND_ASSERT_THROW_MES(type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+      }
+      nd.type = type;
+      if (type & SERIALIZE_FLAG_ARRAY)
+        return index_array(st, nd, type & ~SERIALIZE_FLAG_ARRAY);
+
+      nd.value = st.ptr;
+      switch (type)
+      {
+      case SERIALIZE_TYPE_STRING:
+      {
+        CHECK_AND_ASSERT_THROW_MES(st.strings < st.max_strings, "Too many strings");
+        ++st.strings;
+        const size_t len = read_varint(st.ptr, m_end);
+        CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+        CHECK_AND_ASSERT_THROW_MES(size_t(m_end - st.ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (m_end - st.ptr));
+        st.ptr += len;
+        return;
+      }
+      case SERIALIZE_TYPE_OBJECT:
+        CHECK_AND_ASSERT_THROW_MES(st.objects < st.max_objects, "Too many objects");
+        ++st.objects;
+        return index_section(st, nd);
+      default:
+      {
+        const size_t size = pod_size(type);
+        CHECK_AND_ASSERT_THROW_MES(size, "unknown entry_type code = " << unsigned(type));
+        CHECK_AND_ASSERT_THROW_MES(size_t(m_end - st.ptr) >= size, "attempt to read " << size << " bytes from buffer with " << (m_end - st.ptr) << " bytes remained");
+        CHECK_AND_ASSERT_THROW_MES(type != SERIALIZE_TYPE_BOOL || *st.ptr <= 1, "Invalid bool value " << unsigned(*st.ptr));
+        st.ptr += size;
+      }
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_reader::index_array(index_state& st, node& nd, const uint8_t type)
+    {
+      const size_t count = read_varint(st.ptr, m_end);
+      const size_t remaining = m_end - st.ptr;
+      nd.count = count;
+      nd.value = st.ptr;
+      switch (type)
+      {
+      case SERIALIZE_TYPE_STRING:
+      {
+        CHECK_AND_ASSERT_THROW_MES(count <= remaining / ps_min_bytes<std::string>::strict, "Size sanity check failed");
+        CHECK_AND_ASSERT_THROW_MES(count <= st.max_strings - st.strings, "Too many strings");
+        st.strings += count;
+        for (size_t i = 0; i < count; ++i)
+        {
+          const size_t len = read_varint(st.ptr, m_end);
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          CHECK_AND_ASSERT_THROW_MES(size_t(m_end - st.ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (m_end - st.ptr));
+          st.ptr += len;
+        }
+        return;
+      }
+      case SERIALIZE_TYPE_OBJECT:
+      {
+        CHECK_AND_ASSERT_THROW_MES(count <= remaining / ps_min_bytes<section>::strict, "Size sanity check failed");
+        CHECK_AND_ASSERT_THROW_MES(count <= st.max_objects - st.objects, "Too many objects");
+        st.objects += count;
+        nd.first = m_nodes.size();
+        m_nodes.resize(nd.first + count);
+        for (size_t i = 0; i < count; ++i)
+        {
+          node element{};
+          element.type = SERIALIZE_TYPE_OBJECT;
+          index_section(st, element);
+          m_nodes[nd.first + i] = element;
+        }
+        return;
+      }
+      case SERIALIZE_TYPE_ARRAY:
+        CHECK_AND_ASSERT_THROW_MES(count <= remaining / ps_min_bytes<array_entry>::strict, "Size sanity check failed");
+        CHECK_AND_ASSERT_THROW_MES(count == 0, "Reading array entry is not supported");
+        return;
+      default:
+      {
+        const size_t size = pod_size(type);
+        CHECK_AND_ASSERT_THROW_MES(size, "unknown entry_type code = " << unsigned(type));
+        CHECK_AND_ASSERT_THROW_MES(count <= remaining / size, "Size sanity check failed");
+        if (type == SERIALIZE_TYPE_BOOL)
+        {
+          for (size_t i = 0; i < count; ++i)
+            CHECK_AND_ASSERT_THROW_MES(st.ptr[i] <= 1, "Invalid bool value " << unsigned(st.ptr[i]));
+        }
+        st.ptr += count * size;
+      }
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline const portable_storage_reader::node* portable_storage_reader::find(const boost::string_ref name, hsection hparent_section) const
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_nodes.empty(), "portable_storage_reader: nothing loaded");
+      const node& sec = hparent_section ? *hparent_section : m_nodes[0];
+      const auto begin = m_nodes.begin() + sec.first;
+      const auto end = begin + sec.count;
+      const auto it = std::lower_bound(begin, end, name, [](const node& a, const boost::string_ref b) {
+        const int r = memcmp(a.name, b.data(), std::min<size_t>(a.name_len, b.size()));
+        return r < 0 || (r == 0 && a.name_len < b.size());
+      });
+      if (it == end || it->name_len != name.size() || memcmp(it->name, name.data(), name.size()) != 0)
+        return nullptr;
+      return std::addressof(*it);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_reader::hsection portable_storage_reader::open_section(const boost::string_ref section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      const node* pentry = find(section_name, hparent_section);
+      if (!pentry || pentry->type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      return pentry;
+      CATCH_ENTRY("portable_storage_reader::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_value(const boost::string_ref value_name, t_value& val, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const node* pentry = find(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      read_element(pentry->type, pentry->value, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage_reader::get_value(const boost::string_ref value_name, storage_entry& val, hsection hparent_section)
+    {
+      const node* pentry = find(value_name, hparent_section);
+      if (!pentry)
+        return false;
+      throwable_buffer_reader reader(pentry->entry, m_end - pentry->entry);
+      val = reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_reader::harray portable_storage_reader::get_first_value(const boost::string_ref value_name, t_value& target, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const node* pentry = find(value_name, hparent_section);
+      if (!pentry || !(pentry->type & SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      pentry->next = read_element(pentry->type & ~SERIALIZE_FLAG_ARRAY, pentry->value, target);
+      pentry->left = pentry->count - 1;
+      return pentry;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      CHECK_AND_ASSERT(hval_array, false);
+      if (!hval_array->left)
+        return false;
+      hval_array->next = read_element(hval_array->type & ~SERIALIZE_FLAG_ARRAY, hval_array->next, target);
+      --hval_array->left;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_reader::harray portable_storage_reader::get_first_section(const boost::string_ref section_name, hsection& h_child_section, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      const node* pentry = find(section_name, hparent_section);
+      if (!pentry || pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      h_child_section = &m_nodes[pentry->first];
+      pentry->left = pentry->count - 1;
+      return pentry;
+      CATCH_ENTRY("portable_storage_reader::get_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if (!hsec_array->left)
+        return false;
+      h_child_section = &m_nodes[hsec_array->first + hsec_array->count - hsec_array->left];
+      --hsec_array->left;
+      return true;
+    }
+  }
+}
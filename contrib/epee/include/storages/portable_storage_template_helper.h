@@ -31,6 +31,8 @@
 #include "byte_slice.h"
 #include "parserse_base_utils.h" /// TODO: (mj-xmr) This will be reduced in an another PR
 #include "portable_storage.h"
+#include "portable_storage_reader.h"
+#include "portable_storage_writer.h"
 #include "file_io_utils.h"
 #include "span.h"
 
@@ -115,6 +117,17 @@ namespace epee
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
+    bool load_t_from_binary_direct(t_struct& out, const epee::span<const uint8_t> binary_buff, const epee::serialization::portable_storage::limits_t *limits = NULL)
+    {
+      portable_storage_reader reader;
+      bool rs = reader.load_from_binary(binary_buff, limits);
+      if(!rs)
+        return false;
+
+      return out.load(reader);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, byte_slice& binary_buff, size_t initial_buffer_size = 8192)
     {
       portable_storage ps;
@@ -137,6 +150,24 @@ namespace epee
       str_in.store(ps);
       return ps.store_to_binary(binary_buff);
     }
-
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_to_binary_direct(t_struct& str_in, byte_stream& binary_buff)
+    {
+      portable_storage_writer writer(binary_buff);
+      str_in.store(writer);
+      return writer.finish();
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_to_binary_direct(t_struct& str_in, byte_slice& binary_buff, size_t initial_buffer_size = 8192)
+    {
+      byte_stream ss;
+      ss.reserve(initial_buffer_size);
+      if(!store_t_to_binary_direct(str_in, ss))
+        return false;
+      binary_buff = epee::byte_slice{std::move(ss), false};
+      return true;
+    }
   }
 }
@@ -0,0 +1,298 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/mpl/contains.hpp>
+#include <boost/mpl/push_front.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "byte_stream.h"
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_to_bin.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "serialization"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Stores KV_SERIALIZE structs directly in the binary portable storage  */
+    /* format, without building a portable_storage tree first.              */
+    /*                                                                      */
+    /* Fields are written in the order the struct stores them. Section and  */
+    /* array sizes are only known once they are closed, so a one byte count */
+    /* is reserved when they are opened and widened in place if needed.     */
+    /* Writing to a section or array implicitly closes everything that was  */
+    /* opened inside it after it; finish() closes the rest. The output has  */
+    /* the same size as portable_storage::store_to_binary and loads back to */
+    /* the same values, only the order of fields may differ.                */
+    /************************************************************************/
+    class portable_storage_writer
+    {
+    public:
+      struct frame
+      {
+        size_t count_pos;
+        size_t count;
+        bool open;
+      };
+
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      explicit portable_storage_writer(byte_stream& out);
+
+      hsection open_section(const boost::string_ref section_name, hsection hparent_section, bool create_if_notexist = true);
+      template<class t_value>
+      bool set_value(const boost::string_ref value_name, t_value&& target, hsection hparent_section);
+
+      template<class t_value>
+      harray insert_first_value(const boost::string_ref value_name, t_value&& target, hsection hparent_section);
+      template<class t_value>
+      bool insert_next_value(harray hval_array, t_value&& target);
+      harray insert_first_section(const boost::string_ref section_name, hsection& hinserted_childsection, hsection hparent_section);
+      bool insert_next_section(harray hsec_array, hsection& hinserted_childsection);
+
+      //! Closes every open section and array. Must be called once the struct is stored.
+      bool finish();
+
+    private:
+      struct varint_buffer
+      {
+        uint8_t data[sizeof(uint64_t)];
+        size_t size;
+        void write(const char* ptr, size_t count) { memcpy(data + size, ptr, count); size += count; }
+      };
+
+      static uint8_t type_code(const int64_t&)  { return SERIALIZE_TYPE_INT64; }
+      static uint8_t type_code(const int32_t&)  { return SERIALIZE_TYPE_INT32; }
+      static uint8_t type_code(const int16_t&)  { return SERIALIZE_TYPE_INT16; }
+      static uint8_t type_code(const int8_t&)   { return SERIALIZE_TYPE_INT8; }
+      static uint8_t type_code(const uint64_t&) { return SERIALIZE_TYPE_UINT64; }
+      static uint8_t type_code(const uint32_t&) { return SERIALIZE_TYPE_UINT32; }
+      static uint8_t type_code(const uint16_t&) { return SERIALIZE_TYPE_UINT16; }
+      static uint8_t type_code(const uint8_t&)  { return SERIALIZE_TYPE_UINT8; }
+      static uint8_t type_code(const double&)   { return SERIALIZE_TYPE_DOUBLE; }
+      static uint8_t type_code(const bool&)     { return SERIALIZE_TYPE_BOOL; }
+      static uint8_t type_code(const std::string&) { return SERIALIZE_TYPE_STRING; }
+
+      template<class t_pod_type>
+      void put_element(const t_pod_type& v);
+      void put_element(const std::string& v);
+      template<class t_value>
+      void put_value(const t_value& v);
+      void put_value(const storage_entry& v);
+
+      frame& enter(hsection h);
+      void put_name(const boost::string_ref name);
+      frame* push_frame();
+      void close_top();
+
+      std::deque<frame> m_frames;
+      std::vector<frame*> m_open;
+      byte_stream& m_out;
+    };
+
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_writer::portable_storage_writer(byte_stream& out): m_out(out)
+    {
+      const uint32_t signature_a = SWAP32LE(PORTABLE_STORAGE_SIGNATUREA);
+      const uint32_t signature_b = SWAP32LE(PORTABLE_STORAGE_SIGNATUREB);
+      m_out.write(reinterpret_cast<const char*>(&signature_a), sizeof(signature_a));
+      m_out.write(reinterpret_cast<const char*>(&signature_b), sizeof(signature_b));
+      m_out.put(PORTABLE_STORAGE_FORMAT_VER);
+      push_frame();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_writer::frame* portable_storage_writer::push_frame()
+    {
+      m_frames.push_back(frame{m_out.size(), 0, true});
+      m_out.put(PORTABLE_RAW_SIZE_MARK_BYTE);
+      m_open.push_back(std::addressof(m_frames.back()));
+      return m_open.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_writer::close_top()
+    {
+      frame& f = *m_open.back();
+      m_open.pop_back();
+      f.open = false;
+
+      varint_buffer count{};
+      pack_varint(count, f.count);
+      if (count.size > 1)
+      {
+        const size_t tail = m_out.size() - f.count_pos - 1;
+        m_out.put_n(0, count.size - 1);
+        uint8_t* const data = m_out.data() + f.count_pos;
+        memmove(data + count.size, data + 1, tail);
+      }
+      memcpy(m_out.data() + f.count_pos, count.data, count.size);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_writer::frame& portable_storage_writer::enter(hsection h)
+    {
+      frame& f = h ? *h : m_frames.front();
+      CHECK_AND_ASSERT_THROW_MES(f.open, "portable_storage_writer: section or array already closed");
+      while (m_open.back() != std::addressof(f))
+        close_top();
+      return f;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_writer::put_name(const boost::string_ref name)
+    {
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+      CHECK_AND_ASSERT_THROW_MES(!name.empty(), "storage_entry_name is empty");
+      m_out.put(static_cast<uint8_t>(name.size()));
+      m_out.write(name.data(), name.size());
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type>
+    void portable_storage_writer::put_element(const t_pod_type& v)
+    {
+      const t_pod_type v0 = CONVERT_POD(v);
+      m_out.write(reinterpret_cast<const char*>(&v0), sizeof(v0));
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_writer::put_element(const std::string& v)
+    {
+      put_string(m_out, v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_writer::put_value(const t_value& v)
+    {
+      m_out.put(type_code(v));
+      put_element(v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline void portable_storage_writer::put_value(const storage_entry& v)
+    {
+      pack_entry_to_buff(m_out, v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_writer::hsection portable_storage_writer::open_section(const boost::string_ref section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(create_if_notexist, nullptr, "portable_storage_writer can only create sections");
+      frame& parent = enter(hparent_section);
+      put_name(section_name);
+      m_out.put(SERIALIZE_TYPE_OBJECT);
+      ++parent.count;
+      return push_frame();
+      CATCH_ENTRY("portable_storage_writer::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::set_value(const boost::string_ref value_name, t_value&& v, hsection hparent_section)
+    {
+      using t_real_value = typename std::decay<t_value>::type;
+      BOOST_MPL_ASSERT(( boost::mpl::contains<boost::mpl::push_front<storage_entry::types, storage_entry>::type, t_real_value> ));
+      TRY_ENTRY();
+      frame& parent = enter(hparent_section);
+      put_name(value_name);
+      put_value(v);
+      ++parent.count;
+      return true;
+      CATCH_ENTRY("portable_storage_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_writer::harray portable_storage_writer::insert_first_value(const boost::string_ref value_name, t_value&& target, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      frame& parent = enter(hparent_section);
+      put_name(value_name);
+      m_out.put(type_code(target) | SERIALIZE_FLAG_ARRAY);
+      ++parent.count;
+      frame* const array = push_frame();
+      put_element(target);
+      array->count = 1;
+      return array;
+      CATCH_ENTRY("portable_storage_writer::insert_first_value", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::insert_next_value(harray hval_array, t_value&& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+      frame& array = enter(hval_array);
+      put_element(target);
+      ++array.count;
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline portable_storage_writer::harray portable_storage_writer::insert_first_section(const boost::string_ref section_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      frame& parent = enter(hparent_section);
+      put_name(section_name);
+      m_out.put(SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+      ++parent.count;
+      frame* const array = push_frame();
+      array->count = 1;
+      hinserted_childsection = push_frame();
+      return array;
+      CATCH_ENTRY("portable_storage_writer::insert_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      frame& array = enter(hsec_array);
+      ++array.count;
+      hinserted_childsection = push_frame();
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_section", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage_writer::finish()
+    {
+      TRY_ENTRY();
+      while (!m_open.empty())
+        close_top();
+      return true;
+      CATCH_ENTRY("portable_storage_writer::finish", false);
+    }
+  }
+}
@@ -0,0 +1,221 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace epee
+{
+namespace metrics
+{
+  namespace
+  {
+    enum class metric_type { counter, gauge, histogram };
+
+    struct family
+    {
+      std::string help;
+      metric_type type;
+      std::map<std::string, std::unique_ptr<counter>> counters;
+      std::map<std::string, std::unique_ptr<gauge>> gauges;
+      std::map<std::string, std::unique_ptr<histogram>> histograms;
+    };
+
+    struct registry
+    {
+      std::mutex lock;
+      std::map<std::string, family> families;
+    };
+
+    registry& get_registry()
+    {
+      // never destroyed, metrics may be updated from static destructors
+      static registry* const instance = new registry{};
+      return *instance;
+    }
+
+    family& get_family(registry& reg, const std::string &name, const std::string &help, const metric_type type)
+    {
+      auto it = reg.families.find(name);
+      if (it == reg.families.end())
+        it = reg.families.emplace(name, family{help, type, {}, {}, {}}).first;
+      else if (it->second.type != type)
+        throw std::logic_error{"metric " + name + " already registered with another type"};
+      return it->second;
+    }
+
+    template<typename T>
+    T& get_metric(std::map<std::string, std::unique_ptr<T>>& metrics, const std::string &labels)
+    {
+      std::unique_ptr<T>& metric = metrics[labels];
+      if (!metric)
+        metric.reset(new T{});
+      return *metric;
+    }
+
+    void write_name(std::ostream& out, const std::string &name, const char* suffix, const std::string &labels, const std::string &extra = std::string())
+    {
+      out << name << suffix;
+      if (!labels.empty() || !extra.empty())
+      {
+        out << '{' << labels;
+        if (!labels.empty() && !extra.empty())
+          out << ',';
+        out << extra << '}';
+      }
+      out << ' ';
+    }
+
+    std::string seconds(const std::uint64_t ns)
+    {
+      std::ostringstream out;
+      out << ns / 1000000000 << '.';
+      const std::string frac = std::to_string(1000000000 + ns % 1000000000).substr(1);
+      out << frac.substr(0, std::max<std::size_t>(1, frac.find_last_not_of('0') + 1));
+      return out.str();
+    }
+  }
+
+  std::size_t thread_shard() noexcept
+  {
+    static std::atomic<std::size_t> next{0};
+    static thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+    return shard;
+  }
+
+  std::uint64_t counter::value() const noexcept
+  {
+    std::uint64_t total = 0;
+    for (const shard &s: shards_)
+      total += s.value.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  void histogram::observe_ns(const std::uint64_t ns) noexcept
+  {
+    const std::uint64_t* const bound = std::lower_bound(std::begin(histogram_bounds_ns), std::end(histogram_bounds_ns), ns);
+    shard &s = shards_[thread_shard()];
+    s.buckets[bound - std::begin(histogram_bounds_ns)].fetch_add(1, std::memory_order_relaxed);
+    s.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  histogram::snapshot histogram::get() const noexcept
+  {
+    snapshot out{};
+    for (const shard &s: shards_)
+    {
+      for (std::size_t i = 0; i < histogram_bucket_count; ++i)
+      {
+        const std::uint64_t n = s.buckets[i].load(std::memory_order_relaxed);
+        out.buckets[i] += n;
+        out.count += n;
+      }
+      out.sum_ns += s.sum_ns.load(std::memory_order_relaxed);
+    }
+    return out;
+  }
+
+  counter& get_counter(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    registry& reg = get_registry();
+    const std::lock_guard<std::mutex> lock{reg.lock};
+    return get_metric(get_family(reg, name, help, metric_type::counter).counters, labels);
+  }
+
+  gauge& get_gauge(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    registry& reg = get_registry();
+    const std::lock_guard<std::mutex> lock{reg.lock};
+    return get_metric(get_family(reg, name, help, metric_type::gauge).gauges, labels);
+  }
+
+  histogram& get_histogram(const std::string &name, const std::string &help, const std::string &labels)
+  {
+    registry& reg = get_registry();
+    const std::lock_guard<std::mutex> lock{reg.lock};
+    return get_metric(get_family(reg, name, help, metric_type::histogram).histograms, labels);
+  }
+
+  std::string dump()
+  {
+    registry& reg = get_registry();
+    std::ostringstream out;
+    const std::lock_guard<std::mutex> lock{reg.lock};
+    for (const auto &f: reg.families)
+    {
+      const std::string &name = f.first;
+      out << "# HELP " << name << ' ' << f.second.help << '\n';
+      switch (f.second.type)
+      {
+      case metric_type::counter:
+        out << "# TYPE " << name << " counter\n";
+        for (const auto &m: f.second.counters)
+        {
+          write_name(out, name, "", m.first);
+          out << m.second->value() << '\n';
+        }
+        break;
+      case metric_type::gauge:
+        out << "# TYPE " << name << " gauge\n";
+        for (const auto &m: f.second.gauges)
+        {
+          write_name(out, name, "", m.first);
+          out << m.second->value() << '\n';
+        }
+        break;
+      case metric_type::histogram:
+        out << "# TYPE " << name << " histogram\n";
+        for (const auto &m: f.second.histograms)
+        {
+          const histogram::snapshot s = m.second->get();
+          std::uint64_t cumulative = 0;
+          for (std::size_t i = 0; i < histogram_bucket_count; ++i)
+          {
+            cumulative += s.buckets[i];
+            const std::string le = i + 1 < histogram_bucket_count ? seconds(histogram_bounds_ns[i]) : std::string{"+Inf"};
+            write_name(out, name, "_bucket", m.first, "le=\"" + le + "\"");
+            out << cumulative << '\n';
+          }
+          write_name(out, name, "_sum", m.first);
+          out << seconds(s.sum_ns) << '\n';
+          write_name(out, name, "_count", m.first);
+          out << s.count << '\n';
+        }
+        break;
+      }
+    }
+    return out.str();
+  }
+} // metrics
+} // epee
@@ -160,6 +160,16 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_compress_txs  = {
+  "db-compress-txs"
+, "Compress the transaction data added to the blockchain database, see monero-blockchain-compress to compress existing data"
+, false
+};
+const command_line::arg_descriptor<bool> arg_db_reserve_map  = {
+  "db-reserve-map"
+, "Reserve a 1 TB memory map for the blockchain database up front, so it does not need to stop to be resized as it grows. The map is only address space, but with --db-sync-mode fastest the file will be sparse and have that size"
+, false
+};
 
 BlockchainDB *new_db()
 {
@@ -170,6 +180,8 @@ void BlockchainDB::init_options(boost::program_options::options_description& des
 {
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_compress_txs);
+  command_line::add_arg(desc, arg_db_reserve_map);
 }
 
 void BlockchainDB::pop_block()
@@ -105,6 +105,8 @@ typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_compress_txs;
+extern const command_line::arg_descriptor<bool, false> arg_db_reserve_map;
 
 enum class relay_category : uint8_t
 {
@@ -193,6 +195,8 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_COMPRESS 0x20
+#define DBF_RESERVE_MAP 0x40
 
 /***********************************
  * Exception Definitions
@@ -0,0 +1,198 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "int-util.h"
+#include "misc_log_ex.h"
+#include "key_image_filter.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db"
+
+// 40 key images per 512 bit block is about 12.8 bits per key image, which
+// with 8 probes keeps false positives around 0.3% at capacity
+#define KEY_IMAGE_FILTER_KEYS_PER_BLOCK 40
+#define KEY_IMAGE_FILTER_PROBES 8
+#define KEY_IMAGE_FILTER_MAGIC 0x314649656b6f6d4dull
+#define KEY_IMAGE_FILTER_VERSION 1
+
+namespace
+{
+  struct filter_header
+  {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t num_blocks;
+    uint64_t num_key_images;
+    crypto::hash top_hash;
+  };
+
+  // the first 8 bytes pick the block, the next ones 9 bits each for the probes
+  uint64_t get_probes(const crypto::key_image &ki, uint64_t num_blocks, uint64_t mask[8])
+  {
+    uint64_t words[4];
+    memcpy_swap64le(words, &ki, sizeof(words) / sizeof(words[0]));
+    uint64_t block;
+    mul128(words[0], num_blocks, &block);
+    memset(mask, 0, 8 * sizeof(uint64_t));
+    for (unsigned int i = 0; i < KEY_IMAGE_FILTER_PROBES; ++i)
+    {
+      const uint64_t w = words[1 + i / 7];
+      const unsigned int bit = (w >> (9 * (i % 7))) & 511;
+      mask[bit / 64] |= ((uint64_t)1) << (bit % 64);
+    }
+    return block;
+  }
+}
+
+namespace cryptonote
+{
+
+key_image_filter::key_image_filter(uint64_t capacity):
+  m_num_blocks(std::max<uint64_t>(1, (capacity + KEY_IMAGE_FILTER_KEYS_PER_BLOCK - 1) / KEY_IMAGE_FILTER_KEYS_PER_BLOCK)),
+  m_blocks(new block_t[m_num_blocks]()),
+  m_size(0)
+{
+}
+
+void key_image_filter::insert(const crypto::key_image &ki)
+{
+  uint64_t mask[8];
+  block_t &b = m_blocks[get_probes(ki, m_num_blocks, mask)];
+  for (size_t i = 0; i < 8; ++i)
+    if (mask[i])
+      b.words[i].fetch_or(mask[i], std::memory_order_release);
+  m_size.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool key_image_filter::may_contain(const crypto::key_image &ki) const
+{
+  uint64_t mask[8];
+  const block_t &b = m_blocks[get_probes(ki, m_num_blocks, mask)];
+  for (size_t i = 0; i < 8; ++i)
+    if ((b.words[i].load(std::memory_order_acquire) & mask[i]) != mask[i])
+      return false;
+  return true;
+}
+
+uint64_t key_image_filter::capacity() const
+{
+  return m_num_blocks * KEY_IMAGE_FILTER_KEYS_PER_BLOCK;
+}
+
+bool key_image_filter::store(const std::string &filename, uint64_t num_key_images, const crypto::hash &top_hash) const
+{
+  // written aside and renamed, so an interrupted write can't leave a valid
+  // looking header in front of a truncated filter
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      MERROR("Failed to open " << tmp_filename << " for writing");
+      return false;
+    }
+    const filter_header header{KEY_IMAGE_FILTER_MAGIC, KEY_IMAGE_FILTER_VERSION, m_num_blocks, num_key_images, top_hash};
+    out.write((const char*)&header, sizeof(header));
+    std::vector<uint64_t> buffer;
+    buffer.reserve(8 * 1024);
+    for (uint64_t b = 0; b < m_num_blocks && out; ++b)
+    {
+      for (size_t i = 0; i < 8; ++i)
+        buffer.push_back(m_blocks[b].words[i].load(std::memory_order_relaxed));
+      if (buffer.size() == buffer.capacity() || b + 1 == m_num_blocks)
+      {
+        out.write((const char*)buffer.data(), buffer.size() * sizeof(uint64_t));
+        buffer.clear();
+      }
+    }
+    if (!out)
+    {
+      MERROR("Failed to write " << tmp_filename);
+      out.close();
+      boost::system::error_code ec;
+      boost::filesystem::remove(tmp_filename, ec);
+      return false;
+    }
+  }
+  boost::system::error_code ec;
+  boost::filesystem::rename(tmp_filename, filename, ec);
+  if (ec)
+  {
+    MERROR("Failed to rename " << tmp_filename << " to " << filename << ": " << ec.message());
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<key_image_filter> key_image_filter::load(const std::string &filename, uint64_t num_key_images, const crypto::hash &top_hash)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+    return nullptr;
+  filter_header header;
+  if (!in.read((char*)&header, sizeof(header)))
+    return nullptr;
+  if (header.magic != KEY_IMAGE_FILTER_MAGIC || header.version != KEY_IMAGE_FILTER_VERSION)
+  {
+    MINFO("Ignoring key image filter " << filename << " of unknown format");
+    return nullptr;
+  }
+  if (header.num_key_images != num_key_images || header.top_hash != top_hash)
+  {
+    MINFO("Ignoring stale key image filter " << filename);
+    return nullptr;
+  }
+  if (header.num_blocks == 0 || header.num_blocks > std::numeric_limits<uint64_t>::max() / (64 * KEY_IMAGE_FILTER_KEYS_PER_BLOCK))
+    return nullptr;
+  boost::system::error_code ec;
+  const uint64_t file_size = boost::filesystem::file_size(filename, ec);
+  if (ec || file_size != sizeof(header) + header.num_blocks * 64)
+    return nullptr;
+
+  std::unique_ptr<key_image_filter> filter(new key_image_filter(header.num_blocks * KEY_IMAGE_FILTER_KEYS_PER_BLOCK));
+  std::vector<uint64_t> buffer(8 * 1024);
+  for (uint64_t b = 0; b < header.num_blocks; )
+  {
+    const uint64_t n = std::min<uint64_t>(header.num_blocks - b, buffer.size() / 8);
+    if (!in.read((char*)buffer.data(), n * 64))
+      return nullptr;
+    for (uint64_t j = 0; j < n; ++j, ++b)
+      for (size_t i = 0; i < 8; ++i)
+        filter->m_blocks[b].words[i].store(buffer[j * 8 + i], std::memory_order_relaxed);
+  }
+  filter->m_size = num_key_images;
+  return filter;
+}
+
+}  // namespace cryptonote
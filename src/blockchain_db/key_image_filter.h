@@ -0,0 +1,113 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+/**
+ * @brief a blocked Bloom filter over spent key images
+ *
+ * Each key image sets a few bits within a single cache line, picked from the
+ * key image bytes themselves, which are already uniformly distributed.  A
+ * negative answer is definite, a positive one has to be confirmed against
+ * the database.  There is no removal: a key image taken out of the chain by
+ * a pop leaves its bits set, which costs a false positive until the next
+ * rebuild, never a false negative.
+ *
+ * Inserts come from the db writer thread only, lookups may come from any
+ * thread concurrently with it.
+ */
+class key_image_filter
+{
+public:
+  /**
+   * @brief creates an empty filter sized for a number of key images
+   *
+   * @param capacity the number of key images the filter is sized for
+   */
+  key_image_filter(uint64_t capacity);
+
+  /**
+   * @brief adds a key image to the filter
+   */
+  void insert(const crypto::key_image &ki);
+
+  /**
+   * @brief checks whether a key image may be in the filter
+   *
+   * @return false if the key image was never inserted, true otherwise
+   */
+  bool may_contain(const crypto::key_image &ki) const;
+
+  /**
+   * @brief the number of key images the filter is sized for
+   */
+  uint64_t capacity() const;
+
+  /**
+   * @brief the number of insertions since the filter was created or loaded,
+   * plus the number of key images it was loaded with
+   */
+  uint64_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief writes the filter to a file
+   *
+   * The number of key images and the top block hash identify the database
+   * state the filter covers, and must be passed back to load it.
+   */
+  bool store(const std::string &filename, uint64_t num_key_images, const crypto::hash &top_hash) const;
+
+  /**
+   * @brief reads a filter stored for the given database state
+   *
+   * @return the filter, or nullptr if the file is missing, damaged, or was
+   * stored for a different database state
+   */
+  static std::unique_ptr<key_image_filter> load(const std::string &filename, uint64_t num_key_images, const crypto::hash &top_hash);
+
+private:
+  struct alignas(64) block_t
+  {
+    std::atomic<uint64_t> words[8];
+  };
+
+  const uint64_t m_num_blocks;
+  std::unique_ptr<block_t[]> m_blocks;
+  std::atomic<uint64_t> m_size;
+};
+
+}  // namespace cryptonote
@@ -40,6 +40,7 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
+#include "metrics.h"
 #include "ringct/rctOps.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -54,7 +55,23 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 5
+#define VERSION 6
+// Version 6 only adds compressed tx data. A db stays at version 5, which
+// older code can still read, until compressed data or a dictionary is written
+#define UNCOMPRESSED_VERSION 5
+
+// Lookups of at least this many outputs are sorted and served page by page
+#define BATCHED_OUTPUT_KEY_LOOKUP_THRESHOLD 64
+
+// The spent key image filter lives next to the db files, and is sized with
+// some headroom so it doesn't need rebuilding again soon after a rebuild
+#define KEY_IMAGE_FILTER_FILENAME "spent_keys.filter"
+#define KEY_IMAGE_FILTER_MIN_CAPACITY (1 << 18)
+
+// zstd level for tx data added with DBF_COMPRESS, kept low since it is on the block add path
+#define TX_COMPRESSION_LEVEL 3
+// records sampled to train a tx data dictionary
+#define TX_DICTIONARY_SAMPLES 20000
 
 namespace
 {
@@ -174,6 +191,28 @@ int BlockchainLMDB::compare_string(const MDB_val *a, const MDB_val *b)
   return 0;
 }
 
+// Records how long a write txn was held open, and how much of that was
+// spent in mdb_txn_commit
+static void observe_write_txn(bool batch, uint64_t start_ns, uint64_t commit_start_ns)
+{
+  static epee::metrics::histogram &write_txn = epee::metrics::get_histogram("monero_lmdb_txn_seconds", "Lifetime of LMDB write transactions", "type=\"write\"");
+  static epee::metrics::histogram &batch_txn = epee::metrics::get_histogram("monero_lmdb_txn_seconds", "Lifetime of LMDB write transactions", "type=\"batch\"");
+  static epee::metrics::histogram &write_commit = epee::metrics::get_histogram("monero_lmdb_commit_seconds", "Time spent committing LMDB write transactions", "type=\"write\"");
+  static epee::metrics::histogram &batch_commit = epee::metrics::get_histogram("monero_lmdb_commit_seconds", "Time spent committing LMDB write transactions", "type=\"batch\"");
+  const uint64_t now = epee::misc_utils::get_ns_count();
+  (batch ? batch_txn : write_txn).observe_ns(now - start_ns);
+  (batch ? batch_commit : write_commit).observe_ns(now - commit_start_ns);
+}
+
+// Records a map resize, which stalls every reader and writer while it lasts
+static void observe_resize(uint64_t start_ns)
+{
+  static epee::metrics::histogram &resize = epee::metrics::get_histogram("monero_lmdb_resize_seconds", "Time during which LMDB txns were stopped for a map resize");
+  const uint64_t elapsed = epee::misc_utils::get_ns_count() - start_ns;
+  resize.observe_ns(elapsed);
+  MGINFO("LMDB map resize took " << elapsed / 1000000 << " ms");
+}
+
 }
 
 namespace
@@ -204,6 +243,8 @@ namespace
  *
  * alt_blocks       block hash   {block data, block blob}
  *
+ * tx_dicts         dict ID      zstd dictionary for txs_pruned/txs_prunable
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -238,6 +279,8 @@ const char* const LMDB_HF_VERSIONS = "hf_versions";
 
 const char* const LMDB_PROPERTIES = "properties";
 
+const char* const LMDB_TX_DICTS = "tx_dicts";
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
@@ -253,6 +296,12 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
     throw0(cryptonote::DB_OPEN_FAILURE((lmdb_error(error_string + " : ", res) + std::string(" - you may want to start with --db-salvage")).c_str()));
 }
 
+// property holding the id of the dictionary new records of a table are compressed with
+const char *tx_dict_property(cryptonote::tx_blob_codec::table t)
+{
+  return t == cryptonote::tx_blob_codec::table::pruned ? "tx_dict_pruned" : "tx_dict_prunable";
+}
+
 
 }  // anonymous namespace
 
@@ -493,6 +542,7 @@ void mdb_txn_safe::increment_txns(int i)
 
 void lmdb_resized(MDB_env *env, int isactive)
 {
+  const uint64_t start_ns = epee::misc_utils::get_ns_count();
   mdb_txn_safe::prevent_new_txns();
 
   MGINFO("LMDB map resize detected.");
@@ -518,6 +568,7 @@ void lmdb_resized(MDB_env *env, int isactive)
   MGINFO("LMDB Mapsize increased." << "  Old: " << old / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
 
   mdb_txn_safe::allow_new_txns();
+  observe_resize(start_ns);
 }
 
 inline int lmdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **txn)
@@ -546,30 +597,42 @@ inline void BlockchainLMDB::check_open() const
     throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
 }
 
-void BlockchainLMDB::do_resize(uint64_t increase_size)
+uint64_t BlockchainLMDB::get_resized_mapsize(uint64_t mapsize, uint64_t page_size, uint64_t increase_size, uint64_t available)
 {
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  CRITICAL_REGION_LOCAL(m_synchronization_lock);
   const uint64_t add_size = 1LL << 30;
 
-  // check disk capacity
-  try
+  // Grow by a fraction of the current size, and by at least 1GB, so the
+  // number of resizes, which each stop all txns, grows with the log of the
+  // db size rather than linearly.
+  // If given, increase_size is a lower bound. This is currently used for
+  // increasing by an estimated size at start of new batch txn.
+  const uint64_t min_increase = std::max(add_size, increase_size);
+  uint64_t increase = std::max(min_increase, (uint64_t)(mapsize * RESIZE_GROWTH));
+
+  // the disk space check is for what the map really grows by, falling back
+  // to the least increase if the geometric one does not fit
+  if (available < increase)
   {
-    boost::filesystem::path path(m_folder);
-    boost::filesystem::space_info si = boost::filesystem::space(path);
-    if(si.available < add_size)
+    if (available < min_increase)
     {
       MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
-          (si.available >> 20L) << " MB available, " << (add_size >> 20L) << " MB needed");
-      return;
+          (available >> 20L) << " MB available, " << (min_increase >> 20L) << " MB needed");
+      return 0;
     }
-  }
-  catch(...)
-  {
-    // print something but proceed.
-    MWARNING("Unable to query free disk space.");
+    MWARNING("Low free disk space: extending database by " << (min_increase >> 20L) << " MB instead of " << (increase >> 20L) << " MB");
+    increase = min_increase;
   }
 
+  uint64_t new_mapsize = mapsize + increase;
+  new_mapsize += (new_mapsize % page_size);
+  return new_mapsize;
+}
+
+void BlockchainLMDB::do_resize(uint64_t increase_size)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  CRITICAL_REGION_LOCAL(m_synchronization_lock);
+
   MDB_envinfo mei;
 
   mdb_env_info(m_env, &mei);
@@ -578,17 +641,25 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
 
   mdb_env_stat(m_env, &mst);
 
-  // add 1Gb per resize, instead of doing a percentage increase
-  uint64_t new_mapsize = (uint64_t) mei.me_mapsize + add_size;
-
-  // If given, use increase_size instead of above way of resizing.
-  // This is currently used for increasing by an estimated size at start of new
-  // batch txn.
-  if (increase_size > 0)
-    new_mapsize = mei.me_mapsize + increase_size;
+  // check disk capacity
+  uint64_t available = std::numeric_limits<uint64_t>::max();
+  try
+  {
+    boost::filesystem::path path(m_folder);
+    boost::filesystem::space_info si = boost::filesystem::space(path);
+    available = si.available;
+  }
+  catch(...)
+  {
+    // print something but proceed.
+    MWARNING("Unable to query free disk space.");
+  }
 
-  new_mapsize += (new_mapsize % mst.ms_psize);
+  const uint64_t new_mapsize = get_resized_mapsize(mei.me_mapsize, mst.ms_psize, increase_size, available);
+  if (!new_mapsize)
+    return;
 
+  const uint64_t start_ns = epee::misc_utils::get_ns_count();
   mdb_txn_safe::prevent_new_txns();
 
   if (m_write_txn != nullptr)
@@ -612,6 +683,7 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
 
   mdb_txn_safe::allow_new_txns();
+  observe_resize(start_ns);
 }
 
 // threshold_size is used for batch transactions
@@ -940,11 +1012,21 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     throw0(DB_ERROR("pruned tx size is larger than tx size"));
 
   MDB_val pruned_blob = {unprunable_size, (void*)blob.data()};
+  MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
+  std::string pruned_record, prunable_record;
+  if (m_tx_codec.level() > 0)
+  {
+    set_compressed_version(*m_write_txn);
+    m_tx_codec.encode(tx_blob_codec::table::pruned, {blob.data(), unprunable_size}, pruned_record);
+    m_tx_codec.encode(tx_blob_codec::table::prunable, {blob.data() + unprunable_size, blob.size() - unprunable_size}, prunable_record);
+    pruned_blob = {pruned_record.size(), (void*)pruned_record.data()};
+    prunable_blob = {prunable_record.size(), (void*)prunable_record.data()};
+  }
+
   result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
 
-  MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
   result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
@@ -1266,6 +1348,14 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
     else
       throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
   }
+
+  const std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter)
+  {
+    filter->insert(k_image);
+    if (filter->size() > filter->capacity())
+      rebuild_key_image_filter(filter->capacity() * 2);
+  }
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -1286,6 +1376,178 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
   }
+  // the key image filter can't forget it, it'll be a false positive there
+}
+
+uint64_t BlockchainLMDB::num_spent_keys() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+
+  MDB_stat db_stats;
+  if (auto result = mdb_stat(m_txn, m_spent_keys, &db_stats))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+  return db_stats.ms_entries;
+}
+
+std::string BlockchainLMDB::get_key_image_filter_filename() const
+{
+  return (boost::filesystem::path(m_folder) / KEY_IMAGE_FILTER_FILENAME).string();
+}
+
+void BlockchainLMDB::init_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (is_read_only())
+    return;
+
+  std::unique_ptr<key_image_filter> filter = key_image_filter::load(get_key_image_filter_filename(), num_spent_keys(), top_block_hash());
+  if (filter)
+  {
+    MDEBUG("Loaded key image filter for " << filter->size() << " key images");
+    std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>(std::move(filter)));
+  }
+  else
+  {
+    rebuild_key_image_filter(0);
+  }
+}
+
+void BlockchainLMDB::init_tx_blob_codec(int level)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(properties)
+  if (m_tx_dicts)
+    m_tx_codec.load(m_txn, m_tx_dicts);
+  for (const tx_blob_codec::table t: {tx_blob_codec::table::pruned, tx_blob_codec::table::prunable})
+  {
+    MDB_val_str(k, tx_dict_property(t));
+    MDB_val v;
+    int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      continue;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve tx dictionary id: ", result).c_str()));
+    if (v.mv_size != sizeof(uint32_t))
+      throw0(DB_ERROR("Failed to retrieve tx dictionary id: unexpected value size"));
+    uint32_t id;
+    memcpy(&id, v.mv_data, sizeof(id));
+    m_tx_codec.use_dictionary(t, id);
+  }
+  TXN_POSTFIX_RDONLY();
+
+  m_tx_codec.set_level(level);
+  if (m_tx_codec.level() > 0)
+    MINFO("New transaction data will be compressed at level " << m_tx_codec.level());
+}
+
+void BlockchainLMDB::set_compressed_version(MDB_txn *txn)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  // looked up every time, as a version written in a txn which is then aborted is lost
+  MDB_val_str(k, "version");
+  MDB_val v;
+  int result = mdb_get(txn, m_properties, &k, &v);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve db version: ", result).c_str()));
+  if (!result && v.mv_size == sizeof(uint32_t) && *(const uint32_t*)v.mv_data >= VERSION)
+    return;
+
+  MDB_val_copy<uint32_t> vv(VERSION);
+  if ((result = mdb_put(txn, m_properties, &k, &vv, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+}
+
+void BlockchainLMDB::rebuild_key_image_filter(uint64_t min_capacity)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  // on the writer thread, this sees the key images added by the current txn
+  TXN_PREFIX_RDONLY();
+  RCURSOR(spent_keys);
+
+  const uint64_t n_keys = num_spent_keys();
+  MINFO("Building key image filter for " << n_keys << " key images");
+  const uint64_t capacity = std::max<uint64_t>({min_capacity, n_keys + n_keys / 4, m_key_image_filter_min_capacity});
+  std::shared_ptr<key_image_filter> filter = std::make_shared<key_image_filter>(capacity);
+
+  // all the key images are dups of the same zero key, a page at a time
+  MDB_val k = zerokval, v;
+  int result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_SET);
+  if (!result)
+    result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_GET_MULTIPLE);
+  while (!result)
+  {
+    const crypto::key_image *ki = (const crypto::key_image*)v.mv_data;
+    for (size_t i = 0; i < v.mv_size / sizeof(crypto::key_image); ++i)
+      filter->insert(ki[i]);
+    result = mdb_cursor_get(m_cur_spent_keys, &k, &v, MDB_NEXT_MULTIPLE);
+  }
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate key images: ", result).c_str()));
+
+  TXN_POSTFIX_RDONLY();
+
+  std::atomic_store(&m_key_image_filter, filter);
+}
+
+void BlockchainLMDB::store_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (!filter || is_read_only())
+    return;
+
+  try
+  {
+    if (filter->store(get_key_image_filter_filename(), num_spent_keys(), top_block_hash()))
+      MDEBUG("Stored key image filter for " << filter->size() << " key images");
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Failed to store key image filter: " << e.what());
+  }
+}
+
+void BlockchainLMDB::enable_key_image_filter(bool enable, uint64_t min_capacity)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  m_key_image_filter_min_capacity = min_capacity ? min_capacity : KEY_IMAGE_FILTER_MIN_CAPACITY;
+  if (!enable)
+    std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
+  else if (!std::atomic_load(&m_key_image_filter) && !is_read_only())
+  {
+    // a read txn would miss the key images of a batch in progress, so build
+    // it as the writer; this throws if another thread is writing
+    block_wtxn_start();
+    try
+    {
+      rebuild_key_image_filter(0);
+    }
+    catch (...)
+    {
+      block_wtxn_abort();
+      throw;
+    }
+    // nothing was written, and aborting leaves a batch alone
+    block_wtxn_abort();
+  }
+}
+
+uint64_t BlockchainLMDB::get_key_image_filter_capacity() const
+{
+  const std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  return filter ? filter->capacity() : 0;
 }
 
 BlockchainLMDB::~BlockchainLMDB()
@@ -1313,6 +1575,8 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_write_txn_start_ns = 0;
+  m_key_image_filter_min_capacity = KEY_IMAGE_FILTER_MIN_CAPACITY;
   m_cum_size = 0;
   m_cum_count = 0;
 
@@ -1374,6 +1638,16 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     throw0(DB_ERROR(lmdb_error("Failed to set max number of readers: ", result).c_str()));
 
   size_t mapsize = DEFAULT_MAPSIZE;
+  if ((db_flags & DBF_RESERVE_MAP) && !(db_flags & DBF_RDONLY))
+  {
+    // the map is only address space, pages get backed as the db grows into
+    // it, so reserving a lot of it up front means resizes, and their stall
+    // of all txns, are not needed until the db gets that big
+    if (sizeof(size_t) < sizeof(uint64_t))
+      MWARNING("Cannot reserve a large LMDB map on a 32 bit system");
+    else
+      mapsize = (size_t)RESERVED_MAPSIZE;
+  }
 
   if (db_flags & DBF_FAST)
     mdb_flags |= MDB_NOSYNC;
@@ -1452,6 +1726,14 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
+  // added in version 6, so a read-only open of an older db may not find it
+  if (!(mdb_flags & MDB_RDONLY))
+    lmdb_db_open(txn, LMDB_TX_DICTS, MDB_INTEGERKEY | MDB_CREATE, m_tx_dicts, "Failed to open db handle for m_tx_dicts");
+  else if ((result = mdb_dbi_open(txn, LMDB_TX_DICTS, MDB_INTEGERKEY, &m_tx_dicts)) == MDB_NOTFOUND)
+    m_tx_dicts = 0; // the free list's handle, never returned for a named db
+  else if (result)
+    throw0(DB_OPEN_FAILURE(lmdb_error("Failed to open db handle for m_tx_dicts: ", result).c_str()));
+
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
   mdb_set_dupsort(txn, m_block_heights, compare_hash32);
   mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
@@ -1496,7 +1778,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
       compatible = false;
     }
 #if VERSION > 0
-    else if (db_version < VERSION)
+    else if (db_version < UNCOMPRESSED_VERSION)
     {
       if (mdb_flags & MDB_RDONLY)
       {
@@ -1513,6 +1795,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
       txn.commit();
       m_open = true;
       migrate(db_version);
+      init_key_image_filter();
+      init_tx_blob_codec(db_flags & DBF_COMPRESS ? TX_COMPRESSION_LEVEL : 0);
       return;
     }
 #endif
@@ -1542,7 +1826,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     if (m_height == 0)
     {
       MDB_val_str(k, "version");
-      MDB_val_copy<uint32_t> v(VERSION);
+      MDB_val_copy<uint32_t> v(UNCOMPRESSED_VERSION);
       auto put_result = mdb_put(txn, m_properties, &k, &v, 0);
       if (put_result != MDB_SUCCESS)
       {
@@ -1559,6 +1843,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   txn.commit();
 
   m_open = true;
+
+  init_key_image_filter();
+  init_tx_blob_codec(db_flags & DBF_COMPRESS ? TX_COMPRESSION_LEVEL : 0);
   // from here, init should be finished
 }
 
@@ -1571,6 +1858,8 @@ void BlockchainLMDB::close()
     BlockchainLMDB::batch_abort();
   }
   BlockchainLMDB::sync();
+  store_key_image_filter();
+  std::atomic_store(&m_key_image_filter, std::shared_ptr<key_image_filter>());
   m_tinfo.reset();
 
   // FIXME: not yet thread safe!!!  Use with care.
@@ -1638,16 +1927,26 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_properties, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_tx_dicts, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_tx_dicts: ", result).c_str()));
 
   // init with current version
   MDB_val_str(k, "version");
-  MDB_val_copy<uint32_t> v(VERSION);
+  MDB_val_copy<uint32_t> v(UNCOMPRESSED_VERSION);
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
 
+  // forget the dropped dictionaries, keeping the level
+  const int level = m_tx_codec.level();
+  m_tx_codec.load(txn, m_tx_dicts);
+  m_tx_codec.set_level(level);
+
   txn.commit();
   m_cum_size = 0;
   m_cum_count = 0;
+
+  if (std::atomic_load(&m_key_image_filter))
+    std::atomic_store(&m_key_image_filter, std::make_shared<key_image_filter>(m_key_image_filter_min_capacity));
 }
 
 std::vector<std::string> BlockchainLMDB::get_filenames() const
@@ -1660,8 +1959,12 @@ std::vector<std::string> BlockchainLMDB::get_filenames() const
   boost::filesystem::path lockfile(m_folder);
   lockfile /= CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME;
 
+  boost::filesystem::path filterfile(m_folder);
+  filterfile /= KEY_IMAGE_FILTER_FILENAME;
+
   filenames.push_back(datafile.string());
   filenames.push_back(lockfile.string());
+  filenames.push_back(filterfile.string());
 
   return filenames;
 }
@@ -1672,6 +1975,7 @@ bool BlockchainLMDB::remove_data_file(const std::string& folder) const
   try
   {
     boost::filesystem::remove(filename);
+    boost::filesystem::remove(folder + "/" KEY_IMAGE_FILTER_FILENAME);
   }
   catch (const std::exception &e)
   {
@@ -1954,7 +2258,7 @@ uint32_t BlockchainLMDB::get_blockchain_pruning_seed() const
   return pruning_seed;
 }
 
-static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
+static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id, const tx_blob_codec &codec)
 {
   MDB_val v;
   int ret = mdb_cursor_get(c_txs_pruned, tx_id, &v, MDB_SET);
@@ -1962,7 +2266,11 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
     throw0(DB_ERROR(lmdb_error("Failed to find transaction pruned data: ", ret).c_str()));
   if (v.mv_size == 0)
     throw0(DB_ERROR("Invalid transaction pruned data"));
-  return cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
+  if (!tx_blob_codec::is_encoded(v))
+    return cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
+  cryptonote::blobdata bd;
+  codec.decode(tx_blob_codec::table::pruned, v, true, bd);
+  return cryptonote::is_v1_tx(bd);
 }
 
 enum { prune_mode_prune, prune_mode_update, prune_mode_check };
@@ -2071,7 +2379,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS < blockchain_height)
       {
         ++n_total_records;
-        if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &k))
+        if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &k, m_tx_codec))
         {
           ++n_prunable_records;
           result = mdb_cursor_get(c_txs_prunable, &k, &v, MDB_SET);
@@ -2157,7 +2465,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
         }
       }
       MDB_val_set(kp, ti.data.tx_id);
-      if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
+      if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp, m_tx_codec))
       {
         result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
         if (result && result != MDB_NOTFOUND)
@@ -2265,6 +2573,181 @@ bool BlockchainLMDB::check_pruning()
   return prune_worker(prune_mode_check, 0);
 }
 
+std::string BlockchainLMDB::train_tx_dictionary(MDB_dbi dbi, size_t dict_size) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const tx_blob_codec::table t = dbi == m_txs_pruned ? tx_blob_codec::table::pruned : tx_blob_codec::table::prunable;
+
+  mdb_txn_safe txn;
+  if (auto result = lmdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  MDB_cursor *c_records, *c_pruned;
+  if (auto result = mdb_cursor_open(txn, dbi, &c_records))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor: ", result).c_str()));
+  if (auto result = mdb_cursor_open(txn, m_txs_pruned, &c_pruned))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+
+  MDB_stat db_stats;
+  if (auto result = mdb_stat(txn, dbi, &db_stats))
+    throw0(DB_ERROR(lmdb_error("Failed to query tx data: ", result).c_str()));
+  MDB_val k, v, pv;
+  int result = mdb_cursor_get(c_records, &k, &v, MDB_LAST);
+  if (result == MDB_NOTFOUND)
+    return {};
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get tx data: ", result).c_str()));
+  const uint64_t last_tx_id = *(const uint64_t*)k.mv_data;
+
+  // spread the samples over the whole chain, the format of old and recent txes differs a lot
+  std::vector<std::string> samples;
+  const uint64_t step = std::max<uint64_t>(1, last_tx_id / TX_DICTIONARY_SAMPLES);
+  for (uint64_t tx_id = 0; tx_id <= last_tx_id && samples.size() < TX_DICTIONARY_SAMPLES; tx_id += step)
+  {
+    MDB_val_set(key, tx_id);
+    result = mdb_cursor_get(c_records, &key, &v, MDB_SET_RANGE);
+    if (result == MDB_NOTFOUND)
+      break;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to get tx data: ", result).c_str()));
+    bool encoded = tx_blob_codec::is_encoded(v);
+    if (t == tx_blob_codec::table::prunable)
+    {
+      if ((result = mdb_cursor_get(c_pruned, &key, &pv, MDB_SET)))
+        throw0(DB_ERROR(lmdb_error("Failed to get pruned tx data: ", result).c_str()));
+      encoded = tx_blob_codec::is_encoded(pv);
+    }
+    samples.emplace_back();
+    m_tx_codec.decode(t, v, encoded, samples.back());
+    if (samples.back().empty())
+      samples.pop_back();
+  }
+  txn.commit();
+
+  MINFO("Training a " << dict_size << " byte dictionary for " << (t == tx_blob_codec::table::pruned ? "pruned" : "prunable") << " tx data from " << samples.size() << " samples");
+  return tx_blob_codec::train(samples, dict_size);
+}
+
+void BlockchainLMDB::compress_tx_data(int level, size_t dict_size, bool retrain)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!tx_blob_codec::available())
+    throw0(DB_ERROR("Built without zstd support"));
+  if (m_write_txn)
+    throw0(DB_ERROR("Cannot compress tx data with a write txn in progress"));
+
+  const int old_level = m_tx_codec.level();
+  m_tx_codec.set_level(level);
+  epee::misc_utils::auto_scope_leave_caller restore_level = epee::misc_utils::create_scope_leave_handler([&](){ m_tx_codec.set_level(old_level); });
+
+  mdb_txn_safe txn(false);
+  for (const tx_blob_codec::table t: {tx_blob_codec::table::pruned, tx_blob_codec::table::prunable})
+  {
+    if (!dict_size || (m_tx_codec.dictionary(t) && !retrain))
+      continue;
+    std::string dict = train_tx_dictionary(t == tx_blob_codec::table::pruned ? m_txs_pruned : m_txs_prunable, dict_size);
+    if (dict.empty())
+      continue;
+    MDB_val v = {dict.size(), (void*)dict.data()};
+    const uint32_t id = m_tx_codec.add_dictionary(t, std::move(dict));
+
+    if (auto result = mdb_txn_begin(m_env, NULL, 0, txn))
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    set_compressed_version(txn);
+    MDB_val_set(k, id);
+    // v still points to the dictionary, now owned by the codec
+    if (auto result = mdb_put(txn, m_tx_dicts, &k, &v, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to add tx dictionary: ", result).c_str()));
+    MDB_val_str(pk, tx_dict_property(t));
+    MDB_val_set(pv, id);
+    if (auto result = mdb_put(txn, m_properties, &pk, &pv, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to set tx dictionary: ", result).c_str()));
+    txn.commit();
+    MINFO("Using dictionary " << id << " for new " << (t == tx_blob_codec::table::pruned ? "pruned" : "prunable") << " tx data");
+  }
+
+  MDB_stat db_stats;
+  if (auto result = mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  if (auto result = mdb_stat(txn, m_txs_pruned, &db_stats))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_txs_pruned: ", result).c_str()));
+  txn.commit();
+  const uint64_t n_txes = db_stats.ms_entries;
+
+  uint64_t tx_id = 0, n_compressed = 0, bytes_before = 0, bytes_after = 0;
+  std::string raw, pruned_record, prunable_record;
+  bool done = false;
+  while (!done)
+  {
+    if (need_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map needs to be resized, doing that now.");
+      do_resize();
+    }
+
+    if (auto result = mdb_txn_begin(m_env, NULL, 0, txn))
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    MDB_cursor *c_pruned, *c_prunable;
+    if (auto result = mdb_cursor_open(txn, m_txs_pruned, &c_pruned))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+    if (auto result = mdb_cursor_open(txn, m_txs_prunable, &c_prunable))
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+
+    MDB_val_set(k, tx_id);
+    MDB_val v;
+    MDB_cursor_op op = MDB_SET_RANGE;
+    for (size_t n = 0; n < 1000; ++n)
+    {
+      int result = mdb_cursor_get(c_pruned, &k, &v, op);
+      op = MDB_NEXT;
+      if (result == MDB_NOTFOUND)
+      {
+        done = true;
+        break;
+      }
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get pruned tx data: ", result).c_str()));
+      // record pointers are invalidated by writes, copy what is needed first
+      const uint64_t id = *(const uint64_t*)k.mv_data;
+      tx_id = id + 1;
+      if (tx_blob_codec::is_encoded(v))
+        continue;
+
+      if (!n_compressed)
+        set_compressed_version(txn);
+      bytes_before += v.mv_size;
+      m_tx_codec.encode(tx_blob_codec::table::pruned, {(const char*)v.mv_data, v.mv_size}, pruned_record);
+      MDB_val_set(pk, id);
+      MDB_val pv;
+      result = mdb_cursor_get(c_prunable, &pk, &pv, MDB_SET);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data: ", result).c_str()));
+      if (!result)
+      {
+        // pruned dbs may only have the pruned record
+        bytes_before += pv.mv_size;
+        m_tx_codec.encode(tx_blob_codec::table::prunable, {(const char*)pv.mv_data, pv.mv_size}, prunable_record);
+        MDB_val nv = {prunable_record.size(), (void*)prunable_record.data()};
+        if ((result = mdb_cursor_put(c_prunable, &pk, &nv, MDB_CURRENT)))
+          throw0(DB_ERROR(lmdb_error("Failed to update prunable tx data: ", result).c_str()));
+        bytes_after += nv.mv_size;
+      }
+      MDB_val nv = {pruned_record.size(), (void*)pruned_record.data()};
+      MDB_val_set(kk, id);
+      if ((result = mdb_cursor_put(c_pruned, &kk, &nv, MDB_CURRENT)))
+        throw0(DB_ERROR(lmdb_error("Failed to update pruned tx data: ", result).c_str()));
+      bytes_after += nv.mv_size;
+      ++n_compressed;
+    }
+    txn.commit();
+    if (ELPP->vRegistry()->allowed(el::Level::Info, "global")) {
+      std::cout << std::min(tx_id, n_txes) << " / " << n_txes << "  \r" << std::flush;
+    }
+  }
+
+  MGINFO("Compressed " << n_compressed << " txes, from " << bytes_before << " to " << bytes_after << " bytes");
+}
+
 bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata_ref*)> f, bool include_blob, relay_category category) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3048,8 +3531,10 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
-  bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
+  const bool encoded = tx_blob_codec::is_encoded(result0);
+  bd.clear();
+  m_tx_codec.decode(tx_blob_codec::table::pruned, result0, encoded, bd);
+  m_tx_codec.decode(tx_blob_codec::table::prunable, result1, encoded, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3079,7 +3564,8 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd.clear();
+  m_tx_codec.decode(tx_blob_codec::table::pruned, result, tx_blob_codec::is_encoded(result), bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3120,7 +3606,8 @@ bool BlockchainLMDB::get_pruned_tx_blobs_from(const crypto::hash& h, size_t coun
       return false;
     if (res)
       throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx blob", res).c_str()));
-    bd.emplace_back(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+    bd.emplace_back();
+    m_tx_codec.decode(tx_blob_codec::table::pruned, result, tx_blob_codec::is_encoded(result), bd.back());
   }
 
   TXN_POSTFIX_RDONLY();
@@ -3260,14 +3747,15 @@ bool BlockchainLMDB::get_blocks_from(uint64_t start_height, size_t min_block_cou
       result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &v, op);
       if (result)
         throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-      tx_blob.assign((const char*)v.mv_data, v.mv_size);
+      const bool encoded = tx_blob_codec::is_encoded(v);
+      m_tx_codec.decode(tx_blob_codec::table::pruned, v, encoded, tx_blob);
 
       if (!pruned)
       {
         result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &v, op);
         if (result)
           throw0(DB_ERROR(lmdb_error("Error attempting to retrieve transaction data from the db: ", result).c_str()));
-        tx_blob.append(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+        m_tx_codec.decode(tx_blob_codec::table::prunable, v, encoded, tx_blob);
       }
       current_block.second.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
       size += current_block.second.back().second.size();
@@ -3289,23 +3777,28 @@ bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blo
 
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
   RCURSOR(txs_prunable);
 
   MDB_val_set(v, h);
-  MDB_val result;
+  MDB_val pruned, result;
   auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
   if (get_result == 0)
   {
     const txindex *tip = (const txindex *)v.mv_data;
     MDB_val_set(val_tx_id, tip->data.tx_id);
-    get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
+    // the pruned record says how the prunable one is encoded
+    get_result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &pruned, MDB_SET);
+    if (get_result == 0)
+      get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &result, MDB_SET);
   }
   if (get_result == MDB_NOTFOUND)
     return false;
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd.clear();
+  m_tx_codec.decode(tx_blob_codec::table::prunable, result, tx_blob_codec::is_encoded(pruned), bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -3540,6 +4033,10 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
 
   bool ret;
 
+  const std::shared_ptr<key_image_filter> filter = std::atomic_load(&m_key_image_filter);
+  if (filter && !filter->may_contain(img))
+    return false;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(spent_keys);
 
@@ -3668,7 +4165,8 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     if (ret)
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     transaction tx;
-    if (pruned)
+    const bool encoded = tx_blob_codec::is_encoded(v);
+    if (pruned && !encoded)
     {
       blobdata_ref bd{reinterpret_cast<char*>(v.mv_data), v.mv_size};
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
@@ -3677,13 +4175,21 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     else
     {
       blobdata bd;
-      bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-      ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
-      if (ret)
-        throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
-      bd.append(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-      if (!parse_and_validate_tx_from_blob(bd, tx))
-        throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      m_tx_codec.decode(tx_blob_codec::table::pruned, v, encoded, bd);
+      if (pruned)
+      {
+        if (!parse_and_validate_tx_base_from_blob(bd, tx))
+          throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      }
+      else
+      {
+        ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
+        if (ret)
+          throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
+        m_tx_codec.decode(tx_blob_codec::table::prunable, v, encoded, bd);
+        if (!parse_and_validate_tx_from_blob(bd, tx))
+          throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+      }
     }
     if (!f(hash, tx)) {
       fret = false;
@@ -3801,6 +4307,7 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes
   // active
   m_write_batch_txn->m_batch_txn = true;
   m_write_txn = m_write_batch_txn;
+  m_write_txn_start_ns = epee::misc_utils::get_ns_count();
 
   m_batch_active = true;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
@@ -3830,10 +4337,12 @@ void BlockchainLMDB::batch_commit()
   check_open();
 
   LOG_PRINT_L3("batch transaction: committing...");
+  const uint64_t commit_start_ns = epee::misc_utils::get_ns_count();
   TIME_MEASURE_START(time1);
   m_write_txn->commit();
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
+  observe_write_txn(true, m_write_txn_start_ns, commit_start_ns);
   LOG_PRINT_L3("batch transaction: committed");
 
   m_write_txn = nullptr;
@@ -3865,12 +4374,14 @@ void BlockchainLMDB::batch_stop()
     throw1(DB_ERROR("batch transaction owned by other thread"));
   check_open();
   LOG_PRINT_L3("batch transaction: committing...");
+  const uint64_t commit_start_ns = epee::misc_utils::get_ns_count();
   TIME_MEASURE_START(time1);
   try
   {
     m_write_txn->commit();
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
+    observe_write_txn(true, m_write_txn_start_ns, commit_start_ns);
     cleanup_batch();
   }
   catch (const std::exception &e)
@@ -3996,6 +4507,7 @@ void BlockchainLMDB::block_wtxn_start()
       m_write_txn = nullptr;
       throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a transaction for the db: ", mdb_res).c_str()));
     }
+    m_write_txn_start_ns = epee::misc_utils::get_ns_count();
     memset(&m_wcursors, 0, sizeof(m_wcursors));
     if (m_tinfo.get())
     {
@@ -4017,10 +4529,12 @@ void BlockchainLMDB::block_wtxn_stop()
   {
     if (! m_batch_active)
 	{
+      const uint64_t commit_start_ns = epee::misc_utils::get_ns_count();
       TIME_MEASURE_START(time1);
       m_write_txn->commit();
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
+      observe_write_txn(false, m_write_txn_start_ns, commit_start_ns);
 
       delete m_write_txn;
       m_write_txn = nullptr;
@@ -4139,6 +4653,17 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   outputs.clear();
   outputs.reserve(offsets.size());
 
+  if (offsets.size() >= BATCHED_OUTPUT_KEY_LOOKUP_THRESHOLD)
+    get_output_key_batched(amounts, offsets, outputs, allow_partial);
+  else
+    get_output_key_sequential(amounts, offsets, outputs, allow_partial);
+
+  TIME_MEASURE_FINISH(db3);
+  LOG_PRINT_L3("db3: " << db3);
+}
+
+void BlockchainLMDB::get_output_key_sequential(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const
+{
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
@@ -4178,9 +4703,119 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   }
 
   TXN_POSTFIX_RDONLY();
+}
 
-  TIME_MEASURE_FINISH(db3);
-  LOG_PRINT_L3("db3: " << db3);
+void BlockchainLMDB::get_output_key_batched(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const
+{
+  const size_t n_outputs = offsets.size();
+  auto amount_of = [&](size_t i) { return amounts.size() == 1 ? amounts[0] : amounts[i]; };
+
+  // visit the requested outputs in (amount, index) order, so the cursor only
+  // ever moves forward and neighbouring ring members share a leaf page
+  std::vector<uint32_t> order(n_outputs);
+  for (size_t i = 0; i < n_outputs; ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const uint64_t amount_a = amount_of(a), amount_b = amount_of(b);
+    return amount_a < amount_b || (amount_a == amount_b && offsets[a] < offsets[b]);
+  });
+
+  outputs.resize(n_outputs);
+  std::vector<bool> found(n_outputs, false);
+
+  TXN_PREFIX_RDONLY();
+
+  RCURSOR(output_amounts);
+
+  // the duplicates of an amount are fixed size records with contiguous amount
+  // indices, so once a page is fetched with MDB_GET_MULTIPLE, any following
+  // request which falls within it is read straight from the page
+  const uint8_t *page = NULL;
+  size_t page_records = 0, record_size = 0;
+  uint64_t page_amount = 0, page_first = 0;
+  uint64_t commitment_amount = 0;
+  rct::key commitment;
+
+  for (size_t n = 0; n < n_outputs; ++n)
+  {
+    const size_t i = order[n];
+    const uint64_t amount = amount_of(i);
+    const uint64_t index = offsets[i];
+
+    if (!page || amount != page_amount || index < page_first || index - page_first >= page_records)
+    {
+      page = NULL;
+      MDB_val_set(k, amount);
+      MDB_val_set(v, index);
+      int get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
+      if (get_result == MDB_NOTFOUND)
+        continue;
+      else if (get_result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
+
+      page_amount = amount;
+      record_size = amount == 0 ? sizeof(outkey) : sizeof(pre_rct_outkey);
+
+      // a lone duplicate is stored inline, with no page to fetch
+      MDB_val p = {0, NULL};
+      get_result = mdb_cursor_get(m_cur_output_amounts, &k, &p, MDB_GET_MULTIPLE);
+      if (get_result == 0 && p.mv_size >= record_size && p.mv_size % record_size == 0)
+      {
+        page = (const uint8_t *)p.mv_data;
+        page_records = p.mv_size / record_size;
+        page_first = *(const uint64_t *)page;
+        const uint64_t page_last = *(const uint64_t *)(page + (page_records - 1) * record_size);
+        if (page_last - page_first + 1 != page_records || index < page_first || index - page_first >= page_records)
+          page = NULL;
+      }
+      else if (get_result && get_result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve output pubkeys from the db", get_result).c_str()));
+      if (!page)
+      {
+        page = (const uint8_t *)v.mv_data;
+        page_records = 1;
+        page_first = index;
+      }
+    }
+
+    const uint8_t *record = page + (index - page_first) * record_size;
+    if (amount == 0)
+    {
+      const outkey *okp = (const outkey *)record;
+      outputs[i] = okp->data;
+    }
+    else
+    {
+      const pre_rct_outkey *okp = (const pre_rct_outkey *)record;
+      output_data_t &data = outputs[i];
+      memcpy(&data, &okp->data, sizeof(pre_rct_output_data_t));
+      if (amount != commitment_amount)
+      {
+        commitment = rct::zeroCommit(amount);
+        commitment_amount = amount;
+      }
+      data.commitment = commitment;
+    }
+    found[i] = true;
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  // same contract as the sequential lookup: results stop at the first
+  // missing output in request order
+  for (size_t i = 0; i < n_outputs; ++i)
+  {
+    if (found[i])
+      continue;
+    if (allow_partial)
+    {
+      MDEBUG("Partial result: " << i << "/" << n_outputs);
+      outputs.resize(i);
+      return;
+    }
+    const uint64_t amount = amount_of(i);
+    throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + boost::lexical_cast<std::string>(amount) + ", index " + boost::lexical_cast<std::string>(offsets[i]) + ", count " + boost::lexical_cast<std::string>(get_num_outputs(amount)) + "), but key does not exist (current height " + boost::lexical_cast<std::string>(height()) + ")").c_str()));
+  }
 }
 
 void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
@@ -29,6 +29,8 @@
 #include <atomic>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/key_image_filter.h"
+#include "blockchain_db/tx_blob_codec.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
@@ -282,6 +284,30 @@ public:
 
   virtual bool has_key_image(const crypto::key_image& img) const;
 
+  /**
+   * @brief turns the in-memory spent key image filter on or off
+   *
+   * It is on by default for writable databases.  A read-only instance can't
+   * see key images added by another process, so it never keeps one.
+   *
+   * Turning it on builds the filter in a write txn, so that key images added
+   * by a batch in progress on this thread are included.  If another thread
+   * holds the write or batch txn, this throws DB_ERROR_TXN_START.
+   *
+   * @param enable whether to keep the filter
+   * @param min_capacity the fewest key images the filter is sized for, 0 for
+   * the default; mostly useful for tests, which can't add enough key images
+   * to fill the default one
+   */
+  void enable_key_image_filter(bool enable, uint64_t min_capacity = 0);
+
+  /**
+   * @brief gets how many key images the filter holds before it is rebuilt
+   *
+   * @return the capacity, or 0 if there is no filter
+   */
+  uint64_t get_key_image_filter_capacity() const;
+
   virtual void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata_ref &blob, const txpool_tx_meta_t& meta);
   virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta);
   virtual uint64_t get_txpool_tx_count(relay_category category = relay_category::broadcasted) const;
@@ -291,6 +317,19 @@ public:
   virtual bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata& bd, relay_category tx_category) const;
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
+  /**
+   * @brief compresses the stored pruned and prunable tx data in place
+   *
+   * Records which are already compressed are skipped, so this may be
+   * interrupted and run again.  New records are only compressed when the
+   * db was opened with DBF_COMPRESS.
+   *
+   * @param level the zstd compression level
+   * @param dict_size the size of the dictionaries to train, 0 for none
+   * @param retrain whether to train new dictionaries if some already exist
+   */
+  void compress_tx_data(int level, size_t dict_size, bool retrain);
+
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
   virtual bool update_pruning();
   virtual bool check_pruning();
@@ -356,6 +395,22 @@ public:
   static int compare_hash32(const MDB_val *a, const MDB_val *b);
   static int compare_string(const MDB_val *a, const MDB_val *b);
 
+  /**
+   * @brief computes the map size to resize to
+   *
+   * The map grows by a fraction of its size, and by at least 1GB, or by
+   * increase_size if larger. If the free disk space is less than that, it
+   * only grows by the least of those which fits.
+   *
+   * @param mapsize the current map size
+   * @param page_size the db page size
+   * @param increase_size the least increase needed, 0 if none
+   * @param available the free disk space
+   *
+   * @return the new map size, or 0 if there is not enough free disk space
+   */
+  static uint64_t get_resized_mapsize(uint64_t mapsize, uint64_t page_size, uint64_t increase_size, uint64_t available);
+
 private:
   void do_resize(uint64_t size_increase=0);
 
@@ -399,8 +454,20 @@ private:
 
   virtual void remove_spent_key(const crypto::key_image& k_image);
 
+  uint64_t num_spent_keys() const;
+  std::string get_key_image_filter_filename() const;
+  void init_key_image_filter();
+  void rebuild_key_image_filter(uint64_t min_capacity);
+  void store_key_image_filter();
+  void init_tx_blob_codec(int level);
+  void set_compressed_version(MDB_txn *txn);
+  std::string train_tx_dictionary(MDB_dbi dbi, size_t dict_size) const;
+
   uint64_t num_outputs() const;
 
+  void get_output_key_sequential(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const;
+  void get_output_key_batched(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const;
+
   // Hard fork
   virtual void set_hard_fork_version(uint64_t height, uint8_t version);
   virtual uint8_t get_hard_fork_version(uint64_t height) const;
@@ -472,6 +539,7 @@ private:
   MDB_dbi m_hf_versions;
 
   MDB_dbi m_properties;
+  MDB_dbi m_tx_dicts;
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
@@ -482,10 +550,17 @@ private:
 
   bool m_batch_transactions; // support for batch transactions
   bool m_batch_active; // whether batch transaction is in progress
+  uint64_t m_write_txn_start_ns; // when the current write/batch txn began, for metrics
 
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
 
+  // swapped whole on rebuild, so always accessed through std::atomic_load/store
+  std::shared_ptr<key_image_filter> m_key_image_filter;
+  uint64_t m_key_image_filter_min_capacity;
+
+  tx_blob_codec m_tx_codec;
+
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
   constexpr static uint64_t DEFAULT_MAPSIZE = 1LL << 31;
@@ -497,7 +572,11 @@ private:
 #endif
 #endif
 
+  // map size reserved with DBF_RESERVE_MAP, large enough for many years of growth
+  constexpr static uint64_t RESERVED_MAPSIZE = 1LL << 40;
+
   constexpr static float RESIZE_PERCENT = 0.9f;
+  constexpr static float RESIZE_GROWTH = 0.25f;
 };
 
 }  // namespace cryptonote
@@ -0,0 +1,338 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/locks.hpp>
+#include <cstring>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+#include "misc_log_ex.h"
+#include "blockchain_db/blockchain_db.h"
+#include "tx_blob_codec.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain.db.lmdb"
+
+namespace
+{
+  enum: uint8_t { codec_raw = 0, codec_zstd = 1 };
+
+  // no tx comes close, this only guards against a corrupt frame header
+  constexpr const unsigned long long max_blob_size = 64 * 1024 * 1024;
+
+#ifdef HAVE_ZSTD
+  struct cctx_deleter { void operator()(ZSTD_CCtx *ctx) const { ZSTD_freeCCtx(ctx); } };
+  struct dctx_deleter { void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); } };
+
+  ZSTD_CCtx *get_cctx()
+  {
+    static thread_local std::unique_ptr<ZSTD_CCtx, cctx_deleter> ctx{ZSTD_createCCtx()};
+    if (!ctx)
+      throw cryptonote::DB_ERROR("Failed to create a zstd compression context");
+    return ctx.get();
+  }
+
+  ZSTD_DCtx *get_dctx()
+  {
+    static thread_local std::unique_ptr<ZSTD_DCtx, dctx_deleter> ctx{ZSTD_createDCtx()};
+    if (!ctx)
+      throw cryptonote::DB_ERROR("Failed to create a zstd decompression context");
+    return ctx.get();
+  }
+#endif
+}
+
+namespace cryptonote
+{
+
+struct tx_blob_codec::dictionary_t
+{
+  std::string data;
+#ifdef HAVE_ZSTD
+  ZSTD_DDict *ddict = nullptr;
+  ZSTD_CDict *cdict = nullptr;
+  int cdict_level = 0;
+
+  ~dictionary_t()
+  {
+    ZSTD_freeDDict(ddict);
+    ZSTD_freeCDict(cdict);
+  }
+
+  void prepare_compression(int level)
+  {
+    if (cdict && cdict_level == level)
+      return;
+    ZSTD_freeCDict(cdict);
+    cdict = ZSTD_createCDict(data.data(), data.size(), level);
+    if (!cdict)
+      throw DB_ERROR("Failed to create a zstd compression dictionary");
+    cdict_level = level;
+  }
+#endif
+};
+
+tx_blob_codec::tx_blob_codec(): m_current{0, 0}, m_level(0)
+{
+}
+
+tx_blob_codec::~tx_blob_codec()
+{
+}
+
+bool tx_blob_codec::available() noexcept
+{
+#ifdef HAVE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
+void tx_blob_codec::load(MDB_txn *txn, MDB_dbi dicts)
+{
+  MDB_cursor *cursor;
+  int result = mdb_cursor_open(txn, dicts, &cursor);
+  if (result)
+    throw DB_ERROR(std::string("Failed to open a cursor for tx_dicts: ").append(mdb_strerror(result)).c_str());
+
+  std::map<uint32_t, std::unique_ptr<dictionary_t>> dictionaries;
+  MDB_val k, v;
+  MDB_cursor_op op = MDB_FIRST;
+  while ((result = mdb_cursor_get(cursor, &k, &v, op)) == 0)
+  {
+    op = MDB_NEXT;
+    if (k.mv_size != sizeof(uint32_t))
+    {
+      mdb_cursor_close(cursor);
+      throw DB_ERROR("Invalid tx dictionary id");
+    }
+    uint32_t id;
+    memcpy(&id, k.mv_data, sizeof(id));
+    std::unique_ptr<dictionary_t> dict{new dictionary_t()};
+    dict->data.assign((const char*)v.mv_data, v.mv_size);
+#ifdef HAVE_ZSTD
+    dict->ddict = ZSTD_createDDict(dict->data.data(), dict->data.size());
+    if (!dict->ddict)
+    {
+      mdb_cursor_close(cursor);
+      throw DB_ERROR("Failed to load a tx dictionary");
+    }
+#endif
+    dictionaries[id] = std::move(dict);
+  }
+  mdb_cursor_close(cursor);
+  if (result != MDB_NOTFOUND)
+    throw DB_ERROR(std::string("Failed to enumerate tx dictionaries: ").append(mdb_strerror(result)).c_str());
+
+  boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+  m_dictionaries = std::move(dictionaries);
+  m_current[0] = m_current[1] = 0;
+}
+
+uint32_t tx_blob_codec::add_dictionary(table t, std::string dict)
+{
+#ifdef HAVE_ZSTD
+  const uint32_t id = ZDICT_getDictID(dict.data(), dict.size());
+  if (id == 0)
+    throw DB_ERROR("Invalid tx dictionary");
+  boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+  auto &entry = m_dictionaries[id];
+  if (entry && entry->data != dict)
+    throw DB_ERROR("Another tx dictionary with the same id already exists");
+  if (!entry)
+  {
+    std::unique_ptr<dictionary_t> d{new dictionary_t()};
+    d->data = std::move(dict);
+    d->ddict = ZSTD_createDDict(d->data.data(), d->data.size());
+    if (!d->ddict)
+      throw DB_ERROR("Failed to load a tx dictionary");
+    entry = std::move(d);
+  }
+  if (m_level > 0)
+    entry->prepare_compression(m_level);
+  m_current[(int)t] = id;
+  return id;
+#else
+  throw DB_ERROR("Built without zstd support");
+#endif
+}
+
+void tx_blob_codec::use_dictionary(table t, uint32_t id)
+{
+  boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+  if (id)
+  {
+    auto it = m_dictionaries.find(id);
+    if (it == m_dictionaries.end())
+      throw DB_ERROR("Unknown tx dictionary");
+#ifdef HAVE_ZSTD
+    if (m_level > 0)
+      it->second->prepare_compression(m_level);
+#endif
+  }
+  m_current[(int)t] = id;
+}
+
+uint32_t tx_blob_codec::dictionary(table t) const
+{
+  boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+  return m_current[(int)t];
+}
+
+void tx_blob_codec::set_level(int level)
+{
+#ifdef HAVE_ZSTD
+  boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+  level = std::min(std::max(level, 0), ZSTD_maxCLevel());
+  if (level > 0)
+  {
+    for (uint32_t id: m_current)
+      if (id)
+        m_dictionaries.at(id)->prepare_compression(level);
+  }
+  m_level = level;
+#else
+  if (level > 0)
+    MWARNING("Built without zstd support, transaction data will not be compressed");
+#endif
+}
+
+void tx_blob_codec::encode(table t, const epee::span<const char> blob, std::string &out) const
+{
+  out.clear();
+  if (t == table::pruned)
+    out.push_back(0);
+  const size_t header = out.size() + 1;
+#ifdef HAVE_ZSTD
+  const int level = m_level;
+  if (level > 0)
+  {
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    const uint32_t id = m_current[(int)t];
+    ZSTD_CCtx *ctx = get_cctx();
+    out.resize(header + ZSTD_compressBound(blob.size()));
+    size_t size;
+    if (id)
+      size = ZSTD_compress_usingCDict(ctx, &out[header], out.size() - header, blob.data(), blob.size(), m_dictionaries.at(id)->cdict);
+    else
+      size = ZSTD_compressCCtx(ctx, &out[header], out.size() - header, blob.data(), blob.size(), level);
+    if (ZSTD_isError(size))
+      throw DB_ERROR(std::string("Failed to compress tx data: ").append(ZSTD_getErrorName(size)).c_str());
+    if (size < blob.size())
+    {
+      out[header - 1] = codec_zstd;
+      out.resize(header + size);
+      return;
+    }
+    out.resize(header - 1);
+  }
+#endif
+  out.push_back(codec_raw);
+  out.append(blob.data(), blob.size());
+}
+
+void tx_blob_codec::decode(table t, const MDB_val &v, bool encoded, std::string &out) const
+{
+  const char *data = (const char*)v.mv_data;
+  size_t size = v.mv_size;
+  if (!encoded)
+  {
+    out.append(data, size);
+    return;
+  }
+
+  const size_t header = t == table::pruned ? 2 : 1;
+  if (size < header)
+    throw DB_ERROR("Invalid encoded tx data");
+  const uint8_t codec = data[header - 1];
+  data += header;
+  size -= header;
+
+  if (codec == codec_raw)
+  {
+    out.append(data, size);
+    return;
+  }
+  if (codec != codec_zstd)
+    throw DB_ERROR("Unknown tx data codec");
+
+#ifdef HAVE_ZSTD
+  const unsigned long long blob_size = ZSTD_getFrameContentSize(data, size);
+  if (blob_size == ZSTD_CONTENTSIZE_ERROR || blob_size == ZSTD_CONTENTSIZE_UNKNOWN || blob_size > max_blob_size)
+    throw DB_ERROR("Invalid compressed tx data");
+  const uint32_t id = ZSTD_getDictID_fromFrame(data, size);
+  boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+  const auto it = m_dictionaries.find(id);
+  if (id && it == m_dictionaries.end())
+    throw DB_ERROR("Compressed tx data uses an unknown dictionary");
+
+  const size_t offset = out.size();
+  out.resize(offset + blob_size);
+  size_t result;
+  if (id)
+    result = ZSTD_decompress_usingDDict(get_dctx(), &out[offset], blob_size, data, size, it->second->ddict);
+  else
+    result = ZSTD_decompressDCtx(get_dctx(), &out[offset], blob_size, data, size);
+  if (ZSTD_isError(result) || result != blob_size)
+  {
+    out.resize(offset);
+    throw DB_ERROR("Failed to decompress tx data");
+  }
+#else
+  throw DB_ERROR("Compressed tx data found, but built without zstd support");
+#endif
+}
+
+std::string tx_blob_codec::train(const std::vector<std::string> &samples, size_t size)
+{
+#ifdef HAVE_ZSTD
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const std::string &s: samples)
+  {
+    buffer += s;
+    sizes.push_back(s.size());
+  }
+  std::string dict(size, '\0');
+  const size_t dict_size = ZDICT_trainFromBuffer(&dict[0], dict.size(), buffer.data(), sizes.data(), sizes.size());
+  if (ZDICT_isError(dict_size))
+  {
+    MWARNING("Failed to train tx dictionary: " << ZDICT_getErrorName(dict_size));
+    return {};
+  }
+  dict.resize(dict_size);
+  return dict;
+#else
+  return {};
+#endif
+}
+
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <boost/thread/shared_mutex.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "span.h"
+
+#include <lmdb.h>
+
+namespace cryptonote
+{
+
+/**
+ * @brief optional compression of the txs_pruned and txs_prunable records
+ *
+ * Records written without compression are the raw blobs, as they always
+ * were.  A compressed pruned record starts with a 0 byte, which can never
+ * start a stored transaction since version 0 is invalid, followed by a
+ * codec byte and the payload.  The prunable record of such a transaction,
+ * if there is one, starts with its own codec byte.  The two are always
+ * rewritten together, so old and new records can be freely mixed.
+ *
+ * Compressed payloads are zstd frames.  They may use a dictionary trained
+ * on the table's records; the frame header carries the dictionary's id,
+ * and every dictionary ever used is kept in the tx_dicts table.
+ */
+class tx_blob_codec
+{
+public:
+  enum class table: uint8_t { pruned = 0, prunable = 1 };
+
+  tx_blob_codec();
+  ~tx_blob_codec();
+
+  /**
+   * @brief whether this build can compress and decompress at all
+   */
+  static bool available() noexcept;
+
+  /**
+   * @brief whether a pruned record, and so its prunable record, is encoded
+   */
+  static bool is_encoded(const MDB_val &pruned) noexcept
+  {
+    return pruned.mv_size > 0 && *static_cast<const uint8_t*>(pruned.mv_data) == 0;
+  }
+
+  /**
+   * @brief loads every dictionary in a tx_dicts table
+   *
+   * @param txn a read txn on the database
+   * @param dicts the tx_dicts table handle
+   */
+  void load(MDB_txn *txn, MDB_dbi dicts);
+
+  /**
+   * @brief adds a dictionary, and uses it to compress new records of a table
+   *
+   * @param t the table the dictionary was trained on
+   * @param dict the dictionary, as returned by train()
+   *
+   * @return the dictionary id
+   */
+  uint32_t add_dictionary(table t, std::string dict);
+
+  /**
+   * @brief picks which previously loaded dictionary compresses new records
+   *
+   * @param t the table
+   * @param id the dictionary id, or 0 to compress without a dictionary
+   */
+  void use_dictionary(table t, uint32_t id);
+
+  /**
+   * @brief the dictionary new records of a table are compressed with, 0 if none
+   */
+  uint32_t dictionary(table t) const;
+
+  /**
+   * @brief the zstd level new records are compressed at, 0 when disabled
+   */
+  void set_level(int level);
+  int level() const noexcept { return m_level; }
+
+  /**
+   * @brief encodes a blob into a record for the given table
+   *
+   * @param t the table the record goes to
+   * @param blob the raw pruned or prunable data
+   * @param out the record, replaced
+   */
+  void encode(table t, const epee::span<const char> blob, std::string &out) const;
+
+  /**
+   * @brief decodes a record, appending the blob to out
+   *
+   * @param t the table the record comes from
+   * @param v the record
+   * @param encoded whether the transaction's pruned record is encoded
+   * @param out the string the blob is appended to
+   */
+  void decode(table t, const MDB_val &v, bool encoded, std::string &out) const;
+
+  /**
+   * @brief trains a dictionary from sample records
+   *
+   * @param samples the raw blobs to train from
+   * @param size the maximum dictionary size
+   *
+   * @return the dictionary, empty if the samples were not enough
+   */
+  static std::string train(const std::vector<std::string> &samples, size_t size);
+
+private:
+  struct dictionary_t;
+
+  mutable boost::shared_mutex m_mutex;
+  std::map<uint32_t, std::unique_ptr<dictionary_t>> m_dictionaries;
+  uint32_t m_current[2];
+  std::atomic<int> m_level;
+};
+
+}
@@ -38,6 +38,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/blockchain.h"
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/tx_blob_codec.h"
 #include "wallet/ringdb.h"
 #include "version.h"
 
@@ -329,6 +330,25 @@ static std::vector<uint64_t> decompress_ring(const std::string &s)
   return ring;
 }
 
+static void load_tx_codec(MDB_txn *txn, tx_blob_codec &codec)
+{
+  MDB_dbi dbi;
+  int dbr = mdb_dbi_open(txn, "tx_dicts", MDB_INTEGERKEY, &dbi);
+  if (dbr == MDB_NOTFOUND)
+    return;
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  codec.load(txn, dbi);
+}
+
+static void get_pruned_tx_blob(const tx_blob_codec &codec, const MDB_val &v, blobdata &bd)
+{
+  bd.clear();
+  if (tx_blob_codec::is_encoded(v))
+    codec.decode(tx_blob_codec::table::pruned, v, true, bd);
+  else
+    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+}
+
 static bool for_all_transactions(const std::string &filename, uint64_t &start_idx, uint64_t &n_txes, const std::function<bool(const cryptonote::transaction_prefix&)> &f)
 {
   MDB_env *env;
@@ -342,7 +362,7 @@ static bool for_all_transactions(const std::string &filename, uint64_t &start_id
 
   dbr = mdb_env_create(&env);
   if (dbr) throw std::runtime_error("Failed to create LDMB environment: " + std::string(mdb_strerror(dbr)));
-  dbr = mdb_env_set_maxdbs(env, 2);
+  dbr = mdb_env_set_maxdbs(env, 4);
   if (dbr) throw std::runtime_error("Failed to set max env dbs: " + std::string(mdb_strerror(dbr)));
   const std::string actual_filename = filename;
   dbr = mdb_env_open(env, actual_filename.c_str(), 0, 0664);
@@ -358,6 +378,8 @@ static bool for_all_transactions(const std::string &filename, uint64_t &start_id
   if (dbr)
     dbr = mdb_dbi_open(txn, "txs", MDB_INTEGERKEY, &dbi);
   if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  tx_blob_codec codec;
+  load_tx_codec(txn, codec);
   dbr = mdb_cursor_open(txn, dbi, &cur);
   if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
   MDB_stat stat;
@@ -387,7 +409,7 @@ static bool for_all_transactions(const std::string &filename, uint64_t &start_id
 
     cryptonote::transaction_prefix tx;
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    get_pruned_tx_blob(codec, v, bd);
     binary_archive<false> ba{epee::strspan<std::uint8_t>(bd)};
     bool r = do_serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
@@ -437,6 +459,8 @@ static bool for_all_transactions(const std::string &filename, const uint64_t &st
   if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
   dbr = mdb_dbi_open(txn, "txs_pruned", MDB_INTEGERKEY, &dbi_txs);
   if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  tx_blob_codec codec;
+  load_tx_codec(txn, codec);
 
   dbr = mdb_cursor_open(txn, dbi_blocks, &cur_blocks);
   if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
@@ -494,7 +518,7 @@ static bool for_all_transactions(const std::string &filename, const uint64_t &st
       if (start_idx <= tx_idx++)
       {
         cryptonote::transaction_prefix tx;
-        bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+        get_pruned_tx_blob(codec, v, bd);
         CHECK_AND_ASSERT_MES(parse_and_validate_tx_prefix_from_blob(bd, tx), false, "Failed to parse transaction from blob");
         if (!f(last_block && i == b.tx_hashes.size() - 1, height, tx))
         {
@@ -528,13 +552,15 @@ static uint64_t find_first_diverging_transaction(const std::string &first_filena
   uint64_t n_txes[2];
   MDB_val k;
   MDB_val v[2];
+  tx_blob_codec codec[2];
+  blobdata bd[2];
 
   epee::misc_utils::auto_scope_leave_caller txn_dtor[2];
   for (int i = 0; i < 2; ++i)
   {
     dbr = mdb_env_create(&env[i]);
     if (dbr) throw std::runtime_error("Failed to create LDMB environment: " + std::string(mdb_strerror(dbr)));
-    dbr = mdb_env_set_maxdbs(env[i], 2);
+    dbr = mdb_env_set_maxdbs(env[i], 3);
     if (dbr) throw std::runtime_error("Failed to set max env dbs: " + std::string(mdb_strerror(dbr)));
     const std::string actual_filename = i ? second_filename : first_filename;
     dbr = mdb_env_open(env[i], actual_filename.c_str(), 0, 0664);
@@ -550,6 +576,7 @@ static uint64_t find_first_diverging_transaction(const std::string &first_filena
     if (dbr)
       dbr = mdb_dbi_open(txn[i], "txs", MDB_INTEGERKEY, &dbi[i]);
     if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+    load_tx_codec(txn[i], codec[i]);
     dbr = mdb_cursor_open(txn[i], dbi[i], &cur[i]);
     if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
     MDB_stat stat;
@@ -571,7 +598,10 @@ static uint64_t find_first_diverging_transaction(const std::string &first_filena
     if (dbr) throw std::runtime_error("Failed to query transaction: " + std::string(mdb_strerror(dbr)));
     dbr = mdb_cursor_get(cur[1], &k, &v[1], MDB_SET);
     if (dbr) throw std::runtime_error("Failed to query transaction: " + std::string(mdb_strerror(dbr)));
-    if (v[0].mv_size == v[1].mv_size && !memcmp(v[0].mv_data, v[1].mv_data, v[0].mv_size))
+    // the two databases may not be compressed alike
+    get_pruned_tx_blob(codec[0], v[0], bd[0]);
+    get_pruned_tx_blob(codec[1], v[1], bd[1]);
+    if (bd[0] == bd[1])
       lo = mid + 1;
     else
       hi = mid - 1;
@@ -54,6 +54,7 @@ static uint64_t records_per_sync = 16 * 65536;
 static const size_t slack = 512 * 1024 * 1024;
 
 static std::vector<bool> is_v1;
+static tx_blob_codec tx_codec;
 
 static std::error_code replace_file(const boost::filesystem::path& replacement_name, const boost::filesystem::path& replaced_name)
 {
@@ -94,7 +95,26 @@ static void mark_v1_tx(const MDB_val &k, const MDB_val &v)
   const uint64_t tx_id = *(const uint64_t*)k.mv_data;
   if (tx_id >= is_v1.size())
     is_v1.resize(tx_id + 1, false);
-  is_v1[tx_id] = cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
+  if (!tx_blob_codec::is_encoded(v))
+  {
+    is_v1[tx_id] = cryptonote::is_v1_tx(cryptonote::blobdata_ref{(const char*)v.mv_data, v.mv_size});
+    return;
+  }
+  cryptonote::blobdata bd;
+  tx_codec.decode(tx_blob_codec::table::pruned, v, true, bd);
+  is_v1[tx_id] = cryptonote::is_v1_tx(bd);
+}
+
+static void load_tx_codec(MDB_env *env)
+{
+  MDB_txn *txn;
+  MDB_dbi dbi;
+  int dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){ mdb_txn_abort(txn); });
+  dbr = mdb_dbi_open(txn, "tx_dicts", MDB_INTEGERKEY, &dbi);
+  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
+  tx_codec.load(txn, dbi);
 }
 
 static void add_size(MDB_env *env, uint64_t bytes)
@@ -637,6 +657,7 @@ int main(int argc, char* argv[])
   MDB_env *env0 = NULL, *env1 = NULL;
   open(env0, paths[0], db_flags, true);
   open(env1, paths[1], db_flags, false);
+  load_tx_codec(env0);
   copy_table(env0, env1, "blocks", MDB_INTEGERKEY, 0);
   copy_table(env0, env1, "block_info", MDB_INTEGERKEY | MDB_DUPSORT| MDB_DUPFIXED, 0, BlockchainLMDB::compare_uint64);
   copy_table(env0, env1, "block_heights", MDB_INTEGERKEY | MDB_DUPSORT| MDB_DUPFIXED, 0, BlockchainLMDB::compare_hash32);
@@ -654,6 +675,7 @@ int main(int argc, char* argv[])
   copy_table(env0, env1, "alt_blocks", 0, 0, BlockchainLMDB::compare_hash32);
   copy_table(env0, env1, "hf_versions", MDB_INTEGERKEY, 0);
   copy_table(env0, env1, "properties", 0, 0, BlockchainLMDB::compare_string);
+  copy_table(env0, env1, "tx_dicts", MDB_INTEGERKEY, 0);
   if (already_pruned)
   {
     copy_table(env0, env1, "txs_prunable", MDB_INTEGERKEY, 0, BlockchainLMDB::compare_uint64);
@@ -31,7 +31,11 @@
 #pragma once 
 
 #include <unordered_set>
+#include <vector>
+#include <memory>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
 
 namespace tools
 {
@@ -62,4 +66,113 @@ namespace tools
     T buf[MAX_SIZE] = {};
     size_t counter = 0;
   };
+
+  // Same FIFO eviction as data_cache, but split in shards with their own lock,
+  // so concurrent users only contend when they hit the same shard. The size is
+  // set at runtime, and hits, misses and evictions are counted.
+  template<typename T, typename Hash = std::hash<T>>
+  class sharded_data_cache
+  {
+  public:
+    struct stats_t
+    {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t evictions;
+      size_t size;
+      size_t max_size;
+    };
+
+    explicit sharded_data_cache(size_t max_size, size_t num_shards = 64)
+    {
+      resize(max_size, num_shards);
+    }
+
+    // Drops all contents. Not thread safe, call before the cache is shared.
+    void resize(size_t max_size, size_t num_shards = 64)
+    {
+      if (max_size == 0)
+        max_size = 1;
+      if (num_shards == 0)
+        num_shards = 1;
+      if (num_shards > max_size)
+        num_shards = max_size;
+      n_shards = num_shards;
+      shard_size = (max_size + n_shards - 1) / n_shards;
+      shards.reset(new shard[n_shards]);
+      for (size_t i = 0; i < n_shards; ++i)
+      {
+        shards[i].data.reserve(shard_size);
+        shards[i].buf.reserve(shard_size);
+      }
+    }
+
+    void add(const T& value)
+    {
+      shard &s = get_shard(value);
+      std::lock_guard<std::mutex> lock(s.m);
+      if (s.data.insert(value).second)
+      {
+        if (s.buf.size() < shard_size)
+        {
+          s.buf.push_back(value);
+          return;
+        }
+        T& old_value = s.buf[s.counter++ % shard_size];
+        s.data.erase(old_value);
+        old_value = value;
+        s.evictions.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    bool has(const T& value) const
+    {
+      shard &s = get_shard(value);
+      bool found;
+      {
+        std::lock_guard<std::mutex> lock(s.m);
+        found = s.data.find(value) != s.data.end();
+      }
+      (found ? s.hits : s.misses).fetch_add(1, std::memory_order_relaxed);
+      return found;
+    }
+
+    stats_t get_stats() const
+    {
+      stats_t stats = {0, 0, 0, 0, shard_size * n_shards};
+      for (size_t i = 0; i < n_shards; ++i)
+      {
+        const shard &s = shards[i];
+        stats.hits += s.hits.load(std::memory_order_relaxed);
+        stats.misses += s.misses.load(std::memory_order_relaxed);
+        stats.evictions += s.evictions.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(s.m);
+        stats.size += s.data.size();
+      }
+      return stats;
+    }
+
+  private:
+    struct alignas(64) shard
+    {
+      mutable std::mutex m;
+      std::unordered_set<T, Hash> data;
+      std::vector<T> buf;
+      size_t counter = 0;
+      mutable std::atomic<uint64_t> hits{0};
+      mutable std::atomic<uint64_t> misses{0};
+      std::atomic<uint64_t> evictions{0};
+    };
+
+    shard &get_shard(const T& value) const
+    {
+      // the shard must not be picked from the same bits the set buckets use
+      const uint64_t h = static_cast<uint64_t>(Hash()(value)) * 0x9E3779B97F4A7C15ull;
+      return shards[(h >> 32) % n_shards];
+    }
+
+    std::unique_ptr<shard[]> shards;
+    size_t n_shards;
+    size_t shard_size;
+  };
 }
@@ -103,6 +103,11 @@ void set_performance_timer_log_level(el::Level level)
   performance_timer_log_level = level;
 }
 
+epee::metrics::histogram &get_performance_timer_histogram(const char *name)
+{
+  return epee::metrics::get_histogram("monero_perf_timer_seconds", "Time spent in PERF_TIMER scopes", std::string("timer=\"") + name + "\"");
+}
+
 PerformanceTimer::PerformanceTimer(bool paused): started(true), paused(paused)
 {
   if (paused)
@@ -111,7 +116,7 @@ PerformanceTimer::PerformanceTimer(bool paused): started(true), paused(paused)
     ticks = get_tick_count();
 }
 
-LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l)
+LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l, epee::metrics::histogram *histogram): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l), histogram(histogram)
 {
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (!performance_timers)
@@ -147,6 +152,8 @@ LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
   pause();
   performance_timers->pop_back();
+  if (histogram)
+    histogram->observe_ns(ticks_to_ns(ticks));
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (log)
   {
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <memory>
 #include "misc_log_ex.h"
+#include "metrics.h"
 
 namespace tools
 {
@@ -64,7 +65,7 @@ protected:
 class LoggingPerformanceTimer: public PerformanceTimer
 {
 public:
-  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info);
+  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info, epee::metrics::histogram *histogram = NULL);
   ~LoggingPerformanceTimer();
 
 private:
@@ -72,16 +73,19 @@ private:
   std::string cat;
   uint64_t unit;
   el::Level level;
+  epee::metrics::histogram *histogram;
 };
 
 void set_performance_timer_log_level(el::Level level);
+epee::metrics::histogram &get_performance_timer_histogram(const char *name);
 
 #define PERF_TIMER_NAME(name) pt_##name
-#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level)
+#define PERF_TIMER_HISTOGRAM(name) static epee::metrics::histogram &pt_histogram_##name = tools::get_performance_timer_histogram(#name)
+#define PERF_TIMER_UNIT(name, unit) PERF_TIMER_HISTOGRAM(name); tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level, &pt_histogram_##name)
 #define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer PERF_TIMER_NAME(name)t_##name(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, l)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> PERF_TIMER_NAME(name)(new tools::LoggingPerformanceTimer(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, el::Level::Info))
+#define PERF_TIMER_START_UNIT(name, unit) PERF_TIMER_HISTOGRAM(name); std::unique_ptr<tools::LoggingPerformanceTimer> PERF_TIMER_NAME(name)(new tools::LoggingPerformanceTimer(#name, "perf." MONERO_DEFAULT_LOG_CATEGORY, unit, el::Level::Info, &pt_histogram_##name))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000000)
 #define PERF_TIMER_STOP(name) do { PERF_TIMER_NAME(name).reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) PERF_TIMER_NAME(name).pause()
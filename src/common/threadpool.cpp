@@ -33,10 +33,12 @@
 
 static __thread int depth = 0;
 static __thread bool is_leaf = false;
+static __thread const tools::threadpool *worker_pool = NULL;
+static __thread size_t worker_index = 0;
 
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) : running(true), active(0) {
+threadpool::threadpool(unsigned int max_threads) : num_queues(0), next_queue(0), pending(0), sleeping(0), active(0), running(true) {
   create(max_threads);
 }
 
@@ -76,19 +78,36 @@ void threadpool::create(unsigned int max_threads) {
   attrs.set_stack_size(THREAD_STACK_SIZE);
   max = max_threads ? max_threads : tools::get_max_concurrency();
   size_t i = max ? max - 1 : 0;
+  // with no worker thread, jobs still need a queue to wait in for waiter::wait
+  const size_t n_queues = i ? i : 1;
+  if (num_queues != n_queues)
+  {
+    // only reached with no threads running, so no queue is in use, but
+    // jobs submitted before a recycle may still wait in the old ones
+    std::unique_ptr<worker_queue[]> new_queues(new worker_queue[n_queues]);
+    size_t n = 0;
+    for (size_t q = 0; q < num_queues; ++q)
+      for (entry &e: queues[q].queue)
+      {
+        if (e.leaf)
+          new_queues[n++ % n_queues].queue.push_front(std::move(e));
+        else
+          new_queues[n++ % n_queues].queue.push_back(std::move(e));
+      }
+    queues = std::move(new_queues);
+    num_queues = n_queues;
+  }
   running = true;
   while(i--) {
-    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, false)));
+    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::worker, this, i)));
   }
 }
 
 void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  boost::unique_lock<boost::mutex> lock(mutex);
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
+  if (!leaf && ((active == max && pending > 0) || depth > 0)) {
     // if all available threads are already running
     // and there's work waiting, just run in current thread
-    lock.unlock();
     ++depth;
     is_leaf = leaf;
     f();
@@ -97,11 +116,24 @@ void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   } else {
     if (obj)
       obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
-    else
-      queue.push_back({obj, f, leaf});
-    has_work.notify_one();
+    // a worker keeps what it submits local, other threads spread their jobs
+    const size_t index = worker_pool == this ? worker_index : next_queue++ % num_queues;
+    {
+      worker_queue &q = queues[index];
+      const boost::unique_lock<boost::mutex> lock(q.mutex);
+      if (leaf)
+        q.queue.push_front({obj, std::move(f), leaf});
+      else
+        q.queue.push_back({obj, std::move(f), leaf});
+      ++pending;
+    }
+    // a worker about to sleep increments sleeping before checking pending,
+    // so either it sees this job, or we see it and wake it up
+    if (sleeping > 0)
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      has_work.notify_one();
+    }
   }
 }
 
@@ -129,7 +161,7 @@ threadpool::waiter::~waiter()
 }
 
 bool threadpool::waiter::wait() {
-  pool.run(true);
+  pool.run();
   boost::unique_lock<boost::mutex> lock(mt);
   while(num)
     cv.wait(lock);
@@ -148,33 +180,88 @@ void threadpool::waiter::dec() {
     cv.notify_all();
 }
 
-void threadpool::run(bool flush) {
-  boost::unique_lock<boost::mutex> lock(mutex);
-  while (running) {
-    entry e;
-    while(queue.empty() && running)
+bool threadpool::take(size_t index, entry &e) {
+  if (pending == 0)
+    return false;
+  {
+    // own queue first, oldest job first
+    worker_queue &q = queues[index];
+    const boost::unique_lock<boost::mutex> lock(q.mutex);
+    if (!q.queue.empty())
     {
-      if (flush)
-        return;
-      has_work.wait(lock);
+      e = std::move(q.queue.front());
+      q.queue.pop_front();
+      --pending;
+      return true;
+    }
+  }
+  // steal from the back of the others, starting with the next one
+  for (size_t n = 1; n < num_queues; ++n)
+  {
+    worker_queue &q = queues[(index + n) % num_queues];
+    const boost::unique_lock<boost::mutex> lock(q.mutex);
+    if (!q.queue.empty())
+    {
+      // leaf jobs are at the front and must not wait, take those first
+      if (q.queue.front().leaf)
+      {
+        e = std::move(q.queue.front());
+        q.queue.pop_front();
+      }
+      else
+      {
+        e = std::move(q.queue.back());
+        q.queue.pop_back();
+      }
+      --pending;
+      return true;
     }
-    if (!running) break;
+  }
+  return false;
+}
 
-    active++;
-    e = std::move(queue.front());
-    queue.pop_front();
-    lock.unlock();
-    ++depth;
-    is_leaf = e.leaf;
-    try { e.f(); }
-    catch (const std::exception &ex) { e.wo->set_error(); try { MERROR("Exception in threadpool job: " << ex.what()); } catch (...) {} }
-    --depth;
-    is_leaf = false;
+void threadpool::execute(entry &e) {
+  ++active;
+  ++depth;
+  is_leaf = e.leaf;
+  try { e.f(); }
+  catch (const std::exception &ex) { if (e.wo) e.wo->set_error(); try { MERROR("Exception in threadpool job: " << ex.what()); } catch (...) {} }
+  --depth;
+  is_leaf = false;
+
+  if (e.wo)
+    e.wo->dec();
+  --active;
+}
 
-    if (e.wo)
-      e.wo->dec();
-    lock.lock();
-    active--;
+void threadpool::worker(size_t index) {
+  worker_pool = this;
+  worker_index = index;
+  while (true) {
+    entry e;
+    if (take(index, e))
+    {
+      execute(e);
+      continue;
+    }
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (!running)
+      break;
+    ++sleeping;
+    while (pending == 0 && running)
+      has_work.wait(lock);
+    --sleeping;
+    if (!running)
+      break;
   }
+  worker_pool = NULL;
+}
+
+void threadpool::run() {
+  // called by waiter::wait to help with queued jobs until there are none left
+  const size_t index = worker_pool == this ? worker_index : next_queue % num_queues;
+  entry e;
+  while (take(index, e))
+    execute(e);
 }
 }
@@ -30,9 +30,11 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <atomic>
 #include <cstddef>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <stdexcept>
@@ -83,6 +85,9 @@ public:
 
   unsigned int get_max_concurrency() const;
 
+  // number of submitted jobs not yet picked up by a thread
+  unsigned int get_queue_depth() const noexcept { return pending; }
+
   ~threadpool();
 
   private:
@@ -94,14 +99,26 @@ public:
       std::function<void()> f;
       bool leaf;
     } entry;
-    std::deque<entry> queue;
+    // Each worker has its own queue, which it takes jobs from the front of.
+    // Idle workers and waiting threads steal from the back of other queues.
+    struct worker_queue {
+      boost::mutex mutex;
+      std::deque<entry> queue;
+    };
+    std::unique_ptr<worker_queue[]> queues;
+    size_t num_queues;
+    std::atomic<size_t> next_queue;
+    std::atomic<unsigned int> pending;
+    std::atomic<unsigned int> sleeping;
     boost::condition_variable has_work;
     boost::mutex mutex;
     std::vector<boost::thread> threads;
-    unsigned int active;
+    std::atomic<unsigned int> active;
     unsigned int max;
     bool running;
-    void run(bool flush = false);
+    bool take(size_t index, entry &e);
+    void execute(entry &e);
+    void worker(size_t index);
+    void run();
 };
-
 }
@@ -0,0 +1,1092 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto-ops-fe51.h"
+
+#if CRYPTO_OPS_FE51
+
+typedef unsigned __int128 fe51_uint128;
+
+#define FE51_MASK ((((uint64_t) 1) << 51) - 1)
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+} ge51_p2;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p3;
+
+typedef struct {
+  fe51 X;
+  fe51 Y;
+  fe51 Z;
+  fe51 T;
+} ge51_p1p1;
+
+typedef struct {
+  fe51 YplusX;
+  fe51 YminusX;
+  fe51 Z;
+  fe51 T2d;
+} ge51_cached;
+
+/* Field arithmetic
+
+   Elements are five unsigned 51 bit limbs.  mul, sq and sub leave each limb
+   below 2^51 + 2^13, add leaves the sum of its inputs.  mul and sq accept
+   limbs up to 2^54, sub wants its subtrahend below 2^53 - 76. */
+
+static uint64_t load_8(const unsigned char *in) {
+  return ((uint64_t) in[0]) | ((uint64_t) in[1] << 8) | ((uint64_t) in[2] << 16) | ((uint64_t) in[3] << 24) |
+    ((uint64_t) in[4] << 32) | ((uint64_t) in[5] << 40) | ((uint64_t) in[6] << 48) | ((uint64_t) in[7] << 56);
+}
+
+static void store_8(unsigned char *out, uint64_t in) {
+  int i;
+  for (i = 0; i < 8; ++i) {
+    out[i] = (unsigned char) (in >> (8 * i));
+  }
+}
+
+static void fe51_0(fe51 h) {
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe51_1(fe51 h) {
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe51_copy(fe51 h, const fe51 f) {
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+static void fe51_carry(fe51 h) {
+  uint64_t c;
+  c = h[0] >> 51; h[0] &= FE51_MASK; h[1] += c;
+  c = h[1] >> 51; h[1] &= FE51_MASK; h[2] += c;
+  c = h[2] >> 51; h[2] &= FE51_MASK; h[3] += c;
+  c = h[3] >> 51; h[3] &= FE51_MASK; h[4] += c;
+  c = h[4] >> 51; h[4] &= FE51_MASK; h[0] += c * 19;
+}
+
+static void fe51_add(fe51 h, const fe51 f, const fe51 g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+/* h = f - g, computed as f + 4p - g */
+static void fe51_sub(fe51 h, const fe51 f, const fe51 g) {
+  h[0] = (f[0] + 0x1fffffffffffb4) - g[0];
+  h[1] = (f[1] + 0x1ffffffffffffc) - g[1];
+  h[2] = (f[2] + 0x1ffffffffffffc) - g[2];
+  h[3] = (f[3] + 0x1ffffffffffffc) - g[3];
+  h[4] = (f[4] + 0x1ffffffffffffc) - g[4];
+  fe51_carry(h);
+}
+
+static void fe51_neg(fe51 h, const fe51 f) {
+  fe51 zero;
+  fe51_0(zero);
+  fe51_sub(h, zero, f);
+}
+
+static void fe51_mul(fe51 h, const fe51 f, const fe51 g) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+  fe51_uint128 r0, r1, r2, r3, r4;
+  uint64_t c;
+
+  r0 = (fe51_uint128) f0 * g0 + (fe51_uint128) f1 * g4_19 + (fe51_uint128) f2 * g3_19 + (fe51_uint128) f3 * g2_19 + (fe51_uint128) f4 * g1_19;
+  r1 = (fe51_uint128) f0 * g1 + (fe51_uint128) f1 * g0 + (fe51_uint128) f2 * g4_19 + (fe51_uint128) f3 * g3_19 + (fe51_uint128) f4 * g2_19;
+  r2 = (fe51_uint128) f0 * g2 + (fe51_uint128) f1 * g1 + (fe51_uint128) f2 * g0 + (fe51_uint128) f3 * g4_19 + (fe51_uint128) f4 * g3_19;
+  r3 = (fe51_uint128) f0 * g3 + (fe51_uint128) f1 * g2 + (fe51_uint128) f2 * g1 + (fe51_uint128) f3 * g0 + (fe51_uint128) f4 * g4_19;
+  r4 = (fe51_uint128) f0 * g4 + (fe51_uint128) f1 * g3 + (fe51_uint128) f2 * g2 + (fe51_uint128) f3 * g1 + (fe51_uint128) f4 * g0;
+
+  c = (uint64_t) (r0 >> 51); h[0] = (uint64_t) r0 & FE51_MASK; r1 += c;
+  c = (uint64_t) (r1 >> 51); h[1] = (uint64_t) r1 & FE51_MASK; r2 += c;
+  c = (uint64_t) (r2 >> 51); h[2] = (uint64_t) r2 & FE51_MASK; r3 += c;
+  c = (uint64_t) (r3 >> 51); h[3] = (uint64_t) r3 & FE51_MASK; r4 += c;
+  c = (uint64_t) (r4 >> 51); h[4] = (uint64_t) r4 & FE51_MASK;
+  h[0] += c * 19;
+  c = h[0] >> 51; h[0] &= FE51_MASK; h[1] += c;
+}
+
+static void fe51_sq(fe51 h, const fe51 f) {
+  const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3;
+  const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+  fe51_uint128 r0, r1, r2, r3, r4;
+  uint64_t c;
+
+  r0 = (fe51_uint128) f0 * f0 + (fe51_uint128) f1_2 * f4_19 + (fe51_uint128) f2_2 * f3_19;
+  r1 = (fe51_uint128) f0_2 * f1 + (fe51_uint128) f2_2 * f4_19 + (fe51_uint128) f3 * f3_19;
+  r2 = (fe51_uint128) f0_2 * f2 + (fe51_uint128) f1 * f1 + (fe51_uint128) f3_2 * f4_19;
+  r3 = (fe51_uint128) f0_2 * f3 + (fe51_uint128) f1_2 * f2 + (fe51_uint128) f4 * f4_19;
+  r4 = (fe51_uint128) f0_2 * f4 + (fe51_uint128) f1_2 * f3 + (fe51_uint128) f2 * f2;
+
+  c = (uint64_t) (r0 >> 51); h[0] = (uint64_t) r0 & FE51_MASK; r1 += c;
+  c = (uint64_t) (r1 >> 51); h[1] = (uint64_t) r1 & FE51_MASK; r2 += c;
+  c = (uint64_t) (r2 >> 51); h[2] = (uint64_t) r2 & FE51_MASK; r3 += c;
+  c = (uint64_t) (r3 >> 51); h[3] = (uint64_t) r3 & FE51_MASK; r4 += c;
+  c = (uint64_t) (r4 >> 51); h[4] = (uint64_t) r4 & FE51_MASK;
+  h[0] += c * 19;
+  c = h[0] >> 51; h[0] &= FE51_MASK; h[1] += c;
+}
+
+/* h = 2 * f * f */
+static void fe51_sq2(fe51 h, const fe51 f) {
+  fe51_sq(h, f);
+  h[0] *= 2;
+  h[1] *= 2;
+  h[2] *= 2;
+  h[3] *= 2;
+  h[4] *= 2;
+}
+
+static void fe51_sqn(fe51 h, const fe51 f, int n) {
+  fe51_sq(h, f);
+  while (--n > 0) {
+    fe51_sq(h, h);
+  }
+}
+
+/* Replace f with g if b == 1, keep f if b == 0, in constant time */
+static void fe51_cmov(fe51 f, const fe51 g, unsigned int b) {
+  const uint64_t mask = (uint64_t) 0 - b;
+  f[0] ^= mask & (f[0] ^ g[0]);
+  f[1] ^= mask & (f[1] ^ g[1]);
+  f[2] ^= mask & (f[2] ^ g[2]);
+  f[3] ^= mask & (f[3] ^ g[3]);
+  f[4] ^= mask & (f[4] ^ g[4]);
+}
+
+/* Ignores the top bit, like fe_frombytes */
+static void fe51_frombytes(fe51 h, const unsigned char *s) {
+  h[0] = load_8(s) & FE51_MASK;
+  h[1] = (load_8(s + 6) >> 3) & FE51_MASK;
+  h[2] = (load_8(s + 12) >> 6) & FE51_MASK;
+  h[3] = (load_8(s + 19) >> 1) & FE51_MASK;
+  h[4] = (load_8(s + 24) >> 12) & FE51_MASK;
+}
+
+static void fe51_tobytes(unsigned char *s, const fe51 f) {
+  fe51 t;
+  uint64_t c;
+
+  fe51_copy(t, f);
+  fe51_carry(t);
+  fe51_carry(t);
+  /* t is now below 2^255, fully carried; add 19 so that values in
+     [p, 2^255) overflow past 2^255 */
+  t[0] += 19;
+  fe51_carry(t);
+  /* t is now in [19, 2^255), offset by 19; add 2^255 - 19 and drop
+     bit 255 */
+  t[0] += 0x8000000000000 - 19;
+  t[1] += 0x8000000000000 - 1;
+  t[2] += 0x8000000000000 - 1;
+  t[3] += 0x8000000000000 - 1;
+  t[4] += 0x8000000000000 - 1;
+  c = t[0] >> 51; t[0] &= FE51_MASK; t[1] += c;
+  c = t[1] >> 51; t[1] &= FE51_MASK; t[2] += c;
+  c = t[2] >> 51; t[2] &= FE51_MASK; t[3] += c;
+  c = t[3] >> 51; t[3] &= FE51_MASK; t[4] += c;
+  t[4] &= FE51_MASK;
+
+  store_8(s, t[0] | (t[1] << 51));
+  store_8(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_8(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_8(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static int fe51_isnegative(const fe51 f) {
+  unsigned char s[32];
+  fe51_tobytes(s, f);
+  return s[0] & 1;
+}
+
+static int fe51_isnonzero(const fe51 f) {
+  unsigned char s[32];
+  unsigned char r = 0;
+  int i;
+  fe51_tobytes(s, f);
+  for (i = 0; i < 32; ++i) {
+    r |= s[i];
+  }
+  return r != 0;
+}
+
+/* Same addition chain as fe_invert */
+static void fe51_invert(fe51 out, const fe51 z) {
+  fe51 t0, t1, t2, t3;
+
+  fe51_sq(t0, z);
+  fe51_sqn(t1, t0, 2);
+  fe51_mul(t1, z, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t2, t0);
+  fe51_mul(t1, t1, t2);
+  fe51_sqn(t2, t1, 5);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t2, t1, 10);
+  fe51_mul(t2, t2, t1);
+  fe51_sqn(t3, t2, 20);
+  fe51_mul(t2, t3, t2);
+  fe51_sqn(t2, t2, 10);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t2, t1, 50);
+  fe51_mul(t2, t2, t1);
+  fe51_sqn(t3, t2, 100);
+  fe51_mul(t2, t3, t2);
+  fe51_sqn(t2, t2, 50);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 5);
+  fe51_mul(out, t1, t0);
+}
+
+/* r = uv^3(uv^7)^((q-5)/8), as fe_divpowm1 */
+static void fe51_divpowm1(fe51 r, const fe51 u, const fe51 v) {
+  fe51 v3, uv7, t0, t1, t2;
+
+  fe51_sq(v3, v);
+  fe51_mul(v3, v3, v); /* v3 = v^3 */
+  fe51_sq(uv7, v3);
+  fe51_mul(uv7, uv7, v);
+  fe51_mul(uv7, uv7, u); /* uv7 = uv^7 */
+
+  fe51_sq(t0, uv7);
+  fe51_sqn(t1, t0, 2);
+  fe51_mul(t1, uv7, t1);
+  fe51_mul(t0, t0, t1);
+  fe51_sq(t0, t0);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 5);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 10);
+  fe51_mul(t1, t1, t0);
+  fe51_sqn(t2, t1, 20);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 10);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t1, t0, 50);
+  fe51_mul(t1, t1, t0);
+  fe51_sqn(t2, t1, 100);
+  fe51_mul(t1, t2, t1);
+  fe51_sqn(t1, t1, 50);
+  fe51_mul(t0, t1, t0);
+  fe51_sqn(t0, t0, 2);
+  fe51_mul(t0, t0, uv7);
+  /* t0 = (uv^7)^((q-5)/8) */
+  fe51_mul(t0, t0, v3);
+  fe51_mul(r, t0, u); /* u^(m+1)v^(-(m+1)) */
+}
+
+/* Conversions from and to the ref10 representation */
+
+/* The ref10 limbs of the values converted here are below 2^27 in
+   magnitude, so each pair of them is well within 4p of a radix 2^51 limb */
+static void fe51_from_fe(fe51 h, const fe f) {
+  h[0] = (uint64_t) (f[0] + (int64_t) f[1] * (1 << 26) + 0x1fffffffffffb4);
+  h[1] = (uint64_t) (f[2] + (int64_t) f[3] * (1 << 26) + 0x1ffffffffffffc);
+  h[2] = (uint64_t) (f[4] + (int64_t) f[5] * (1 << 26) + 0x1ffffffffffffc);
+  h[3] = (uint64_t) (f[6] + (int64_t) f[7] * (1 << 26) + 0x1ffffffffffffc);
+  h[4] = (uint64_t) (f[8] + (int64_t) f[9] * (1 << 26) + 0x1ffffffffffffc);
+  fe51_carry(h);
+}
+
+/* Balances the limbs into the signed ranges ref10's own fe_mul leaves, as
+   ref10 code adds fe's without carrying before feeding them to fe_mul */
+static void fe_from_fe51(fe h, const fe51 f) {
+  fe51 t;
+  int64_t l[10];
+  uint64_t c;
+  int64_t carry;
+  int i;
+
+  fe51_copy(t, f);
+  fe51_carry(t);
+  c = t[0] >> 51; t[0] &= FE51_MASK; t[1] += c;
+  for (i = 0; i < 5; ++i) {
+    l[2 * i] = (int64_t) (t[i] & 0x3ffffff);
+    l[2 * i + 1] = (int64_t) (t[i] >> 26);
+  }
+  for (i = 0; i < 10; i += 2) {
+    carry = (l[i] + (int64_t) (1 << 25)) >> 26; l[i + 1] += carry; l[i] -= carry << 26;
+    carry = (l[i + 1] + (int64_t) (1 << 24)) >> 25; l[i + 1] -= carry << 25;
+    if (i < 8)
+      l[i + 2] += carry;
+    else
+      l[0] += carry * 19;
+  }
+  for (i = 0; i < 10; ++i) {
+    h[i] = (int32_t) l[i];
+  }
+}
+
+static void ge51_p3_from_ge(ge51_p3 *r, const ge_p3 *p) {
+  fe51_from_fe(r->X, p->X);
+  fe51_from_fe(r->Y, p->Y);
+  fe51_from_fe(r->Z, p->Z);
+  fe51_from_fe(r->T, p->T);
+}
+
+static void ge_p3_from_ge51(ge_p3 *r, const ge51_p3 *p) {
+  fe_from_fe51(r->X, p->X);
+  fe_from_fe51(r->Y, p->Y);
+  fe_from_fe51(r->Z, p->Z);
+  fe_from_fe51(r->T, p->T);
+}
+
+static void ge_p2_from_ge51(ge_p2 *r, const ge51_p2 *p) {
+  fe_from_fe51(r->X, p->X);
+  fe_from_fe51(r->Y, p->Y);
+  fe_from_fe51(r->Z, p->Z);
+}
+
+static void ge51_dsmp_from_ge(ge51_cached r[8], const ge_dsmp p) {
+  int i;
+  for (i = 0; i < 8; ++i) {
+    fe51_from_fe(r[i].YplusX, p[i].YplusX);
+    fe51_from_fe(r[i].YminusX, p[i].YminusX);
+    fe51_from_fe(r[i].Z, p[i].Z);
+    fe51_from_fe(r[i].T2d, p[i].T2d);
+  }
+}
+
+/* Group operations, with the same formulas as their ref10 counterparts */
+
+static void ge51_p2_0(ge51_p2 *h) {
+  fe51_0(h->X);
+  fe51_1(h->Y);
+  fe51_1(h->Z);
+}
+
+static void ge51_p3_0(ge51_p3 *h) {
+  fe51_0(h->X);
+  fe51_1(h->Y);
+  fe51_1(h->Z);
+  fe51_0(h->T);
+}
+
+static void ge51_precomp_0(ge51_precomp *h) {
+  fe51_1(h->yplusx);
+  fe51_1(h->yminusx);
+  fe51_0(h->xy2d);
+}
+
+static void ge51_cached_0(ge51_cached *h) {
+  fe51_1(h->YplusX);
+  fe51_1(h->YminusX);
+  fe51_1(h->Z);
+  fe51_0(h->T2d);
+}
+
+static void ge51_p1p1_to_p2(ge51_p2 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+}
+
+static void ge51_p1p1_to_p3(ge51_p3 *r, const ge51_p1p1 *p) {
+  fe51_mul(r->X, p->X, p->T);
+  fe51_mul(r->Y, p->Y, p->Z);
+  fe51_mul(r->Z, p->Z, p->T);
+  fe51_mul(r->T, p->X, p->Y);
+}
+
+static void ge51_p3_to_p2(ge51_p2 *r, const ge51_p3 *p) {
+  fe51_copy(r->X, p->X);
+  fe51_copy(r->Y, p->Y);
+  fe51_copy(r->Z, p->Z);
+}
+
+static void ge51_p3_to_cached(ge51_cached *r, const ge51_p3 *p) {
+  fe51_add(r->YplusX, p->Y, p->X);
+  fe51_sub(r->YminusX, p->Y, p->X);
+  fe51_copy(r->Z, p->Z);
+  fe51_mul(r->T2d, p->T, fe51_d2);
+}
+
+static void ge51_p2_dbl(ge51_p1p1 *r, const ge51_p2 *p) {
+  fe51 t0;
+  fe51_sq(r->X, p->X);
+  fe51_sq(r->Z, p->Y);
+  fe51_sq2(r->T, p->Z);
+  fe51_add(r->Y, p->X, p->Y);
+  fe51_sq(t0, r->Y);
+  fe51_add(r->Y, r->Z, r->X);
+  fe51_sub(r->Z, r->Z, r->X);
+  fe51_sub(r->X, t0, r->Y);
+  fe51_sub(r->T, r->T, r->Z);
+}
+
+static void ge51_p3_dbl(ge51_p1p1 *r, const ge51_p3 *p) {
+  ge51_p2 q;
+  ge51_p3_to_p2(&q, p);
+  ge51_p2_dbl(r, &q);
+}
+
+static void ge51_add(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YplusX);
+  fe51_mul(r->Y, r->Y, q->YminusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_sub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_cached *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->YminusX);
+  fe51_mul(r->Y, r->Y, q->YplusX);
+  fe51_mul(r->T, q->T2d, p->T);
+  fe51_mul(r->X, p->Z, q->Z);
+  fe51_add(t0, r->X, r->X);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void ge51_madd(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yplusx);
+  fe51_mul(r->Y, r->Y, q->yminusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_add(r->Z, t0, r->T);
+  fe51_sub(r->T, t0, r->T);
+}
+
+static void ge51_msub(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q) {
+  fe51 t0;
+  fe51_add(r->X, p->Y, p->X);
+  fe51_sub(r->Y, p->Y, p->X);
+  fe51_mul(r->Z, r->X, q->yminusx);
+  fe51_mul(r->Y, r->Y, q->yplusx);
+  fe51_mul(r->T, q->xy2d, p->T);
+  fe51_add(t0, p->Z, p->Z);
+  fe51_sub(r->X, r->Z, r->Y);
+  fe51_add(r->Y, r->Z, r->Y);
+  fe51_sub(r->Z, t0, r->T);
+  fe51_add(r->T, t0, r->T);
+}
+
+static void ge51_precomp_cmov(ge51_precomp *t, const ge51_precomp *u, unsigned char b) {
+  fe51_cmov(t->yplusx, u->yplusx, b);
+  fe51_cmov(t->yminusx, u->yminusx, b);
+  fe51_cmov(t->xy2d, u->xy2d, b);
+}
+
+static void ge51_cached_cmov(ge51_cached *t, const ge51_cached *u, unsigned char b) {
+  fe51_cmov(t->YplusX, u->YplusX, b);
+  fe51_cmov(t->YminusX, u->YminusX, b);
+  fe51_cmov(t->Z, u->Z, b);
+  fe51_cmov(t->T2d, u->T2d, b);
+}
+
+static unsigned char equal(signed char b, signed char c) {
+  unsigned char ub = b;
+  unsigned char uc = c;
+  unsigned char x = ub ^ uc; /* 0: yes; 1..255: no */
+  uint32_t y = x; /* 0: yes; 1..255: no */
+  y -= 1; /* 4294967295: yes; 0..254: no */
+  y >>= 31; /* 1: yes; 0: no */
+  return y;
+}
+
+static unsigned char negative(signed char b) {
+  unsigned long long x = b; /* 18446744073709551361..18446744073709551615: yes; 0..255: no */
+  x >>= 63; /* 1: yes; 0: no */
+  return x;
+}
+
+static void select_base(ge51_precomp *t, int pos, signed char b) {
+  ge51_precomp minust;
+  unsigned char bnegative = negative(b);
+  unsigned char babs = b - (((-bnegative) & b) << 1);
+  int i;
+
+  ge51_precomp_0(t);
+  for (i = 0; i < 8; ++i) {
+    ge51_precomp_cmov(t, &ge51_base[pos][i], equal(babs, i + 1));
+  }
+  fe51_copy(minust.yplusx, t->yminusx);
+  fe51_copy(minust.yminusx, t->yplusx);
+  fe51_neg(minust.xy2d, t->xy2d);
+  ge51_precomp_cmov(t, &minust, bnegative);
+}
+
+static void slide(signed char *r, const unsigned char *a) {
+  int i;
+  int b;
+  int k;
+
+  for (i = 0; i < 256; ++i) {
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+  }
+
+  for (i = 0; i < 256; ++i) {
+    if (r[i]) {
+      for (b = 1; b <= 6 && i + b < 256; ++b) {
+        if (r[i + b]) {
+          if (r[i] + (r[i + b] << b) <= 15) {
+            r[i] += r[i + b] << b; r[i + b] = 0;
+          } else if (r[i] - (r[i + b] << b) >= -15) {
+            r[i] -= r[i + b] << b;
+            for (k = i + b; k < 256; ++k) {
+              if (!r[k]) {
+                r[k] = 1;
+                break;
+              }
+              r[k] = 0;
+            }
+          } else
+            break;
+        }
+      }
+    }
+  }
+}
+
+/* Point decoding */
+
+static int ge51_frombytes_vartime(ge51_p3 *r, const unsigned char *s) {
+  fe51 u;
+  fe51 v;
+  fe51 vxx;
+  fe51 check;
+  int i;
+
+  /* Validate the number to be canonical */
+  if ((s[31] & 0x7f) == 0x7f && s[0] >= 0xed) {
+    for (i = 1; i < 31; ++i) {
+      if (s[i] != 0xff)
+        break;
+    }
+    if (i == 31)
+      return -1;
+  }
+
+  fe51_frombytes(r->Y, s);
+  fe51_1(r->Z);
+  fe51_sq(u, r->Y);
+  fe51_mul(v, u, fe51_d);
+  fe51_sub(u, u, r->Z);       /* u = y^2-1 */
+  fe51_add(v, v, r->Z);       /* v = dy^2+1 */
+
+  fe51_divpowm1(r->X, u, v); /* x = uv^3(uv^7)^((q-5)/8) */
+
+  fe51_sq(vxx, r->X);
+  fe51_mul(vxx, vxx, v);
+  fe51_sub(check, vxx, u);    /* vx^2-u */
+  if (fe51_isnonzero(check)) {
+    fe51_add(check, vxx, u);  /* vx^2+u */
+    if (fe51_isnonzero(check)) {
+      return -1;
+    }
+    fe51_mul(r->X, r->X, fe51_sqrtm1);
+  }
+
+  if (fe51_isnegative(r->X) != (s[31] >> 7)) {
+    /* If x = 0, the sign must be positive */
+    if (!fe51_isnonzero(r->X)) {
+      return -1;
+    }
+    fe51_neg(r->X, r->X);
+  }
+
+  fe51_mul(r->T, r->X, r->Y);
+  return 0;
+}
+
+int ge_frombytes_vartime_fe51(ge_p3 *h, const unsigned char *s) {
+  ge51_p3 r;
+  if (ge51_frombytes_vartime(&r, s) != 0)
+    return -1;
+  ge_p3_from_ge51(h, &r);
+  return 0;
+}
+
+void ge_fromfe_frombytes_vartime_fe51(ge_p2 *r, const unsigned char *s) {
+  ge51_p2 p;
+  fe51 u, v, w, x, y, z;
+  unsigned char sign;
+
+  /* unlike fe51_frombytes, the top bit counts, as 2^255 = 19 */
+  fe51_frombytes(u, s);
+  u[0] += 19 * (s[31] >> 7);
+
+  fe51_sq2(v, u); /* 2 * u^2 */
+  fe51_1(w);
+  fe51_add(w, v, w); /* w = 2 * u^2 + 1 */
+  fe51_sq(x, w); /* w^2 */
+  fe51_mul(y, fe51_ma2, v); /* -2 * A^2 * u^2 */
+  fe51_add(x, x, y); /* x = w^2 - 2 * A^2 * u^2 */
+  fe51_divpowm1(p.X, w, x); /* (w / x)^(m + 1) */
+  fe51_sq(y, p.X);
+  fe51_mul(x, y, x);
+  fe51_sub(y, w, x);
+  fe51_copy(z, fe51_ma);
+  if (fe51_isnonzero(y)) {
+    fe51_add(y, w, x);
+    if (fe51_isnonzero(y)) {
+      goto negative;
+    } else {
+      fe51_mul(p.X, p.X, fe51_fffb1);
+    }
+  } else {
+    fe51_mul(p.X, p.X, fe51_fffb2);
+  }
+  fe51_mul(p.X, p.X, u); /* u * sqrt(2 * A * (A + 2) * w / x) */
+  fe51_mul(z, z, v); /* -2 * A * u^2 */
+  sign = 0;
+  goto setsign;
+negative:
+  fe51_mul(x, x, fe51_sqrtm1);
+  fe51_sub(y, w, x);
+  if (fe51_isnonzero(y)) {
+    assert((fe51_add(y, w, x), !fe51_isnonzero(y)));
+    fe51_mul(p.X, p.X, fe51_fffb3);
+  } else {
+    fe51_mul(p.X, p.X, fe51_fffb4);
+  }
+  /* p.X = sqrt(A * (A + 2) * w / x) */
+  /* z = -A */
+  sign = 1;
+setsign:
+  if (fe51_isnegative(p.X) != sign) {
+    assert(fe51_isnonzero(p.X));
+    fe51_neg(p.X, p.X);
+  }
+  fe51_add(p.Z, z, w);
+  fe51_sub(p.Y, z, w);
+  fe51_mul(p.X, p.X, p.Z);
+  ge_p2_from_ge51(r, &p);
+}
+
+/* Point encoding */
+
+static void ge51_tobytes(unsigned char *s, const fe51 X, const fe51 Y, const fe51 Z) {
+  fe51 recip;
+  fe51 x;
+  fe51 y;
+
+  fe51_invert(recip, Z);
+  fe51_mul(x, X, recip);
+  fe51_mul(y, Y, recip);
+  fe51_tobytes(s, y);
+  s[31] ^= fe51_isnegative(x) << 7;
+}
+
+void ge_tobytes_fe51(unsigned char *s, const ge_p2 *h) {
+  fe51 X, Y, Z;
+  fe51_from_fe(X, h->X);
+  fe51_from_fe(Y, h->Y);
+  fe51_from_fe(Z, h->Z);
+  ge51_tobytes(s, X, Y, Z);
+}
+
+void ge_p3_tobytes_fe51(unsigned char *s, const ge_p3 *h) {
+  fe51 X, Y, Z;
+  fe51_from_fe(X, h->X);
+  fe51_from_fe(Y, h->Y);
+  fe51_from_fe(Z, h->Z);
+  ge51_tobytes(s, X, Y, Z);
+}
+
+/* Constant time scalar multiplications, as their ref10 counterparts */
+
+void ge_scalarmult_base_fe51(ge_p3 *h, const unsigned char *a) {
+  signed char e[64];
+  signed char carry;
+  ge51_p1p1 r;
+  ge51_p2 s;
+  ge51_p3 p;
+  ge51_precomp t;
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    e[2 * i + 0] = (a[i] >> 0) & 15;
+    e[2 * i + 1] = (a[i] >> 4) & 15;
+  }
+  /* each e[i] is between 0 and 15 */
+  /* e[63] is between 0 and 7 */
+
+  carry = 0;
+  for (i = 0; i < 63; ++i) {
+    e[i] += carry;
+    carry = e[i] + 8;
+    carry >>= 4;
+    e[i] -= carry << 4;
+  }
+  e[63] += carry;
+  /* each e[i] is between -8 and 8 */
+
+  ge51_p3_0(&p);
+  for (i = 1; i < 64; i += 2) {
+    select_base(&t, i / 2, e[i]);
+    ge51_madd(&r, &p, &t); ge51_p1p1_to_p3(&p, &r);
+  }
+
+  ge51_p3_dbl(&r, &p);  ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p2(&s, &r);
+  ge51_p2_dbl(&r, &s); ge51_p1p1_to_p3(&p, &r);
+
+  for (i = 0; i < 64; i += 2) {
+    select_base(&t, i / 2, e[i]);
+    ge51_madd(&r, &p, &t); ge51_p1p1_to_p3(&p, &r);
+  }
+
+  ge_p3_from_ge51(h, &p);
+}
+
+static void ge51_scalarmult_recode(signed char e[64], const unsigned char *a) {
+  int carry, carry2, i;
+
+  carry = 0; /* 0..1 */
+  for (i = 0; i < 31; i++) {
+    carry += a[i]; /* 0..256 */
+    carry2 = (carry + 8) >> 4; /* 0..16 */
+    e[2 * i] = carry - (carry2 << 4); /* -8..7 */
+    carry = (carry2 + 8) >> 4; /* 0..1 */
+    e[2 * i + 1] = carry2 - (carry << 4); /* -8..7 */
+  }
+  carry += a[31]; /* 0..128 */
+  carry2 = (carry + 8) >> 4; /* 0..8 */
+  e[62] = carry - (carry2 << 4); /* -8..7 */
+  e[63] = carry2; /* 0..8 */
+}
+
+/* Leaves the last sum in t, for the caller to convert as it needs */
+static void ge51_scalarmult_recoded(ge51_p1p1 *t, const signed char e[64], const ge51_p3 *A51) {
+  ge51_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
+  ge51_p3 u;
+  ge51_p2 r;
+  int i;
+
+  ge51_p3_to_cached(&Ai[0], A51);
+  for (i = 0; i < 7; i++) {
+    ge51_add(t, A51, &Ai[i]);
+    ge51_p1p1_to_p3(&u, t);
+    ge51_p3_to_cached(&Ai[i + 1], &u);
+  }
+
+  ge51_p2_0(&r);
+  for (i = 63; i >= 0; i--) {
+    signed char b = e[i];
+    unsigned char bnegative = negative(b);
+    unsigned char babs = b - (((-bnegative) & b) << 1);
+    ge51_cached cur, minuscur;
+    int j;
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p2(&r, t);
+    ge51_p2_dbl(t, &r);
+    ge51_p1p1_to_p3(&u, t);
+    ge51_cached_0(&cur);
+    for (j = 0; j < 8; ++j) {
+      ge51_cached_cmov(&cur, &Ai[j], equal(babs, j + 1));
+    }
+    fe51_copy(minuscur.YplusX, cur.YminusX);
+    fe51_copy(minuscur.YminusX, cur.YplusX);
+    fe51_copy(minuscur.Z, cur.Z);
+    fe51_neg(minuscur.T2d, cur.T2d);
+    ge51_cached_cmov(&cur, &minuscur, bnegative);
+    ge51_add(t, &u, &cur);
+    if (i > 0)
+      ge51_p1p1_to_p2(&r, t);
+  }
+}
+
+static void ge51_scalarmult(ge51_p1p1 *t, const unsigned char *a, const ge_p3 *A) {
+  signed char e[64];
+  ge51_p3 A51;
+
+  ge51_scalarmult_recode(e, a);
+  ge51_p3_from_ge(&A51, A);
+  ge51_scalarmult_recoded(t, e, &A51);
+}
+
+void ge_scalarmult_fe51(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
+  ge51_p1p1 t;
+  ge51_p2 r51;
+  ge51_scalarmult(&t, a, A);
+  ge51_p1p1_to_p2(&r51, &t);
+  ge_p2_from_ge51(r, &r51);
+}
+
+void ge_scalarmult_p3_fe51(ge_p3 *r3, const unsigned char *a, const ge_p3 *A) {
+  ge51_p1p1 t;
+  ge51_p3 r51;
+  ge51_scalarmult(&t, a, A);
+  ge51_p1p1_to_p3(&r51, &t);
+  ge_p3_from_ge51(r3, &r51);
+}
+
+/* The scalar is recoded once for the whole batch, and the points never
+   leave the 51 bit representation */
+void ge_scalarmult8_tobytes_batch_fe51(unsigned char *r, int *ok, const unsigned char *a, const unsigned char *s, size_t n) {
+  signed char e[64];
+  ge51_p2 p[GE_TOBYTES_BATCH];
+  fe51 acc[GE_TOBYTES_BATCH];
+  fe51 t, recip, x, y;
+  ge51_p3 A;
+  ge51_p1p1 q;
+  size_t i, m;
+
+  ge51_scalarmult_recode(e, a);
+  for (; n > 0; n -= m, r += 32 * m, s += 32 * m, ok += m) {
+    m = n < GE_TOBYTES_BATCH ? n : GE_TOBYTES_BATCH;
+    fe51_1(t);
+    for (i = 0; i < m; ++i) {
+      ok[i] = ge51_frombytes_vartime(&A, s + 32 * i) == 0;
+      if (ok[i]) {
+        ge51_scalarmult_recoded(&q, e, &A);
+        ge51_p1p1_to_p2(&p[i], &q);
+        ge51_p2_dbl(&q, &p[i]); ge51_p1p1_to_p2(&p[i], &q);
+        ge51_p2_dbl(&q, &p[i]); ge51_p1p1_to_p2(&p[i], &q);
+        ge51_p2_dbl(&q, &p[i]); ge51_p1p1_to_p2(&p[i], &q);
+      } else {
+        ge51_p2_0(&p[i]);
+      }
+      fe51_copy(acc[i], t);
+      fe51_mul(t, t, p[i].Z);
+    }
+
+    fe51_invert(recip, t);
+    for (i = m; i-- > 0; ) {
+      fe51_mul(t, recip, acc[i]); /* 1 / Z[i] */
+      fe51_mul(recip, recip, p[i].Z);
+      fe51_mul(x, p[i].X, t);
+      fe51_mul(y, p[i].Y, t);
+      fe51_tobytes(r + 32 * i, y);
+      r[32 * i + 31] ^= fe51_isnegative(x) << 7;
+    }
+  }
+}
+
+/* Variable time multi-scalar multiplications
+
+   Each term is a scalar with either a table of odd multiples of its point
+   or, for the base point, the precomputed ge51_Bi.  Terms are added in the
+   order given, as the ref10 functions do, so the projective results match
+   theirs exactly. */
+
+typedef struct {
+  signed char slide[256];
+  const ge51_cached *table; /* NULL for the base point */
+} ge51_vartime_term;
+
+static void ge51_vartime_term_init(ge51_vartime_term *term, const unsigned char *scalar, const ge51_cached *table) {
+  slide(term->slide, scalar);
+  term->table = table;
+}
+
+/* Returns 0 if all the scalars are zero, and t was not written */
+static int ge51_multi_scalarmult_vartime(ge51_p1p1 *t, const ge51_vartime_term *terms, int n) {
+  ge51_p2 r;
+  ge51_p3 u;
+  int i, j;
+
+  for (i = 255; i >= 0; --i) {
+    for (j = 0; j < n; ++j) {
+      if (terms[j].slide[i])
+        break;
+    }
+    if (j < n)
+      break;
+  }
+  if (i < 0)
+    return 0;
+
+  ge51_p2_0(&r);
+  for (; i >= 0; --i) {
+    ge51_p2_dbl(t, &r);
+
+    for (j = 0; j < n; ++j) {
+      const signed char d = terms[j].slide[i];
+      if (d == 0)
+        continue;
+      ge51_p1p1_to_p3(&u, t);
+      if (terms[j].table) {
+        if (d > 0)
+          ge51_add(t, &u, &terms[j].table[d / 2]);
+        else
+          ge51_sub(t, &u, &terms[j].table[(-d) / 2]);
+      } else {
+        if (d > 0)
+          ge51_madd(t, &u, &ge51_Bi[d / 2]);
+        else
+          ge51_msub(t, &u, &ge51_Bi[(-d) / 2]);
+      }
+    }
+
+    if (i > 0)
+      ge51_p1p1_to_p2(&r, t);
+  }
+  return 1;
+}
+
+static void ge51_multi_scalarmult_vartime_p2(ge_p2 *r, const ge51_vartime_term *terms, int n) {
+  ge51_p1p1 t;
+  ge51_p2 r51;
+  if (ge51_multi_scalarmult_vartime(&t, terms, n))
+    ge51_p1p1_to_p2(&r51, &t);
+  else
+    ge51_p2_0(&r51);
+  ge_p2_from_ge51(r, &r51);
+}
+
+/* Like the ref10 functions, leaves r3 alone if all the scalars are zero */
+static void ge51_multi_scalarmult_vartime_p3(ge_p3 *r3, const ge51_vartime_term *terms, int n) {
+  ge51_p1p1 t;
+  ge51_p3 r51;
+  if (ge51_multi_scalarmult_vartime(&t, terms, n)) {
+    ge51_p1p1_to_p3(&r51, &t);
+    ge_p3_from_ge51(r3, &r51);
+  }
+}
+
+/* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A, as ge_dsm_precomp */
+static void ge51_dsm_precomp(ge51_cached r[8], const ge_p3 *s) {
+  ge51_p1p1 t;
+  ge51_p3 s51, s2, u;
+  int i;
+  ge51_p3_from_ge(&s51, s);
+  ge51_p3_to_cached(&r[0], &s51);
+  ge51_p3_dbl(&t, &s51); ge51_p1p1_to_p3(&s2, &t);
+  for (i = 0; i < 7; ++i) {
+    ge51_add(&t, &s2, &r[i]); ge51_p1p1_to_p3(&u, &t); ge51_p3_to_cached(&r[i + 1], &u);
+  }
+}
+
+void ge_double_scalarmult_base_vartime_fe51(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge51_cached Ai[8];
+  ge51_vartime_term terms[2];
+  ge51_dsm_precomp(Ai, A);
+  ge51_vartime_term_init(&terms[0], a, Ai);
+  ge51_vartime_term_init(&terms[1], b, NULL);
+  ge51_multi_scalarmult_vartime_p2(r, terms, 2);
+}
+
+void ge_double_scalarmult_base_vartime_p3_fe51(ge_p3 *r3, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge51_cached Ai[8];
+  ge51_vartime_term terms[2];
+  ge51_dsm_precomp(Ai, A);
+  ge51_vartime_term_init(&terms[0], a, Ai);
+  ge51_vartime_term_init(&terms[1], b, NULL);
+  ge51_multi_scalarmult_vartime_p3(r3, terms, 2);
+}
+
+void ge_triple_scalarmult_base_vartime_fe51(ge_p2 *r, const unsigned char *a, const unsigned char *b, const ge_dsmp Bi, const unsigned char *c, const ge_dsmp Ci) {
+  ge51_cached Bi51[8], Ci51[8];
+  ge51_vartime_term terms[3];
+  ge51_dsmp_from_ge(Bi51, Bi);
+  ge51_dsmp_from_ge(Ci51, Ci);
+  ge51_vartime_term_init(&terms[0], a, NULL);
+  ge51_vartime_term_init(&terms[1], b, Bi51);
+  ge51_vartime_term_init(&terms[2], c, Ci51);
+  ge51_multi_scalarmult_vartime_p2(r, terms, 3);
+}
+
+void ge_double_scalarmult_precomp_vartime2_fe51(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+  ge51_cached Ai51[8], Bi51[8];
+  ge51_vartime_term terms[2];
+  ge51_dsmp_from_ge(Ai51, Ai);
+  ge51_dsmp_from_ge(Bi51, Bi);
+  ge51_vartime_term_init(&terms[0], a, Ai51);
+  ge51_vartime_term_init(&terms[1], b, Bi51);
+  ge51_multi_scalarmult_vartime_p2(r, terms, 2);
+}
+
+void ge_double_scalarmult_precomp_vartime2_p3_fe51(ge_p3 *r3, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+  ge51_cached Ai51[8], Bi51[8];
+  ge51_vartime_term terms[2];
+  ge51_dsmp_from_ge(Ai51, Ai);
+  ge51_dsmp_from_ge(Bi51, Bi);
+  ge51_vartime_term_init(&terms[0], a, Ai51);
+  ge51_vartime_term_init(&terms[1], b, Bi51);
+  ge51_multi_scalarmult_vartime_p3(r3, terms, 2);
+}
+
+void ge_triple_scalarmult_precomp_vartime_fe51(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi, const unsigned char *c, const ge_dsmp Ci) {
+  ge51_cached Ai51[8], Bi51[8], Ci51[8];
+  ge51_vartime_term terms[3];
+  ge51_dsmp_from_ge(Ai51, Ai);
+  ge51_dsmp_from_ge(Bi51, Bi);
+  ge51_dsmp_from_ge(Ci51, Ci);
+  ge51_vartime_term_init(&terms[0], a, Ai51);
+  ge51_vartime_term_init(&terms[1], b, Bi51);
+  ge51_vartime_term_init(&terms[2], c, Ci51);
+  ge51_multi_scalarmult_vartime_p2(r, terms, 3);
+}
+
+#endif
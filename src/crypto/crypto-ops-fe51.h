@@ -0,0 +1,83 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "crypto-ops.h"
+
+/* 64 bit field arithmetic backend: radix 2^51 limbs with 128 bit products,
+   in the style of ed25519-donna's 64 bit code.  The entry points below take
+   and return the ref10 types of crypto-ops.h, converting at the edges, and
+   are only used when crypto_ops_get_backend() selects them. */
+
+#if defined(__SIZEOF_INT128__) && !defined(NO_CRYPTO_OPS_FE51)
+#define CRYPTO_OPS_FE51 1
+#else
+#define CRYPTO_OPS_FE51 0
+#endif
+
+#if CRYPTO_OPS_FE51
+
+typedef uint64_t fe51[5];
+
+typedef struct {
+  fe51 yplusx;
+  fe51 yminusx;
+  fe51 xy2d;
+} ge51_precomp;
+
+extern const fe51 fe51_d;
+extern const fe51 fe51_sqrtm1;
+extern const fe51 fe51_d2;
+extern const ge51_precomp ge51_base[32][8];
+extern const ge51_precomp ge51_Bi[8];
+extern const fe51 fe51_ma2;
+extern const fe51 fe51_ma;
+extern const fe51 fe51_fffb1;
+extern const fe51 fe51_fffb2;
+extern const fe51 fe51_fffb3;
+extern const fe51 fe51_fffb4;
+
+int ge_frombytes_vartime_fe51(ge_p3 *, const unsigned char *);
+void ge_fromfe_frombytes_vartime_fe51(ge_p2 *, const unsigned char *);
+void ge_tobytes_fe51(unsigned char *, const ge_p2 *);
+void ge_p3_tobytes_fe51(unsigned char *, const ge_p3 *);
+void ge_scalarmult_base_fe51(ge_p3 *, const unsigned char *);
+void ge_scalarmult_fe51(ge_p2 *, const unsigned char *, const ge_p3 *);
+void ge_scalarmult_p3_fe51(ge_p3 *, const unsigned char *, const ge_p3 *);
+void ge_scalarmult8_tobytes_batch_fe51(unsigned char *, int *, const unsigned char *, const unsigned char *, size_t);
+void ge_double_scalarmult_base_vartime_fe51(ge_p2 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+void ge_double_scalarmult_base_vartime_p3_fe51(ge_p3 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+void ge_triple_scalarmult_base_vartime_fe51(ge_p2 *, const unsigned char *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
+void ge_double_scalarmult_precomp_vartime2_fe51(ge_p2 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
+void ge_double_scalarmult_precomp_vartime2_p3_fe51(ge_p3 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
+void ge_triple_scalarmult_precomp_vartime_fe51(ge_p2 *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
+
+#endif
@@ -33,9 +33,25 @@
 
 #include "warnings.h"
 #include "crypto-ops.h"
+#include "crypto-ops-fe51.h"
 
 DISABLE_VS_WARNINGS(4146 4244)
 
+/* Backend selection */
+
+static enum crypto_ops_backend backend = CRYPTO_OPS_FE51 ? CRYPTO_OPS_BACKEND_FE51 : CRYPTO_OPS_BACKEND_REF10;
+
+int crypto_ops_set_backend(enum crypto_ops_backend b) {
+  if (b == CRYPTO_OPS_BACKEND_FE51 && !CRYPTO_OPS_FE51)
+    return 0;
+  backend = b;
+  return 1;
+}
+
+enum crypto_ops_backend crypto_ops_get_backend(void) {
+  return backend;
+}
+
 /* Predeclarations */
 
 static void fe_sq(fe, const fe);
@@ -1193,6 +1209,12 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_double_scalarmult_base_vartime_fe51(r, a, A, b);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
@@ -1235,6 +1257,12 @@ void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const g
 
 // Computes aG + bB + cC (G is the fixed basepoint)
 void ge_triple_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const unsigned char *b, const ge_dsmp Bi, const unsigned char *c, const ge_dsmp Ci) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_triple_scalarmult_base_vartime_fe51(r, a, b, Bi, c, Ci);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   signed char cslide[256];
@@ -1284,6 +1312,12 @@ void ge_triple_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const u
 }
 
 void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_double_scalarmult_base_vartime_p3_fe51(r3, a, A, b);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
@@ -1331,6 +1365,10 @@ void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, con
 /* From ge_frombytes.c, modified */
 
 int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51)
+    return ge_frombytes_vartime_fe51(h, s);
+#endif
   fe u;
   fe v;
   fe vxx;
@@ -1563,6 +1601,12 @@ void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p) {
 /* From ge_p3_tobytes.c */
 
 void ge_p3_tobytes(unsigned char *s, const ge_p3 *h) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_p3_tobytes_fe51(s, h);
+    return;
+  }
+#endif
   fe recip;
   fe x;
   fe y;
@@ -1636,6 +1680,12 @@ Preconditions:
 */
 
 void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_scalarmult_base_fe51(h, a);
+    return;
+  }
+#endif
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
@@ -1701,6 +1751,12 @@ void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *s, const ge_p2 *h) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_tobytes_fe51(s, h);
+    return;
+  }
+#endif
   fe recip;
   fe x;
   fe y;
@@ -1712,6 +1768,48 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+void ge_scalarmult8_tobytes_batch(unsigned char *r, int *ok, const unsigned char *a, const unsigned char *s, size_t n) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_scalarmult8_tobytes_batch_fe51(r, ok, a, s, n);
+    return;
+  }
+#endif
+  ge_p2 p[GE_TOBYTES_BATCH];
+  fe acc[GE_TOBYTES_BATCH];
+  fe t, recip, x, y;
+  ge_p3 A;
+  ge_p1p1 q;
+  size_t i, m;
+
+  for (; n > 0; n -= m, r += 32 * m, s += 32 * m, ok += m) {
+    m = n < GE_TOBYTES_BATCH ? n : GE_TOBYTES_BATCH;
+    fe_1(t);
+    for (i = 0; i < m; ++i) {
+      ok[i] = ge_frombytes_vartime(&A, s + 32 * i) == 0;
+      if (ok[i]) {
+        ge_scalarmult(&p[i], a, &A);
+        ge_mul8(&q, &p[i]);
+        ge_p1p1_to_p2(&p[i], &q);
+      } else {
+        ge_p2_0(&p[i]);
+      }
+      fe_copy(acc[i], t);
+      fe_mul(t, t, p[i].Z);
+    }
+
+    fe_invert(recip, t);
+    for (i = m; i-- > 0; ) {
+      fe_mul(t, recip, acc[i]); /* 1 / Z[i] */
+      fe_mul(recip, recip, p[i].Z);
+      fe_mul(x, p[i].X, t);
+      fe_mul(y, p[i].Y, t);
+      fe_tobytes(r + 32 * i, y);
+      r[32 * i + 31] ^= fe_isnegative(x) << 7;
+    }
+  }
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -2035,6 +2133,12 @@ static void ge_cached_cmov(ge_cached *t, const ge_cached *u, unsigned char b) {
 
 /* Assumes that a[31] <= 127 */
 void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_scalarmult_fe51(r, a, A);
+    return;
+  }
+#endif
   signed char e[64];
   int carry, carry2, i;
   ge_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
@@ -2095,6 +2199,12 @@ void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
 }
 
 void ge_scalarmult_p3(ge_p3 *r3, const unsigned char *a, const ge_p3 *A) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_scalarmult_p3_fe51(r3, a, A);
+    return;
+  }
+#endif
   signed char e[64];
   int carry, carry2, i;
   ge_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
@@ -2159,6 +2269,12 @@ void ge_scalarmult_p3(ge_p3 *r3, const unsigned char *a, const ge_p3 *A) {
 }
 
 void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_double_scalarmult_precomp_vartime2_fe51(r, a, Ai, b, Bi);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   ge_p1p1 t;
@@ -2199,6 +2315,12 @@ void ge_double_scalarmult_precomp_vartime2(ge_p2 *r, const unsigned char *a, con
 
 // Computes aA + bB + cC (all points require precomputation)
 void ge_triple_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi, const unsigned char *c, const ge_dsmp Ci) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_triple_scalarmult_precomp_vartime_fe51(r, a, Ai, b, Bi, c, Ci);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   signed char cslide[256];
@@ -2248,6 +2370,12 @@ void ge_triple_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, cons
 }
 
 void ge_double_scalarmult_precomp_vartime2_p3(ge_p3 *r3, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b, const ge_dsmp Bi) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_double_scalarmult_precomp_vartime2_p3_fe51(r3, a, Ai, b, Bi);
+    return;
+  }
+#endif
   signed char aslide[256];
   signed char bslide[256];
   ge_p1p1 t;
@@ -2307,6 +2435,12 @@ void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
 }
 
 void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
+#if CRYPTO_OPS_FE51
+  if (backend == CRYPTO_OPS_BACKEND_FE51) {
+    ge_fromfe_frombytes_vartime_fe51(r, s);
+    return;
+  }
+#endif
   fe u, v, w, x, y, z;
   unsigned char sign;
 
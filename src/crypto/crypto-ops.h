@@ -30,8 +30,19 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Field arithmetic backends. The 64 bit one is the default wherever the
+   compiler has 128 bit integers; the ref10 one is always available. */
+
+enum crypto_ops_backend {
+  CRYPTO_OPS_BACKEND_REF10,
+  CRYPTO_OPS_BACKEND_FE51,
+};
+int crypto_ops_set_backend(enum crypto_ops_backend); /* 0 if not compiled in */
+enum crypto_ops_backend crypto_ops_get_backend(void);
+
 /* From fe.h */
 
 typedef int32_t fe[10];
@@ -124,6 +135,12 @@ void ge_scalarmult_base(ge_p3 *, const unsigned char *);
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
 
+/* 8 * a * A for each of n encoded points A in s, encoded into r, with one
+   field inversion shared by up to GE_TOBYTES_BATCH outputs. Where a point
+   fails to decode, its ok entry is 0 and its output is the identity. */
+#define GE_TOBYTES_BATCH 64
+void ge_scalarmult8_tobytes_batch(unsigned char *r, int *ok, const unsigned char *a, const unsigned char *s, size_t n);
+
 /* From sc_reduce.c */
 
 void sc_reduce(unsigned char *);
@@ -202,6 +202,22 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::generate_key_derivations(const std::vector<public_key> &keys1, const secret_key &key2, std::vector<key_derivation> &derivations, std::vector<bool> &valid) {
+    static_assert(sizeof(public_key) == 32 && sizeof(key_derivation) == 32, "Unexpected key sizes");
+    assert(sc_check(&key2) == 0);
+    std::vector<int> ok(keys1.size());
+    derivations.resize(keys1.size());
+    ge_scalarmult8_tobytes_batch(reinterpret_cast<unsigned char*>(derivations.data()), ok.data(), &unwrap(key2), reinterpret_cast<const unsigned char*>(keys1.data()), keys1.size());
+    valid.resize(keys1.size());
+    bool all_valid = true;
+    for (size_t i = 0; i < ok.size(); ++i)
+    {
+      valid[i] = ok[i] != 0;
+      all_valid &= valid[i];
+    }
+    return all_valid;
+  }
+
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     struct {
       key_derivation derivation;
@@ -127,6 +127,8 @@ namespace crypto {
     friend bool secret_key_to_public_key(const secret_key &, public_key &);
     static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
+    static bool generate_key_derivations(const std::vector<public_key> &, const secret_key &, std::vector<key_derivation> &, std::vector<bool> &);
+    friend bool generate_key_derivations(const std::vector<public_key> &, const secret_key &, std::vector<key_derivation> &, std::vector<bool> &);
     static void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
@@ -230,6 +232,32 @@ namespace crypto {
   inline bool generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
     return crypto_ops::generate_key_derivation(key1, key2, derivation);
   }
+  /* Same as generate_key_derivation for each of a list of keys, sharing the
+   * work that only depends on the secret key and the final inversion. Keys
+   * that are not valid points get a false in valid and the identity as their
+   * derivation. Returns whether all keys were valid.
+   */
+  inline bool generate_key_derivations(const std::vector<public_key> &keys1, const secret_key &key2, std::vector<key_derivation> &derivations, std::vector<bool> &valid) {
+    return crypto_ops::generate_key_derivations(keys1, key2, derivations, valid);
+  }
+  /* Same results as generate_key_derivations, one key at a time through
+   * derive(key, derivation), for implementations which cannot batch.
+   */
+  template<typename F>
+  bool generate_key_derivations_each(const std::vector<public_key> &keys1, std::vector<key_derivation> &derivations, std::vector<bool> &valid, F derive) {
+    bool all_valid = true;
+    derivations.resize(keys1.size());
+    valid.resize(keys1.size());
+    for (size_t i = 0; i < keys1.size(); ++i) {
+      valid[i] = derive(keys1[i], derivations[i]);
+      if (!valid[i]) {
+        derivations[i] = key_derivation{};
+        derivations[i].data[0] = 1;
+      }
+      all_valid &= valid[i];
+    }
+    return all_valid;
+  }
   inline bool derive_public_key(const key_derivation &derivation, std::size_t output_index,
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
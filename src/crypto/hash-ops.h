@@ -99,7 +99,11 @@ uint64_t rx_seedheight(const uint64_t height);
 void rx_seedheights(const uint64_t height, uint64_t *seed_height, uint64_t *next_height);
 
 void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads);
+void rx_set_next_seedhash(const char *seedhash, size_t max_dataset_init_threads);
 void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash);
+void rx_slow_hash_batch(const char *seedhash, const void *const *data, const size_t *lengths, size_t count, char *result_hashes);
+/* seed hashes of the light mode caches, least recently used first */
+size_t rx_get_light_cache_seedhashes(char *seedhashes, size_t max);
 
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads);
 uint32_t rx_get_miner_thread(void);
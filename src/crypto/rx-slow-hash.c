@@ -47,18 +47,46 @@
 #define alloc_err_msg(x) mdebug(RX_LOGCAT, x);
 
 static CTHR_RWLOCK_TYPE main_dataset_lock = CTHR_RWLOCK_INIT;
-static CTHR_RWLOCK_TYPE main_cache_lock = CTHR_RWLOCK_INIT;
 
 static randomx_dataset *main_dataset = NULL;
-static randomx_cache *main_cache = NULL;
 static char main_seedhash[HASH_SIZE];
 static int main_seedhash_set = 0;
 
-static CTHR_RWLOCK_TYPE secondary_cache_lock = CTHR_RWLOCK_INIT;
-
-static randomx_cache *secondary_cache = NULL;
-static char secondary_seedhash[HASH_SIZE];
-static int secondary_seedhash_set = 0;
+// Dataset for the next seed hash, built in the background before the switch
+static CTHR_RWLOCK_TYPE next_dataset_lock = CTHR_RWLOCK_INIT;
+
+static randomx_dataset *next_dataset = NULL;
+static char next_seedhash[HASH_SIZE];
+static int next_seedhash_set = 0;
+static char next_seedhash_requested[HASH_SIZE];
+static int next_seedhash_requested_set = 0;
+
+// Light mode caches for the most recently used seed hashes.
+// light_caches_lock guards which seed hash each slot holds and how many threads
+// use it. A slot is only given to another seed hash while nobody uses it, so the
+// global lock is never held while waiting for a slot. Each slot's lock is held
+// for writing while its cache is being initialized, and for reading while it is
+// being hashed with
+typedef struct rx_light_cache {
+  CTHR_RWLOCK_TYPE lc_lock;
+  randomx_cache *lc_cache;
+  char lc_seedhash[HASH_SIZE];
+  int lc_seedhash_set;
+  int lc_users;
+  int lc_temporary;
+  uint64_t lc_last_used;
+} rx_light_cache;
+
+#define RX_LIGHT_CACHES_MAX	8
+#define RX_LIGHT_CACHES_DEFAULT	3
+#define RX_LIGHT_CACHE_INIT	{ CTHR_RWLOCK_INIT, NULL, {0}, 0, 0, 0, 0 }
+
+static CTHR_RWLOCK_TYPE light_caches_lock = CTHR_RWLOCK_INIT;
+static rx_light_cache light_caches[RX_LIGHT_CACHES_MAX] = {
+  RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT,
+  RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT, RX_LIGHT_CACHE_INIT
+};
+static uint64_t light_caches_clock = 0;
 
 #if defined(_MSC_VER)
 #define THREADV __declspec(thread)
@@ -67,13 +95,15 @@ static int secondary_seedhash_set = 0;
 #endif
 
 static THREADV randomx_vm *main_vm_full = NULL;
-static THREADV randomx_vm *main_vm_light = NULL;
-static THREADV randomx_vm *secondary_vm_light = NULL;
+static THREADV randomx_dataset *main_vm_full_dataset = NULL;
+static THREADV randomx_vm *light_vm = NULL;
+static THREADV randomx_cache *light_vm_cache = NULL;
+static THREADV char light_vm_seedhash[HASH_SIZE];
 
 static THREADV uint32_t miner_thread = 0;
 
 static bool is_main(const char* seedhash) { return main_seedhash_set && (memcmp(seedhash, main_seedhash, HASH_SIZE) == 0); }
-static bool is_secondary(const char* seedhash) { return secondary_seedhash_set && (memcmp(seedhash, secondary_seedhash, HASH_SIZE) == 0); }
+static bool is_next(const char* seedhash) { return next_seedhash_set && (memcmp(seedhash, next_seedhash, HASH_SIZE) == 0); }
 
 static void local_abort(const char *msg)
 {
@@ -133,6 +163,37 @@ static inline int enabled_flags(void) {
   return flags;
 }
 
+static unsigned int get_light_caches(void) {
+  static unsigned int caches = 0;
+
+  if (caches) {
+    return caches;
+  }
+
+  const char *env = getenv("MONERO_RANDOMX_LIGHT_CACHES");
+  caches = env ? atoi(env) : RX_LIGHT_CACHES_DEFAULT;
+  if (caches < 2 || caches > RX_LIGHT_CACHES_MAX) {
+    caches = RX_LIGHT_CACHES_DEFAULT;
+  }
+
+  return caches;
+}
+
+static int preinit_next_dataset(void) {
+  static int preinit = -1;
+
+  if (preinit != -1) {
+    return preinit;
+  }
+
+  preinit = getenv("MONERO_RANDOMX_PREINIT_NEXT") != NULL;
+  if (preinit) {
+    minfo(RX_LOGCAT, "RandomX dataset for the next seed hash will be built ahead of the switch");
+  }
+
+  return preinit;
+}
+
 #define SEEDHASH_EPOCH_BLOCKS	2048	/* Must be same as BLOCKS_SYNCHRONIZING_MAX_COUNT in cryptonote_config.h */
 #define SEEDHASH_EPOCH_LAG		64
 
@@ -239,7 +300,16 @@ static void rx_alloc_cache(randomx_flags flags, randomx_cache** cache)
 
 static void rx_init_full_vm(randomx_flags flags, randomx_vm** vm)
 {
-  if (*vm || !main_dataset || (disabled_flags() & RANDOMX_FLAG_FULL_MEM)) {
+  if (!main_dataset || (disabled_flags() & RANDOMX_FLAG_FULL_MEM)) {
+    return;
+  }
+
+  if (*vm) {
+    // the dataset for the next seed hash may have been swapped in
+    if (main_vm_full_dataset != main_dataset) {
+      randomx_vm_set_dataset(*vm, main_dataset);
+      main_vm_full_dataset = main_dataset;
+    }
     return;
   }
 
@@ -259,12 +329,18 @@ static void rx_init_full_vm(randomx_flags flags, randomx_vm** vm)
       merror(RX_LOGCAT, "Couldn't allocate RandomX full VM");
     }
   }
+  main_vm_full_dataset = main_dataset;
 }
 
-static void rx_init_light_vm(randomx_flags flags, randomx_vm** vm, randomx_cache* cache)
+static void rx_init_light_vm(randomx_flags flags, randomx_vm** vm, randomx_cache* cache, const char *seedhash)
 {
   if (*vm) {
-    randomx_vm_set_cache(*vm, cache);
+    // a cache slot may have been reinitialized for another seed hash since
+    if (light_vm_cache != cache || memcmp(light_vm_seedhash, seedhash, HASH_SIZE) != 0) {
+      randomx_vm_set_cache(*vm, cache);
+      light_vm_cache = cache;
+      memcpy(light_vm_seedhash, seedhash, HASH_SIZE);
+    }
     return;
   }
 
@@ -284,9 +360,120 @@ static void rx_init_light_vm(randomx_flags flags, randomx_vm** vm, randomx_cache
     *vm = randomx_create_vm(flags & ~disabled_flags(), cache, NULL);
     if (!*vm) local_abort("Couldn't allocate RandomX light VM");
   }
+  light_vm_cache = cache;
+  memcpy(light_vm_seedhash, seedhash, HASH_SIZE);
+}
+
+static void rx_init_light_cache(rx_light_cache *lc, const char *seedhash) {
+  const randomx_flags flags = enabled_flags() & ~disabled_flags();
+  char buf[HASH_SIZE * 2 + 1];
+  hash2hex(seedhash, buf);
+  minfo(RX_LOGCAT, "RandomX new light cache for seed hash %s", buf);
+
+  rx_alloc_cache(flags, &lc->lc_cache);
+  randomx_init_cache(lc->lc_cache, seedhash, HASH_SIZE);
+  minfo(RX_LOGCAT, "RandomX light cache initialized");
+}
+
+// Returns the light cache for seedhash, read locked. If there is none, the least
+// recently used one nobody is using is reinitialized for it first, so that hashing
+// for a recent seed hash (alt chains, reorgs, the epoch switch) never waits for a
+// rebuild. If every slot is in use, e.g. by dataset builds, a temporary cache is
+// built instead, rather than waiting for one of them
+static rx_light_cache *rx_get_light_cache(const char *seedhash) {
+  const unsigned int num_caches = get_light_caches();
+  rx_light_cache *lc = NULL;
+
+  CTHR_RWLOCK_LOCK_WRITE(light_caches_lock);
+  for (unsigned int i = 0; i < num_caches; ++i) {
+    if (light_caches[i].lc_seedhash_set && memcmp(light_caches[i].lc_seedhash, seedhash, HASH_SIZE) == 0) {
+      lc = &light_caches[i];
+      lc->lc_last_used = ++light_caches_clock;
+      ++lc->lc_users;
+      CTHR_RWLOCK_UNLOCK_WRITE(light_caches_lock);
+      // Only waits if the cache is still being initialized for this seed hash
+      CTHR_RWLOCK_LOCK_READ(lc->lc_lock);
+      return lc;
+    }
+  }
+
+  for (unsigned int i = 0; i < num_caches; ++i) {
+    rx_light_cache *candidate = &light_caches[i];
+    if (!candidate->lc_users && (!lc || candidate->lc_last_used < lc->lc_last_used)) {
+      lc = candidate;
+    }
+  }
+
+  if (!lc) {
+    CTHR_RWLOCK_UNLOCK_WRITE(light_caches_lock);
+    lc = calloc(1, sizeof(rx_light_cache));
+    if (!lc) local_abort("Couldn't allocate RandomX light cache");
+    const rx_light_cache init = RX_LIGHT_CACHE_INIT;
+    *lc = init;
+    lc->lc_temporary = 1;
+    rx_init_light_cache(lc, seedhash);
+    CTHR_RWLOCK_LOCK_READ(lc->lc_lock);
+    return lc;
+  }
+
+  // Nobody uses the slot, so this doesn't wait. Threads looking for the same
+  // seed hash meanwhile wait on the slot's lock, not the global one
+  CTHR_RWLOCK_LOCK_WRITE(lc->lc_lock);
+  memcpy(lc->lc_seedhash, seedhash, HASH_SIZE);
+  lc->lc_seedhash_set = 1;
+  lc->lc_last_used = ++light_caches_clock;
+  ++lc->lc_users;
+  CTHR_RWLOCK_UNLOCK_WRITE(light_caches_lock);
+
+  rx_init_light_cache(lc, seedhash);
+
+  // Our use keeps the slot for this seed hash in between
+  CTHR_RWLOCK_UNLOCK_WRITE(lc->lc_lock);
+  CTHR_RWLOCK_LOCK_READ(lc->lc_lock);
+  return lc;
+}
+
+static void rx_release_light_cache(rx_light_cache *lc) {
+  CTHR_RWLOCK_UNLOCK_READ(lc->lc_lock);
+  if (lc->lc_temporary) {
+    randomx_release_cache(lc->lc_cache);
+    free(lc);
+    return;
+  }
+  CTHR_RWLOCK_LOCK_WRITE(light_caches_lock);
+  --lc->lc_users;
+  CTHR_RWLOCK_UNLOCK_WRITE(light_caches_lock);
+}
+
+size_t rx_get_light_cache_seedhashes(char *seedhashes, size_t max) {
+  const unsigned int num_caches = get_light_caches();
+  size_t count = 0;
+  uint64_t last = 0;
+
+  CTHR_RWLOCK_LOCK_READ(light_caches_lock);
+  while (count < max) {
+    // next least recently used one
+    const rx_light_cache *lc = NULL;
+    for (unsigned int i = 0; i < num_caches; ++i) {
+      const rx_light_cache *candidate = &light_caches[i];
+      if (candidate->lc_seedhash_set && candidate->lc_last_used > last && (!lc || candidate->lc_last_used < lc->lc_last_used)) {
+        lc = candidate;
+      }
+    }
+    if (!lc) {
+      break;
+    }
+    memcpy(seedhashes + count * HASH_SIZE, lc->lc_seedhash, HASH_SIZE);
+    last = lc->lc_last_used;
+    ++count;
+  }
+  CTHR_RWLOCK_UNLOCK_READ(light_caches_lock);
+
+  return count;
 }
 
 typedef struct seedinfo {
+  randomx_dataset *si_dataset;
   randomx_cache *si_cache;
   unsigned long si_start;
   unsigned long si_count;
@@ -294,12 +481,12 @@ typedef struct seedinfo {
 
 static CTHR_THREAD_RTYPE rx_seedthread(void *arg) {
   seedinfo *si = arg;
-  randomx_init_dataset(main_dataset, si->si_cache, si->si_start, si->si_count);
+  randomx_init_dataset(si->si_dataset, si->si_cache, si->si_start, si->si_count);
   CTHR_THREAD_RETURN;
 }
 
-static void rx_init_dataset(size_t max_threads) {
-  if (!main_dataset) {
+static void rx_init_dataset(randomx_dataset *dataset, const char *seedhash, size_t max_threads) {
+  if (!dataset) {
     return;
   }
 
@@ -308,33 +495,38 @@ static void rx_init_dataset(size_t max_threads) {
   seedinfo* si = malloc(num_threads * sizeof(seedinfo));
   if (!si) local_abort("Couldn't allocate RandomX mining threadinfo");
 
+  // the light cache for this seed hash can't be reused until the dataset is built
+  rx_light_cache *lc = rx_get_light_cache(seedhash);
+
   const uint32_t delta = randomx_dataset_item_count() / num_threads;
   uint32_t start = 0;
 
   const size_t n1 = num_threads - 1;
   for (size_t i = 0; i < n1; ++i) {
-    si[i].si_cache = main_cache;
+    si[i].si_dataset = dataset;
+    si[i].si_cache = lc->lc_cache;
     si[i].si_start = start;
     si[i].si_count = delta;
     start += delta;
   }
 
-  si[n1].si_cache = main_cache;
+  si[n1].si_dataset = dataset;
+  si[n1].si_cache = lc->lc_cache;
   si[n1].si_start = start;
   si[n1].si_count = randomx_dataset_item_count() - start;
 
   CTHR_THREAD_TYPE *st = malloc(num_threads * sizeof(CTHR_THREAD_TYPE));
   if (!st) local_abort("Couldn't allocate RandomX mining threadlist");
 
-  CTHR_RWLOCK_LOCK_READ(main_cache_lock);
   for (size_t i = 0; i < n1; ++i) {
     if (!CTHR_THREAD_CREATE(st[i], rx_seedthread, &si[i])) {
       local_abort("Couldn't start RandomX seed thread");
     }
   }
-  randomx_init_dataset(main_dataset, si[n1].si_cache, si[n1].si_start, si[n1].si_count);
+  randomx_init_dataset(dataset, si[n1].si_cache, si[n1].si_start, si[n1].si_count);
   for (size_t i = 0; i < n1; ++i) CTHR_THREAD_JOIN(st[i]);
-  CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
+
+  rx_release_light_cache(lc);
 
   free(st);
   free(si);
@@ -350,12 +542,13 @@ typedef struct thread_info {
 static CTHR_THREAD_RTYPE rx_set_main_seedhash_thread(void *arg) {
   thread_info* info = arg;
 
+  // Light mode hashing for the new seed hash is ready before it becomes the main one
+  rx_release_light_cache(rx_get_light_cache(info->seedhash));
+
   CTHR_RWLOCK_LOCK_WRITE(main_dataset_lock);
-  CTHR_RWLOCK_LOCK_WRITE(main_cache_lock);
 
   // Double check that seedhash wasn't already updated
   if (is_main(info->seedhash)) {
-    CTHR_RWLOCK_UNLOCK_WRITE(main_cache_lock);
     CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
     free(info);
     CTHR_THREAD_RETURN;
@@ -367,17 +560,25 @@ static CTHR_THREAD_RTYPE rx_set_main_seedhash_thread(void *arg) {
   hash2hex(main_seedhash, buf);
   minfo(RX_LOGCAT, "RandomX new main seed hash is %s", buf);
 
-  const randomx_flags flags = enabled_flags() & ~disabled_flags();
-  rx_alloc_dataset(flags, &main_dataset, 0);
-  rx_alloc_cache(flags, &main_cache);
-
-  randomx_init_cache(main_cache, info->seedhash, HASH_SIZE);
-  minfo(RX_LOGCAT, "RandomX main cache initialized");
-
-  CTHR_RWLOCK_UNLOCK_WRITE(main_cache_lock);
+  // Swap in the dataset built ahead for this seed hash, if there is one. Until
+  // main_dataset_lock is released, rx_slow_hash uses light mode
+  int swapped = 0;
+  CTHR_RWLOCK_LOCK_WRITE(next_dataset_lock);
+  if (next_dataset && is_next(info->seedhash)) {
+    randomx_dataset *dataset = main_dataset;
+    main_dataset = next_dataset;
+    next_dataset = dataset;
+    next_seedhash_set = 0;
+    swapped = 1;
+    minfo(RX_LOGCAT, "RandomX dataset for the new main seed hash was built ahead");
+  }
+  CTHR_RWLOCK_UNLOCK_WRITE(next_dataset_lock);
 
-  // From this point, rx_slow_hash can calculate hashes in light mode, but dataset is not initialized yet
-  rx_init_dataset(info->max_threads);
+  if (!swapped) {
+    const randomx_flags flags = enabled_flags() & ~disabled_flags();
+    rx_alloc_dataset(flags, &main_dataset, 0);
+    rx_init_dataset(main_dataset, info->seedhash, info->max_threads);
+  }
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
 
@@ -405,86 +606,107 @@ void rx_set_main_seedhash(const char *seedhash, size_t max_dataset_init_threads)
   CTHR_THREAD_CLOSE(t);
 }
 
-void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash) {
-  const randomx_flags flags = enabled_flags() & ~disabled_flags();
-  int success = 0;
+static CTHR_THREAD_RTYPE rx_set_next_seedhash_thread(void *arg) {
+  thread_info* info = arg;
 
-  // Fast path (seedhash == main_seedhash)
-  // Multiple threads can run in parallel in fast or light mode, 1-2 ms or 10-15 ms per hash per thread
-  if (is_main(seedhash)) {
-    // If CTHR_RWLOCK_TRYLOCK_READ fails it means dataset is being initialized now, so use the light mode
-    if (main_dataset && CTHR_RWLOCK_TRYLOCK_READ(main_dataset_lock)) {
-      // Double check that main_seedhash didn't change
-      if (is_main(seedhash)) {
-        rx_init_full_vm(flags, &main_vm_full);
-        if (main_vm_full) {
-          randomx_calculate_hash(main_vm_full, data, length, result_hash);
-          success = 1;
-        }
-      }
-      CTHR_RWLOCK_UNLOCK_READ(main_dataset_lock);
-    } else {
-      CTHR_RWLOCK_LOCK_READ(main_cache_lock);
-      // Double check that main_seedhash didn't change
-      if (is_main(seedhash)) {
-        rx_init_light_vm(flags, &main_vm_light, main_cache);
-        randomx_calculate_hash(main_vm_light, data, length, result_hash);
-        success = 1;
+  rx_release_light_cache(rx_get_light_cache(info->seedhash));
+
+  if (preinit_next_dataset()) {
+    CTHR_RWLOCK_LOCK_WRITE(next_dataset_lock);
+    if (!is_next(info->seedhash) && !is_main(info->seedhash)) {
+      const randomx_flags flags = enabled_flags() & ~disabled_flags();
+      next_seedhash_set = 0;
+      rx_alloc_dataset(flags, &next_dataset, 0);
+      if (next_dataset) {
+        char buf[HASH_SIZE * 2 + 1];
+        hash2hex(info->seedhash, buf);
+        minfo(RX_LOGCAT, "RandomX building dataset for next seed hash %s", buf);
+        rx_init_dataset(next_dataset, info->seedhash, info->max_threads);
+        memcpy(next_seedhash, info->seedhash, HASH_SIZE);
+        next_seedhash_set = 1;
       }
-      CTHR_RWLOCK_UNLOCK_READ(main_cache_lock);
     }
+    CTHR_RWLOCK_UNLOCK_WRITE(next_dataset_lock);
   }
 
-  if (success) {
+  free(info);
+  CTHR_THREAD_RETURN;
+}
+
+void rx_set_next_seedhash(const char *seedhash, size_t max_dataset_init_threads) {
+  // Early out if this seedhash was already requested or is in use
+  if (is_main(seedhash) || (next_seedhash_requested_set && memcmp(seedhash, next_seedhash_requested, HASH_SIZE) == 0)) {
     return;
   }
+  memcpy(next_seedhash_requested, seedhash, HASH_SIZE);
+  next_seedhash_requested_set = 1;
 
-  char buf[HASH_SIZE * 2 + 1];
+  // Build the light cache, and the dataset if enabled, in the background
+  thread_info* info = malloc(sizeof(thread_info));
+  if (!info) local_abort("Couldn't allocate RandomX mining threadinfo");
 
-  // Slow path (seedhash != main_seedhash, but seedhash == secondary_seedhash)
-  // Multiple threads can run in parallel in light mode, 10-15 ms per hash per thread
-  if (!secondary_cache) {
-    CTHR_RWLOCK_LOCK_WRITE(secondary_cache_lock);
-    if (!secondary_cache) {
-      hash2hex(seedhash, buf);
-      minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
-
-      rx_alloc_cache(flags, &secondary_cache);
-      randomx_init_cache(secondary_cache, seedhash, HASH_SIZE);
-      minfo(RX_LOGCAT, "RandomX secondary cache updated");
-      memcpy(secondary_seedhash, seedhash, HASH_SIZE);
-      secondary_seedhash_set = 1;
-    }
-    CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
-  }
+  memcpy(info->seedhash, seedhash, HASH_SIZE);
+  info->max_threads = max_dataset_init_threads;
 
-  CTHR_RWLOCK_LOCK_READ(secondary_cache_lock);
-  if (is_secondary(seedhash)) {
-    rx_init_light_vm(flags, &secondary_vm_light, secondary_cache);
-    randomx_calculate_hash(secondary_vm_light, data, length, result_hash);
-    success = 1;
+  CTHR_THREAD_TYPE t;
+  if (!CTHR_THREAD_CREATE(t, rx_set_next_seedhash_thread, info)) {
+    local_abort("Couldn't start RandomX seed thread");
   }
-  CTHR_RWLOCK_UNLOCK_READ(secondary_cache_lock);
+  CTHR_THREAD_CLOSE(t);
+}
 
-  if (success) {
+// Hashes count inputs back to back, overlapping the program generation for each
+// input with the execution for the previous one
+static void rx_calculate_hashes(randomx_vm *vm, const void *const *data, const size_t *lengths, size_t count, char *result_hashes) {
+  if (count == 1) {
+    randomx_calculate_hash(vm, data[0], lengths[0], result_hashes);
     return;
   }
 
-  // Slowest path (seedhash != main_seedhash, seedhash != secondary_seedhash)
-  // Only one thread runs at a time and updates secondary_seedhash if needed, up to 200-500 ms per hash
-  CTHR_RWLOCK_LOCK_WRITE(secondary_cache_lock);
-  if (!is_secondary(seedhash)) {
-    hash2hex(seedhash, buf);
-    minfo(RX_LOGCAT, "RandomX new secondary seed hash is %s", buf);
+  randomx_calculate_hash_first(vm, data[0], lengths[0]);
+  for (size_t i = 1; i < count; ++i) {
+    randomx_calculate_hash_next(vm, data[i], lengths[i], result_hashes + (i - 1) * HASH_SIZE);
+  }
+  randomx_calculate_hash_last(vm, result_hashes + (count - 1) * HASH_SIZE);
+}
+
+void rx_slow_hash_batch(const char *seedhash, const void *const *data, const size_t *lengths, size_t count, char *result_hashes) {
+  const randomx_flags flags = enabled_flags() & ~disabled_flags();
 
-    randomx_init_cache(secondary_cache, seedhash, HASH_SIZE);
-    minfo(RX_LOGCAT, "RandomX secondary cache updated");
-    memcpy(secondary_seedhash, seedhash, HASH_SIZE);
-    secondary_seedhash_set = 1;
+  if (count == 0) {
+    return;
   }
-  rx_init_light_vm(flags, &secondary_vm_light, secondary_cache);
-  randomx_calculate_hash(secondary_vm_light, data, length, result_hash);
-  CTHR_RWLOCK_UNLOCK_WRITE(secondary_cache_lock);
+
+  // Fast path (seedhash == main_seedhash)
+  // Multiple threads can run in parallel in fast mode, 1-2 ms per hash per thread
+  // If CTHR_RWLOCK_TRYLOCK_READ fails it means dataset is being initialized or swapped now, so use the light mode
+  if (is_main(seedhash) && main_dataset && CTHR_RWLOCK_TRYLOCK_READ(main_dataset_lock)) {
+    int success = 0;
+    // Double check that main_seedhash didn't change
+    if (is_main(seedhash)) {
+      rx_init_full_vm(flags, &main_vm_full);
+      if (main_vm_full) {
+        rx_calculate_hashes(main_vm_full, data, lengths, count, result_hashes);
+        success = 1;
+      }
+    }
+    CTHR_RWLOCK_UNLOCK_READ(main_dataset_lock);
+    if (success) {
+      return;
+    }
+  }
+
+  // Light path, for any of the recently used seed hashes
+  // Multiple threads can run in parallel in light mode, 10-15 ms per hash per thread
+  // A seed hash which isn't one of them first costs a cache rebuild, up to 200-500 ms
+  rx_light_cache *lc = rx_get_light_cache(seedhash);
+  rx_init_light_vm(flags, &light_vm, lc->lc_cache, seedhash);
+  rx_calculate_hashes(light_vm, data, lengths, count, result_hashes);
+  rx_release_light_cache(lc);
+}
+
+void rx_slow_hash(const char *seedhash, const void *data, size_t length, char *result_hash) {
+  rx_slow_hash_batch(seedhash, &data, &length, 1, result_hash);
 }
 
 void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
@@ -499,7 +721,9 @@ void rx_set_miner_thread(uint32_t value, size_t max_dataset_init_threads) {
 
   const randomx_flags flags = enabled_flags() & ~disabled_flags();
   rx_alloc_dataset(flags, &main_dataset, 1);
-  rx_init_dataset(max_dataset_init_threads);
+  if (main_seedhash_set) {
+    rx_init_dataset(main_dataset, main_seedhash, max_dataset_init_threads);
+  }
 
   CTHR_RWLOCK_UNLOCK_WRITE(main_dataset_lock);
 }
@@ -519,6 +743,7 @@ static void rx_destroy_vm(randomx_vm** vm) {
 
 void rx_slow_hash_free_state() {
   rx_destroy_vm(&main_vm_full);
-  rx_destroy_vm(&main_vm_light);
-  rx_destroy_vm(&secondary_vm_light);
+  rx_destroy_vm(&light_vm);
+  main_vm_full_dataset = NULL;
+  light_vm_cache = NULL;
 }
@@ -30,6 +30,8 @@
 #pragma once
 
 #include <cstddef>
+#include <vector>
+#include "crypto/crypto.h"
 #include "crypto/wallet/ops.h"
 
 namespace crypto {
@@ -42,6 +44,14 @@ namespace crypto {
         return monero_crypto_generate_key_derivation(out.data, tx_pub.data, view_sec.data) == 0;
       }
 
+      inline
+      bool generate_key_derivations(const std::vector<public_key> &tx_pubs, const secret_key &view_sec, std::vector<key_derivation> &out, std::vector<bool> &valid)
+      {
+        return ::crypto::generate_key_derivations_each(tx_pubs, out, valid, [&view_sec](const public_key &tx_pub, key_derivation &derivation) {
+          return wallet::generate_key_derivation(tx_pub, view_sec, derivation);
+        });
+      }
+
       inline
       bool derive_subaddress_public_key(const public_key &output_pub, const key_derivation &d, std::size_t index, public_key &out)
       {
@@ -51,6 +61,7 @@ namespace crypto {
       }
 #else
     using ::crypto::generate_key_derivation;
+    using ::crypto::generate_key_derivations;
     using ::crypto::derive_subaddress_public_key;
 #endif
   }
@@ -64,6 +64,16 @@ namespace cryptonote
       return 1024 * 1024; // 1 MB
     case cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID:
       return 1024 * 1024 * 4; // 4 MB
+    case cryptonote::NOTIFY_TX_POOL_HASH::ID:
+      return 64 * 1024; // 64 kB
+    case cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::ID:
+      return 64 * 1024; // 64 kB
+    case cryptonote::NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::ID:
+      return 1024 * 1024 * 4; // 4 MB, never larger than the full hash list it replaces
+    case cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED::ID:
+      return 4096;
+    case cryptonote::NOTIFY_NEW_COMPACT_BLOCK::ID:
+      return 1024 * 1024 * 4; // 4 MB, like fluffy blocks
     default:
       break;
     };
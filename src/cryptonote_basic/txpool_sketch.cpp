@@ -0,0 +1,197 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "txpool_sketch.h"
+
+#include <cstring>
+
+#include "int-util.h"
+
+namespace cryptonote
+{
+  namespace
+  {
+    constexpr const std::size_t sketch_hashes = 3;
+
+    //! splitmix64 finalizer; short ids are already uniform, this only decorrelates derived values
+    std::uint64_t mix64(std::uint64_t x) noexcept
+    {
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+      return x ^ (x >> 31);
+    }
+
+    std::uint64_t check_of(const std::uint64_t id) noexcept
+    {
+      return mix64(id ^ 0x9e3779b97f4a7c15ull);
+    }
+  }
+
+  txpool_sketch::txpool_sketch(const std::size_t cells, const std::uint64_t salt)
+    : m_cells(((cells + sketch_hashes - 1) / sketch_hashes) * sketch_hashes, cell{0, 0, 0}),
+      m_salt(salt)
+  {}
+
+  std::uint64_t txpool_sketch::short_id(const crypto::hash& txid, const std::uint64_t salt)
+  {
+    char data[sizeof(salt) + sizeof(txid)];
+    const std::uint64_t salt_le = SWAP64LE(salt);
+    std::memcpy(data, &salt_le, sizeof(salt_le));
+    std::memcpy(data + sizeof(salt_le), txid.data, sizeof(txid.data));
+
+    const crypto::hash hash = crypto::cn_fast_hash(data, sizeof(data));
+    std::uint64_t id;
+    std::memcpy(&id, hash.data, sizeof(id));
+    return SWAP64LE(id);
+  }
+
+  std::size_t txpool_sketch::index(const std::uint64_t id, const std::size_t hash) const noexcept
+  {
+    // each hash function owns its own slice, so an id never lands twice in a cell
+    const std::size_t slice = m_cells.size() / sketch_hashes;
+    return hash * slice + mix64(id + hash + 1) % slice;
+  }
+
+  void txpool_sketch::toggle(const std::uint64_t id, const std::int32_t count) noexcept
+  {
+    const std::uint64_t check = check_of(id);
+    for (std::size_t hash = 0; hash < sketch_hashes; ++hash)
+    {
+      cell& c = m_cells[index(id, hash)];
+      c.count = std::int32_t(std::uint32_t(c.count) + std::uint32_t(count));
+      c.key_sum ^= id;
+      c.check_sum ^= check;
+    }
+  }
+
+  void txpool_sketch::insert(const std::uint64_t id)
+  {
+    if (!m_cells.empty())
+      toggle(id, 1);
+  }
+
+  bool txpool_sketch::subtract(const txpool_sketch& other)
+  {
+    if (m_salt != other.m_salt || m_cells.size() != other.m_cells.size())
+      return false;
+
+    for (std::size_t i = 0; i < m_cells.size(); ++i)
+    {
+      // unsigned arithmetic, counts come from the network
+      m_cells[i].count = std::int32_t(std::uint32_t(m_cells[i].count) - std::uint32_t(other.m_cells[i].count));
+      m_cells[i].key_sum ^= other.m_cells[i].key_sum;
+      m_cells[i].check_sum ^= other.m_cells[i].check_sum;
+    }
+    return true;
+  }
+
+  bool txpool_sketch::decode(std::vector<std::uint64_t>& local, std::vector<std::uint64_t>& remote) const
+  {
+    local.clear();
+    remote.clear();
+
+    txpool_sketch work{*this};
+    const auto is_pure = [](const cell& c) {
+      return (c.count == 1 || c.count == -1) && c.check_sum == check_of(c.key_sum);
+    };
+
+    std::vector<std::size_t> pure;
+    for (std::size_t i = 0; i < work.m_cells.size(); ++i)
+    {
+      if (is_pure(work.m_cells[i]))
+        pure.push_back(i);
+    }
+
+    while (!pure.empty())
+    {
+      const std::size_t i = pure.back();
+      pure.pop_back();
+
+      const cell c = work.m_cells[i];
+      if (!is_pure(c))
+        continue; // already peeled through another cell
+
+      (c.count == 1 ? local : remote).push_back(c.key_sum);
+      if (work.m_cells.size() < local.size() + remote.size())
+        return false; // a hostile sketch could keep peeling
+      work.toggle(c.key_sum, -c.count);
+      for (std::size_t hash = 0; hash < sketch_hashes; ++hash)
+      {
+        const std::size_t j = work.index(c.key_sum, hash);
+        if (is_pure(work.m_cells[j]))
+          pure.push_back(j);
+      }
+    }
+
+    for (const cell& c : work.m_cells)
+    {
+      if (c.count != 0 || c.key_sum != 0 || c.check_sum != 0)
+        return false;
+    }
+    return true;
+  }
+
+  std::string txpool_sketch::to_blob() const
+  {
+    std::string blob(m_cells.size() * cell_blob_size, '\0');
+    char* out = &blob[0];
+    for (const cell& c : m_cells)
+    {
+      const std::uint32_t count = SWAP32LE(std::uint32_t(c.count));
+      const std::uint64_t key_sum = SWAP64LE(c.key_sum);
+      const std::uint64_t check_sum = SWAP64LE(c.check_sum);
+      std::memcpy(out, &count, sizeof(count));
+      std::memcpy(out + 4, &key_sum, sizeof(key_sum));
+      std::memcpy(out + 12, &check_sum, sizeof(check_sum));
+      out += cell_blob_size;
+    }
+    return blob;
+  }
+
+  bool txpool_sketch::from_blob(const std::string& blob)
+  {
+    const std::size_t cells = blob.size() / cell_blob_size;
+    if (blob.empty() || blob.size() % cell_blob_size || cells % sketch_hashes)
+      return false;
+
+    m_cells.resize(cells);
+    const char* in = blob.data();
+    for (cell& c : m_cells)
+    {
+      std::uint32_t count;
+      std::memcpy(&count, in, sizeof(count));
+      std::memcpy(&c.key_sum, in + 4, sizeof(c.key_sum));
+      std::memcpy(&c.check_sum, in + 12, sizeof(c.check_sum));
+      c.count = std::int32_t(SWAP32LE(count));
+      c.key_sum = SWAP64LE(c.key_sum);
+      c.check_sum = SWAP64LE(c.check_sum);
+      in += cell_blob_size;
+    }
+    return true;
+  }
+}
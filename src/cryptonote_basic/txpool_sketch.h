@@ -0,0 +1,109 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /*! Invertible Bloom lookup table over salted 64-bit short tx ids, used to
+      reconcile two txpools with traffic proportional to their difference.
+
+      Each side inserts the short ids of its txs, one sketch is subtracted
+      from the other, and peeling the result recovers the ids present on
+      only one side. Decoding succeeds with high probability while the
+      difference stays below roughly 2/3 of the cell count. */
+  class txpool_sketch
+  {
+  public:
+    struct cell
+    {
+      std::int32_t count;
+      std::uint64_t key_sum;
+      std::uint64_t check_sum;
+    };
+
+    //! Size of one cell on the wire
+    static constexpr const std::size_t cell_blob_size = 4 + 8 + 8;
+
+    //! `cells` is rounded up to a multiple of the number of hash functions.
+    txpool_sketch(std::size_t cells, std::uint64_t salt);
+
+    //! \return Short id of `txid`, keyed by `salt` so that ids cannot be ground.
+    static std::uint64_t short_id(const crypto::hash& txid, std::uint64_t salt);
+
+    std::size_t cells() const noexcept { return m_cells.size(); }
+    std::uint64_t salt() const noexcept { return m_salt; }
+
+    void insert(std::uint64_t id);
+    void insert(const crypto::hash& txid) { insert(short_id(txid, m_salt)); }
+
+    //! \return False if `other` does not have the same size and salt.
+    bool subtract(const txpool_sketch& other);
+
+    /*! Peels a subtracted sketch. `local` receives the ids that were only
+        in `*this`, `remote` the ids that were only in the subtracted one.
+        \return False if the difference is too large to be recovered. */
+    bool decode(std::vector<std::uint64_t>& local, std::vector<std::uint64_t>& remote) const;
+
+    std::string to_blob() const;
+
+    //! \return False if `blob` is not a whole number of cells (or is empty).
+    bool from_blob(const std::string& blob);
+
+  private:
+    std::size_t index(std::uint64_t id, std::size_t hash) const noexcept;
+    void toggle(std::uint64_t id, std::int32_t count) noexcept;
+
+    std::vector<cell> m_cells;
+    std::uint64_t m_salt;
+  };
+
+  //! Bytes of a compact block short id on the wire
+  constexpr const std::size_t compact_short_id_size = 6;
+
+  //! \return Salted 6-byte short id of `txid`, as listed in compact blocks.
+  inline std::uint64_t get_compact_short_id(const crypto::hash& txid, const std::uint64_t salt)
+  {
+    return txpool_sketch::short_id(txid, salt) & 0xffffffffffffull;
+  }
+
+  //! \return Salt of the `n`th try at listing the txes of block `block_id` by
+  //!   short id. Every relayer picks the same one, so receivers index their
+  //!   txpool once per block.
+  inline std::uint64_t get_compact_block_salt(const crypto::hash& block_id, const std::uint64_t n)
+  {
+    return txpool_sketch::short_id(block_id, n);
+  }
+}
@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
 #include <boost/filesystem.hpp>
 #include <boost/range/adaptor/reversed.hpp>
@@ -40,6 +41,7 @@
 #include "blockchain.h"
 #include "blockchain_db/blockchain_db.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
+#include "serialization/string.h"
 #include "cryptonote_config.h"
 #include "cryptonote_basic/miner.h"
 #include "hardforks/hardforks.h"
@@ -58,6 +60,7 @@
 #include "common/pruning.h"
 #include "common/data_cache.h"
 #include "time_helper.h"
+#include "metrics.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "blockchain"
@@ -86,9 +89,32 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// RCT type whose non-semantics verification results are cached
+static constexpr const std::uint8_t RCT_CACHE_TYPE = rct::RCTTypeBulletproofPlus;
+
+// Stages of adding a block, in the order observe_block_verify_stages takes their times
+static constexpr const char *BLOCK_VERIFY_STAGES[] = {
+  "total", "setup", "checks", "difficulty", "pow", "prepare_txs", "tx_exists", "tx_from_pool",
+  "check_tx_inputs", "double_spend", "miner_tx", "db_add_block"
+};
+static constexpr const size_t BLOCK_VERIFY_STAGE_COUNT = sizeof(BLOCK_VERIFY_STAGES) / sizeof(BLOCK_VERIFY_STAGES[0]);
+
+static void observe_block_verify_stages(const uint64_t (&stage_ns)[BLOCK_VERIFY_STAGE_COUNT])
+{
+  static const std::array<epee::metrics::histogram*, BLOCK_VERIFY_STAGE_COUNT> histograms = [](){
+    std::array<epee::metrics::histogram*, BLOCK_VERIFY_STAGE_COUNT> h;
+    for (size_t i = 0; i < BLOCK_VERIFY_STAGE_COUNT; ++i)
+      h[i] = &epee::metrics::get_histogram("monero_block_verify_seconds", "Time spent in each stage of adding a block to the main chain",
+          std::string("stage=\"") + BLOCK_VERIFY_STAGES[i] + "\"");
+    return h;
+  }();
+  for (size_t i = 0; i < BLOCK_VERIFY_STAGE_COUNT; ++i)
+    histograms[i]->observe_ns(stage_ns[i]);
+}
+
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
-  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
+  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_reset_timestamps_and_difficulties_height(true), m_chain_tip_weights_top_hash(crypto::null_hash), m_chain_tip_weight_limit(0), m_chain_tip_weight_median(0), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
   m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
@@ -99,7 +125,7 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_btc_valid(false),
   m_batch_success(true),
   m_prepare_height(0),
-  m_rct_ver_cache()
+  m_rct_ver_cache(RCT_VER_CACHE_SIZE)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -546,6 +572,30 @@ bool Blockchain::deinit()
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::reload_db_state()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  m_hardfork->init();
+  m_timestamps_and_difficulties_height = 0;
+  m_reset_timestamps_and_difficulties_height = true;
+  invalidate_block_template_cache();
+
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    if (!update_next_cumulative_weight_limit())
+      MERROR("Failed to update the next cumulative weight limit");
+  }
+
+  if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
+  {
+    const crypto::hash seedhash = get_block_id_by_height(crypto::rx_seedheight(m_db->height()));
+    if (seedhash != crypto::null_hash)
+      rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
+  }
+}
+//------------------------------------------------------------------
 // This function removes blocks from the top of blockchain.
 // It starts a batch and calls private method pop_block_from_blockchain().
 void Blockchain::pop_blocks(uint64_t nblocks)
@@ -698,10 +748,35 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
 crypto::hash Blockchain::get_tail_id(uint64_t& height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  // read only, so served from a db snapshot instead of taking m_blockchain_lock
+  db_rtxn_guard rtxn_guard(m_db);
   return m_db->top_block_hash(&height);
 }
 //------------------------------------------------------------------
+std::shared_ptr<const Blockchain::chain_tip_state> Blockchain::get_chain_tip_state() const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  db_rtxn_guard rtxn_guard(m_db);
+  uint64_t top_height;
+  const crypto::hash top_hash = m_db->top_block_hash(&top_height);
+
+  boost::unique_lock<boost::mutex> lock(m_chain_tip_state_lock);
+  if (m_chain_tip_state && m_chain_tip_state->top_hash == top_hash)
+    return m_chain_tip_state;
+
+  std::shared_ptr<chain_tip_state> state = std::make_shared<chain_tip_state>();
+  state->height = top_height + 1;
+  state->top_hash = top_hash;
+  state->cumulative_difficulty = m_db->get_block_cumulative_difficulty(top_height);
+  state->block_weight_limit = m_chain_tip_weight_limit;
+  state->block_weight_median = m_chain_tip_weight_median;
+
+  // only shared once the weights are the ones for this top
+  if (m_chain_tip_weights_top_hash == top_hash)
+    m_chain_tip_state = state;
+  return state;
+}
+//------------------------------------------------------------------
 crypto::hash Blockchain::get_tail_id() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -727,7 +802,7 @@ crypto::hash Blockchain::get_tail_id() const
 bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t i = 0;
   uint64_t current_multiplier = 1;
   uint64_t sz = m_db->height();
@@ -735,7 +810,6 @@ bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
   if(!sz)
     return true;
 
-  db_rtxn_guard rtxn_guard(m_db);
   bool genesis_included = false;
   uint64_t current_back_offset = 1;
   while(current_back_offset < sz)
@@ -995,6 +1069,47 @@ start:
   return diff;
 }
 //------------------------------------------------------------------
+bool Blockchain::check_block_header_pow(const block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  // the same hashing blob get_block_hashing_blob builds from the full tx list
+  blobdata hashing_blob = t_serializable_object_to_blob(static_cast<const block_header&>(b));
+  hashing_blob.append(reinterpret_cast<const char*>(&tx_tree_root), sizeof(tx_tree_root));
+  hashing_blob.append(tools::get_varint_data(tx_count + 1));
+  crypto::hash hashing_blob_id;
+  if (!get_object_hash(hashing_blob, hashing_blob_id) || hashing_blob_id != id)
+  {
+    MERROR_VER("Block header does not hash to its id " << id);
+    return false;
+  }
+
+  // another block got in first, it will be checked in full on the alt chain path
+  if (b.prev_id != get_tail_id())
+    return true;
+
+  const uint64_t height = m_db->height();
+  const difficulty_type difficulty = get_difficulty_for_next_block();
+  crypto::hash seed_hash = crypto::null_hash;
+  if (b.major_version >= RX_BLOCK_VERSION)
+    seed_hash = get_pending_block_id_by_height(crypto::rx_seedheight(height));
+  crypto::hash proof_of_work;
+  get_block_longhash(this, hashing_blob, proof_of_work, height, b.major_version, &seed_hash);
+  if (!check_hash(proof_of_work, difficulty))
+  {
+    MERROR_VER("Block with id: " << id << " does not have enough proof of work: " << proof_of_work << " at height " << height << ", unexpected difficulty: " << difficulty);
+    return false;
+  }
+
+  // handed to block_longhash_worker, so the block is not hashed again once complete
+  boost::unique_lock<boost::mutex> lock(m_prehashed_blocks_lock);
+  if (m_prehashed_blocks.size() > 2 * BLOCKS_SYNCHRONIZING_MAX_COUNT)
+    m_prehashed_blocks.clear();
+  m_prehashed_blocks[id] = std::make_pair(seed_hash, proof_of_work);
+  return true;
+}
+//------------------------------------------------------------------
 std::pair<bool, uint64_t> Blockchain::check_difficulty_checkpoints() const
 {
   uint64_t res = 0;
@@ -2153,7 +2268,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks, std::vector<cryptonote::blobdata>& txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   if(start_offset >= m_db->height())
     return false;
 
@@ -2175,7 +2290,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata,block>>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   const uint64_t height = m_db->height();
   if(start_offset >= height)
     return false;
@@ -2308,7 +2423,7 @@ crypto::public_key Blockchain::get_output_key(uint64_t amount, uint64_t global_i
 bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMAND_RPC_GET_OUTPUTS_BIN::response& res) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   res.outs.clear();
   res.outs.reserve(req.outputs.size());
@@ -2417,7 +2532,7 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   // make sure the request includes at least the genesis block, otherwise
   // how can we expect to sync from the client that the block list came from?
@@ -2427,7 +2542,6 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     return false;
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   // make sure that the last block in the request's block list matches
   // the genesis block
   auto gen_hash = m_db->get_block_hash_from_height(0);
@@ -2495,7 +2609,7 @@ template<class t_ids_container, class t_blocks_container, class t_missed_contain
 bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(blocks, block_ids.size());
   for (const auto& block_hash : block_ids)
@@ -2580,7 +2694,7 @@ static bool fill(BlockchainDB *db, const crypto::hash &tx_hash, tx_blob_entry &t
 bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::blobdata>& txs, std::vector<crypto::hash>& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   txs.reserve(txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2604,7 +2718,7 @@ bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids
 bool Blockchain::get_transactions_blobs(const std::vector<crypto::hash>& txs_ids, std::vector<tx_blob_entry>& txs, std::vector<crypto::hash>& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   txs.reserve(txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2640,7 +2754,7 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_split_transactions_blobs(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(txs, txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2674,7 +2788,7 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   reserve_container(txs, txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2710,7 +2824,7 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::vector<crypto::hash>& hashes, std::vector<uint64_t>* weights, uint64_t& start_height, uint64_t& current_height, bool clip_pruned) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   // if we can't find the split point, return false
   if(!find_blockchain_supplement(qblock_ids, start_height))
@@ -2718,7 +2832,6 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     return false;
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   current_height = get_current_blockchain_height();
   uint64_t stop_height = current_height;
   if (clip_pruned)
@@ -2749,7 +2862,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   bool result = find_blockchain_supplement(qblock_ids, resp.m_block_ids, &resp.m_block_weights, resp.start_height, resp.total_height, clip_pruned);
   if (result)
@@ -2769,7 +2882,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, crypto::hash& top_hash, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_block_count, size_t max_tx_count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
 
   // if a specific start height has been requested
   if(req_start_block > 0)
@@ -2791,7 +2904,6 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
     }
   }
 
-  db_rtxn_guard rtxn_guard(m_db);
   top_hash = m_db->top_block_hash(&total_height);
   ++total_height;
   blocks.reserve(std::min(std::min(max_block_count, (size_t)10000), (size_t)(total_height - start_height)));
@@ -2950,7 +3062,7 @@ bool Blockchain::check_for_double_spend(const transaction& tx, key_images_contai
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes, std::vector<std::vector<uint64_t>>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -2966,7 +3078,7 @@ bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -3309,7 +3421,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height) const
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, std::vector<rct::ctkeyM>* deferred_mix_rings) const
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -3540,7 +3652,6 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
   }
 
   // Warn that new RCT types are present, and thus the cache is not being used effectively
-  static constexpr const std::uint8_t RCT_CACHE_TYPE = rct::RCTTypeBulletproofPlus;
   if (tx.rct_signatures.type > RCT_CACHE_TYPE)
   {
     MWARNING("RCT cache is not caching new verification results. Please update RCT_CACHE_TYPE!");
@@ -3584,6 +3695,12 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     case rct::RCTTypeCLSAG:
     case rct::RCTTypeBulletproofPlus:
     {
+      if (deferred_mix_rings)
+      {
+        // the caller verifies these along with the rest of the block's transactions
+        deferred_mix_rings->push_back(std::move(pubkeys));
+        break;
+      }
       if (!ver_rct_non_semantics_simple_cached(tx, pubkeys, m_rct_ver_cache, RCT_CACHE_TYPE))
       {
         MERROR_VER("Failed to check ringct signatures!");
@@ -4052,9 +4169,9 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
-  TIME_MEASURE_START(block_processing_time);
+  TIME_MEASURE_NS_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  TIME_MEASURE_START(t1);
+  TIME_MEASURE_NS_START(t1);
 
   static bool seen_future_version = false;
 
@@ -4091,8 +4208,8 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(t1);
-  TIME_MEASURE_START(t2);
+  TIME_MEASURE_NS_FINISH(t1);
+  TIME_MEASURE_NS_START(t2);
 
   // make sure block timestamp is not less than the median timestamp
   // of a set number of the most recent blocks.
@@ -4103,9 +4220,9 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(t2);
+  TIME_MEASURE_NS_FINISH(t2);
   //check proof of work
-  TIME_MEASURE_START(target_calculating_time);
+  TIME_MEASURE_NS_START(target_calculating_time);
 
   // get the target difficulty for the block.
   // the calculation can overflow, among other failure cases,
@@ -4115,9 +4232,9 @@ leave:
   difficulty_type current_diffic = get_difficulty_for_next_block();
   CHECK_AND_ASSERT_MES(current_diffic, false, "!!!!!!!!! difficulty overhead !!!!!!!!!");
 
-  TIME_MEASURE_FINISH(target_calculating_time);
+  TIME_MEASURE_NS_FINISH(target_calculating_time);
 
-  TIME_MEASURE_START(longhash_calculating_time);
+  TIME_MEASURE_NS_START(longhash_calculating_time);
 
   crypto::hash proof_of_work;
   memset(proof_of_work.data, 0xff, sizeof(proof_of_work.data));
@@ -4186,11 +4303,11 @@ leave:
     }
   }
 
-  TIME_MEASURE_FINISH(longhash_calculating_time);
+  TIME_MEASURE_NS_FINISH(longhash_calculating_time);
   if (precomputed)
-    longhash_calculating_time += m_fake_pow_calc_time;
+    longhash_calculating_time += m_fake_pow_calc_time * 1000000;
 
-  TIME_MEASURE_START(t3);
+  TIME_MEASURE_NS_START(t3);
 
   // sanity check basic miner tx properties;
   if(!prevalidate_miner_transaction(bl, blockchain_height, hf_version))
@@ -4205,6 +4322,8 @@ leave:
 
   std::vector<std::pair<transaction, blobdata>> txs;
   key_images_container keys;
+  std::vector<transaction*> deferred_txs;
+  std::vector<rct::ctkeyM> deferred_mix_rings;
 
   uint64_t fee_summary = 0;
   uint64_t t_checktx = 0;
@@ -4212,7 +4331,7 @@ leave:
   uint64_t t_pool = 0;
   uint64_t t_dblspnd = 0;
   uint64_t n_pruned = 0;
-  TIME_MEASURE_FINISH(t3);
+  TIME_MEASURE_NS_FINISH(t3);
 
 // XXX old code adds miner tx here
 
@@ -4228,7 +4347,7 @@ leave:
     size_t tx_weight = 0;
     uint64_t fee = 0;
     bool relayed = false, do_not_relay = false, double_spend_seen = false, pruned = false;
-    TIME_MEASURE_START(aa);
+    TIME_MEASURE_NS_START(aa);
 
 // XXX old code does not check whether tx exists
     if (m_db->tx_exists(tx_id))
@@ -4239,9 +4358,9 @@ leave:
       goto leave;
     }
 
-    TIME_MEASURE_FINISH(aa);
+    TIME_MEASURE_NS_FINISH(aa);
     t_exists += aa;
-    TIME_MEASURE_START(bb);
+    TIME_MEASURE_NS_START(bb);
 
     // get transaction with hash <tx_id> from tx_pool
     if(!m_tx_pool.take_tx(tx_id, tx_tmp, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
@@ -4254,14 +4373,14 @@ leave:
     if (pruned)
       ++n_pruned;
 
-    TIME_MEASURE_FINISH(bb);
+    TIME_MEASURE_NS_FINISH(bb);
     t_pool += bb;
     // add the transaction to the temp list of transactions, so we can either
     // store the list of transactions all at once or return the ones we've
     // taken from the tx_pool back to it if the block fails verification.
     txs.push_back(std::make_pair(std::move(tx_tmp), std::move(txblob)));
     transaction &tx = txs.back().first;
-    TIME_MEASURE_START(dd);
+    TIME_MEASURE_NS_START(dd);
 
     // FIXME: the storage should not be responsible for validation.
     //        If it does any, it is merely a sanity check.
@@ -4276,17 +4395,19 @@ leave:
     //     break;
     // }
 
-    TIME_MEASURE_FINISH(dd);
+    TIME_MEASURE_NS_FINISH(dd);
     t_dblspnd += dd;
-    TIME_MEASURE_START(cc);
+    TIME_MEASURE_NS_START(cc);
+    const size_t n_deferred = deferred_mix_rings.size();
 
 #if defined(PER_BLOCK_CHECKPOINT)
     if (!fast_check)
 #endif
     {
       // validate that transaction inputs and the keys spending them are correct.
+      // simple rct signatures are deferred and verified for the whole block below
       tx_verification_context tvc;
-      if(!check_tx_inputs(tx, tvc))
+      if(!check_tx_inputs(tx, tvc, NULL, &deferred_mix_rings))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -4317,12 +4438,30 @@ leave:
       }
     }
 #endif
-    TIME_MEASURE_FINISH(cc);
+    if (deferred_mix_rings.size() != n_deferred)
+      deferred_txs.push_back(&tx);
+    TIME_MEASURE_NS_FINISH(cc);
     t_checktx += cc;
     fee_summary += fee;
     cumulative_block_weight += tx_weight;
   }
 
+  if (!deferred_txs.empty())
+  {
+    TIME_MEASURE_NS_START(cc);
+    if (!ver_rct_non_semantics_simple_cached(deferred_txs, deferred_mix_rings, m_rct_ver_cache, RCT_CACHE_TYPE))
+    {
+      MERROR_VER("Block with id: " << id << " has at least one transaction with wrong ringct signatures.");
+      add_block_as_invalid(bl, id);
+      MERROR_VER("Block with id " << id << " added as invalid because of wrong inputs in transactions");
+      bvc.m_verifivation_failed = true;
+      return_tx_to_pool(txs);
+      goto leave;
+    }
+    TIME_MEASURE_NS_FINISH(cc);
+    t_checktx += cc;
+  }
+
   // if we were syncing pruned blocks
   if (n_pruned > 0)
   {
@@ -4336,7 +4475,7 @@ leave:
 
   m_blocks_txs_check.clear();
 
-  TIME_MEASURE_START(vmt);
+  TIME_MEASURE_NS_START(vmt);
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = blockchain_height ? m_db->get_block_already_generated_coins(blockchain_height - 1) : 0;
   if(!validate_miner_transaction(bl, cumulative_block_weight, fee_summary, base_reward, already_generated_coins, bvc.m_partial_block_reward, m_hardfork->get_current_version()))
@@ -4347,7 +4486,7 @@ leave:
     goto leave;
   }
 
-  TIME_MEASURE_FINISH(vmt);
+  TIME_MEASURE_NS_FINISH(vmt);
   size_t block_weight;
   difficulty_type cumulative_difficulty;
 
@@ -4362,12 +4501,12 @@ leave:
   if(blockchain_height)
     cumulative_difficulty += m_db->get_block_cumulative_difficulty(blockchain_height - 1);
 
-  TIME_MEASURE_FINISH(block_processing_time);
+  TIME_MEASURE_NS_FINISH(block_processing_time);
   if(precomputed)
-    block_processing_time += m_fake_pow_calc_time;
+    block_processing_time += m_fake_pow_calc_time * 1000000;
 
   rtxn_guard.stop();
-  TIME_MEASURE_START(addblock);
+  TIME_MEASURE_NS_START(addblock);
   uint64_t new_height = 0;
   if (!bvc.m_verifivation_failed)
   {
@@ -4400,7 +4539,7 @@ leave:
     LOG_ERROR("Blocks that failed verification should not reach here");
   }
 
-  TIME_MEASURE_FINISH(addblock);
+  TIME_MEASURE_NS_FINISH(addblock);
 
   // do this after updating the hard fork state since the weight limit may change due to fork
   if (!update_next_cumulative_weight_limit())
@@ -4410,14 +4549,21 @@ leave:
     return false;
   }
 
-  MINFO("+++++ BLOCK SUCCESSFULLY ADDED" << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "HEIGHT " << new_height-1 << ", difficulty:\t" << current_diffic << std::endl << "block reward: " << print_money(fee_summary + base_reward) << "(" << print_money(base_reward) << " + " << print_money(fee_summary) << "), coinbase_weight: " << coinbase_weight << ", cumulative weight: " << cumulative_block_weight << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << ")ms");
+  MINFO("+++++ BLOCK SUCCESSFULLY ADDED" << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "HEIGHT " << new_height-1 << ", difficulty:\t" << current_diffic << std::endl << "block reward: " << print_money(fee_summary + base_reward) << "(" << print_money(base_reward) << " + " << print_money(fee_summary) << "), coinbase_weight: " << coinbase_weight << ", cumulative weight: " << cumulative_block_weight << ", " << block_processing_time / 1000000 << "(" << target_calculating_time / 1000000 << "/" << longhash_calculating_time / 1000000 << ")ms");
+  observe_block_verify_stages({
+    block_processing_time, t1, t2, target_calculating_time, longhash_calculating_time, t3, t_exists, t_pool,
+    t_checktx, t_dblspnd, vmt, addblock
+  });
   if(m_show_time_stats)
   {
     MINFO("Height: " << new_height << " coinbase weight: " << coinbase_weight << " cumm: "
-        << cumulative_block_weight << " p/t: " << block_processing_time << " ("
-        << target_calculating_time << "/" << longhash_calculating_time << "/"
-        << t1 << "/" << t2 << "/" << t3 << "/" << t_exists << "/" << t_pool
-        << "/" << t_checktx << "/" << t_dblspnd << "/" << vmt << "/" << addblock << ")ms");
+        << cumulative_block_weight << " p/t: " << block_processing_time / 1000000 << " ("
+        << target_calculating_time / 1000000 << "/" << longhash_calculating_time / 1000000 << "/"
+        << t1 / 1000000 << "/" << t2 / 1000000 << "/" << t3 / 1000000 << "/" << t_exists / 1000000 << "/" << t_pool / 1000000
+        << "/" << t_checktx / 1000000 << "/" << t_dblspnd / 1000000 << "/" << vmt / 1000000 << "/" << addblock / 1000000 << ")ms");
+    const rct_ver_cache_t::stats_t rct_cache_stats = m_rct_ver_cache.get_stats();
+    MINFO("RCT cache: " << rct_cache_stats.size << "/" << rct_cache_stats.max_size << " entries, hits/misses/evictions: "
+        << rct_cache_stats.hits << "/" << rct_cache_stats.misses << "/" << rct_cache_stats.evictions);
   }
 
   bvc.m_added_to_main_chain = true;
@@ -4448,8 +4594,17 @@ leave:
     notifier(new_height - 1, {std::addressof(bl), 1});
 
   if (m_hardfork->get_current_version() >= RX_BLOCK_VERSION)
+  {
     rx_set_main_seedhash(seedhash.data, tools::get_max_concurrency());
 
+    // the next seed hash is known SEEDHASH_EPOCH_LAG blocks ahead of the switch,
+    // get its cache (and dataset, if enabled) ready in the background meanwhile
+    uint64_t seed_height, next_height;
+    crypto::rx_seedheights(new_height, &seed_height, &next_height);
+    if (next_height != seed_height)
+      rx_set_next_seedhash(get_block_id_by_height(next_height).data, tools::get_max_concurrency());
+  }
+
   return true;
 }
 //------------------------------------------------------------------
@@ -4568,6 +4723,13 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
   if (!m_db->is_read_only())
     m_db->add_max_block_size(m_current_block_cumul_weight_limit);
 
+  {
+    boost::unique_lock<boost::mutex> lock(m_chain_tip_state_lock);
+    m_chain_tip_weights_top_hash = db_height ? m_db->top_block_hash() : crypto::null_hash;
+    m_chain_tip_weight_limit = m_current_block_cumul_weight_limit;
+    m_chain_tip_weight_median = m_current_block_cumul_weight_median;
+  }
+
   return true;
 }
 //------------------------------------------------------------------
@@ -4621,7 +4783,9 @@ void Blockchain::check_against_checkpoints(const checkpoints& points, bool enfor
   bool stop_batch;
 
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  stop_batch = m_db->batch_start();
+  // a read only db can only be checked, another process is writing it
+  const bool read_only = m_db->is_read_only();
+  stop_batch = read_only ? false : m_db->batch_start();
   const uint64_t blockchain_height = m_db->height();
   for (const auto& pt : pts)
   {
@@ -4634,7 +4798,11 @@ void Blockchain::check_against_checkpoints(const checkpoints& points, bool enfor
     if (!points.check_block(pt.first, m_db->get_block_hash_from_height(pt.first)))
     {
       // if asked to enforce checkpoints, roll back to a couple of blocks before the checkpoint
-      if (enforce)
+      if (enforce && read_only)
+      {
+        LOG_ERROR("Local blockchain failed to pass a checkpoint, but the database is read only");
+      }
+      else if (enforce)
       {
         LOG_ERROR("Local blockchain failed to pass a checkpoint, rolling back!");
         std::list<block> empty;
@@ -4699,19 +4867,149 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
   TIME_MEASURE_START(t);
   slow_hash_allocate_state();
 
-  for (const auto & block : blocks)
+  std::vector<crypto::hash> ids(blocks.size());
+  std::vector<crypto::hash> seed_hashes(blocks.size(), crypto::null_hash);
+  std::vector<crypto::hash> pows(blocks.size(), crypto::null_hash);
+  for (size_t i = 0; i < blocks.size(); ++i)
   {
-    if (m_cancel)
-       break;
-    crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash(this, block, height++, 0);
-    map.emplace(id, pow);
+    ids[i] = get_block_hash(blocks[i]);
+    if (blocks[i].major_version >= RX_BLOCK_VERSION)
+      seed_hashes[i] = get_pending_block_id_by_height(rx_seedheight(height + i));
+
+    // use the PoW from prehash_incoming_blocks if it was done with the same seed
+    boost::unique_lock<boost::mutex> lock(m_prehashed_blocks_lock);
+    auto it = m_prehashed_blocks.find(ids[i]);
+    if (it != m_prehashed_blocks.end())
+    {
+      if (it->second.first == seed_hashes[i])
+        pows[i] = it->second.second;
+      m_prehashed_blocks.erase(it);
+    }
+  }
+
+  // hash the rest by runs, so consecutive blocks are pipelined through the VM
+  for (size_t i = 0; i < blocks.size() && !m_cancel; )
+  {
+    if (pows[i] != crypto::null_hash)
+    {
+      ++i;
+      continue;
+    }
+    size_t n = 1;
+    while (i + n < blocks.size() && pows[i + n] == crypto::null_hash)
+      ++n;
+    get_block_longhashes(this, {&blocks[i], n}, height + i, &seed_hashes[i], &pows[i]);
+    i += n;
   }
 
+  for (size_t i = 0; i < blocks.size(); ++i)
+    if (pows[i] != crypto::null_hash)
+      map.emplace(ids[i], pows[i]);
+
   slow_hash_free_state();
   TIME_MEASURE_FINISH(t);
 }
 
+//------------------------------------------------------------------
+size_t Blockchain::prehash_incoming_blocks(uint64_t height, const std::vector<block_complete_entry> &blocks_entry, const std::vector<crypto::hash> &parent_hashes)
+{
+  MTRACE("Blockchain::" << __func__);
+  TIME_MEASURE_START(t);
+
+  {
+    // no PoW is checked for blocks covered by the hashes of hashes
+    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    if (height + blocks_entry.size() < m_blocks_hash_check.size())
+      return 0;
+  }
+
+  std::vector<block> blocks(blocks_entry.size());
+  std::vector<crypto::hash> hashes(blocks_entry.size());
+  for (size_t i = 0; i < blocks_entry.size(); ++i)
+  {
+    // anything wrong will be caught again when the blocks get prepared
+    if (!parse_and_validate_block_from_blob(blocks_entry[i].block, blocks[i], hashes[i]))
+      return 0;
+    const crypto::hash *prev_id = i ? &hashes[i - 1] : parent_hashes.empty() ? NULL : &parent_hashes.back();
+    if (prev_id && blocks[i].prev_id != *prev_id)
+      return 0;
+  }
+
+  // the seed hash is taken from the blocks being hashed or the ones right
+  // below, or the db for anything older, which is already there
+  const uint64_t parent_height = height - std::min<uint64_t>(height, parent_hashes.size());
+  const uint64_t db_height = m_db->height();
+  std::vector<crypto::hash> seed_hashes(blocks.size(), crypto::null_hash);
+  std::vector<bool> known(blocks.size(), true);
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    if (blocks[i].major_version < RX_BLOCK_VERSION)
+      continue;
+    const uint64_t seed_height = rx_seedheight(height + i);
+    if (seed_height >= height)
+      seed_hashes[i] = hashes[seed_height - height];
+    else if (seed_height >= parent_height)
+      seed_hashes[i] = parent_hashes[seed_height - parent_height];
+    else if (seed_height < db_height)
+    {
+      try { seed_hashes[i] = m_db->get_block_hash_from_height(seed_height); }
+      catch (...) { known[i] = false; }
+    }
+    else
+      known[i] = false;
+  }
+
+  tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
+  unsigned threads = std::min<unsigned>(tpool.get_max_concurrency(), m_max_prepare_blocks_threads);
+  threads = std::max<unsigned>(1, std::min<size_t>(threads, blocks.size()));
+  std::vector<crypto::hash> pows(blocks.size(), crypto::null_hash);
+  tools::threadpool::waiter waiter(tpool);
+  const size_t blocks_per_thread = (blocks.size() + threads - 1) / threads;
+  for (size_t start = 0; start < blocks.size(); start += blocks_per_thread)
+  {
+    // each thread hashes a contiguous range, so blocks sharing a seed can be batched
+    tpool.submit(&waiter, [&, start]() {
+      slow_hash_allocate_state();
+      const size_t end = std::min(start + blocks_per_thread, blocks.size());
+      for (size_t i = start; i < end && !m_cancel; )
+      {
+        if (!known[i])
+        {
+          ++i;
+          continue;
+        }
+        size_t n = 1;
+        while (i + n < end && known[i + n])
+          ++n;
+        get_block_longhashes(this, {&blocks[i], n}, height + i, &seed_hashes[i], &pows[i]);
+        i += n;
+      }
+      slow_hash_free_state();
+    }, true);
+  }
+  if (!waiter.wait() || m_cancel)
+    return 0;
+
+  size_t nhashed = 0;
+  {
+    boost::unique_lock<boost::mutex> lock(m_prehashed_blocks_lock);
+    // leftovers from blocks which were never added, eg from a dropped peer
+    if (m_prehashed_blocks.size() > 2 * BLOCKS_SYNCHRONIZING_MAX_COUNT)
+      m_prehashed_blocks.clear();
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+      if (!known[i])
+        continue;
+      m_prehashed_blocks[hashes[i]] = std::make_pair(seed_hashes[i], pows[i]);
+      ++nhashed;
+    }
+  }
+
+  TIME_MEASURE_FINISH(t);
+  MDEBUG("Prehashed " << nhashed << "/" << blocks.size() << " blocks at height " << height << " in " << t << " ms");
+  return nhashed;
+}
+
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
@@ -152,6 +152,14 @@ namespace cryptonote
      */
     bool deinit();
 
+    /**
+     * @brief recomputes the state kept in memory from the db
+     *
+     * For a db written by another process, whose changes bypass the
+     * code keeping that state up to date.
+     */
+    void reload_db_state();
+
     /**
      * @brief get a set of blockchain checkpoint hashes
      *
@@ -247,6 +255,22 @@ namespace cryptonote
      */
     bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks_entry, std::vector<block> &blocks);
 
+    /**
+     * @brief computes the PoW of a group of incoming blocks ahead of their preparation
+     *
+     * This is meant to run while the group before it is being added, so the
+     * PoW is ready by the time prepare_handle_incoming_blocks gets to them.
+     * Blocks whose RandomX seed is not known yet are skipped, and hashed in
+     * prepare_handle_incoming_blocks as usual.
+     *
+     * @param height the height of the first incoming block
+     * @param blocks_entry a list of incoming blocks
+     * @param parent_hashes hashes of the blocks right below height, which may not be in the db yet
+     *
+     * @return the number of blocks hashed
+     */
+    size_t prehash_incoming_blocks(uint64_t height, const std::vector<block_complete_entry> &blocks_entry, const std::vector<crypto::hash> &parent_hashes);
+
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
      *
@@ -311,6 +335,28 @@ namespace cryptonote
      */
     crypto::hash get_tail_id(uint64_t& height) const;
 
+    //! the state of the chain at its top block
+    struct chain_tip_state
+    {
+      uint64_t height;  //!< blockchain height, ie top block height + 1
+      crypto::hash top_hash;
+      difficulty_type cumulative_difficulty;
+      uint64_t block_weight_limit;
+      uint64_t block_weight_median;
+    };
+
+    /**
+     * @brief gets the state of the chain at its top block, without taking the blockchain lock
+     *
+     * The state is read from a db snapshot, built once per top block, and
+     * shared by all readers until the top changes. While a batch of blocks
+     * is being added, the weight limit and median may be the ones for a top
+     * which isn't committed yet.
+     *
+     * @return the chain tip state
+     */
+    std::shared_ptr<const chain_tip_state> get_chain_tip_state() const;
+
     /**
      * @brief returns the difficulty target the next block to be added must meet
      *
@@ -318,6 +364,24 @@ namespace cryptonote
      */
     difficulty_type get_difficulty_for_next_block();
 
+    /**
+     * @brief checks the id and PoW of a block whose tx hashes are not known yet
+     *
+     * The block id only needs the tree hash and number of the txes, so the
+     * header of a compact block can be checked before any work is spent
+     * reconstructing it. The PoW is only checked if the block extends the
+     * current top, and is then kept so it is not computed again when the
+     * full block is added.
+     *
+     * @param b the block, without its tx hashes
+     * @param tx_tree_root the tree hash of the miner tx and tx hashes
+     * @param tx_count the number of txes, excluding the miner tx
+     * @param id the id the block is announced with
+     *
+     * @return false if the header does not hash to id, or the PoW is too low, else true
+     */
+    bool check_block_header_pow(const block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id);
+
     /**
      * @brief check currently stored difficulties against difficulty checkpoints
      *
@@ -845,6 +909,22 @@ namespace cryptonote
      */
     void set_show_time_stats(bool stats) { m_show_time_stats = stats; }
 
+    /**
+     * @brief sets how many tx+mixring hashes the RCT verification cache holds
+     *
+     * The cache is emptied, so this must be called before the Blockchain is in use.
+     *
+     * @param size the new maximum number of cache entries
+     */
+    void set_rct_ver_cache_size(size_t size) { m_rct_ver_cache.resize(size); }
+
+    /**
+     * @brief gets the hit/miss/eviction statistics of the RCT verification cache
+     *
+     * @return the cache statistics
+     */
+    rct_ver_cache_t::stats_t get_rct_ver_cache_stats() const { return m_rct_ver_cache.get_stats(); }
+
     /**
      * @brief gets the hardfork voting state object
      *
@@ -1136,7 +1216,17 @@ namespace cryptonote
 
     tx_memory_pool& m_tx_pool;
 
-    mutable epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+    // taken by the paths changing the chain and its in memory state; paths which
+    // only read the db use a db read txn instead, so they see a consistent snapshot
+    // and don't wait for blocks being added
+    mutable epee::critical_section m_blockchain_lock;
+
+    mutable boost::mutex m_chain_tip_state_lock;
+    mutable std::shared_ptr<const chain_tip_state> m_chain_tip_state;
+    // weight limit and median as last computed, and the top they were computed for
+    crypto::hash m_chain_tip_weights_top_hash;
+    uint64_t m_chain_tip_weight_limit;
+    uint64_t m_chain_tip_weight_median;
 
     // main chain
     size_t m_current_block_cumul_weight_limit;
@@ -1145,6 +1235,9 @@ namespace cryptonote
     // metadata containers
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    // block id -> (seed hash, PoW hash), for blocks hashed ahead of their preparation
+    mutable std::unordered_map<crypto::hash, std::pair<crypto::hash, crypto::hash>> m_prehashed_blocks;
+    mutable boost::mutex m_prehashed_blocks_lock;
 
     // Keccak hashes for each block and for fast pow checking
     std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
@@ -1290,15 +1383,18 @@ namespace cryptonote
      * of the most recent block which contains an output used in any input set
      *
      * Currently this function calls ring signature validation for each
-     * transaction.
+     * transaction, unless deferred_mix_rings is not NULL, in which case
+     * the mix ring of a simple rct transaction is appended to it and its
+     * ring signatures are left for the caller to verify in a batch.
      *
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param deferred_mix_rings if not NULL, where to defer simple rct signature verification to
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL) const;
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, std::vector<rct::ctkeyM>* deferred_mix_rings = NULL) const;
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -115,6 +115,10 @@ namespace cryptonote
     "offline"
   , "Do not listen for peers, nor connect to any"
   };
+  const command_line::arg_descriptor<bool> arg_rpc_replica = {
+    "rpc-replica"
+  , "Only serve RPC, from the database of another daemon running on this host, opened read only. Use a separate --log-file"
+  };
   const command_line::arg_descriptor<bool> arg_disable_dns_checkpoints = {
     "disable-dns-checkpoints"
   , "Do not retrieve checkpoints from DNS"
@@ -183,6 +187,11 @@ namespace cryptonote
   , "Set maximum txpool weight in bytes."
   , DEFAULT_TXPOOL_MAX_WEIGHT
   };
+  static const command_line::arg_descriptor<size_t> arg_rct_ver_cache_size  = {
+    "rct-ver-cache-size"
+  , "Set how many verified transaction ring signatures are cached."
+  , RCT_VER_CACHE_SIZE
+  };
   static const command_line::arg_descriptor<std::string> arg_block_notify = {
     "block-notify"
   , "Run a program for each new block, '%s' will be replaced by the block hash"
@@ -235,7 +244,8 @@ namespace cryptonote
               m_disable_dns_checkpoints(false),
               m_update_download(0),
               m_nettype(UNDEFINED),
-              m_update_available(false)
+              m_update_available(false),
+              m_replica(false)
   {
     m_checkpoints_updating.clear();
     set_cryptonote_protocol(pprotocol);
@@ -339,10 +349,12 @@ namespace cryptonote
     command_line::add_arg(desc, arg_no_fluffy_blocks);
     command_line::add_arg(desc, arg_test_dbg_lock_sleep);
     command_line::add_arg(desc, arg_offline);
+    command_line::add_arg(desc, arg_rpc_replica);
     command_line::add_arg(desc, arg_disable_dns_checkpoints);
     command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_sync_pruned_blocks);
     command_line::add_arg(desc, arg_max_txpool_weight);
+    command_line::add_arg(desc, arg_rct_ver_cache_size);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
     command_line::add_arg(desc, arg_reorg_notify);
@@ -385,7 +397,8 @@ namespace cryptonote
     set_enforce_dns_checkpoints(command_line::get_arg(vm, arg_dns_checkpoints));
     test_drop_download_height(command_line::get_arg(vm, arg_test_drop_download_height));
     m_fluffy_blocks_enabled = !get_arg(vm, arg_no_fluffy_blocks);
-    m_offline = get_arg(vm, arg_offline);
+    m_replica = get_arg(vm, arg_rpc_replica);
+    m_offline = get_arg(vm, arg_offline) || m_replica;
     m_disable_dns_checkpoints = get_arg(vm, arg_disable_dns_checkpoints);
 
     if (command_line::get_arg(vm, arg_test_drop_download) == true)
@@ -472,10 +485,13 @@ namespace cryptonote
 
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_compress_txs = command_line::get_arg(vm, cryptonote::arg_db_compress_txs) != 0;
+    bool db_reserve_map = command_line::get_arg(vm, cryptonote::arg_db_reserve_map) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, arg_check_updates);
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
+    size_t rct_ver_cache_size = command_line::get_arg(vm, arg_rct_ver_cache_size);
     bool prune_blockchain = command_line::get_arg(vm, arg_prune_blockchain);
     bool keep_alt_blocks = command_line::get_arg(vm, arg_keep_alt_blocks);
     bool keep_fakechain = command_line::get_arg(vm, arg_keep_fakechain);
@@ -610,6 +626,12 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_compress_txs)
+        db_flags |= DBF_COMPRESS;
+      if (db_reserve_map)
+        db_flags |= DBF_RESERVE_MAP;
+      if (m_replica)
+        db_flags = DBF_RDONLY;
 
       db->open(filename, db_flags);
       if(!db->m_open)
@@ -623,6 +645,7 @@ namespace cryptonote
 
     m_blockchain_storage.set_user_options(blocks_threads,
         sync_on_blocks, sync_threshold, sync_mode, fast_sync);
+    m_blockchain_storage.set_rct_ver_cache_size(rct_ver_cache_size);
 
     try
     {
@@ -681,7 +704,9 @@ namespace cryptonote
 
     // now that we have a valid m_blockchain_storage, we can clean out any
     // transactions in the pool that do not conform to the current fork
-    m_mempool.validate(m_blockchain_storage.get_current_hard_fork_version());
+    if (!m_replica)
+      m_mempool.validate(m_blockchain_storage.get_current_hard_fork_version());
+    m_replica_top_hash = m_blockchain_storage.get_tail_id();
 
     bool show_time_stats = command_line::get_arg(vm, arg_show_time_stats) != 0;
     m_blockchain_storage.set_show_time_stats(show_time_stats);
@@ -718,7 +743,11 @@ namespace cryptonote
     if (!keep_alt_blocks && !m_blockchain_storage.get_db().is_read_only())
       m_blockchain_storage.get_db().drop_alt_blocks();
 
-    if (prune_blockchain)
+    if (prune_blockchain && m_replica)
+    {
+      MWARNING("--" << arg_prune_blockchain.name << " is ignored by a replica");
+    }
+    else if (prune_blockchain)
     {
       // display a message if the blockchain is not pruned yet
       if (!m_blockchain_storage.get_blockchain_pruning_seed())
@@ -1625,6 +1654,12 @@ namespace cryptonote
     return true;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  size_t core::prehash_incoming_blocks(uint64_t height, const std::vector<block_complete_entry> &blocks_entry, const std::vector<crypto::hash> &parent_hashes)
+  {
+    return m_blockchain_storage.prehash_incoming_blocks(height, blocks_entry, parent_hashes);
+  }
+
   //-----------------------------------------------------------------------------------------------
   bool core::cleanup_handle_incoming_blocks(bool force_sync)
   {
@@ -1704,6 +1739,34 @@ namespace cryptonote
     return m_mempool.get_transactions_count(include_sensitive_txes);
   }
   //-----------------------------------------------------------------------------------------------
+  size_t core::get_pool_transactions_weight() const
+  {
+    return m_mempool.get_txpool_weight();
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::refresh_replica(bool reload_pool)
+  {
+    CHECK_AND_ASSERT_MES(m_replica, false, "Not a replica");
+
+    uint64_t top_height;
+    const crypto::hash top_hash = m_blockchain_storage.get_tail_id(top_height);
+    const bool chain_changed = top_hash != m_replica_top_hash;
+    if (chain_changed)
+    {
+      m_blockchain_storage.reload_db_state();
+      m_replica_top_hash = top_hash;
+      MDEBUG("Replica now at height " << top_height << ", top " << top_hash);
+    }
+
+    // blocks take txes out of the pool
+    if (chain_changed || reload_pool)
+    {
+      if (!m_mempool.reload())
+        MERROR("Failed to reload the txpool");
+    }
+    return chain_changed;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block_unlocked(const crypto::hash& id, int *where) const
   {
     return m_blockchain_storage.have_block_unlocked(id, where);
@@ -1757,11 +1820,26 @@ namespace cryptonote
     return m_mempool.get_transaction(id, tx, tx_category);
   }  
   //-----------------------------------------------------------------------------------------------
+  void core::get_pool_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const
+  {
+    m_mempool.get_short_id_index(salt, index);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::check_block_header_pow(const block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id)
+  {
+    return m_blockchain_storage.check_block_header_pow(b, tx_tree_root, tx_count, id);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::pool_has_tx(const crypto::hash &id) const
   {
     return m_mempool.have_tx(id, relay_category::legacy);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::have_tx(const crypto::hash &id) const
+  {
+    return m_blockchain_storage.have_tx(id);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_pool_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const
   {
     return m_mempool.get_transactions_and_spent_keys_info(tx_infos, key_image_infos, include_sensitive_data);
@@ -2092,6 +2170,11 @@ namespace cryptonote
     return m_mempool.get_complement(hashes, txes);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_txpool_complement(const txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes)
+  {
+    return m_mempool.get_complement(sketch, txes);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::update_blockchain_pruning()
   {
     return m_blockchain_storage.update_blockchain_pruning();
@@ -68,6 +68,7 @@ namespace cryptonote
   extern const command_line::arg_descriptor<bool, false> arg_regtest_on;
   extern const command_line::arg_descriptor<difficulty_type> arg_fixed_difficulty;
   extern const command_line::arg_descriptor<bool> arg_offline;
+  extern const command_line::arg_descriptor<bool> arg_rpc_replica;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
   extern const command_line::arg_descriptor<bool> arg_sync_pruned_blocks;
 
@@ -187,6 +188,13 @@ namespace cryptonote
       */
      bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks);
 
+     /**
+      * @copydoc Blockchain::prehash_incoming_blocks
+      *
+      * @note see Blockchain::prehash_incoming_blocks
+      */
+     size_t prehash_incoming_blocks(uint64_t height, const std::vector<block_complete_entry> &blocks_entry, const std::vector<crypto::hash> &parent_hashes);
+
      /**
       * @copydoc Blockchain::cleanup_handle_incoming_blocks
       *
@@ -484,6 +492,13 @@ namespace cryptonote
       */
      bool pool_has_tx(const crypto::hash &txid) const;
 
+     /**
+      * @copydoc Blockchain::have_tx
+      *
+      * @note see Blockchain::have_tx
+      */
+     bool have_tx(const crypto::hash &txid) const;
+
      /**
       * @copydoc tx_memory_pool::get_transactions
       * @param include_sensitive_txes include private transactions
@@ -540,6 +555,20 @@ namespace cryptonote
       */
      bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx, relay_category tx_category) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_short_id_index
+      *
+      * @note see tx_memory_pool::get_short_id_index
+      */
+     void get_pool_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const;
+
+     /**
+      * @copydoc Blockchain::check_block_header_pow
+      *
+      * @note see Blockchain::check_block_header_pow
+      */
+     bool check_block_header_pow(const block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id);
+
      /**
       * @copydoc tx_memory_pool::get_pool_transactions_and_spent_keys_info
       * @param include_sensitive_txes include private transactions
@@ -563,6 +592,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count(bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_txpool_weight
+      *
+      * @note see tx_memory_pool::get_txpool_weight
+      */
+     size_t get_pool_transactions_weight() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -663,6 +699,13 @@ namespace cryptonote
       */
      const Blockchain& get_blockchain_storage()const{return m_blockchain_storage;}
 
+     /**
+      * @brief gets the tx_memory_pool instance
+      *
+      * @return a reference to the tx_memory_pool instance
+      */
+     tx_memory_pool& get_pool(){return m_mempool;}
+
      /**
       * @copydoc tx_memory_pool::print_pool
       *
@@ -854,6 +897,26 @@ namespace cryptonote
       */
      bool offline() const { return m_offline; }
 
+     /**
+      * @brief get whether the core serves another daemon's database, read only
+      *
+      * @return whether the core is an RPC replica
+      */
+     bool is_replica() const { return m_replica; }
+
+     /**
+      * @brief brings a replica's in memory state up to date with its database
+      *
+      * The database is written by another process, which does not tell us
+      * about its changes, so this is called when it signals them, or
+      * periodically.
+      *
+      * @param reload_pool whether to reload the txpool even if the chain did not change
+      *
+      * @return true if the chain changed, false otherwise
+      */
+     bool refresh_replica(bool reload_pool);
+
      /**
       * @brief get the blockchain pruning seed
       *
@@ -915,6 +978,15 @@ namespace cryptonote
       */
      bool get_txpool_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes);
 
+     /**
+      * @brief returns the set of transactions in the txpool which are not in a peer's sketch
+      *
+      * @param sketch the peer's sketch of its txpool
+      *
+      * @return true iff success, false if the sketch could not be decoded
+      */
+     bool get_txpool_complement(const txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes);
+
    private:
 
      /**
@@ -1155,6 +1227,8 @@ namespace cryptonote
 
      bool m_fluffy_blocks_enabled;
      bool m_offline;
+     bool m_replica;
+     crypto::hash m_replica_top_hash;
 
     /* `boost::function` is used because the implementation never allocates if
        the callable object has a single `std::shared_ptr` or `std::weap_ptr`
@@ -717,4 +717,45 @@ namespace cryptonote
     get_block_longhash(pbc, b, p, height, seed_hash, miners);
     return p;
   }
+
+  void get_block_longhashes(const Blockchain *pbc, const epee::span<const block> blocks, const uint64_t height, const crypto::hash *seed_hashes, crypto::hash *res)
+  {
+    // runs of RandomX blocks sharing a seed hash go through the pipelined batch API
+    std::vector<blobdata> bds;
+    std::vector<const void*> data;
+    std::vector<size_t> lengths;
+    for (size_t i = 0; i < blocks.size(); )
+    {
+      if (blocks[i].major_version < RX_BLOCK_VERSION || height + i == 202612)
+      {
+        get_block_longhash(pbc, blocks[i], res[i], height + i, seed_hashes ? &seed_hashes[i] : NULL);
+        ++i;
+        continue;
+      }
+
+      const uint64_t seed_height = rx_seedheight(height + i);
+      crypto::hash seed_hash = crypto::null_hash; // only null when generating genesis block
+      if (seed_hashes)
+        seed_hash = seed_hashes[i];
+      else if (pbc)
+        seed_hash = pbc->get_pending_block_id_by_height(seed_height);
+
+      size_t n = 1;
+      while (i + n < blocks.size() && blocks[i + n].major_version >= RX_BLOCK_VERSION &&
+          (seed_hashes ? seed_hashes[i + n] == seed_hash : rx_seedheight(height + i + n) == seed_height))
+        ++n;
+
+      bds.resize(n);
+      data.resize(n);
+      lengths.resize(n);
+      for (size_t k = 0; k < n; ++k)
+      {
+        bds[k] = get_block_hashing_blob(blocks[i + k]);
+        data[k] = bds[k].data();
+        lengths[k] = bds[k].size();
+      }
+      rx_slow_hash_batch(seed_hash.data, data.data(), lengths.data(), n, res[i].data);
+      i += n;
+    }
+  }
 }
@@ -127,7 +127,7 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_next_check(std::time(nullptr))
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_cookie(0), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_mine_stem_txes(false), m_block_template(), m_next_check(std::time(nullptr))
   {
     // class code expects unsigned values throughout
     if (m_next_check < time_t(0))
@@ -746,6 +746,68 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_complement(const txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    txpool_sketch local{sketch.cells(), sketch.salt()};
+    std::unordered_map<uint64_t, crypto::hash> short_ids;
+    m_blockchain.for_all_txpool_txes([&local, &short_ids, &sketch](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
+      const auto tx_relay_method = meta.get_relay_method();
+      if (tx_relay_method != relay_method::block && tx_relay_method != relay_method::fluff)
+        return true;
+      const uint64_t id = txpool_sketch::short_id(txid, sketch.salt());
+      local.insert(id);
+      short_ids.emplace(id, txid);
+      return true;
+    }, false);
+
+    std::vector<uint64_t> missing, extra;
+    if (!local.subtract(sketch) || !local.decode(missing, extra))
+      return false;
+
+    for (const uint64_t id: missing)
+    {
+      const auto it = short_ids.find(id);
+      if (it == short_ids.end())
+        continue; // short id collision or junk cell, the fallback will catch up
+      cryptonote::blobdata bd;
+      try
+      {
+        if (!m_blockchain.get_txpool_tx_blob(it->second, bd, cryptonote::relay_category::broadcasted))
+        {
+          MERROR("Failed to get blob for txpool transaction " << it->second);
+          continue;
+        }
+        txes.emplace_back(std::move(bd));
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to get blob for txpool transaction " << it->second << ": " << e.what());
+      }
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    index.clear();
+    index.reserve(m_blockchain.get_txpool_tx_count());
+    m_blockchain.for_all_txpool_txes([salt, &index](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata_ref*) {
+      const auto tx_relay_method = meta.get_relay_method();
+      if (tx_relay_method != relay_method::block && tx_relay_method != relay_method::fluff)
+        return true;
+      const auto inserted = index.emplace(get_compact_short_id(txid, salt), txid);
+      if (!inserted.second)
+        inserted.first->second = crypto::null_hash; // ambiguous, resolve by full hash
+      return true;
+    }, false);
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
@@ -915,6 +977,7 @@ namespace cryptonote
         {
           // txes can be received as "stem" or "fluff" in either order
           const bool already_broadcasted = meta.matches(relay_category::broadcasted);
+          const relay_method original_method = meta.get_relay_method();
           meta.upgrade_relay_method(method);
           meta.relayed = true;
 
@@ -933,6 +996,9 @@ namespace cryptonote
           if (was_just_broadcasted)
             // Make sure the tx gets re-added with an updated time
             add_tx_to_transient_lists(hash, meta.fee / (double)meta.weight, std::chrono::system_clock::to_time_t(now));
+          else if (meta.get_relay_method() != original_method)
+            // eg, a local tx going to stem may be minable now
+            reset_template_candidate(find_tx_in_sorted_container(hash), hash);
         }
       }
       catch (const std::exception &e)
@@ -1368,6 +1434,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
     m_parsed_tx_cache.clear();
+    m_block_template.valid = false;
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1376,6 +1443,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
     m_parsed_tx_cache.clear();
+    m_block_template.valid = false;
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1613,107 +1681,114 @@ namespace cryptonote
     return ss.str();
   }
   //---------------------------------------------------------------------------------
-  //TODO: investigate whether boolean return is appropriate
-  bool tx_memory_pool::fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version)
+  tx_memory_pool::template_candidate *tx_memory_pool::get_template_candidate(const crypto::hash &txid)
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    auto it = m_block_template.candidates.find(txid);
+    if (it != m_block_template.candidates.end())
+      return &it->second;
+
+    txpool_tx_meta_t meta;
+    if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+    {
+      static bool warned = false;
+      if (!warned)
+        MERROR("  failed to find tx meta: " << txid << " (will only print once)");
+      warned = true;
+      return NULL;
+    }
+
+    template_candidate &c = m_block_template.candidates[txid];
+    c.weight = meta.weight;
+    c.fee = meta.fee;
+    c.minable = (meta.matches(relay_category::legacy) || (m_mine_stem_txes && meta.get_relay_method() == relay_method::stem)) && !meta.pruned;
+    c.ready = -1;
+    return &c;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::reset_template_candidate(const cryptonote::sorted_tx_container::iterator& sorted_it, const crypto::hash &txid)
+  {
+    m_block_template.candidates.erase(txid);
+    if (m_block_template.selected.count(txid))
+      m_block_template.needs_rebuild = true;
+    else if (sorted_it != m_txs_by_fee_and_receive_time.end())
+      m_block_template.added.insert(*sorted_it);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::add_tx_to_block_template(const tx_by_fee_and_receive_time_entry &entry, size_t max_total_weight, bool &stop)
+  {
+    block_template_state &bt = m_block_template;
+    const crypto::hash &txid = entry.second;
+    stop = false;
 
-    uint64_t best_coinbase = 0, coinbase = 0;
-    total_weight = 0;
-    fee = 0;
-    
-    //baseline empty block
-    if (!get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, version))
+    template_candidate *c = get_template_candidate(txid);
+    if (!c)
+      return false;
+    LOG_PRINT_L2("Considering " << txid << ", weight " << c->weight << ", current block weight " << bt.total_weight << "/" << max_total_weight << ", current coinbase " << print_money(bt.best_coinbase));
+
+    if (!c->minable)
     {
-      MERROR("Failed to get block reward for empty block");
+      LOG_PRINT_L2("  tx relay method does not allow mining it, or tx is pruned");
       return false;
     }
 
-
-    size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-    size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-    size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
-    std::unordered_set<crypto::key_image> k_images;
-
-    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
-
-    LockedTXN lock(m_blockchain.get_db());
-
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    // Can not exceed maximum block weight
+    if (max_total_weight < bt.total_weight + c->weight)
     {
-      txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
-      {
-        static bool warned = false;
-        if (!warned)
-          MERROR("  failed to find tx meta: " << sorted_it->second << " (will only print once)");
-        warned = true;
-        continue;
-      }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase) << ", relay method " << (unsigned)meta.get_relay_method());
-
-      if (!meta.matches(relay_category::legacy) && !(m_mine_stem_txes && meta.get_relay_method() == relay_method::stem))
-      {
-        LOG_PRINT_L2("  tx relay method is " << (unsigned)meta.get_relay_method());
-        continue;
-      }
-      if (meta.pruned)
-      {
-        LOG_PRINT_L2("  tx is pruned");
-        continue;
-      }
+      LOG_PRINT_L2("  would exceed maximum block weight");
+      return false;
+    }
 
-      // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
+    uint64_t coinbase = 0;
+    // start using the optimal filling algorithm from v5
+    if (bt.version >= 5)
+    {
+      // If we're getting lower coinbase tx,
+      // stop including more tx
+      uint64_t block_reward;
+      if(!get_block_reward(bt.median_weight, bt.total_weight + c->weight, bt.already_generated_coins, block_reward, bt.version))
       {
         LOG_PRINT_L2("  would exceed maximum block weight");
-        continue;
+        return false;
       }
-
-      // start using the optimal filling algorithm from v5
-      if (version >= 5)
+      coinbase = block_reward + bt.fee + c->fee;
+      if (coinbase < template_accept_threshold(bt.best_coinbase))
       {
-        // If we're getting lower coinbase tx,
-        // stop including more tx
-        uint64_t block_reward;
-        if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, version))
-        {
-          LOG_PRINT_L2("  would exceed maximum block weight");
-          continue;
-        }
-        coinbase = block_reward + fee + meta.fee;
-        if (coinbase < template_accept_threshold(best_coinbase))
-        {
-          LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
-          continue;
-        }
+        LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
+        return false;
       }
-      else
+    }
+    else
+    {
+      // If we've exceeded the penalty free weight,
+      // stop including more tx
+      if (bt.total_weight > bt.median_weight)
       {
-        // If we've exceeded the penalty free weight,
-        // stop including more tx
-        if (total_weight > median_weight)
-        {
-          LOG_PRINT_L2("  would exceed median block weight");
-          break;
-        }
+        LOG_PRINT_L2("  would exceed median block weight");
+        stop = true;
+        return false;
       }
+    }
+
+    // Skip transactions that are not ready to be
+    // included into the blockchain or that are
+    // missing key images. This is only checked once
+    // per chain top, the result is kept with the candidate
+    if (c->ready < 0)
+    {
+      c->ready = 0;
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+        return false;
 
       // "local" and "stem" txes are filtered above
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second, relay_category::all);
+      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid, relay_category::all);
 
       cryptonote::transaction tx;
-
-      // Skip transactions that are not ready to be
-      // included into the blockchain or that are
-      // missing key images
       const cryptonote::txpool_tx_meta_t original_meta = meta;
       bool ready = false;
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        ready = is_transaction_ready_to_go(meta, txid, txblob, tx);
       }
       catch (const std::exception &e)
       {
@@ -1723,38 +1798,140 @@ namespace cryptonote
       if (memcmp(&original_meta, &meta, sizeof(meta)))
       {
         try
-	{
-	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
-	}
+        {
+          m_blockchain.update_txpool_tx(txid, meta);
+        }
         catch (const std::exception &e)
-	{
-	  MERROR("Failed to update tx meta: " << e.what());
-	  // continue, not fatal
-	}
+        {
+          MERROR("Failed to update tx meta: " << e.what());
+          // continue, not fatal
+        }
       }
-      if (!ready)
+      if (ready)
       {
-        LOG_PRINT_L2("  not ready to go");
-        continue;
+        c->key_images.reserve(tx.vin.size());
+        for (const auto &in: tx.vin)
+        {
+          CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, itk, false);
+          c->key_images.push_back(itk.k_image);
+        }
+        c->ready = 1;
       }
-      if (have_key_images(k_images, tx))
+    }
+    if (!c->ready)
+    {
+      LOG_PRINT_L2("  not ready to go");
+      return false;
+    }
+    for (const crypto::key_image &ki: c->key_images)
+    {
+      if (bt.k_images.count(ki))
       {
         LOG_PRINT_L2("  key images already seen");
-        continue;
+        return false;
       }
+    }
 
-      bl.tx_hashes.push_back(sorted_it->second);
-      total_weight += meta.weight;
-      fee += meta.fee;
-      best_coinbase = coinbase;
-      append_key_images(k_images, tx);
-      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
+    bt.tx_hashes.push_back(txid);
+    bt.selected.insert(txid);
+    bt.k_images.insert(c->key_images.begin(), c->key_images.end());
+    bt.last_selected = entry;
+    bt.total_weight += c->weight;
+    bt.fee += c->fee;
+    bt.best_coinbase = coinbase;
+    LOG_PRINT_L2("  added, new block weight " << bt.total_weight << "/" << max_total_weight << ", coinbase " << print_money(bt.best_coinbase));
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::build_block_template(size_t max_total_weight)
+  {
+    block_template_state &bt = m_block_template;
+    bt.tx_hashes.clear();
+    bt.selected.clear();
+    bt.k_images.clear();
+    bt.total_weight = 0;
+    bt.fee = 0;
+
+    //baseline empty block
+    if (!get_block_reward(bt.median_weight, bt.total_weight, bt.already_generated_coins, bt.best_coinbase, bt.version))
+    {
+      MERROR("Failed to get block reward for empty block");
+      return false;
     }
+
+    for (const auto &entry: m_txs_by_fee_and_receive_time)
+    {
+      bool stop;
+      add_tx_to_block_template(entry, max_total_weight, stop);
+      if (stop)
+        break;
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  //TODO: investigate whether boolean return is appropriate
+  bool tx_memory_pool::fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
+    size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+    size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+    size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
+
+    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
+
+    LockedTXN lock(m_blockchain.get_db());
+
+    // The selection is kept between calls. Readiness depends on the chain, so a new
+    // top throws everything away. Otherwise, txes sorting after the last selected one
+    // are tried on top of the current template, while a selected tx leaving the pool
+    // or a better one coming in changes what the greedy pass picks, so the template
+    // is then selected again, but from the candidates cached in memory
+    block_template_state &bt = m_block_template;
+    const crypto::hash top_id = m_blockchain.get_tail_id();
+    bool r = true;
+    if (!bt.valid || bt.top_id != top_id || bt.median_weight != median_weight || bt.already_generated_coins != already_generated_coins || bt.version != version)
+    {
+      bt.candidates.clear();
+      bt.added.clear();
+      bt.top_id = top_id;
+      bt.median_weight = median_weight;
+      bt.already_generated_coins = already_generated_coins;
+      bt.version = version;
+      r = build_block_template(max_total_weight);
+    }
+    else
+    {
+      if (version < 5 || (!bt.selected.empty() && !bt.added.empty() && txCompare()(*bt.added.begin(), bt.last_selected)))
+        bt.needs_rebuild = true;
+      if (bt.needs_rebuild)
+      {
+        r = build_block_template(max_total_weight);
+      }
+      else
+      {
+        LOG_PRINT_L2("Trying " << bt.added.size() << " new txes on top of the current template");
+        for (const auto &entry: bt.added)
+        {
+          bool stop;
+          add_tx_to_block_template(entry, max_total_weight, stop);
+        }
+      }
+    }
+    bt.added.clear();
+    bt.needs_rebuild = false;
+    bt.valid = r;
+    if (!r)
+      return false;
     lock.commit();
 
-    expected_reward = best_coinbase;
-    LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
-        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
+    bl.tx_hashes.insert(bl.tx_hashes.end(), bt.tx_hashes.begin(), bt.tx_hashes.end());
+    total_weight = bt.total_weight;
+    fee = bt.fee;
+    expected_reward = bt.best_coinbase;
+    LOG_PRINT_L2("Block template filled with " << bt.tx_hashes.size() << " txes, weight "
+        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(expected_reward)
         << " (including " << print_money(fee) << " in fees)");
     return true;
   }
@@ -1769,6 +1946,7 @@ namespace cryptonote
     m_added_txs_start_time = (time_t)0;
     m_removed_txs_by_time.clear();
     m_removed_txs_start_time = (time_t)0;
+    m_block_template.valid = false;
 
     MINFO("Validating txpool contents for v" << (unsigned)version);
 
@@ -1851,10 +2029,14 @@ namespace cryptonote
       }
       else
       {
+        m_block_template.added.erase(*sorted_it);
         m_txs_by_fee_and_receive_time.erase(sorted_it);
       }
     }
-    m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(fee, receive_time), txid);
+    const auto sorted_it = m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(fee, receive_time), txid).first;
+
+    // a tx coming back with a new time (eg, fluffed after stem) may now be minable
+    reset_template_candidate(sorted_it, txid);
 
     // Don't check for "resurrected" txs in case of reorgs i.e. don't check in 'm_removed_txs_by_time'
     // whether we have that txid there and if yes remove it; this results in possible duplicates
@@ -1874,9 +2056,14 @@ namespace cryptonote
     }
     else
     {
+      m_block_template.added.erase(*sorted_it);
       m_txs_by_fee_and_receive_time.erase(sorted_it);
     }
 
+    m_block_template.candidates.erase(txid);
+    if (m_block_template.selected.count(txid))
+      m_block_template.needs_rebuild = true;
+
     const std::unordered_map<crypto::hash, time_t>::iterator it = m_added_txs_by_id.find(txid);
     if (it != m_added_txs_by_id.end())
     {
@@ -1934,6 +2121,9 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    // whether stem txes are minable is cached with the template candidates
+    m_mine_stem_txes = mine_stem_txes;
+    m_block_template = block_template_state();
     m_added_txs_by_id.clear();
     m_added_txs_start_time = (time_t)0;
     m_removed_txs_by_time.clear();
@@ -1969,7 +2159,7 @@ namespace cryptonote
       if (!r)
         return false;
     }
-    if (!remove.empty())
+    if (!remove.empty() && !m_blockchain.get_db().is_read_only())
     {
       LockedTXN lock(m_blockchain.get_db());
       for (const auto &txid: remove)
@@ -1987,13 +2177,17 @@ namespace cryptonote
       lock.commit();
     }
 
-    m_mine_stem_txes = mine_stem_txes;
     m_cookie = 0;
 
     // Ignore deserialization error
     return true;
   }
 
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::reload()
+  {
+    return init(m_txpool_max_weight, m_mine_stem_txes);
+  }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
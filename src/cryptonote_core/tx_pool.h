@@ -46,6 +46,7 @@
 #include "math_helper.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/verification_context.h"
+#include "cryptonote_basic/txpool_sketch.h"
 #include "cryptonote_protocol/enums.h"
 #include "blockchain_db/blockchain_db.h"
 #include "crypto/hash.h"
@@ -205,6 +206,15 @@ namespace cryptonote
      */
     bool init(size_t max_txpool_weight = 0, bool mine_stem_txes = false);
 
+    /**
+     * @brief reinitializes the pool from the db, keeping the settings from init()
+     *
+     * Used when the db is written by another process.
+     *
+     * @return true
+     */
+    bool reload();
+
     /**
      * @brief attempts to save the transaction pool state to disk
      *
@@ -472,6 +482,25 @@ namespace cryptonote
      */
     bool get_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) const;
 
+    /**
+     * @brief get transactions missing from a peer, reconciled against its sketch
+     *
+     * @param sketch the peer's sketch of its pool
+     * @param txes return-by-reference the transactions the peer does not have
+     *
+     * @return false if the difference is too large to decode from `sketch`
+     */
+    bool get_complement(const txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes) const;
+
+    /**
+     * @brief index the broadcastable transactions by compact block short id
+     *
+     * @param salt the salt of the compact block being matched
+     * @param index return-by-reference short id to tx hash; ids shared by
+     *        several transactions map to `crypto::null_hash`
+     */
+    void get_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const;
+
     /**
      * @brief get info necessary for update of pool-related info in a wallet, preferably incremental
      *
@@ -594,6 +623,49 @@ namespace cryptonote
     void remove_tx_from_transient_lists(const cryptonote::sorted_tx_container::iterator& sorted_it, const crypto::hash& txid, bool sensitive);
     void track_removed_tx(const crypto::hash& txid, bool sensitive);
 
+    //! what the block template selection needs to know about a pool tx
+    struct template_candidate
+    {
+      uint64_t weight;
+      uint64_t fee;
+      bool minable;  //!< relay method allows mining it and it is not pruned
+      int ready;     //!< -1 until checked against the current chain, then 0 or 1
+      std::vector<crypto::key_image> key_images;
+    };
+
+    /**
+     * @brief get the template candidate info for a tx, loading it from the db if not cached
+     *
+     * @return the candidate, or NULL if the tx meta could not be found
+     */
+    template_candidate *get_template_candidate(const crypto::hash &txid);
+
+    /**
+     * @brief drop the cached template candidate info for a tx whose meta changed
+     *
+     * @param sorted_it the tx's entry in the fee sorted container, if any
+     * @param txid the tx's hash
+     */
+    void reset_template_candidate(const cryptonote::sorted_tx_container::iterator& sorted_it, const crypto::hash &txid);
+
+    /**
+     * @brief try to add a tx on top of the current block template
+     *
+     * @param entry the tx's entry in the fee sorted container
+     * @param max_total_weight the maximum weight of the template's txes
+     * @param stop return-by-reference true if no more txes should be considered
+     *
+     * @return true if the tx was added, false otherwise
+     */
+    bool add_tx_to_block_template(const tx_by_fee_and_receive_time_entry &entry, size_t max_total_weight, bool &stop);
+
+    /**
+     * @brief select the template's txes from scratch, going through the whole pool by fee
+     *
+     * @return false if the block reward can't be computed, otherwise true
+     */
+    bool build_block_template(size_t max_total_weight);
+
     //TODO: confirm the below comments and investigate whether or not this
     //      is the desired behavior
     //! map key images to transactions which spent them
@@ -674,6 +746,29 @@ private:
 
     std::unordered_map<crypto::hash, transaction> m_parsed_tx_cache;
 
+    //! the txes picked by the last fill_block_template call, kept up to date as txes come and go
+    struct block_template_state
+    {
+      bool valid;
+      crypto::hash top_id;  //!< chain top the candidates' readiness was checked against
+      size_t median_weight;
+      uint64_t already_generated_coins;
+      uint8_t version;
+
+      std::vector<crypto::hash> tx_hashes;  //!< selected txes, by decreasing fee per weight
+      std::unordered_set<crypto::hash> selected;
+      std::unordered_set<crypto::key_image> k_images;
+      tx_by_fee_and_receive_time_entry last_selected;
+      size_t total_weight;
+      uint64_t fee;
+      uint64_t best_coinbase;
+
+      std::unordered_map<crypto::hash, template_candidate> candidates;
+      sorted_tx_container added;  //!< txes which entered the pool since the last fill
+      bool needs_rebuild;  //!< a selected tx left the pool, or a better one came in
+    };
+    block_template_state m_block_template;
+
     //! Next timestamp that a DB check for relayable txes is allowed
     std::atomic<time_t> m_next_check;
 
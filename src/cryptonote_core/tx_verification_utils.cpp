@@ -37,8 +37,8 @@
 
 using namespace cryptonote;
 
-// Do RCT expansion, then do post-expansion sanity checks, then do full non-semantics verification.
-static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mix_ring)
+// Do RCT expansion, then do post-expansion sanity checks.
+static bool expand_tx_for_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mix_ring)
 {
     // Pruned transactions can not be expanded and verified because they are missing RCT data
     VER_ASSERT(!tx.pruned, "Pruned transaction will not pass verRctNonSemanticsSimple");
@@ -79,7 +79,16 @@ static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mi
     }
 
     // Mix ring data is now known to be correctly incorporated into the RCT sig inside tx.
-    return rct::verRctNonSemanticsSimple(rv);
+    return true;
+}
+
+// Do RCT expansion, then do post-expansion sanity checks, then do full non-semantics verification.
+static bool expand_tx_and_ver_rct_non_sem(transaction& tx, const rct::ctkeyM& mix_ring)
+{
+    if (!expand_tx_for_ver_rct_non_sem(tx, mix_ring))
+        return false;
+
+    return rct::verRctNonSemanticsSimple(tx.rct_signatures);
 }
 
 // Create a unique identifier for pair of tx blob + mix ring
@@ -164,4 +173,61 @@ bool ver_rct_non_semantics_simple_cached
     return true;
 }
 
+bool ver_rct_non_semantics_simple_cached
+(
+    const std::vector<transaction*>& txs,
+    const std::vector<rct::ctkeyM>& mix_rings,
+    rct_ver_cache_t& cache,
+    const std::uint8_t rct_type_to_cache
+)
+{
+    VER_ASSERT(txs.size() == mix_rings.size(), "Mismatched sizes of txs and mix_rings");
+
+    // See the single transaction version above for why this is safe to cache
+    std::vector<const rct::rctSig*> to_verify;
+    std::vector<crypto::hash> to_cache;
+    to_verify.reserve(txs.size());
+    to_cache.reserve(txs.size());
+    for (size_t n = 0; n < txs.size(); ++n)
+    {
+        transaction& tx = *txs[n];
+        const rct::ctkeyM& mix_ring = mix_rings[n];
+
+        const bool untested_tx = tx.version > 2 || tx.rct_signatures.type > rct::RCTTypeBulletproofPlus;
+        VER_ASSERT(!untested_tx, "Unknown TX type. Make sure RCT cache works correctly with this type and then enable it in the code here.");
+
+        if (tx.rct_signatures.type == rct_type_to_cache)
+        {
+            const crypto::hash tx_mixring_hash = calc_tx_mixring_hash(tx, mix_ring);
+            if (cache.has(tx_mixring_hash))
+            {
+                MDEBUG("RCT cache: tx " << get_transaction_hash(tx) << " hit");
+                continue;
+            }
+            MDEBUG("RCT cache: tx " << get_transaction_hash(tx) << " missed");
+            to_cache.push_back(tx_mixring_hash);
+        }
+        else
+        {
+            MDEBUG("RCT cache: tx " << get_transaction_hash(tx) << " skipped");
+        }
+
+        if (!expand_tx_for_ver_rct_non_sem(tx, mix_ring))
+        {
+            MERROR("Failed to expand ringct signatures of tx " << get_transaction_hash(tx));
+            return false;
+        }
+        to_verify.push_back(&tx.rct_signatures);
+    }
+
+    // One pass over every input of every tx we did not have cached
+    if (!to_verify.empty() && !rct::verRctNonSemanticsSimple(to_verify))
+        return false;
+
+    for (const crypto::hash& tx_mixring_hash : to_cache)
+        cache.add(tx_mixring_hash);
+
+    return true;
+}
+
 } // namespace cryptonote
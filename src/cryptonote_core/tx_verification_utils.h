@@ -35,9 +35,10 @@ namespace cryptonote
 {
 
 // Modifying this value should not affect consensus. You can adjust it for performance needs
+// (default for --rct-ver-cache-size)
 static constexpr const size_t RCT_VER_CACHE_SIZE = 8192;
 
-using rct_ver_cache_t = ::tools::data_cache<::crypto::hash, RCT_VER_CACHE_SIZE>;
+using rct_ver_cache_t = ::tools::sharded_data_cache<::crypto::hash>;
 
 /**
  * @brief Cached version of rct::verRctNonSemanticsSimple
@@ -75,4 +76,26 @@ bool ver_rct_non_semantics_simple_cached
     std::uint8_t rct_type_to_cache
 );
 
+/**
+ * @brief Cached version of rct::verRctNonSemanticsSimple over a set of transactions
+ *
+ * Same as the single transaction version, but the ring signatures of all transactions which are
+ * not found in the cache are verified together, so that all their inputs are spread over the
+ * threadpool at once. Results are only added to the cache if the whole set verifies.
+ *
+ * @param txs transactions which contain RCT signatures to verify
+ * @param mix_rings mixrings referenced by each tx, in the same order. THIS DATA MUST BE PREVIOUSLY VALIDATED
+ * @param cache saves tx+mixring hashes used to cache calls
+ * @param rct_type_to_cache Only RCT sigs with version (e.g. RCTTypeBulletproofPlus) will be cached
+ * @return true when verRctNonSemanticsSimple() w/ expanded tx.rct_signatures would return true for all txs
+ * @return false otherwise
+ */
+bool ver_rct_non_semantics_simple_cached
+(
+    const std::vector<transaction*>& txs,
+    const std::vector<rct::ctkeyM>& mix_rings,
+    rct_ver_cache_t& cache,
+    std::uint8_t rct_type_to_cache
+);
+
 } // namespace cryptonote
@@ -40,6 +40,7 @@ namespace cryptonote
 
 
 #define BC_COMMANDS_POOL_BASE 2000
+#define CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT 1000 // per NOTIFY_TX_POOL_HASH or NOTIFY_REQUEST_TX_POOL_TXS
 
   /************************************************************************/
   /* P2P connection info, serializable to json                            */
@@ -198,11 +199,13 @@ namespace cryptonote
       std::vector<blobdata>   txs;
       std::string _; // padding
       bool dandelionpp_fluff; //zero initialization defaults to stem mode
+      uint64_t txpool_sketch_cells; // size of the txpool sketch this answers, 0 if none
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(txs)
         KV_SERIALIZE(_)
         KV_SERIALIZE_OPT(dandelionpp_fluff, true) // backwards compatible mode is fluff
+        KV_SERIALIZE_OPT(txpool_sketch_cells, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -375,5 +378,107 @@ namespace cryptonote
     };
     typedef epee::misc_utils::struct_init<request_t> request;
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TX_POOL_HASH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request_t
+    {
+      std::vector<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_POOL_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request_t
+    {
+      std::vector<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+
+    struct request_t
+    {
+      uint64_t salt;
+      std::string sketch;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(sketch)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TXPOOL_SKETCH_FAILED
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 14;
+
+    struct request_t
+    {
+      uint64_t cells;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(cells)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 15;
+
+    struct request_t
+    {
+      crypto::hash block_hash;
+      blobdata block;         // block blob without its tx hashes
+      crypto::hash tx_tree_root;  // lets the receiver check the block id and PoW before reconstructing
+      uint64_t salt;
+      std::string short_ids;  // 6-byte salted short id per tx, in block order
+      uint64_t current_blockchain_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE(block)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(tx_tree_root)
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(short_ids)
+        KV_SERIALIZE(current_blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
     
 }
@@ -46,21 +46,33 @@
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/connection_context.h"
 #include "net/levin_base.h"
 #include "p2p/net_node_common.h"
 #include <boost/circular_buffer.hpp>
+#include <boost/functional/hash.hpp>
 
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4355)
 
 #define LOCALHOST_INT 2130706433
 #define CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT 100
+#define CURRENCY_PROTOCOL_COMPACT_BLOCK_SALT_TRIES 4
+#define CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS 96
 static_assert(CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT >= BLOCKS_SYNCHRONIZING_DEFAULT_COUNT_PRE_V4, "Invalid CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT");
 
 namespace cryptonote
 {
 
+	struct sync_pipeline_stats
+	{
+	  uint64_t pow_queue_blocks; // blocks whose PoW is being computed ahead of them being added
+	  uint64_t pow_stall_time; // ms spent adding blocks waiting for the PoW stage
+	  uint64_t add_queue_spans; // downloaded spans waiting to be added
+	  uint64_t add_stall_time; // ms spent waiting for downloads with nothing to add
+	};
+
 	class cryptonote_protocol_handler_base_pimpl;
 	class cryptonote_protocol_handler_base {
 		private:
@@ -96,6 +108,11 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
       HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_COMPLEMENT, &cryptonote_protocol_handler::handle_notify_get_txpool_complement)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_POOL_HASH, &cryptonote_protocol_handler::handle_notify_tx_pool_hash)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TX_POOL_TXS, &cryptonote_protocol_handler::handle_request_tx_pool_txs)
+      HANDLE_NOTIFY_T2(NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT, &cryptonote_protocol_handler::handle_notify_get_txpool_sketch_complement)
+      HANDLE_NOTIFY_T2(NOTIFY_TXPOOL_SKETCH_FAILED, &cryptonote_protocol_handler::handle_notify_txpool_sketch_failed)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -132,6 +149,9 @@ namespace cryptonote
     std::pair<uint32_t, uint32_t> get_next_needed_pruning_stripe() const;
     bool needs_new_sync_connections(epee::net_utils::zone zone) const;
     bool is_busy_syncing();
+    sync_pipeline_stats get_sync_pipeline_stats() const;
+    //! asks the next announcer for txes requested before now - TX_REQUEST_TIMEOUT, called from on_idle
+    bool prune_requested_txs(const boost::posix_time::ptime &now);
 
   private:
     //----------------- commands handlers ----------------------------------------------
@@ -144,6 +164,11 @@ namespace cryptonote
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
     int handle_notify_get_txpool_complement(int command, NOTIFY_GET_TXPOOL_COMPLEMENT::request& arg, cryptonote_connection_context& context);
+    int handle_notify_tx_pool_hash(int command, NOTIFY_TX_POOL_HASH::request& arg, cryptonote_connection_context& context);
+    int handle_request_tx_pool_txs(int command, NOTIFY_REQUEST_TX_POOL_TXS::request& arg, cryptonote_connection_context& context);
+    int handle_notify_get_txpool_sketch_complement(int command, NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::request& arg, cryptonote_connection_context& context);
+    int handle_notify_txpool_sketch_failed(int command, NOTIFY_TXPOOL_SKETCH_FAILED::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
@@ -163,9 +188,13 @@ namespace cryptonote
     bool check_standby_peers();
     bool update_sync_search();
     int try_add_next_blocks(cryptonote_connection_context &context);
+    void start_pow_stage(uint64_t height, const std::vector<block> &parents);
+    void wait_pow_stage();
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     size_t skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
-    bool request_txpool_complement(cryptonote_connection_context &context);
+    bool request_txpool_complement(cryptonote_connection_context &context, uint64_t sketch_cells);
+    void on_requested_txs_received(const std::vector<blobdata> &txs, cryptonote_connection_context &context);
+    void release_requested_tx(const boost::uuids::uuid &peer);
     void hit_score(cryptonote_connection_context &context, int32_t score);
 
     t_core& m_core;
@@ -183,10 +212,17 @@ namespace cryptonote
     epee::math_helper::once_a_time_milliseconds<100> m_standby_checker;
     epee::math_helper::once_a_time_seconds<101> m_sync_search_checker;
     epee::math_helper::once_a_time_seconds<43> m_bad_peer_checker;
+    epee::math_helper::once_a_time_seconds<5> m_requested_txs_pruner;
     std::unordered_map<epee::net_utils::zone, unsigned int> m_max_out_peers;
     mutable epee::critical_section m_max_out_peers_lock;
     tools::PerformanceTimer m_sync_timer, m_add_timer;
     uint64_t m_last_add_end_time;
+
+    // sync pipeline: the PoW of the next span is computed while a span is being added
+    tools::threadpool::waiter m_pow_stage_waiter;
+    std::atomic<uint64_t> m_pow_stage_blocks;
+    std::atomic<uint64_t> m_pow_stage_stall_time;
+    std::atomic<uint64_t> m_add_stage_stall_time;
     uint64_t m_sync_spans_downloaded, m_sync_old_spans_downloaded, m_sync_bad_spans_downloaded;
     uint64_t m_sync_download_chain_size, m_sync_download_objects_size;
     size_t m_block_download_max_size;
@@ -206,13 +242,30 @@ namespace cryptonote
 
     boost::mutex m_bad_peer_check_lock;
 
+    // txs announced by hash that were requested from a peer
+    struct requested_tx
+    {
+      boost::posix_time::ptime time;  //!< when it was last requested
+      boost::uuids::uuid peer;  //!< the peer it was requested from
+      std::vector<boost::uuids::uuid> announcers;  //!< other peers which announced it, asked in turn on timeout
+    };
+    boost::mutex m_requested_txs_lock;
+    std::unordered_map<crypto::hash, requested_tx> m_requested_txs;
+    std::unordered_map<boost::uuids::uuid, size_t, boost::hash<boost::uuids::uuid>> m_requested_txs_per_peer;  //!< txs in m_requested_txs, by peer asked
+
+    // txpool short id index of the last compact block, reused for the same block from other peers
+    boost::mutex m_compact_block_index_lock;
+    crypto::hash m_compact_block_index_id;
+    uint64_t m_compact_block_index_salt;
+    std::unordered_map<uint64_t, crypto::hash> m_compact_block_index;
+
     template<class t_parameter>
       bool post_notify(typename t_parameter::request& arg, cryptonote_connection_context& context)
       {
         LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] post " << typeid(t_parameter).name() << " -->");
 
         epee::levin::message_writer out{256 * 1024}; // optimize for block responses
-        epee::serialization::store_t_to_binary(arg, out.buffer);
+        epee::serialization::store_t_to_binary_direct(arg, out.buffer);
         //handler_response_blocks_now(blob.size()); // XXX
         return m_p2p->invoke_notify_to_peer(t_parameter::ID, std::move(out), context);
       }
@@ -73,6 +73,10 @@
 #define DROP_ON_SYNC_WEDGE_THRESHOLD (30 * 1000000000ull) // nanoseconds
 #define LAST_ACTIVITY_STALL_THRESHOLD (2.0f) // seconds
 #define DROP_PEERS_ON_SCORE -2
+#define TX_REQUEST_TIMEOUT (30 * 1000000) // microseconds
+#define TX_REQUEST_MAX_PER_PEER (2 * CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT)
+#define TX_REQUEST_MAX_IN_FLIGHT (20 * CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT)
+#define TX_REQUEST_MAX_ANNOUNCERS 4
 
 namespace cryptonote
 {
@@ -87,7 +91,13 @@ namespace cryptonote
                                                                                                               m_synchronized(offline),
                                                                                                               m_ask_for_txpool_complement(true),
                                                                                                               m_stopping(false),
-                                                                                                              m_no_sync(false)
+                                                                                                              m_no_sync(false),
+                                                                                                              m_pow_stage_waiter(tools::threadpool::getInstanceForCompute()),
+                                                                                                              m_pow_stage_blocks(0),
+                                                                                                              m_pow_stage_stall_time(0),
+                                                                                                              m_add_stage_stall_time(0),
+                                                                                                              m_compact_block_index_id(crypto::null_hash),
+                                                                                                              m_compact_block_index_salt(0)
 
   {
     if(!m_p2p)
@@ -117,6 +127,7 @@ namespace cryptonote
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::deinit()
   {
+    m_pow_stage_waiter.wait();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -981,6 +992,265 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_get_txpool_sketch_complement(int command, NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT (" << arg.sketch.size() << " bytes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    txpool_sketch sketch{0, arg.salt};
+    if (!sketch.from_blob(arg.sketch))
+    {
+      LOG_ERROR_CCONTEXT("Invalid txpool sketch, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<cryptonote::blobdata> txes;
+    if (!m_core.get_txpool_complement(sketch, txes))
+    {
+      // the requester retries with a larger sketch, or falls back to the full hash list
+      NOTIFY_TXPOOL_SKETCH_FAILED::request failed;
+      failed.cells = sketch.cells();
+      MLOG_P2P_MESSAGE("-->>NOTIFY_TXPOOL_SKETCH_FAILED: cells=" << failed.cells);
+      post_notify<NOTIFY_TXPOOL_SKETCH_FAILED>(failed, context);
+      return 1;
+    }
+
+    // even if empty, so the requester knows the sketch went through
+    NOTIFY_NEW_TRANSACTIONS::request new_txes;
+    new_txes.txs = std::move(txes);
+    new_txes.txpool_sketch_cells = sketch.cells();
+
+    MLOG_P2P_MESSAGE
+    (
+        "-->>NOTIFY_NEW_TRANSACTIONS: "
+        << ", txs.size()=" << new_txes.txs.size()
+        << ", txpool_sketch_cells=" << new_txes.txpool_sketch_cells
+    );
+
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(new_txes, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_txpool_sketch_failed(int command, NOTIFY_TXPOOL_SKETCH_FAILED::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TXPOOL_SKETCH_FAILED (" << arg.cells << " cells)");
+    if (context.m_txpool_sketch_cells == 0 || context.m_txpool_sketch_cells != arg.cells)
+    {
+      LOG_DEBUG_CC(context, "Unexpected NOTIFY_TXPOOL_SKETCH_FAILED, ignored");
+      return 1;
+    }
+
+    // doubling keeps the exchange O(difference), until the full hash list is smaller
+    if (!request_txpool_complement(context, arg.cells * 2))
+      MERROR(context << "Failed to request txpool complement");
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", " << arg.short_ids.size() / compact_short_id_size << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received new compact block while syncing, ignored");
+      return 1;
+    }
+
+    block b;
+    if (arg.short_ids.size() % compact_short_id_size != 0 || !parse_and_validate_block_from_blob(arg.block, b) || !b.tx_hashes.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent malformed NOTIFY_NEW_COMPACT_BLOCK, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    if (m_core.have_block(arg.block_hash))
+      return 1;
+
+    const size_t tx_count = arg.short_ids.size() / compact_short_id_size;
+    std::vector<uint64_t> need_tx_indices;
+
+    // only a block on top of ours is worth indexing the txpool for, others
+    // are fetched with their full hashes
+    uint64_t top_height;
+    crypto::hash top_id;
+    m_core.get_blockchain_top(top_height, top_id);
+    if (b.prev_id != top_id)
+    {
+      MDEBUG("Compact block " << arg.block_hash << " does not extend our top, requesting full hashes");
+    }
+    else
+    {
+      // hashing the header is cheap, indexing the txpool is not
+      if (!m_core.check_block_header_pow(b, arg.tx_tree_root, tx_count, arg.block_hash))
+      {
+        LOG_PRINT_CCONTEXT_L0("Compact block header verification failed, dropping connection");
+        drop_connection_with_score(context, P2P_IP_FAILS_BEFORE_BLOCK, false);
+        return 1;
+      }
+
+      boost::unique_lock<boost::mutex> lock(m_compact_block_index_lock);
+      if (m_compact_block_index_id != arg.block_hash || m_compact_block_index_salt != arg.salt)
+      {
+        m_core.get_pool_short_id_index(arg.salt, m_compact_block_index);
+        m_compact_block_index_id = arg.block_hash;
+        m_compact_block_index_salt = arg.salt;
+      }
+
+      b.tx_hashes.resize(tx_count);
+      for (size_t i = 0; i < tx_count; ++i)
+      {
+        uint64_t id = 0;
+        for (size_t j = 0; j < compact_short_id_size; ++j)
+          id |= uint64_t(uint8_t(arg.short_ids[i * compact_short_id_size + j])) << (8 * j);
+        const auto it = m_compact_block_index.find(id);
+        if (it == m_compact_block_index.end() || it->second == crypto::null_hash)
+          need_tx_indices.push_back(i);
+        else
+          b.tx_hashes[i] = it->second;
+      }
+    }
+
+    if (b.tx_hashes.size() == tx_count && need_tx_indices.empty())
+    {
+      b.invalidate_hashes();
+      if (get_block_hash(b) == arg.block_hash)
+      {
+        MDEBUG("All short ids of compact block " << arg.block_hash << " matched our txpool");
+        NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+        fluffy_arg.b.block = block_to_blob(b);
+        fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+        return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_arg, context);
+      }
+      // a short id matched a different pool tx: we can't tell which, so ask for the full hashes only
+      MDEBUG("Compact block " << arg.block_hash << " did not reconstruct, requesting full hashes");
+    }
+
+    // the reply is a regular fluffy block carrying the full tx hashes
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size());
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_tx_pool_hash(int command, NOTIFY_TX_POOL_HASH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_POOL_HASH (" << arg.txs.size() << " txes)");
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Too many tx hashes announced: " << arg.txs.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    // same reasoning as for NOTIFY_NEW_TRANSACTIONS: do not fetch txes while syncing
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received tx hashes while syncing, ignored");
+      return 1;
+    }
+
+    NOTIFY_REQUEST_TX_POOL_TXS::request request;
+    {
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      size_t &in_flight = m_requested_txs_per_peer[context.m_connection_id];
+      for (const crypto::hash &hash: arg.txs)
+      {
+        if (m_core.pool_has_tx(hash))
+          continue;
+
+        // already requested from another peer: give it a chance to answer,
+        // and remember this one to ask if it does not (see prune_requested_txs)
+        const auto requested = m_requested_txs.find(hash);
+        if (requested != m_requested_txs.end())
+        {
+          std::vector<boost::uuids::uuid> &announcers = requested->second.announcers;
+          if (requested->second.peer != context.m_connection_id && announcers.size() < TX_REQUEST_MAX_ANNOUNCERS &&
+              std::find(announcers.begin(), announcers.end(), context.m_connection_id) == announcers.end())
+            announcers.push_back(context.m_connection_id);
+          continue;
+        }
+
+        // bound what a peer can make us track, it will announce again if we ignored it
+        if (in_flight >= TX_REQUEST_MAX_PER_PEER || m_requested_txs.size() >= TX_REQUEST_MAX_IN_FLIGHT)
+          continue;
+
+        m_requested_txs.emplace(hash, requested_tx{now, context.m_connection_id, {}});
+        ++in_flight;
+        request.txs.push_back(hash);
+      }
+      if (in_flight == 0)
+        m_requested_txs_per_peer.erase(context.m_connection_id);
+    }
+
+    if (request.txs.empty())
+      return 1;
+
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_TX_POOL_TXS: txs.size()=" << request.txs.size());
+    post_notify<NOTIFY_REQUEST_TX_POOL_TXS>(request, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_pool_txs(int command, NOTIFY_REQUEST_TX_POOL_TXS::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_POOL_TXS (" << arg.txs.size() << " txes)");
+    if (context.m_state == cryptonote_connection_context::state_before_handshake)
+    {
+      LOG_ERROR_CCONTEXT("Requested pool txes before handshake, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Too many pool txes requested: " << arg.txs.size() << ", dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    /* Only txes that were already broadcast are served, so a stem tx still
+       under Dandelion++ embargo cannot be probed for by hash. A tx that was
+       mined or dropped in the meantime is silently skipped, the requester
+       finds mined ones in its chain and does not blame us for those. */
+    NOTIFY_NEW_TRANSACTIONS::request new_txes;
+    new_txes.dandelionpp_fluff = true;
+    new_txes.txs.reserve(arg.txs.size());
+    for (const crypto::hash &hash: arg.txs)
+    {
+      cryptonote::blobdata blob;
+      if (m_core.get_pool_transaction(hash, blob, relay_category::broadcasted))
+        new_txes.txs.push_back(std::move(blob));
+    }
+
+    if (new_txes.txs.empty())
+      return 1;
+
+    std::sort(new_txes.txs.begin(), new_txes.txs.end()); // don't leak receive order
+    new_txes.txs.erase(std::unique(new_txes.txs.begin(), new_txes.txs.end()), new_txes.txs.end());
+
+    MLOG_P2P_MESSAGE
+    (
+        "-->>NOTIFY_NEW_TRANSACTIONS: "
+        << ", txs.size()=" << new_txes.txs.size()
+    );
+
+    post_notify<NOTIFY_NEW_TRANSACTIONS>(new_txes, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
@@ -997,6 +1267,10 @@ namespace cryptonote
       seen.insert(blob);
     }
 
+    // our txpool sketch was reconciled, a NOTIFY_TXPOOL_SKETCH_FAILED for it is stale now
+    if (arg.txpool_sketch_cells && arg.txpool_sketch_cells == context.m_txpool_sketch_cells)
+      context.m_txpool_sketch_cells = 0;
+
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
@@ -1022,6 +1296,10 @@ namespace cryptonote
     relay_method tx_relay = zone == epee::net_utils::zone::public_ ?
       relay_method::stem : relay_method::forward;
 
+    // replies to NOTIFY_REQUEST_TX_POOL_TXS are fluffed
+    if (arg.dandelionpp_fluff)
+      on_requested_txs_received(arg.txs, context);
+
     std::vector<blobdata> stem_txs{};
     std::vector<blobdata> fluff_txs{};
     if (arg.dandelionpp_fluff)
@@ -1512,10 +1790,14 @@ namespace cryptonote
             {
               const uint64_t tnow = tools::get_tick_count();
               const uint64_t ns = tools::ticks_to_ns(tnow - m_last_add_end_time);
+              m_add_stage_stall_time += ns / 1000000;
               MINFO("Restarting adding block after idle for " << ns/1e9 << " seconds");
             }
           }
 
+          // the PoW stage may still be hashing this span
+          wait_pow_stage();
+
           std::vector<block> pblocks;
           if (!m_core.prepare_handle_incoming_blocks(blocks, pblocks))
           {
@@ -1530,6 +1812,10 @@ namespace cryptonote
             return 1;
           }
 
+          // hash the next span while this one gets verified and added
+          if (!pblocks.empty())
+            start_pow_stage(start_height + blocks.size(), pblocks);
+
           uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
           size_t num_txs = 0, blockidx = 0;
           for(const block_complete_entry& block_entry: blocks)
@@ -1754,10 +2040,126 @@ skip:
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
     m_standby_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::check_standby_peers, this));
     m_sync_search_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::update_sync_search, this));
+    m_requested_txs_pruner.do_call([this](){ return prune_requested_txs(boost::posix_time::microsec_clock::universal_time()); });
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::prune_requested_txs(const boost::posix_time::ptime &now)
+  {
+    std::unordered_set<boost::uuids::uuid, boost::hash<boost::uuids::uuid>> unanswered;
+    std::unordered_map<boost::uuids::uuid, NOTIFY_REQUEST_TX_POOL_TXS::request, boost::hash<boost::uuids::uuid>> requests;
+    {
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      for (auto it = m_requested_txs.begin(); it != m_requested_txs.end(); )
+      {
+        requested_tx &requested = it->second;
+        if ((now - requested.time).total_microseconds() < TX_REQUEST_TIMEOUT)
+        {
+          ++it;
+          continue;
+        }
+
+        // answered txes are removed when received, so this peer did not send it
+        release_requested_tx(requested.peer);
+        if (m_core.pool_has_tx(it->first)) // got it anyway, from another peer
+        {
+          it = m_requested_txs.erase(it);
+          continue;
+        }
+        // mined in the meantime: the peer had it in a block, not its pool, and
+        // skipped it (see handle_request_tx_pool_txs), which is no fault of its own
+        if (m_core.have_tx(it->first))
+        {
+          it = m_requested_txs.erase(it);
+          continue;
+        }
+        unanswered.insert(requested.peer);
+
+        // ask the next peer which announced it
+        bool asked = false;
+        while (!asked && !requested.announcers.empty())
+        {
+          const boost::uuids::uuid peer = requested.announcers.front();
+          requested.announcers.erase(requested.announcers.begin());
+          size_t &in_flight = m_requested_txs_per_peer[peer];
+          if (in_flight >= TX_REQUEST_MAX_PER_PEER)
+            continue;
+          ++in_flight;
+          requested.time = now;
+          requested.peer = peer;
+          requests[peer].txs.push_back(it->first);
+          asked = true;
+        }
+        if (asked)
+          ++it;
+        else
+          it = m_requested_txs.erase(it);
+      }
+    }
+
+    for (const boost::uuids::uuid &peer: unanswered)
+    {
+      m_p2p->for_connection(peer, [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+        LOG_DEBUG_CC(context, "Requested txes were not sent");
+        hit_score(context, 1);
+        return true;
+      });
+    }
+    for (auto &request: requests)
+    {
+      // a peer which went away in the meantime times out again, and the next one is asked
+      m_p2p->for_connection(request.first, [&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+        MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_TX_POOL_TXS: txs.size()=" << request.second.txs.size());
+        post_notify<NOTIFY_REQUEST_TX_POOL_TXS>(request.second, context);
+        return true;
+      });
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::on_requested_txs_received(const std::vector<blobdata> &txs, cryptonote_connection_context &context)
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      if (m_requested_txs_per_peer.find(context.m_connection_id) == m_requested_txs_per_peer.end())
+        return;
+    }
+
+    // hashed outside the lock, only for peers we asked something
+    std::vector<crypto::hash> hashes;
+    hashes.reserve(txs.size());
+    for (const auto &blob: txs)
+    {
+      cryptonote::transaction tx;
+      crypto::hash hash;
+      if (cryptonote::parse_and_validate_tx_from_blob(blob, tx, hash))
+        hashes.push_back(hash);
+    }
+
+    boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+    for (const crypto::hash &hash: hashes)
+    {
+      const auto requested = m_requested_txs.find(hash);
+      if (requested != m_requested_txs.end() && requested->second.peer == context.m_connection_id)
+      {
+        release_requested_tx(requested->second.peer);
+        m_requested_txs.erase(requested);
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::release_requested_tx(const boost::uuids::uuid &peer)
+  {
+    // m_requested_txs_lock must be held
+    const auto it = m_requested_txs_per_peer.find(peer);
+    if (it != m_requested_txs_per_peer.end() && --it->second == 0)
+      m_requested_txs_per_peer.erase(it);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::kick_idle_peers()
   {
     MTRACE("Checking for idle peers...");
@@ -2527,7 +2929,8 @@ skip:
           MDEBUG(context << "not ready, ignoring");
           return true;
         }
-        if (!request_txpool_complement(context))
+        const uint64_t sketch_cells = (support_flags & P2P_SUPPORT_FLAG_TXPOOL_SKETCH) ? CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS : 0;
+        if (!request_txpool_complement(context, sketch_cells))
         {
           MERROR(context << "Failed to request txpool complement");
           return true;
@@ -2724,14 +3127,57 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // short ids must be unique within the block, else the receiver could not
+    // tell its txes apart; after a few salts just send those peers a fluffy block
+    NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+    bool compact = false;
+    block b;
+    if (m_core.fluffy_blocks_enabled() && parse_and_validate_block_from_blob(arg.b.block, b, compact_arg.block_hash))
+    {
+      compact_arg.tx_tree_root = get_tx_tree_hash(b);
+      std::vector<crypto::hash> tx_hashes;
+      tx_hashes.swap(b.tx_hashes);
+      compact_arg.block = block_to_blob(b);
+      compact_arg.current_blockchain_height = arg.current_blockchain_height;
+
+      std::unordered_set<uint64_t> seen;
+      seen.reserve(tx_hashes.size());
+      for (size_t tries = 0; !compact && tries < CURRENCY_PROTOCOL_COMPACT_BLOCK_SALT_TRIES; ++tries)
+      {
+        compact_arg.salt = get_compact_block_salt(compact_arg.block_hash, tries);
+        compact_arg.short_ids.clear();
+        compact_arg.short_ids.reserve(tx_hashes.size() * compact_short_id_size);
+        seen.clear();
+        compact = true;
+        for (const crypto::hash &tx_hash: tx_hashes)
+        {
+          const uint64_t id = get_compact_short_id(tx_hash, compact_arg.salt);
+          if (!seen.insert(id).second)
+          {
+            compact = false;
+            break;
+          }
+          for (size_t j = 0; j < compact_short_id_size; ++j)
+            compact_arg.short_ids.push_back(char(id >> (8 * j)));
+        }
+      }
+      if (!compact)
+        MDEBUG("Short id collision in block " << compact_arg.block_hash << ", relaying it as fluffy block");
+    }
+
+    // sort peers between compact, fluffy and others
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, compact, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       // peer_id also filters out connections before handshake
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(compact && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT IDS");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
@@ -2745,17 +3191,23 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact and fluffy ones first, we want to encourage people to run that
+    if (!compactConnections.empty())
+    {
+      epee::levin::message_writer compactBlob{8 * 1024};
+      epee::serialization::store_t_to_binary_direct(compact_arg, compactBlob.buffer);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, std::move(compactBlob), std::move(compactConnections));
+    }
     if (!fluffyConnections.empty())
     {
       epee::levin::message_writer fluffyBlob{32 * 1024};
-      epee::serialization::store_t_to_binary(fluffy_arg, fluffyBlob.buffer);
+      epee::serialization::store_t_to_binary_direct(fluffy_arg, fluffyBlob.buffer);
       m_p2p->relay_notify_to_list(NOTIFY_NEW_FLUFFY_BLOCK::ID, std::move(fluffyBlob), std::move(fluffyConnections));
     }
     if (!fullConnections.empty())
     {
       epee::levin::message_writer fullBlob{128 * 1024};
-      epee::serialization::store_t_to_binary(arg, fullBlob.buffer);
+      epee::serialization::store_t_to_binary_direct(arg, fullBlob.buffer);
       m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, std::move(fullBlob), std::move(fullConnections));
     }
 
@@ -2774,7 +3226,7 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
-  bool t_cryptonote_protocol_handler<t_core>::request_txpool_complement(cryptonote_connection_context &context)
+  bool t_cryptonote_protocol_handler<t_core>::request_txpool_complement(cryptonote_connection_context &context, uint64_t sketch_cells)
   {
     NOTIFY_GET_TXPOOL_COMPLEMENT::request r = {};
     if (!m_core.get_pool_transaction_hashes(r.hashes, false))
@@ -2782,6 +3234,24 @@ skip:
       MERROR("Failed to get txpool hashes");
       return false;
     }
+
+    // a sketch only pays off while it is smaller than the hash list it stands for
+    context.m_txpool_sketch_cells = 0;
+    if (sketch_cells && sketch_cells * txpool_sketch::cell_blob_size < r.hashes.size() * sizeof(crypto::hash))
+    {
+      NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::request sr = {};
+      sr.salt = crypto::rand<uint64_t>();
+      txpool_sketch sketch{sketch_cells, sr.salt};
+      for (const crypto::hash &hash: r.hashes)
+        sketch.insert(hash);
+      sr.sketch = sketch.to_blob();
+      context.m_txpool_sketch_cells = sketch.cells();
+
+      MLOG_P2P_MESSAGE("-->>NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT: cells=" << sketch.cells() << ", hashes.size()=" << r.hashes.size());
+      post_notify<NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT>(sr, context);
+      MLOG_PEER_STATE("requesting txpool complement by sketch");
+      return true;
+    }
     MLOG_P2P_MESSAGE("-->>NOTIFY_GET_TXPOOL_COMPLEMENT: hashes.size()=" << r.hashes.size() );
     post_notify<NOTIFY_GET_TXPOOL_COMPLEMENT>(r, context);
     MLOG_PEER_STATE("requesting txpool complement");
@@ -2885,6 +3355,51 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  sync_pipeline_stats t_cryptonote_protocol_handler<t_core>::get_sync_pipeline_stats() const
+  {
+    sync_pipeline_stats stats;
+    stats.pow_queue_blocks = m_pow_stage_blocks;
+    stats.pow_stall_time = m_pow_stage_stall_time;
+    stats.add_queue_spans = m_block_queue.get_num_filled_spans_prefix();
+    stats.add_stall_time = m_add_stage_stall_time;
+    return stats;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::start_pow_stage(uint64_t height, const std::vector<block> &parents)
+  {
+    // only one span is hashed ahead, so this stage's queue is bounded to a span
+    auto blocks = std::make_shared<std::vector<block_complete_entry>>();
+    if (!m_block_queue.get_span(height, *blocks))
+      return;
+    std::vector<crypto::hash> parent_hashes;
+    parent_hashes.reserve(parents.size());
+    for (const block &b: parents)
+      parent_hashes.push_back(get_block_hash(b));
+    m_pow_stage_blocks = blocks->size();
+    MDEBUG("Hashing blocks " << height << "-" << (height + blocks->size() - 1) << " ahead");
+    tools::threadpool::getInstanceForCompute().submit(&m_pow_stage_waiter, [this, height, blocks, parent_hashes]() {
+      try
+      {
+        m_core.prehash_incoming_blocks(height, *blocks, parent_hashes);
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to hash blocks ahead: " << e.what());
+      }
+    });
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::wait_pow_stage()
+  {
+    const uint64_t start = tools::get_tick_count();
+    m_pow_stage_waiter.wait();
+    m_pow_stage_stall_time += tools::ticks_to_ns(tools::get_tick_count() - start) / 1000000;
+    m_pow_stage_blocks = 0;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   void t_cryptonote_protocol_handler<t_core>::drop_connection_with_score(cryptonote_connection_context &context, unsigned score, bool flush_all_spans)
   {
     LOG_DEBUG_CC(context, "dropping connection id " << context.m_connection_id << " (pruning seed " <<
@@ -2950,6 +3465,12 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+
+    {
+      // its requests time out, and are then sent to other peers which announced the same txes
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      m_requested_txs_per_peer.erase(context.m_connection_id);
+    }
     MLOG_PEER_STATE("closed");
   }
 
@@ -43,6 +43,7 @@
 #include "crypto/crypto.h"
 #include "crypto/duration.h"
 #include "cryptonote_basic/connection_context.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/i_core_events.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "net/dandelionpp.h"
@@ -182,7 +183,7 @@ namespace levin
         request._ = std::string(padding, ' ');
 
         epee::byte_slice arg_buff;
-        epee::serialization::store_t_to_binary(request, arg_buff);
+        epee::serialization::store_t_to_binary_direct(request, arg_buff);
 
         // we probably lowballed the payload size a bit, so added a but too much. Fix this now.
         size_t remove = arg_buff.size() % granularity;
@@ -194,7 +195,7 @@ namespace levin
       }
 
       epee::levin::message_writer out;
-      if (!epee::serialization::store_t_to_binary(request, out.buffer))
+      if (!epee::serialization::store_t_to_binary_direct(request, out.buffer))
         throw std::runtime_error{"Failed to serialize to epee binary format"};
 
       return out;
@@ -206,6 +207,46 @@ namespace levin
       return p2p.send(std::move(blob), destination);
     }
 
+    //! Sends `hashes` in as many messages as needed to stay within the receiver's limit.
+    bool make_payload_send_tx_hashes(connections& p2p, const std::vector<crypto::hash>& hashes, const boost::uuids::uuid& destination)
+    {
+      for (std::size_t start = 0; start < hashes.size(); start += CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT)
+      {
+        const std::size_t count = std::min<std::size_t>(hashes.size() - start, CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT);
+        NOTIFY_TX_POOL_HASH::request request{};
+        request.txs.assign(hashes.begin() + start, hashes.begin() + start + count);
+
+        epee::levin::message_writer out;
+        if (!epee::serialization::store_t_to_binary_direct(request, out.buffer))
+          throw std::runtime_error{"Failed to serialize to epee binary format"};
+
+        if (!p2p.send(out.finalize_notify(NOTIFY_TX_POOL_HASH::ID), destination))
+          return false;
+      }
+      return true;
+    }
+
+    //! \return True if `destination` negotiated hash announcements for fluffed txs.
+    bool supports_tx_relay_v2(connections& p2p, const boost::uuids::uuid& destination)
+    {
+      bool supported = false;
+      p2p.for_connection(destination, [&supported] (detail::p2p_context& context) {
+        supported = (context.support_flags & P2P_SUPPORT_FLAG_TX_RELAY_V2);
+        return true;
+      });
+      return supported;
+    }
+
+    //! \return Hash of tx `blob`, or `crypto::null_hash` if it cannot be parsed.
+    crypto::hash get_relay_tx_hash(const blobdata& blob)
+    {
+      transaction tx;
+      crypto::hash hash = crypto::null_hash;
+      if (!parse_and_validate_tx_from_blob(blob, tx, hash))
+        return crypto::null_hash;
+      return hash;
+    }
+
     /* The current design uses `asio::strand`s. The documentation isn't as clear
        as it should be - a `strand` has an internal `mutex` and `bool`. The
        `mutex` synchronizes thread access and the `bool` is set when a thread is
@@ -288,7 +329,8 @@ namespace levin
       boost::asio::steady_timer flush_txs;
       boost::asio::io_service::strand strand;
       struct context_t {
-        std::vector<cryptonote::blobdata> fluff_txs;
+        //! Queued tx blobs, paired with their hash when they may be announced
+        std::vector<std::pair<cryptonote::blobdata, crypto::hash>> fluff_txs;
         std::chrono::steady_clock::time_point flush_time;
         bool m_is_income;
       };
@@ -368,7 +410,7 @@ namespace levin
 
         const auto now = std::chrono::steady_clock::now();
         auto next_flush = std::chrono::steady_clock::time_point::max();
-        std::vector<std::pair<std::vector<blobdata>, boost::uuids::uuid>> connections{};
+        std::vector<std::pair<std::vector<std::pair<blobdata, crypto::hash>>, boost::uuids::uuid>> connections{};
         for (auto &e: zone_->contexts)
         {
           auto &id = e.first;
@@ -395,10 +437,32 @@ namespace levin
 	   (with/without "noise"?). */
         for (auto& connection : connections)
         {
-          std::sort(connection.first.begin(), connection.first.end()); // don't leak receive order
+          // don't leak receive order
+          std::sort(connection.first.begin(), connection.first.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first;
+          });
           connection.first.erase(std::unique(connection.first.begin(), connection.first.end()),
                                   connection.first.end());
-          make_payload_send_txs(*zone_->p2p, std::move(connection.first), connection.second, zone_->pad_txs, true);
+
+          /* Peers that negotiated `P2P_SUPPORT_FLAG_TX_RELAY_V2` receive only
+             the hashes, and request the txs they do not have. Hashes are only
+             computed for public zones without padding (see `fluff_notify`),
+             anything else is pushed in full as before. */
+          std::vector<crypto::hash> hashes{};
+          std::vector<blobdata> txs{};
+          const bool announce = supports_tx_relay_v2(*zone_->p2p, connection.second);
+          for (auto& tx : connection.first)
+          {
+            if (announce && tx.second != crypto::null_hash)
+              hashes.push_back(tx.second);
+            else
+              txs.push_back(std::move(tx.first));
+          }
+
+          if (!hashes.empty())
+            make_payload_send_tx_hashes(*zone_->p2p, hashes, connection.second);
+          if (!txs.empty())
+            make_payload_send_txs(*zone_->p2p, std::move(txs), connection.second, zone_->pad_txs, true);
         }
 
         if (next_flush != std::chrono::steady_clock::time_point::max())
@@ -434,6 +498,12 @@ namespace levin
         crypto::random_poisson_subseconds in_duration(fluff_average_in);
         crypto::random_poisson_subseconds out_duration(fluff_average_out);
 
+        // hash once per batch instead of once per connection
+        std::vector<std::pair<blobdata, crypto::hash>> queued{};
+        queued.reserve(txs.size());
+        const bool announce = zone->nzone == epee::net_utils::zone::public_ && !zone->pad_txs;
+        for (const blobdata& tx : txs)
+          queued.emplace_back(tx, announce ? get_relay_tx_hash(tx) : crypto::null_hash);
 
         MDEBUG("Queueing " << txs.size() << " transaction(s) for Dandelion++ fluffing");
         for (auto &e: zone->contexts)
@@ -447,8 +517,8 @@ namespace levin
               context.flush_time = now + (context.m_is_income ? in_duration() : out_duration());
 
             next_flush = std::min(next_flush, context.flush_time);
-            context.fluff_txs.reserve(context.fluff_txs.size() + txs.size());
-            context.fluff_txs.insert(context.fluff_txs.end(), txs.begin(), txs.end());
+            context.fluff_txs.reserve(context.fluff_txs.size() + queued.size());
+            context.fluff_txs.insert(context.fluff_txs.end(), queued.begin(), queued.end());
           }
         }
 
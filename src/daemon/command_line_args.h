@@ -137,6 +137,12 @@ namespace daemon_args
   , "Disable ZMQ RPC server"
   };
 
+  const command_line::arg_descriptor<std::string> arg_rpc_replica_notify = {
+    "rpc-replica-notify"
+  , "With --rpc-replica, the --zmq-pub address of the primary daemon, to pick up new blocks and txes as they arrive instead of by polling"
+  , ""
+  };
+
 }  // namespace daemon_args
 
 #endif // DAEMON_COMMAND_LINE_ARGS_H
@@ -43,6 +43,7 @@
 #include "daemon/core.h"
 #include "daemon/p2p.h"
 #include "daemon/protocol.h"
+#include "daemon/replica.h"
 #include "daemon/rpc.h"
 #include "daemon/command_server.h"
 #include "daemon/command_line_args.h"
@@ -77,13 +78,14 @@ public:
   t_p2p p2p;
   std::vector<std::unique_ptr<t_rpc>> rpcs;
   std::unique_ptr<zmq_internals> zmq;
+  std::unique_ptr<t_replica> replica;
 
   t_internals(
       boost::program_options::variables_map const & vm
     )
     : core{vm}
-    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline)}
-    , p2p{vm, protocol}
+    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline) || command_line::get_arg(vm, cryptonote::arg_rpc_replica)}
+    , p2p{vm, protocol, command_line::get_arg(vm, cryptonote::arg_rpc_replica)}
     , zmq{nullptr}
   {
     // Handle circular dependencies
@@ -102,7 +104,13 @@ public:
       rpcs.emplace_back(new t_rpc{vm, core, p2p, true, restricted_rpc_port, "restricted", true});
     }
 
-    if (!command_line::get_arg(vm, daemon_args::arg_zmq_rpc_disabled))
+    if (command_line::get_arg(vm, cryptonote::arg_rpc_replica))
+    {
+      replica.reset(new t_replica{core, command_line::get_arg(vm, daemon_args::arg_rpc_replica_notify)});
+      if (!command_line::get_arg(vm, daemon_args::arg_zmq_rpc_disabled))
+        MWARNING("ZMQ RPC server and --zmq-pub are not available with --rpc-replica");
+    }
+    else if (!command_line::get_arg(vm, daemon_args::arg_zmq_rpc_disabled))
     {
       zmq.reset(new zmq_internals{core, p2p});
 
@@ -234,7 +242,10 @@ bool t_daemon::run(bool interactive)
       mp_internals->p2p.get().set_rpc_port(public_rpc_port);
     }
     
-    mp_internals->p2p.run(); // blocks until p2p goes down
+    if (mp_internals->replica)
+      mp_internals->replica->run(); // blocks until stopped
+    else
+      mp_internals->p2p.run(); // blocks until p2p goes down
 
     if (rpc_commands)
       rpc_commands->stop_handling();
@@ -265,7 +276,10 @@ void t_daemon::stop()
   {
     throw std::runtime_error{"Can't stop stopped daemon"};
   }
-  mp_internals->p2p.stop();
+  if (mp_internals->replica)
+    mp_internals->replica->stop();
+  else
+    mp_internals->p2p.stop();
   for(auto& rpc : mp_internals->rpcs)
     rpc->stop();
 
@@ -278,7 +292,10 @@ void t_daemon::stop_p2p()
   {
     throw std::runtime_error{"Can't send stop signal to a stopped daemon"};
   }
-  mp_internals->p2p.get().send_stop_signal();
+  if (mp_internals->replica)
+    mp_internals->replica->stop();
+  else
+    mp_internals->p2p.get().send_stop_signal();
 }
 
 } // namespace daemonize
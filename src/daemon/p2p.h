@@ -53,13 +53,20 @@ public:
   }
 private:
   t_node_server m_server;
+  bool m_replica;
 public:
   t_p2p(
       boost::program_options::variables_map const & vm
     , t_protocol & protocol
+    , bool replica = false
     )
     : m_server{protocol.get()}
+    , m_replica{replica}
   {
+    // a replica shares the primary's data dir, and must not touch its p2p state
+    if (m_replica)
+      return;
+
     //initialize objects
     MGINFO("Initializing p2p server...");
     if (!m_server.init(vm, command_line::get_arg(vm, daemon_args::arg_proxy), command_line::get_arg(vm, daemon_args::arg_proxy_allow_dns_leaks)))
@@ -88,6 +95,8 @@ public:
 
   ~t_p2p()
   {
+    if (m_replica)
+      return;
     MGINFO("Deinitializing p2p...");
     try {
       m_server.deinit();
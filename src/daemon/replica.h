@@ -0,0 +1,143 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <zmq.h>
+#include "misc_log_ex.h"
+#include "net/zmq.h"
+#include "daemon/core.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "daemon"
+
+namespace daemonize
+{
+
+/*! Keeps a --rpc-replica core in step with the primary daemon that owns its
+    database. Takes the place of the p2p loop: blocks in `run()` until
+    `stop()` is called. */
+class t_replica final
+{
+private:
+  static constexpr const char chain_topic[] = "json-minimal-chain_main";
+  static constexpr const char txpool_topic[] = "json-minimal-txpool_add";
+  static constexpr std::chrono::seconds poll_interval{30};
+  static constexpr int wait_ms = 1000;
+
+  t_core & m_core;
+  const std::string m_notify;
+  std::atomic<bool> m_stop;
+
+  net::zmq::socket subscribe(void *context)
+  {
+    net::zmq::socket out{zmq_socket(context, ZMQ_SUB)};
+    if (!out)
+    {
+      MONERO_LOG_ZMQ_ERROR("Failed to create ZMQ socket for replica notifications");
+      return nullptr;
+    }
+    if (zmq_setsockopt(out.get(), ZMQ_SUBSCRIBE, chain_topic, sizeof(chain_topic) - 1) != 0 ||
+        zmq_setsockopt(out.get(), ZMQ_SUBSCRIBE, txpool_topic, sizeof(txpool_topic) - 1) != 0)
+    {
+      MONERO_LOG_ZMQ_ERROR("Failed to subscribe to replica notifications");
+      return nullptr;
+    }
+    if (zmq_connect(out.get(), m_notify.c_str()) != 0)
+    {
+      MONERO_LOG_ZMQ_ERROR("Failed to connect to " << m_notify);
+      return nullptr;
+    }
+    return out;
+  }
+
+public:
+  t_replica(t_core & core, std::string notify)
+    : m_core{core}, m_notify{std::move(notify)}, m_stop{false}
+  {}
+
+  void run()
+  {
+    net::zmq::context context{};
+    net::zmq::socket sub{};
+    if (!m_notify.empty())
+    {
+      context.reset(zmq_init(1));
+      if (context)
+        sub = subscribe(context.get());
+      if (!sub)
+        MWARNING("Replica notifications unavailable, polling the database instead");
+    }
+
+    MGINFO("Serving RPC from a replica of the database" << (sub ? ", notified by " + m_notify : std::string{}));
+    auto last_pool_refresh = std::chrono::steady_clock::now();
+    while (!m_stop)
+    {
+      bool pool_changed = false;
+      if (sub)
+      {
+        zmq_pollitem_t item{sub.get(), 0, ZMQ_POLLIN, 0};
+        if (zmq_poll(&item, 1, wait_ms) > 0)
+        {
+          // drain everything queued, one refresh covers all of it
+          for (expect<std::string> msg = net::zmq::receive(sub.get(), ZMQ_DONTWAIT); msg; msg = net::zmq::receive(sub.get(), ZMQ_DONTWAIT))
+          {
+            if (msg->compare(0, sizeof(txpool_topic) - 1, txpool_topic) == 0)
+              pool_changed = true;
+          }
+        }
+      }
+      else
+        epee::misc_utils::sleep_no_w(wait_ms);
+
+      const auto now = std::chrono::steady_clock::now();
+      if (now - last_pool_refresh >= poll_interval)
+        pool_changed = true;
+      try
+      {
+        if (m_core.get().refresh_replica(pool_changed) || pool_changed)
+          last_pool_refresh = now;
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to refresh replica: " << e.what());
+      }
+    }
+    MGINFO("Replica loop stopped");
+  }
+
+  void stop()
+  {
+    m_stop = true;
+  }
+};
+
+}
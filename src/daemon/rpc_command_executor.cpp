@@ -2300,6 +2300,8 @@ bool t_rpc_command_executor::sync_info()
       total_size += s.size;
     tools::success_msg_writer() << std::to_string(res.spans.size()) << " spans, " << total_size/1e6 << " MB";
     tools::success_msg_writer() << res.overview;
+    for (const auto &stage: res.pipeline)
+      tools::success_msg_writer() << "Stage " << stage.name << ": " << stage.queue_depth << " queued, stalled " << stage.stall_time/1e3 << " sec";
     for (const auto &s: res.spans)
     {
       std::string address = epee::string_tools::pad_string(s.remote_address, 24);
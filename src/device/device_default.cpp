@@ -240,6 +240,10 @@ namespace hw {
             return crypto::wallet::generate_key_derivation(key1, key2, derivation);
         }
 
+        bool device_default::generate_key_derivations(const std::vector<crypto::public_key> &pubs, const crypto::secret_key &sec, std::vector<crypto::key_derivation> &derivations, std::vector<bool> &valid) {
+            return crypto::wallet::generate_key_derivations(pubs, sec, derivations, valid);
+        }
+
         bool device_default::derivation_to_scalar(const crypto::key_derivation &derivation, const size_t output_index, crypto::ec_scalar &res){
             crypto::derivation_to_scalar(derivation,output_index, res);
             return true;
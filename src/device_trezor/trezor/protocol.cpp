@@ -150,7 +150,7 @@ namespace ki {
   {
     for(auto & td : transfers){
       ::crypto::public_key tx_pub_key = wallet->get_tx_pub_key_from_received_outs(td);
-      const std::vector<::crypto::public_key> additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(td.m_tx);
+      const std::vector<::crypto::public_key> &additional_tx_pub_keys = td.m_additional_tx_pub_keys;
 
       res.emplace_back();
       auto & cres = res.back();
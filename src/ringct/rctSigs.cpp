@@ -1518,48 +1518,69 @@ namespace rct {
 
     //ver RingCT simple
     //assumes only post-rct style inputs (at least for max anonymity)
-    bool verRctNonSemanticsSimple(const rctSig & rv) {
+    //all inputs of all the given rctSigs are verified as one set of jobs on the compute
+    //threadpool, so a block's worth of ring signatures does not wait on a per-tx barrier
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv) {
       try
       {
         PERF_TIMER(verRctNonSemanticsSimple);
 
-        CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
-            false, "verRctNonSemanticsSimple called on non simple rctSig");
-        const bool bulletproof = is_rct_bulletproof(rv.type);
-        const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
-        // semantics check is early, and mixRing/MGs aren't resolved yet
-        if (bulletproof || bulletproof_plus)
-          CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
-        else
-          CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-        const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
+        std::vector<size_t> offsets(rvv.size());
+        size_t n_inputs = 0;
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          CHECK_AND_ASSERT_MES(rvv[n], false, "rctSig pointer is NULL");
+          const rctSig &rv = *rvv[n];
+          CHECK_AND_ASSERT_MES(rv.type == RCTTypeSimple || rv.type == RCTTypeBulletproof || rv.type == RCTTypeBulletproof2 || rv.type == RCTTypeCLSAG || rv.type == RCTTypeBulletproofPlus,
+              false, "verRctNonSemanticsSimple called on non simple rctSig");
+          const bool bulletproof = is_rct_bulletproof(rv.type);
+          const bool bulletproof_plus = is_rct_bulletproof_plus(rv.type);
+          // semantics check is early, and mixRing/MGs aren't resolved yet
+          if (bulletproof || bulletproof_plus)
+            CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
+          if (is_rct_clsag(rv.type))
+            CHECK_AND_ASSERT_MES(rv.p.CLSAGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.CLSAGs and mixRing");
+          else
+            CHECK_AND_ASSERT_MES(rv.p.MGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.MGs and mixRing");
+          offsets[n] = n_inputs;
+          n_inputs += rv.mixRing.size();
+        }
 
-        std::deque<bool> results(threads);
         tools::threadpool& tpool = tools::threadpool::getInstanceForCompute();
         tools::threadpool::waiter waiter(tpool);
 
-        const keyV &pseudoOuts = bulletproof || bulletproof_plus ? rv.p.pseudoOuts : rv.pseudoOuts;
-
-        const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
+        // the message hashes the whole rctSig, do them in parallel too
+        keyV messages(rvv.size());
+        for (size_t n = 0; n < rvv.size(); ++n)
+          tpool.submit(&waiter, [&, n] { messages[n] = get_pre_mlsag_hash(*rvv[n], hw::get_device("default")); });
+        if (!waiter.wait())
+          return false;
 
-        results.clear();
-        results.resize(rv.mixRing.size());
-        for (size_t i = 0 ; i < rv.mixRing.size() ; i++) {
-          tpool.submit(&waiter, [&, i] {
-              if (is_rct_clsag(rv.type))
-                  results[i] = verRctCLSAGSimple(message, rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
-              else
-                  results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
-          });
+        std::deque<bool> results(n_inputs);
+        for (size_t n = 0; n < rvv.size(); ++n)
+        {
+          const rctSig &rv = *rvv[n];
+          const keyV &pseudoOuts = is_rct_bulletproof(rv.type) || is_rct_bulletproof_plus(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+          for (size_t i = 0; i < rv.mixRing.size(); i++) {
+            tpool.submit(&waiter, [&, n, i] {
+                if (is_rct_clsag(rv.type))
+                    results[offsets[n] + i] = verRctCLSAGSimple(messages[n], rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
+                else
+                    results[offsets[n] + i] = verRctMGSimple(messages[n], rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+            });
+          }
         }
         if (!waiter.wait())
           return false;
 
-        for (size_t i = 0; i < results.size(); ++i) {
-          if (!results[i]) {
-            LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for input " << i);
-            return false;
+        for (size_t n = 0; n < rvv.size(); ++n) {
+          for (size_t i = 0; i < rvv[n]->mixRing.size(); ++i) {
+            if (!results[offsets[n] + i]) {
+              LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for rctSig " << n << ", input " << i);
+              return false;
+            }
           }
         }
 
@@ -1578,6 +1599,11 @@ namespace rct {
       }
     }
 
+    bool verRctNonSemanticsSimple(const rctSig & rv)
+    {
+      return verRctNonSemanticsSimple(std::vector<const rctSig*>(1, &rv));
+    }
+
     //RingCT protocol
     //genRct: 
     //   creates an rctSig with all data necessary to verify the rangeProofs and that the signer owns one of the
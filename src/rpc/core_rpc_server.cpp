@@ -41,6 +41,7 @@ using namespace epee;
 #include "common/download.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "int-util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
@@ -76,8 +77,11 @@ using namespace epee;
 #define RESTRICTED_SPENT_KEY_IMAGES_COUNT 5000
 #define RESTRICTED_BLOCK_COUNT 1000
 
+#define GET_BLOCKS_SPAN_CACHE_MAX_SIZE (64 * 1024 * 1024) // bytes of block and tx blobs
+
 #define RPC_TRACKER(rpc) \
-  PERF_TIMER(rpc); \
+  static epee::metrics::histogram &pt_histogram_##rpc = epee::metrics::get_histogram("monero_rpc_handler_seconds", "Time spent in RPC handlers", "method=\"" #rpc "\""); \
+  tools::LoggingPerformanceTimer PERF_TIMER_NAME(rpc)(#rpc, "perf." MONERO_DEFAULT_LOG_CATEGORY, 1000000, tools::performance_timer_log_level, &pt_histogram_##rpc); \
   RPCTracker tracker(#rpc, PERF_TIMER_NAME(rpc))
 
 namespace
@@ -172,8 +176,11 @@ namespace cryptonote
     : m_core(cr)
     , m_p2p(p2p)
     , m_was_bootstrap_ever_used(false)
+    , m_replica(false)
     , disable_rpc_ban(false)
     , m_rpc_payment_allow_free_loopback(false)
+    , m_blocks_span_cache_top(crypto::null_hash)
+    , m_blocks_span_cache_size(0)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::set_bootstrap_daemon(
@@ -270,6 +277,7 @@ namespace cryptonote
   {
     m_bootstrap_daemon_proxy = proxy;
     m_restricted = restricted;
+    m_replica = m_core.is_replica();
     m_net_server.set_threads_prefix("RPC");
     m_net_server.set_connection_filter(&m_p2p);
 
@@ -522,10 +530,10 @@ namespace cryptonote
 
     const bool restricted = m_restricted && ctx;
 
-    crypto::hash top_hash;
-    m_core.get_blockchain_top(res.height, top_hash);
-    ++res.height; // turn top block height into blockchain height
-    res.top_block_hash = string_tools::pod_to_hex(top_hash);
+    // consistent, and doesn't wait for a block being added
+    const std::shared_ptr<const Blockchain::chain_tip_state> tip = m_core.get_blockchain_storage().get_chain_tip_state();
+    res.height = tip->height;
+    res.top_block_hash = string_tools::pod_to_hex(tip->top_hash);
     res.target_height = m_p2p.get_payload_object().is_synchronized() ? 0 : m_core.get_target_blockchain_height();
     store_difficulty(m_core.get_blockchain_storage().get_difficulty_for_next_block(), res.difficulty, res.wide_difficulty, res.difficulty_top64);
     res.target = m_core.get_blockchain_storage().get_difficulty_target();
@@ -544,10 +552,9 @@ namespace cryptonote
     res.testnet = net_type == TESTNET;
     res.stagenet = net_type == STAGENET;
     res.nettype = net_type == MAINNET ? "mainnet" : net_type == TESTNET ? "testnet" : net_type == STAGENET ? "stagenet" : "fakechain";
-    store_difficulty(m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(res.height - 1),
-        res.cumulative_difficulty, res.wide_cumulative_difficulty, res.cumulative_difficulty_top64);
-    res.block_size_limit = res.block_weight_limit = m_core.get_blockchain_storage().get_current_cumulative_block_weight_limit();
-    res.block_size_median = res.block_weight_median = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
+    store_difficulty(tip->cumulative_difficulty, res.cumulative_difficulty, res.wide_cumulative_difficulty, res.cumulative_difficulty_top64);
+    res.block_size_limit = res.block_weight_limit = tip->block_weight_limit;
+    res.block_size_median = res.block_weight_median = tip->block_weight_median;
     res.adjusted_time = m_core.get_blockchain_storage().get_adjusted_time(res.height);
 
     res.start_time = restricted ? 0 : (uint64_t)m_core.get_start_time();
@@ -598,6 +605,24 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics(std::string& body, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_metrics);
+    // gauges which are cheaper to read at scrape time than to keep up to date
+    static epee::metrics::gauge &height = epee::metrics::get_gauge("monero_blockchain_height", "Current blockchain height");
+    static epee::metrics::gauge &pool_txes = epee::metrics::get_gauge("monero_txpool_transactions", "Number of transactions in the pool");
+    static epee::metrics::gauge &pool_weight = epee::metrics::get_gauge("monero_txpool_weight_bytes", "Total weight of transactions in the pool");
+    static epee::metrics::gauge &compute_queue = epee::metrics::get_gauge("monero_threadpool_queue_depth", "Jobs waiting for a thread pool worker", "pool=\"compute\"");
+    static epee::metrics::gauge &io_queue = epee::metrics::get_gauge("monero_threadpool_queue_depth", "Jobs waiting for a thread pool worker", "pool=\"io\"");
+    height.set(m_core.get_current_blockchain_height());
+    pool_txes.set(m_core.get_pool_transactions_count(true));
+    pool_weight.set(m_core.get_pool_transactions_weight());
+    compute_queue.set(tools::threadpool::getInstanceForCompute().get_queue_depth());
+    io_queue.set(tools::threadpool::getInstanceForIO().get_queue_depth());
+    body = epee::metrics::dump();
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   class pruned_transaction {
     transaction& tx;
   public:
@@ -608,6 +633,103 @@ namespace cryptonote
     END_SERIALIZE()
   };
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_blocks_span(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, size_t max_blocks, std::shared_ptr<const blocks_span> &span, bool &host_fail)
+  {
+    // Wallets refreshing all ask for the same few spans near the top, so these are
+    // kept, already read from the db and with their output indices, until the top
+    // changes (which also takes care of reorgs)
+    uint64_t start_height = req.start_height;
+    if (start_height == 0 && !m_core.get_blockchain_storage().find_blockchain_supplement(req.block_ids, start_height))
+    {
+      host_fail = true;
+      return false;
+    }
+    const blocks_span_key key(start_height, req.prune, req.no_miner_tx, max_blocks);
+
+    uint64_t top_height;
+    crypto::hash top_hash;
+    m_core.get_blockchain_top(top_height, top_hash);
+    {
+      boost::unique_lock<boost::mutex> lock(m_blocks_span_cache_lock);
+      if (m_blocks_span_cache_top != top_hash)
+      {
+        m_blocks_span_cache.clear();
+        m_blocks_span_cache_order.clear();
+        m_blocks_span_cache_size = 0;
+        m_blocks_span_cache_top = top_hash;
+      }
+      const auto it = m_blocks_span_cache.find(key);
+      if (it != m_blocks_span_cache.end())
+      {
+        span = it->second;
+        return true;
+      }
+    }
+
+    std::shared_ptr<blocks_span> new_span = std::make_shared<blocks_span>();
+    new_span->size = 0;
+    new_span->ntxes = 0;
+    std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
+    if(!m_core.find_blockchain_supplement(start_height, start_height ? std::list<crypto::hash>() : req.block_ids, bs, new_span->current_height, new_span->top_block_hash, new_span->start_height, req.prune, !req.no_miner_tx, max_blocks, COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
+    {
+      host_fail = true;
+      return false;
+    }
+
+    new_span->blocks.reserve(bs.size());
+    new_span->output_indices.reserve(bs.size());
+    for(auto& bd: bs)
+    {
+      new_span->blocks.resize(new_span->blocks.size()+1);
+      new_span->blocks.back().pruned = req.prune;
+      new_span->blocks.back().block = std::move(bd.first.first);
+      new_span->size += new_span->blocks.back().block.size();
+      new_span->output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
+      new_span->ntxes += bd.second.size();
+      new_span->output_indices.back().indices.reserve(1 + bd.second.size());
+      if (req.no_miner_tx)
+        new_span->output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
+      new_span->blocks.back().txs.reserve(bd.second.size());
+      for (std::vector<std::pair<crypto::hash, cryptonote::blobdata>>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
+      {
+        new_span->blocks.back().txs.push_back({std::move(i->second), crypto::null_hash});
+        i->second.clear();
+        i->second.shrink_to_fit();
+        new_span->size += new_span->blocks.back().txs.back().blob.size();
+      }
+
+      const size_t n_txes_to_lookup = bd.second.size() + (req.no_miner_tx ? 0 : 1);
+      if (n_txes_to_lookup > 0)
+      {
+        std::vector<std::vector<uint64_t>> indices;
+        bool r = m_core.get_tx_outputs_gindexs(req.no_miner_tx ? bd.second.front().first : bd.first.second, n_txes_to_lookup, indices);
+        if (!r)
+          return false;
+        if (indices.size() != n_txes_to_lookup || new_span->output_indices.back().indices.size() != (req.no_miner_tx ? 1 : 0))
+          return false;
+        for (size_t i = 0; i < indices.size(); ++i)
+          new_span->output_indices.back().indices.push_back({std::move(indices[i])});
+      }
+    }
+    span = new_span;
+
+    boost::unique_lock<boost::mutex> lock(m_blocks_span_cache_lock);
+    if (new_span->top_block_hash != m_blocks_span_cache_top || new_span->size > GET_BLOCKS_SPAN_CACHE_MAX_SIZE / 4)
+      return true;
+    if (!m_blocks_span_cache.emplace(key, span).second)
+      return true;
+    m_blocks_span_cache_order.push_back(key);
+    m_blocks_span_cache_size += new_span->size;
+    while (m_blocks_span_cache_size > GET_BLOCKS_SPAN_CACHE_MAX_SIZE)
+    {
+      const auto it = m_blocks_span_cache.find(m_blocks_span_cache_order.front());
+      m_blocks_span_cache_size -= it->second->size;
+      m_blocks_span_cache.erase(it);
+      m_blocks_span_cache_order.pop_front();
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_blocks);
@@ -738,59 +860,25 @@ namespace cryptonote
         }
       }
 
-      std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
-      if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.top_block_hash, res.start_height, req.prune, !req.no_miner_tx, max_blocks, COMMAND_RPC_GET_BLOCKS_FAST_MAX_TX_COUNT))
+      std::shared_ptr<const blocks_span> span;
+      bool host_fail = false;
+      if (!get_blocks_span(req, max_blocks, span, host_fail))
       {
         res.status = "Failed";
-        add_host_fail(ctx);
+        if (host_fail)
+          add_host_fail(ctx);
         return true;
       }
 
-      CHECK_PAYMENT_SAME_TS(req, res, bs.size() * COST_PER_BLOCK);
-
-      size_t size = 0, ntxes = 0;
-      res.blocks.reserve(bs.size());
-      res.output_indices.reserve(bs.size());
-      for(auto& bd: bs)
-      {
-        res.blocks.resize(res.blocks.size()+1);
-        res.blocks.back().pruned = req.prune;
-        res.blocks.back().block = bd.first.first;
-        size += bd.first.first.size();
-        res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
-        ntxes += bd.second.size();
-        res.output_indices.back().indices.reserve(1 + bd.second.size());
-        if (req.no_miner_tx)
-          res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
-        res.blocks.back().txs.reserve(bd.second.size());
-        for (std::vector<std::pair<crypto::hash, cryptonote::blobdata>>::iterator i = bd.second.begin(); i != bd.second.end(); ++i)
-        {
-          res.blocks.back().txs.push_back({std::move(i->second), crypto::null_hash});
-          i->second.clear();
-          i->second.shrink_to_fit();
-          size += res.blocks.back().txs.back().blob.size();
-        }
+      CHECK_PAYMENT_SAME_TS(req, res, span->blocks.size() * COST_PER_BLOCK);
 
-        const size_t n_txes_to_lookup = bd.second.size() + (req.no_miner_tx ? 0 : 1);
-        if (n_txes_to_lookup > 0)
-        {
-          std::vector<std::vector<uint64_t>> indices;
-          bool r = m_core.get_tx_outputs_gindexs(req.no_miner_tx ? bd.second.front().first : bd.first.second, n_txes_to_lookup, indices);
-          if (!r)
-          {
-            res.status = "Failed";
-            return true;
-          }
-          if (indices.size() != n_txes_to_lookup || res.output_indices.back().indices.size() != (req.no_miner_tx ? 1 : 0))
-          {
-            res.status = "Failed";
-            return true;
-          }
-          for (size_t i = 0; i < indices.size(); ++i)
-            res.output_indices.back().indices.push_back({std::move(indices[i])});
-        }
-      }
-      MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, size " << size);
+      res.start_height = span->start_height;
+      res.current_height = span->current_height;
+      res.top_block_hash = span->top_block_hash;
+      // the response shares the span instead of copying its blobs
+      res.shared_blocks = std::shared_ptr<const std::vector<block_complete_entry>>(span, &span->blocks);
+      res.shared_output_indices = std::shared_ptr<const std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>>(span, &span->output_indices);
+      MDEBUG("on_get_blocks: " << span->blocks.size() << " blocks, " << span->ntxes << " txes, size " << span->size);
     }
 
     res.status = CORE_RPC_STATUS_OK;
@@ -3334,6 +3422,10 @@ namespace cryptonote
     });
     res.overview = block_queue.get_overview(res.height);
 
+    const cryptonote::sync_pipeline_stats stats = m_p2p.get_payload_object().get_sync_pipeline_stats();
+    res.pipeline.push_back({"pow", stats.pow_queue_blocks, stats.pow_stall_time});
+    res.pipeline.push_back({"add", stats.add_queue_spans, stats.add_stall_time});
+
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -101,7 +101,7 @@ inline const std::string get_rpc_status(const bool trusted_daemon, const std::st
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 16
+#define CORE_RPC_VERSION_MINOR 17
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -254,14 +254,19 @@ inline const std::string get_rpc_status(const bool trusted_daemon, const std::st
       std::vector<pool_tx_info> added_pool_txs;
       std::vector<crypto::hash> remaining_added_pool_txids;
       std::vector<crypto::hash> removed_pool_txids;
+      // stored instead of blocks and output_indices when set, so the daemon
+      // can answer from a span it shares between requests without copying it
+      std::shared_ptr<const std::vector<block_complete_entry>> shared_blocks;
+      std::shared_ptr<const std::vector<block_output_indices>> shared_output_indices;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_response_base)
-        KV_SERIALIZE(blocks)
+        // the shared ones are only read from, when storing
+        epee::serialization::selector<is_store>::serialize(const_cast<std::vector<block_complete_entry>&>(is_store && this_ref.shared_blocks ? *this_ref.shared_blocks : this_ref.blocks), stg, hparent_section, "blocks");
         KV_SERIALIZE(start_height)
         KV_SERIALIZE(current_height)
         KV_SERIALIZE_VAL_POD_AS_BLOB_OPT(top_block_hash, crypto::null_hash)
-        KV_SERIALIZE(output_indices)
+        epee::serialization::selector<is_store>::serialize(const_cast<std::vector<block_output_indices>&>(is_store && this_ref.shared_output_indices ? *this_ref.shared_output_indices : this_ref.output_indices), stg, hparent_section, "output_indices");
         KV_SERIALIZE_OPT(daemon_time, (uint64_t) 0)
         KV_SERIALIZE_OPT(pool_info_extent, (uint8_t) 0)
         if (pool_info_extent != POOL_INFO_EXTENT::NONE)
@@ -2420,6 +2425,19 @@ inline const std::string get_rpc_status(const bool trusted_daemon, const std::st
       END_KV_SERIALIZE_MAP()
     };
 
+    struct pipeline_stage
+    {
+      std::string name;
+      uint64_t queue_depth;
+      uint64_t stall_time;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(queue_depth)
+        KV_SERIALIZE(stall_time)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response_t: public rpc_access_response_base
     {
       uint64_t height;
@@ -2428,6 +2446,7 @@ inline const std::string get_rpc_status(const bool trusted_daemon, const std::st
       std::list<peer> peers;
       std::list<span> spans;
       std::string overview;
+      std::list<pipeline_stage> pipeline;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_response_base)
@@ -2437,6 +2456,7 @@ inline const std::string get_rpc_status(const bool trusted_daemon, const std::st
         KV_SERIALIZE(peers)
         KV_SERIALIZE(spans)
         KV_SERIALIZE(overview)
+        KV_SERIALIZE(pipeline)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1,5 +1,6 @@
 
 #include <algorithm>
+#include <memory>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -23,70 +24,163 @@ namespace rpc
 
       return {std::move(distribution), start_height, base};
     }
+
+    typedef std::function<bool(uint64_t, uint64_t, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&)> distribution_getter;
+    typedef std::function<crypto::hash(uint64_t)> hash_getter;
+
+    constexpr const std::size_t DISTRIBUTION_CHUNK_SIZE = 512;
+
+    // Immutable cumulative rct output counts from the first rct height up to some
+    // height. Requests for any from_height are served from the same snapshot, and
+    // a newer snapshot shares all chunks but the last, partial one with the older.
+    struct distribution_snapshot
+    {
+      std::uint64_t start_height;
+      std::uint64_t base;
+      std::uint64_t size;
+      std::vector<std::shared_ptr<const std::vector<std::uint64_t>>> chunks;
+      std::vector<crypto::hash> chunk_hashes; // hash of the last block of each full chunk
+      crypto::hash top_hash;
+
+      std::uint64_t top_height() const { return start_height + size - 1; }
+
+      std::uint64_t at(std::uint64_t height) const
+      {
+        const std::uint64_t i = height - start_height;
+        return (*chunks[i / DISTRIBUTION_CHUNK_SIZE])[i % DISTRIBUTION_CHUNK_SIZE];
+      }
+
+      void copy(std::uint64_t from, std::uint64_t to, std::vector<std::uint64_t> &distribution) const
+      {
+        distribution.clear();
+        distribution.reserve(to - from + 1);
+        std::uint64_t i = from - start_height;
+        const std::uint64_t end = to - start_height + 1;
+        while (i < end)
+        {
+          const std::vector<std::uint64_t> &chunk = *chunks[i / DISTRIBUTION_CHUNK_SIZE];
+          const std::uint64_t offset = i % DISTRIBUTION_CHUNK_SIZE;
+          const std::uint64_t n = std::min<std::uint64_t>(chunk.size() - offset, end - i);
+          distribution.insert(distribution.end(), chunk.begin() + offset, chunk.begin() + offset + n);
+          i += n;
+        }
+      }
+    };
+
+    std::shared_ptr<const distribution_snapshot>
+      extend_snapshot(const std::shared_ptr<const distribution_snapshot> &snapshot, std::uint64_t to_height, const distribution_getter &f, const hash_getter &get_hash)
+    {
+      std::vector<std::uint64_t> distribution;
+      std::uint64_t start_height, base;
+      const std::uint64_t from_height = snapshot ? snapshot->top_height() + 1 : 0;
+      if (!f(0, from_height, to_height, start_height, distribution, base) || distribution.empty())
+        return nullptr;
+
+      std::shared_ptr<distribution_snapshot> extended;
+      if (snapshot)
+      {
+        if (start_height != from_height || base != snapshot->at(snapshot->top_height()))
+          return nullptr;
+        extended = std::make_shared<distribution_snapshot>(*snapshot);
+      }
+      else
+      {
+        extended = std::make_shared<distribution_snapshot>();
+        extended->start_height = start_height;
+        extended->base = base;
+        extended->size = 0;
+      }
+
+      std::size_t i = 0;
+      while (i < distribution.size())
+      {
+        const std::size_t offset = extended->size % DISTRIBUTION_CHUNK_SIZE;
+        std::shared_ptr<std::vector<std::uint64_t>> chunk;
+        if (offset == 0)
+          chunk = std::make_shared<std::vector<std::uint64_t>>();
+        else
+          chunk = std::make_shared<std::vector<std::uint64_t>>(*extended->chunks.back());
+        const std::size_t n = std::min(DISTRIBUTION_CHUNK_SIZE - offset, distribution.size() - i);
+        chunk->reserve(offset + n);
+        chunk->insert(chunk->end(), distribution.begin() + i, distribution.begin() + i + n);
+        if (offset == 0)
+          extended->chunks.push_back(std::move(chunk));
+        else
+          extended->chunks.back() = std::move(chunk);
+        extended->size += n;
+        i += n;
+        if (extended->size % DISTRIBUTION_CHUNK_SIZE == 0)
+          extended->chunk_hashes.push_back(get_hash(extended->top_height()));
+      }
+      extended->top_hash = get_hash(extended->top_height());
+      return extended;
+    }
+
+    // after a reorg, keep the full chunks which are still on the main chain
+    std::shared_ptr<const distribution_snapshot>
+      truncate_snapshot(const std::shared_ptr<const distribution_snapshot> &snapshot, std::uint64_t blockchain_height, const hash_getter &get_hash)
+    {
+      for (std::size_t k = snapshot->chunk_hashes.size(); k-- > 0; )
+      {
+        const std::uint64_t height = snapshot->start_height + (k + 1) * DISTRIBUTION_CHUNK_SIZE - 1;
+        if (height < blockchain_height && get_hash(height) == snapshot->chunk_hashes[k])
+        {
+          auto truncated = std::make_shared<distribution_snapshot>();
+          truncated->start_height = snapshot->start_height;
+          truncated->base = snapshot->base;
+          truncated->size = (k + 1) * DISTRIBUTION_CHUNK_SIZE;
+          truncated->chunks.assign(snapshot->chunks.begin(), snapshot->chunks.begin() + k + 1);
+          truncated->chunk_hashes.assign(snapshot->chunk_hashes.begin(), snapshot->chunk_hashes.begin() + k + 1);
+          truncated->top_hash = snapshot->chunk_hashes[k];
+          return truncated;
+        }
+      }
+      return nullptr;
+    }
   }
 
   boost::optional<output_distribution_data>
     RpcHandler::get_output_distribution(const std::function<bool(uint64_t, uint64_t, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&)> &f, uint64_t amount, uint64_t from_height, uint64_t to_height, const std::function<crypto::hash(uint64_t)> &get_hash, bool cumulative, uint64_t blockchain_height)
   {
-      static struct D
+      if (amount == 0)
       {
-        boost::mutex mutex;
-        std::vector<std::uint64_t> cached_distribution;
-        std::uint64_t cached_from, cached_to, cached_start_height, cached_base;
-        crypto::hash cached_m10_hash;
-        crypto::hash cached_top_hash;
-        bool cached;
-        D(): cached_from(0), cached_to(0), cached_start_height(0), cached_base(0), cached_m10_hash(crypto::null_hash), cached_top_hash(crypto::null_hash), cached(false) {}
-      } d;
-      const boost::unique_lock<boost::mutex> lock(d.mutex);
-
-      crypto::hash top_hash = crypto::null_hash;
-      if (d.cached_to < blockchain_height)
-        top_hash = get_hash(d.cached_to);
-      if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to == to_height && d.cached_top_hash == top_hash)
-        return process_distribution(cumulative, d.cached_start_height, d.cached_distribution, d.cached_base);
+        static boost::mutex mutex;
+        static std::shared_ptr<const distribution_snapshot> current;
 
-      std::vector<std::uint64_t> distribution;
-      std::uint64_t start_height, base;
+        std::shared_ptr<const distribution_snapshot> snapshot;
+        {
+          const boost::unique_lock<boost::mutex> lock(mutex);
+          snapshot = current;
+          if (snapshot && (snapshot->top_height() >= blockchain_height || get_hash(snapshot->top_height()) != snapshot->top_hash))
+            snapshot = truncate_snapshot(snapshot, blockchain_height, get_hash);
+          if ((!snapshot || to_height > snapshot->top_height()) && to_height < blockchain_height)
+          {
+            // extend to the top, the next requests will most likely want it too
+            std::shared_ptr<const distribution_snapshot> extended = extend_snapshot(snapshot, blockchain_height - 1, f, get_hash);
+            if (extended)
+              snapshot = std::move(extended);
+          }
+          current = snapshot;
+        }
 
-      // see if we can extend the cache - a common case
-      bool can_extend = d.cached && amount == 0 && d.cached_from == from_height && to_height > d.cached_to && top_hash == d.cached_top_hash;
-      if (!can_extend)
-      {
-        // we kept track of the hash 10 blocks below, if it exists, so if it matches,
-        // we can still pop the last 10 cached slots and try again
-        if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to - d.cached_from >= 10 && to_height > d.cached_to - 10)
+        // the copy is done outside the lock, the snapshot can't change under us
+        if (snapshot)
         {
-          crypto::hash hash10 = get_hash(d.cached_to - 10);
-          if (hash10 == d.cached_m10_hash)
+          const std::uint64_t start_height = std::max(from_height, snapshot->start_height);
+          if (start_height <= to_height && to_height <= snapshot->top_height())
           {
-            d.cached_to -= 10;
-            d.cached_top_hash = hash10;
-            d.cached_m10_hash = crypto::null_hash;
-            CHECK_AND_ASSERT_MES(d.cached_distribution.size() >= 10, boost::none, "Cached distribution size does not match cached bounds");
-            for (int p = 0; p < 10; ++p)
-              d.cached_distribution.pop_back();
-            can_extend = true;
+            const std::uint64_t base = start_height > snapshot->start_height ? snapshot->at(start_height - 1) : snapshot->base;
+            std::vector<std::uint64_t> distribution;
+            snapshot->copy(start_height, to_height, distribution);
+            return process_distribution(cumulative, start_height, std::move(distribution), base);
           }
         }
       }
-      if (can_extend)
-      {
-        std::vector<std::uint64_t> new_distribution;
-        if (!f(amount, d.cached_to + 1, to_height, start_height, new_distribution, base))
-          return boost::none;
-        distribution = d.cached_distribution;
-        distribution.reserve(distribution.size() + new_distribution.size());
-        for (const auto &e: new_distribution)
-          distribution.push_back(e);
-        start_height = d.cached_start_height;
-        base = d.cached_base;
-      }
-      else
-      {
-        if (!f(amount, from_height, to_height, start_height, distribution, base))
-          return boost::none;
-      }
+
+      std::vector<std::uint64_t> distribution;
+      std::uint64_t start_height, base;
+      if (!f(amount, from_height, to_height, start_height, distribution, base))
+        return boost::none;
 
       if (to_height > 0 && to_height >= from_height)
       {
@@ -95,18 +189,6 @@ namespace rpc
           distribution.resize(to_height - offset + 1);
       }
 
-      if (amount == 0)
-      {
-        d.cached_from = from_height;
-        d.cached_to = to_height;
-        d.cached_top_hash = get_hash(d.cached_to);
-        d.cached_m10_hash = d.cached_to >= 10 ? get_hash(d.cached_to - 10) : crypto::null_hash;
-        d.cached_distribution = distribution;
-        d.cached_start_height = start_height;
-        d.cached_base = base;
-        d.cached = true;
-      }
-
       return process_distribution(cumulative, start_height, std::move(distribution), base);
   }
 } // rpc
@@ -158,6 +158,8 @@ static const std::string ASCII_OUTPUT_MAGIC = "MoneroAsciiDataV1";
 
 static const std::string BACKGROUND_WALLET_SUFFIX = ".background";
 
+static const std::string CACHE_JOURNAL_SUFFIX = ".journal";
+
 boost::mutex tools::wallet2::default_daemon_address_lock;
 std::string tools::wallet2::default_daemon_address = "";
 
@@ -1221,6 +1223,7 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_ignore_outputs_above(MONEY_SUPPLY),
   m_ignore_outputs_below(0),
   m_track_uses(false),
+  m_journal_cache(false),
   m_is_background_wallet(false),
   m_background_sync_type(BackgroundSyncOff),
   m_background_syncing(false),
@@ -1970,6 +1973,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = true;
   td.m_spent_height = height;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_unspent(size_t idx)
@@ -1979,6 +1983,7 @@ void wallet2::set_unspent(size_t idx)
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = false;
   td.m_spent_height = 0;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_spent(const transfer_details &td, bool strict) const
@@ -2005,6 +2010,7 @@ void wallet2::freeze(size_t idx)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = true;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::thaw(size_t idx)
@@ -2012,6 +2018,7 @@ void wallet2::thaw(size_t idx)
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = false;
+  update_balance_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::frozen(size_t idx) const
@@ -2482,7 +2489,6 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 	    td.m_block_height = height;
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = o_indices[o];
-	    td.m_tx = (const cryptonote::transaction_prefix&)tx;
 	    td.m_txid = txid;
             td.m_key_image = tx_scan_info[o].ki;
             td.m_key_image_known = !m_watch_only && !m_multisig && !m_background_syncing;
@@ -2508,6 +2514,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             td.m_key_image_partial = m_multisig;
             td.m_amount = amount;
             td.m_pk_index = pk_index - 1;
+            THROW_WALLET_EXCEPTION_IF(!td.set_tx_data(tx, keeps_input_key_images()), error::wallet_internal_error,
+                "Failed to get output public key from output");
             td.m_subaddr_index = tx_scan_info[o].received->index;
             if (should_expand(tx_scan_info[o].received->index))
               expand_subaddresses(tx_scan_info[o].received->index);
@@ -2542,7 +2550,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             }
 	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << txid);
 	    if (!ignore_callbacks && 0 != m_callback)
-	      m_callback->on_money_received(height, txid, tx, td.m_amount, 0, td.m_subaddr_index, spends_one_of_ours(tx), td.m_tx.unlock_time);
+	      m_callback->on_money_received(height, txid, tx, td.m_amount, 0, td.m_subaddr_index, spends_one_of_ours(tx), td.m_unlock_time);
           }
           total_received_1 += amount;
           notify = true;
@@ -2584,10 +2592,11 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 	    td.m_block_height = height;
 	    td.m_internal_output_index = o;
 	    td.m_global_output_index = o_indices[o];
-	    td.m_tx = (const cryptonote::transaction_prefix&)tx;
 	    td.m_txid = txid;
             td.m_amount = amount;
             td.m_pk_index = pk_index - 1;
+            THROW_WALLET_EXCEPTION_IF(!td.set_tx_data(tx, keeps_input_key_images()), error::wallet_internal_error,
+                "Failed to get output public key from output");
             td.m_subaddr_index = tx_scan_info[o].received->index;
             if (should_expand(tx_scan_info[o].received->index))
               expand_subaddresses(tx_scan_info[o].received->index);
@@ -2617,10 +2626,11 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             }
             THROW_WALLET_EXCEPTION_IF(td.get_public_key() != tx_scan_info[o].in_ephemeral.pub, error::wallet_internal_error, "Inconsistent public keys");
 	    THROW_WALLET_EXCEPTION_IF(td.m_spent, error::wallet_internal_error, "Inconsistent spent status");
+            update_balance_index(kit->second);
 
 	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << txid);
 	    if (!ignore_callbacks && 0 != m_callback)
-	      m_callback->on_money_received(height, txid, tx, td.m_amount, burnt, td.m_subaddr_index, spends_one_of_ours(tx), td.m_tx.unlock_time);
+	      m_callback->on_money_received(height, txid, tx, td.m_amount, burnt, td.m_subaddr_index, spends_one_of_ours(tx), td.m_unlock_time);
           }
           total_received_1 += extra_amount;
           notify = true;
@@ -2658,6 +2668,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           //   2) the wallet set the highest amount among them to transfer_details::m_amount, and
           //   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
           td.m_amount = amount;
+          update_balance_index(it->second);
         }
       }
       else
@@ -2877,7 +2888,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+        index_payment(*m_payments.emplace(payment_id, payment));
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2903,7 +2914,9 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
   if(unconf_it != m_unconfirmed_txs.end()) {
     if (store_tx_info()) {
       try {
-        m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        const auto entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        if (entry.second)
+          index_confirmed_tx(*entry.first);
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2950,9 +2963,13 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
     const auto &txin = boost::get<cryptonote::txin_to_key>(in);
     entry.first->second.m_rings.push_back(std::make_pair(txin.k_image, txin.key_offsets));
   }
+  if (!entry.second && entry.first->second.m_block_height != height)
+    invalidate_history_index();
   entry.first->second.m_block_height = height;
   entry.first->second.m_timestamp = ts;
   entry.first->second.m_unlock_time = tx.unlock_time;
+  if (entry.second)
+    index_confirmed_tx(*entry.first);
 
   add_rings(tx);
 }
@@ -3246,26 +3263,35 @@ void wallet2::process_parsed_blocks(const uint64_t start_height, const std::vect
   hwdev.set_mode(hw::device::TRANSACTION_PARSE);
   const cryptonote::account_keys &keys = m_account.get_keys();
 
-  auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
-    {
-      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
-      static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
-      memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
-    }
+  // All the tx pubkeys in this range are derived with the same view secret key, so they go to the
+  // device in batches across tx boundaries, which lets it share work between them
+  std::vector<wallet2::is_out_data*> iods;
+  for (auto &slot: tx_cache_data)
+  {
+    for (auto &iod: slot.primary)
+      iods.push_back(&iod);
+    for (auto &iod: slot.additional)
+      iods.push_back(&iod);
+  }
+
+  auto gender = [&](size_t batch_start, size_t batch_end) {
+    std::vector<crypto::public_key> pkeys;
+    std::vector<crypto::key_derivation> derivations;
+    std::vector<bool> valid;
+    pkeys.reserve(batch_end - batch_start);
+    for (size_t i = batch_start; i < batch_end; ++i)
+      pkeys.push_back(iods[i]->pkey);
+    if (!hwdev.generate_key_derivations(pkeys, keys.m_view_secret_key, derivations, valid))
+      MWARNING("Failed to generate key derivation from some tx pubkeys, skipping them");
+    for (size_t i = batch_start; i < batch_end; ++i)
+      iods[i]->derivation = derivations[i - batch_start];
   };
 
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
+  const size_t DERIVATION_BATCH_SIZE = 256;
+  for (size_t batch_start = 0; batch_start < iods.size(); batch_start += DERIVATION_BATCH_SIZE)
   {
-    if (tx_cache_data[i].empty())
-      continue;
-    tpool.submit(&waiter, [&gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      for (auto &iod: slot.primary)
-        gender(iod);
-      for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
+    const size_t batch_end = std::min(batch_start + DERIVATION_BATCH_SIZE, iods.size());
+    tpool.submit(&waiter, [&gender, batch_start, batch_end]() { gender(batch_start, batch_end); }, true);
   }
   THROW_WALLET_EXCEPTION_IF(!waiter.wait(), error::wallet_internal_error, "Exception in thread pool");
 
@@ -4344,6 +4370,7 @@ wallet2::detached_blockchain_data wallet2::detach_blockchain(uint64_t height, st
 
   uint64_t blocks_detached = 0;
   dbd.original_chain_size = m_blockchain.size();
+  m_cache_journal.detached_height = std::min(m_cache_journal.detached_height, height);
   if (height >= m_blockchain.offset())
   {
     for (uint64_t i = height; i < m_blockchain.size(); ++i)
@@ -4376,6 +4403,8 @@ wallet2::detached_blockchain_data wallet2::detach_blockchain(uint64_t height, st
       ++it;
   }
 
+  reset_indices();
+
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
   return dbd;
 }
@@ -4430,6 +4459,8 @@ bool wallet2::clear()
   m_pool_info_query_time = 0;
   m_skip_to_height = 0;
   m_background_sync_data = background_sync_data_t{};
+  m_cache_journal.reset();
+  reset_indices();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -4449,6 +4480,8 @@ void wallet2::clear_soft(bool keep_key_images)
   m_pool_info_query_time = 0;
   m_skip_to_height = 0;
   m_background_sync_data = background_sync_data_t{};
+  m_cache_journal.reset();
+  reset_indices();
 
   cryptonote::block b;
   generate_genesis(b);
@@ -4462,8 +4495,14 @@ void wallet2::clear_user_data()
     i->second.m_dests.clear();
   for (auto i = m_unconfirmed_txs.begin(); i != m_unconfirmed_txs.end(); ++i)
     i->second.m_dests.clear();
-  for (auto i = m_transfers.begin(); i != m_transfers.end(); ++i)
-    i->m_frozen = false;
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    if (m_transfers[i].m_frozen)
+    {
+      m_transfers[i].m_frozen = false;
+      update_balance_index(i);
+    }
+  }
   m_tx_keys.clear();
   m_tx_notes.clear();
   m_address_book.clear();
@@ -4678,6 +4717,9 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const crypt
   value2.SetInt(m_track_uses ? 1 : 0);
   json.AddMember("track_uses", value2, json.GetAllocator());
 
+  value2.SetInt(m_journal_cache ? 1 : 0);
+  json.AddMember("journal_cache", value2, json.GetAllocator());
+
   value2.SetInt(m_background_sync_type);
   json.AddMember("background_sync_type", value2, json.GetAllocator());
 
@@ -4960,6 +5002,7 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_above = MONEY_SUPPLY;
     m_ignore_outputs_below = 0;
     m_track_uses = false;
+    m_journal_cache = false;
     m_background_sync_type = BackgroundSyncOff;
     m_show_wallet_name_when_locked = false;
     m_inactivity_lock_timeout = DEFAULT_INACTIVITY_LOCK_TIMEOUT;
@@ -5136,6 +5179,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_below = field_ignore_outputs_below;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, track_uses, int, Int, false, false);
     m_track_uses = field_track_uses;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, journal_cache, int, Int, false, false);
+    m_journal_cache = field_journal_cache;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, show_wallet_name_when_locked, int, Int, false, false);
     m_show_wallet_name_when_locked = field_show_wallet_name_when_locked;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, inactivity_lock_timeout, uint32_t, Uint, false, DEFAULT_INACTIVITY_LOCK_TIMEOUT);
@@ -6541,6 +6586,7 @@ void wallet2::load_wallet_cache(const bool use_fs, const std::string& cache_buf)
   {
     wallet2::cache_file_data cache_file_data;
     std::string cache_file_buf;
+    boost::optional<crypto::chacha_iv> base_iv;
     bool r = true;
     if (use_fs)
     {
@@ -6555,6 +6601,7 @@ void wallet2::load_wallet_cache(const bool use_fs, const std::string& cache_buf)
 
       r = ::serialization::parse_binary(use_fs ? cache_file_buf : cache_buf, cache_file_data);
       THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "internal error: failed to deserialize \"" + m_wallet_file + '\"');
+      base_iv = cache_file_data.iv;
       std::string cache_data;
       cache_data.resize(cache_file_data.cache_data.size());
       crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), get_cache_key(), cache_file_data.iv, &cache_data[0]);
@@ -6625,6 +6672,7 @@ void wallet2::load_wallet_cache(const bool use_fs, const std::string& cache_buf)
     catch (...)
     {
       LOG_PRINT_L1("Failed to load encrypted cache, trying unencrypted");
+      base_iv = boost::none;
       try {
         std::stringstream iss;
         iss << cache_file_buf;
@@ -6646,7 +6694,18 @@ void wallet2::load_wallet_cache(const bool use_fs, const std::string& cache_buf)
       m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
       m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
       error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
+
+    if (use_fs && base_iv)
+      load_cache_journal(*base_iv, cache_file_data.cache_data.size());
+
+    // older caches did not discard the inputs of txes we received in
+    if (!keeps_input_key_images())
+      for (transfer_details &td: m_transfers)
+        if (!td.m_input_key_images.empty())
+          std::vector<crypto::key_image>().swap(td.m_input_key_images);
   }
+
+  reset_indices();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::process_background_cache_on_open()
@@ -6832,9 +6891,16 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     return;
   }
 
+  // when resaving in place, appending what changed to the cache journal usually does
+  const bool journaled = same_file && append_cache_journal();
+
   // get wallet cache data
-  boost::optional<wallet2::cache_file_data> cache_file_data = get_cache_file_data();
-  THROW_WALLET_EXCEPTION_IF(cache_file_data == boost::none, error::wallet_internal_error, "failed to generate wallet cache data");
+  boost::optional<wallet2::cache_file_data> cache_file_data;
+  if (!journaled)
+  {
+    cache_file_data = get_cache_file_data();
+    THROW_WALLET_EXCEPTION_IF(cache_file_data == boost::none, error::wallet_internal_error, "failed to generate wallet cache data");
+  }
 
   const std::string new_file = same_file ? m_wallet_file + ".new" : path;
   const std::string old_file = m_wallet_file;
@@ -6884,6 +6950,8 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
   }
 
   // Save cache to new file. If storing to the same file, the temp path has the ".new" extension
+  if (!journaled)
+  {
 #ifdef WIN32
     // On Windows avoid using std::ofstream which does not work with UTF-8 filenames
     // The price to pay is temporary higher memory consumption for string stream + binary archive
@@ -6903,19 +6971,27 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
     THROW_WALLET_EXCEPTION_IF(!success || !ostr.good(), error::file_save_error, new_file);
 #endif
 
-  if (same_file)
-  {
-    // here we have "*.new" file, we need to rename it to be without ".new"
-    std::error_code e = tools::replace_file(new_file, m_wallet_file);
-    THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
-  }
-  else if (!same_file && had_old_wallet_files)
-  {
-    // remove old wallet file
-    bool r = boost::filesystem::remove(old_file);
-    if (!r) {
-      LOG_ERROR("error removing file: " << old_file);
+    if (same_file)
+    {
+      // here we have "*.new" file, we need to rename it to be without ".new"
+      std::error_code e = tools::replace_file(new_file, m_wallet_file);
+      THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
     }
+    else if (!same_file && had_old_wallet_files)
+    {
+      // remove old wallet file
+      bool r = boost::filesystem::remove(old_file);
+      if (!r) {
+        LOG_ERROR("error removing file: " << old_file);
+      }
+      boost::system::error_code ec;
+      boost::filesystem::remove(make_cache_journal_file_name(old_file), ec);
+    }
+
+    // the new cache has everything, a journal left over would not match it anyway
+    boost::system::error_code ec;
+    boost::filesystem::remove(make_cache_journal_file_name(m_wallet_file), ec);
+    reset_cache_journal(cache_file_data->iv, cache_file_data->cache_data.size(), 0);
   }
   
   if (m_message_store.get_active())
@@ -6967,6 +7043,317 @@ boost::optional<wallet2::cache_file_data> wallet2::get_cache_file_data()
   }
 }
 //----------------------------------------------------------------------------------------------------
+std::string wallet2::make_cache_journal_file_name(const std::string &wallet_file)
+{
+  return wallet_file + CACHE_JOURNAL_SUFFIX;
+}
+//----------------------------------------------------------------------------------------------------
+// Covers everything about a transfer that can change once it's in m_transfers, plus
+// enough to tell it apart from a different transfer that took its index after a reorg
+static uint64_t get_transfer_fingerprint(const wallet2::transfer_details &td)
+{
+  std::string data;
+  data.reserve(256);
+  const auto add = [&data](const void *ptr, size_t size) { data.append((const char*)ptr, size); };
+  add(&td.m_txid, sizeof(td.m_txid));
+  add(&td.m_internal_output_index, sizeof(td.m_internal_output_index));
+  add(&td.m_global_output_index, sizeof(td.m_global_output_index));
+  add(&td.m_block_height, sizeof(td.m_block_height));
+  const uint8_t flags = td.m_spent | td.m_frozen << 1 | td.m_rct << 2 | td.m_key_image_known << 3 | td.m_key_image_request << 4 | td.m_key_image_partial << 5;
+  add(&flags, sizeof(flags));
+  add(&td.m_spent_height, sizeof(td.m_spent_height));
+  add(&td.m_key_image, sizeof(td.m_key_image));
+  add(&td.m_mask, sizeof(td.m_mask));
+  add(&td.m_amount, sizeof(td.m_amount));
+  add(&td.m_pk_index, sizeof(td.m_pk_index));
+  add(&td.m_subaddr_index, sizeof(td.m_subaddr_index));
+  add(td.m_multisig_k.data(), td.m_multisig_k.size() * sizeof(rct::key));
+  for (const auto &info: td.m_multisig_info)
+  {
+    add(&info.m_signer, sizeof(info.m_signer));
+    add(info.m_LR.data(), info.m_LR.size() * sizeof(wallet2::multisig_info::LR));
+    add(info.m_partial_key_images.data(), info.m_partial_key_images.size() * sizeof(crypto::key_image));
+  }
+  add(&td.m_output_public_key, sizeof(td.m_output_public_key));
+  add(&td.m_unlock_time, sizeof(td.m_unlock_time));
+  add(&td.m_tx_pub_key, sizeof(td.m_tx_pub_key));
+  add(td.m_additional_tx_pub_keys.data(), td.m_additional_tx_pub_keys.size() * sizeof(crypto::public_key));
+  // uses are only ever pushed and popped at the back
+  const uint64_t uses = td.m_uses.size();
+  add(&uses, sizeof(uses));
+  if (!td.m_uses.empty())
+    add(&td.m_uses.back(), sizeof(td.m_uses.back()));
+
+  crypto::hash hash;
+  crypto::cn_fast_hash(data.data(), data.size(), hash);
+  uint64_t fingerprint;
+  memcpy(&fingerprint, &hash, sizeof(fingerprint));
+  return fingerprint;
+}
+//----------------------------------------------------------------------------------------------------
+template<typename F>
+void wallet2::set_aside_journaled_containers(F f)
+{
+  hashchain blockchain;
+  transfer_container transfers;
+  std::unordered_map<crypto::key_image, size_t> key_images;
+  std::unordered_map<crypto::public_key, size_t> pub_keys;
+  payment_container payments;
+  std::unordered_map<crypto::hash, confirmed_transfer_details> confirmed_txs;
+  const auto swap_all = [&]() {
+    std::swap(blockchain, m_blockchain);
+    std::swap(transfers, m_transfers);
+    std::swap(key_images, m_key_images);
+    std::swap(pub_keys, m_pub_keys);
+    std::swap(payments, m_payments);
+    std::swap(confirmed_txs, m_confirmed_txs);
+  };
+  swap_all();
+  auto restore = epee::misc_utils::create_scope_leave_handler(swap_all);
+  f();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_journal(const crypto::chacha_iv &base_iv, size_t base_size, uint64_t journal_size)
+{
+  m_cache_journal.reset();
+  if (m_is_background_wallet || m_wallet_file.empty())
+    return;
+  m_cache_journal.active = true;
+  m_cache_journal.base_iv = base_iv;
+  m_cache_journal.base_size = base_size;
+  m_cache_journal.journal_size = journal_size;
+  m_cache_journal.blockchain_size = m_blockchain.size();
+  m_cache_journal.blockchain_offset = m_blockchain.offset();
+  m_cache_journal.transfer_fingerprints.reserve(m_transfers.size());
+  for (const transfer_details &td: m_transfers)
+    m_cache_journal.transfer_fingerprints.push_back(get_transfer_fingerprint(td));
+  std::string wallet_data;
+  if (get_cache_journal_wallet_data(wallet_data))
+    crypto::cn_fast_hash(wallet_data.data(), wallet_data.size(), m_cache_journal.wallet_data_hash);
+}
+//----------------------------------------------------------------------------------------------------
+// The wallet state which is not journaled by delta: subaddresses, tx keys and notes, etc
+bool wallet2::get_cache_journal_wallet_data(std::string &wallet_data)
+{
+  bool r = true;
+  set_aside_journaled_containers([&]() {
+    r = ::serialization::dump_binary(*this, wallet_data);
+  });
+  return r;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::append_cache_journal()
+{
+  if (!m_journal_cache || !m_cache_journal.active)
+    return false;
+
+  // once the journal is half the size of the cache it applies to, rewrite the cache instead
+  if (m_cache_journal.journal_size * 2 > m_cache_journal.base_size)
+  {
+    MDEBUG("Compacting cache journal");
+    return false;
+  }
+
+  const uint64_t from = std::min(m_cache_journal.detached_height, m_cache_journal.blockchain_size);
+  if (from < m_blockchain.offset() || from > m_blockchain.size() || m_blockchain.offset() < m_cache_journal.blockchain_offset)
+    return false;
+
+  cache_journal_record record;
+  record.base_iv = m_cache_journal.base_iv;
+  record.blockchain_from = from;
+  record.blockchain_offset = m_blockchain.offset();
+  record.blocks.reserve(m_blockchain.size() - from);
+  for (uint64_t height = from; height < m_blockchain.size(); ++height)
+    record.blocks.push_back(m_blockchain[height]);
+
+  const std::vector<uint64_t> &stored_fingerprints = m_cache_journal.transfer_fingerprints;
+  std::vector<uint64_t> fingerprints;
+  fingerprints.reserve(m_transfers.size());
+  record.transfers_size = m_transfers.size();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+  {
+    const transfer_details &td = m_transfers[i];
+    fingerprints.push_back(get_transfer_fingerprint(td));
+    if (i < stored_fingerprints.size() && stored_fingerprints[i] == fingerprints.back())
+      continue;
+    record.transfer_indices.push_back(i);
+    record.transfers.push_back(td);
+    const auto ki = m_key_images.find(td.m_key_image);
+    if (ki != m_key_images.end() && ki->second == i)
+      record.key_images.push_back(*ki);
+    const auto pk = m_pub_keys.find(td.get_public_key());
+    if (pk != m_pub_keys.end() && pk->second == i)
+      record.pub_keys.push_back(*pk);
+  }
+
+  // payments and outgoing txes only change from blocks at or above the lowest height touched
+  for (const auto &p: m_payments)
+    if (p.second.m_block_height >= from)
+      record.payments.push_back(p);
+  for (const auto &c: m_confirmed_txs)
+    if (c.second.m_block_height >= from)
+      record.confirmed_txs.push_back(c);
+
+  // the rest of the wallet state is only written when it changed, so stores
+  // which only add blocks and transfers do not grow with the wallet
+  if (!get_cache_journal_wallet_data(record.wallet_data))
+    return false;
+  crypto::hash wallet_data_hash;
+  crypto::cn_fast_hash(record.wallet_data.data(), record.wallet_data.size(), wallet_data_hash);
+  if (wallet_data_hash == m_cache_journal.wallet_data_hash)
+    record.wallet_data.clear();
+
+  std::string plaintext;
+  if (!::serialization::dump_binary(record, plaintext))
+    return false;
+  cache_journal_entry entry;
+  entry.iv = crypto::rand<crypto::chacha_iv>();
+  entry.data.resize(plaintext.size());
+  crypto::chacha20(plaintext.data(), plaintext.size(), get_cache_key(), entry.iv, &entry.data[0]);
+  crypto::cn_fast_hash(entry.data.data(), entry.data.size(), entry.checksum);
+  std::string blob;
+  if (!::serialization::dump_binary(entry, blob))
+    return false;
+
+  const std::string journal_file = make_cache_journal_file_name(m_wallet_file);
+  if (!epee::file_io_utils::append_string_to_file(journal_file, blob))
+  {
+    MERROR("Failed to append to " << journal_file << ", storing the whole cache");
+    return false;
+  }
+
+  MDEBUG("Journaled " << record.blocks.size() << " blocks, " << record.transfers.size() << " transfers" << (record.wallet_data.empty() ? "" : ", wallet data") << " in " << blob.size() << " bytes");
+  m_cache_journal.journal_size += blob.size();
+  m_cache_journal.blockchain_size = m_blockchain.size();
+  m_cache_journal.blockchain_offset = m_blockchain.offset();
+  m_cache_journal.detached_height = std::numeric_limits<uint64_t>::max();
+  m_cache_journal.transfer_fingerprints = std::move(fingerprints);
+  m_cache_journal.wallet_data_hash = wallet_data_hash;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal(const crypto::chacha_iv &base_iv, size_t base_size)
+{
+  const std::string journal_file = make_cache_journal_file_name(m_wallet_file);
+  boost::system::error_code e;
+  if (!boost::filesystem::exists(journal_file, e) || e)
+  {
+    reset_cache_journal(base_iv, base_size, 0);
+    return;
+  }
+
+  std::string buf;
+  THROW_WALLET_EXCEPTION_IF(!load_from_file(journal_file, buf, std::numeric_limits<size_t>::max()), error::file_read_error, journal_file);
+
+  binary_archive<false> ar{epee::strspan<std::uint8_t>(buf)};
+  size_t records = 0;
+  bool intact = true;
+  while (ar.remaining_bytes() > 0)
+  {
+    // a torn write at the end just loses the last store
+    cache_journal_entry entry;
+    bool good = ::serialization::serialize(ar, entry) && ar.good();
+    if (good)
+    {
+      crypto::hash checksum;
+      crypto::cn_fast_hash(entry.data.data(), entry.data.size(), checksum);
+      good = checksum == entry.checksum;
+    }
+    if (!good)
+    {
+      MWARNING("Cache journal " << journal_file << " is truncated after " << records << " records");
+      intact = false;
+      break;
+    }
+
+    std::string plaintext;
+    plaintext.resize(entry.data.size());
+    crypto::chacha20(entry.data.data(), entry.data.size(), get_cache_key(), entry.iv, &plaintext[0]);
+    cache_journal_record record;
+    THROW_WALLET_EXCEPTION_IF(!::serialization::parse_binary(plaintext, record), error::wallet_internal_error,
+        "Failed to parse cache journal record in " + journal_file);
+    if (memcmp(&record.base_iv, &base_iv, sizeof(base_iv)))
+    {
+      // the cache was rewritten without it, eg by an older version
+      MWARNING("Ignoring cache journal " << journal_file << " which does not belong to " << m_wallet_file);
+      intact = false;
+      break;
+    }
+
+    if (!record.wallet_data.empty())
+    {
+      set_aside_journaled_containers([&]() {
+        binary_archive<false> wallet_ar{epee::strspan<std::uint8_t>(record.wallet_data)};
+        THROW_WALLET_EXCEPTION_IF(!::serialization::serialize(wallet_ar, *this) || !::serialization::check_stream_state(wallet_ar),
+            error::wallet_internal_error, "Failed to parse wallet data in cache journal " + journal_file);
+      });
+    }
+
+    THROW_WALLET_EXCEPTION_IF(record.blockchain_from < m_blockchain.offset() || record.blockchain_from > m_blockchain.size(),
+        error::wallet_internal_error, "Cache journal does not follow on from the wallet cache");
+    m_blockchain.crop(record.blockchain_from);
+    for (const crypto::hash &hash: record.blocks)
+      m_blockchain.push_back(hash);
+    m_blockchain.trim(record.blockchain_offset);
+
+    THROW_WALLET_EXCEPTION_IF(record.transfer_indices.size() != record.transfers.size(), error::wallet_internal_error,
+        "Mismatched transfers in cache journal");
+    const auto forget = [this](size_t i) {
+      const transfer_details &td = m_transfers[i];
+      const auto ki = m_key_images.find(td.m_key_image);
+      if (ki != m_key_images.end() && ki->second == i)
+        m_key_images.erase(ki);
+      const auto pk = m_pub_keys.find(td.get_public_key());
+      if (pk != m_pub_keys.end() && pk->second == i)
+        m_pub_keys.erase(pk);
+    };
+    for (size_t i = record.transfers_size; i < m_transfers.size(); ++i)
+      forget(i);
+    for (const uint64_t i: record.transfer_indices)
+    {
+      THROW_WALLET_EXCEPTION_IF(i >= record.transfers_size, error::wallet_internal_error, "Transfer index out of range in cache journal");
+      if (i < m_transfers.size())
+        forget(i);
+    }
+    m_transfers.resize(record.transfers_size);
+    for (size_t n = 0; n < record.transfer_indices.size(); ++n)
+      m_transfers[record.transfer_indices[n]] = std::move(record.transfers[n]);
+    for (const auto &ki: record.key_images)
+      m_key_images[ki.first] = ki.second;
+    for (const auto &pk: record.pub_keys)
+      m_pub_keys[pk.first] = pk.second;
+
+    for (auto it = m_payments.begin(); it != m_payments.end(); )
+    {
+      if (it->second.m_block_height >= record.blockchain_from)
+        it = m_payments.erase(it);
+      else
+        ++it;
+    }
+    for (auto &p: record.payments)
+      m_payments.emplace(std::move(p));
+    for (auto it = m_confirmed_txs.begin(); it != m_confirmed_txs.end(); )
+    {
+      if (it->second.m_block_height >= record.blockchain_from)
+        it = m_confirmed_txs.erase(it);
+      else
+        ++it;
+    }
+    for (auto &c: record.confirmed_txs)
+      m_confirmed_txs[c.first] = std::move(c.second);
+
+    ++records;
+  }
+
+  reset_indices();
+
+  LOG_PRINT_L1("Replayed " << records << " cache journal records from " << journal_file);
+  if (intact)
+    reset_cache_journal(base_iv, base_size, buf.size());
+  else
+    m_cache_journal.reset(); // next store rewrites the cache and drops the journal
+}
+//----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance(uint32_t index_major, bool strict) const
 {
   uint64_t amount = 0;
@@ -6993,20 +7380,140 @@ uint64_t wallet2::unlocked_balance(uint32_t index_major, bool strict, uint64_t *
   return amount;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::index_transfer_balance(size_t idx) const
+{
+  const transfer_details &td = m_transfers[idx];
+  wallet_indices::transfer_entry entry;
+  entry.subaddr_index = td.m_subaddr_index;
+  entry.amount = td.amount();
+  const bool counted = !td.m_frozen && entry.amount <= m_ignore_outputs_above && entry.amount >= m_ignore_outputs_below;
+  entry.unspent = counted && !is_spent(td, false);
+  entry.unspent_strict = counted && !is_spent(td, true);
+  if (entry.unspent || entry.unspent_strict)
+  {
+    wallet_indices::subaddress_totals &totals = m_indices.balances[entry.subaddr_index.major][entry.subaddr_index.minor];
+    if (entry.unspent)
+    {
+      totals.amount += entry.amount;
+      ++totals.outputs;
+    }
+    if (entry.unspent_strict)
+    {
+      totals.amount_strict += entry.amount;
+      ++totals.outputs_strict;
+    }
+    // an output with no unlock time of its own which is already old enough can never be locked again
+    if (td.m_unlock_time != 0 || td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > get_blockchain_current_height())
+      m_indices.maybe_locked[entry.subaddr_index.major].insert(idx);
+  }
+  if (idx == m_indices.transfers.size())
+    m_indices.transfers.push_back(entry);
+  else
+    m_indices.transfers[idx] = entry;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::unindex_transfer_balance(size_t idx) const
+{
+  const wallet_indices::transfer_entry &entry = m_indices.transfers[idx];
+  if (!entry.unspent && !entry.unspent_strict)
+    return;
+  std::map<uint32_t, wallet_indices::subaddress_totals> &account = m_indices.balances[entry.subaddr_index.major];
+  wallet_indices::subaddress_totals &totals = account[entry.subaddr_index.minor];
+  if (entry.unspent)
+  {
+    totals.amount -= entry.amount;
+    --totals.outputs;
+  }
+  if (entry.unspent_strict)
+  {
+    totals.amount_strict -= entry.amount;
+    --totals.outputs_strict;
+  }
+  if (totals.outputs == 0 && totals.outputs_strict == 0)
+    account.erase(entry.subaddr_index.minor);
+  m_indices.maybe_locked[entry.subaddr_index.major].erase(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_balance_index(size_t idx)
+{
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  if (!m_indices.balances_valid)
+    return;
+  if (idx < m_indices.transfers.size())
+    unindex_transfer_balance(idx);
+  else if (idx > m_indices.transfers.size())
+  {
+    // transfers were added without going through here, start again
+    m_indices.balances_valid = false;
+    return;
+  }
+  index_transfer_balance(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_balance_index() const
+{
+  if (m_indices.balances_valid)
+    return;
+  m_indices.transfers.clear();
+  m_indices.balances.clear();
+  m_indices.maybe_locked.clear();
+  m_indices.transfers.reserve(m_transfers.size());
+  for (size_t idx = 0; idx < m_transfers.size(); ++idx)
+    index_transfer_balance(idx);
+  m_indices.balances_valid = true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_payment(const payment_container::value_type &payment)
+{
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  if (m_indices.history_valid)
+    m_indices.payments.emplace_hint(m_indices.payments.end(), payment.second.m_block_height, &payment);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_confirmed_tx(const std::unordered_map<crypto::hash, confirmed_transfer_details>::value_type &ctd)
+{
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  if (m_indices.history_valid)
+    m_indices.confirmed_txs.emplace_hint(m_indices.confirmed_txs.end(), ctd.second.m_block_height, &ctd);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_history_index() const
+{
+  if (m_indices.history_valid)
+    return;
+  m_indices.payments.clear();
+  m_indices.confirmed_txs.clear();
+  for (const auto &p: m_payments)
+    m_indices.payments.emplace(p.second.m_block_height, &p);
+  for (const auto &c: m_confirmed_txs)
+    m_indices.confirmed_txs.emplace(c.second.m_block_height, &c);
+  m_indices.history_valid = true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_indices()
+{
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  m_indices.reset();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::invalidate_history_index()
+{
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  m_indices.history_valid = false;
+}
+//----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, bool strict) const
 {
   std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for (const auto& td: m_transfers)
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  rebuild_balance_index();
+  const auto account = m_indices.balances.find(index_major);
+  if (account != m_indices.balances.end())
   {
-    if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
-      continue;
-    if (td.m_subaddr_index.major == index_major && !is_spent(td, strict) && !td.m_frozen)
+    for (const auto &i: account->second)
     {
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-      else
-        found->second += td.amount();
+      if (strict ? i.second.outputs_strict : i.second.outputs)
+        amount_per_subaddr[i.first] = strict ? i.second.amount_strict : i.second.amount;
     }
   }
   if (!strict)
@@ -7051,41 +7558,46 @@ std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_majo
 std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::unlocked_balance_per_subaddress(uint32_t index_major, bool strict)
 {
   std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> amount_per_subaddr;
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  rebuild_balance_index();
+  const auto account = m_indices.balances.find(index_major);
+  if (account == m_indices.balances.end())
+    return amount_per_subaddr;
+  for (const auto &i: account->second)
+  {
+    if (strict ? i.second.outputs_strict : i.second.outputs)
+      amount_per_subaddr[i.first] = std::make_pair(strict ? i.second.amount_strict : i.second.amount, std::make_pair(0, 0));
+  }
+
+  // take back whatever is still locked
+  const auto locked = m_indices.maybe_locked.find(index_major);
+  if (locked == m_indices.maybe_locked.end())
+    return amount_per_subaddr;
   const uint64_t blockchain_height = get_blockchain_current_height();
   const uint64_t now = time(NULL);
-  for(const transfer_details& td: m_transfers)
+  for (auto it = locked->second.begin(); it != locked->second.end(); )
   {
-    if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
-      continue;
-    if(td.m_subaddr_index.major == index_major && !is_spent(td, strict) && !td.m_frozen)
+    const transfer_details &td = m_transfers[*it];
+    if (is_transfer_unlocked(td))
     {
-      uint64_t amount = 0, blocks_to_unlock = 0, time_to_unlock = 0;
-      if (is_transfer_unlocked(td))
-      {
-        amount = td.amount();
-        blocks_to_unlock = 0;
-        time_to_unlock = 0;
-      }
-      else
-      {
-        uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
-        if (td.m_tx.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_tx.unlock_time > unlock_height)
-          unlock_height = td.m_tx.unlock_time;
-        uint64_t unlock_time = td.m_tx.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? td.m_tx.unlock_time : 0;
-        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
-        time_to_unlock = unlock_time > now ? unlock_time - now : 0;
-        amount = 0;
-      }
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = std::make_pair(amount, std::make_pair(blocks_to_unlock, time_to_unlock));
-      else
-      {
-        found->second.first += amount;
-        found->second.second.first = std::max(found->second.second.first, blocks_to_unlock);
-        found->second.second.second = std::max(found->second.second.second, time_to_unlock);
-      }
+      // only a reorg can lock it again, and that resets the index
+      it = locked->second.erase(it);
+      continue;
     }
+    const wallet_indices::transfer_entry &entry = m_indices.transfers[*it];
+    ++it;
+    if (!(strict ? entry.unspent_strict : entry.unspent))
+      continue;
+    uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+    if (td.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_unlock_time > unlock_height)
+      unlock_height = td.m_unlock_time;
+    uint64_t unlock_time = td.m_unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? td.m_unlock_time : 0;
+    uint64_t blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
+    uint64_t time_to_unlock = unlock_time > now ? unlock_time - now : 0;
+    auto &found = amount_per_subaddr[entry.subaddr_index.minor];
+    found.first -= entry.amount;
+    found.second.first = std::max(found.second.first, blocks_to_unlock);
+    found.second.second = std::max(found.second.second, time_to_unlock);
   }
   return amount_per_subaddr;
 }
@@ -7137,28 +7649,37 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-      (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
+  if (min_height >= max_height)
+    return;
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  rebuild_history_index();
+  const auto end = m_indices.payments.upper_bound(max_height);
+  for (auto i = m_indices.payments.upper_bound(min_height); i != end; ++i)
+  {
+    const payment_container::value_type &x = *i->second;
+    if ((!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
       (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
     {
       payments.push_back(x);
     }
-  });
+  }
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
     uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  for (auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i) {
-    if (i->second.m_block_height <= min_height || i->second.m_block_height > max_height)
-      continue;
-    if (subaddr_account && *subaddr_account != i->second.m_subaddr_account)
+  if (min_height >= max_height)
+    return;
+  boost::lock_guard<boost::mutex> lock(m_indices_lock);
+  rebuild_history_index();
+  const auto end = m_indices.confirmed_txs.upper_bound(max_height);
+  for (auto i = m_indices.confirmed_txs.upper_bound(min_height); i != end; ++i) {
+    const auto &ctd = *i->second;
+    if (subaddr_account && *subaddr_account != ctd.second.m_subaddr_account)
       continue;
-    if (!subaddr_indices.empty() && std::count_if(i->second.m_subaddr_indices.begin(), i->second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
+    if (!subaddr_indices.empty() && std::count_if(ctd.second.m_subaddr_indices.begin(), ctd.second.m_subaddr_indices.end(), [&subaddr_indices](uint32_t index) { return subaddr_indices.count(index) == 1; }) == 0)
       continue;
-    confirmed_payments.push_back(*i);
+    confirmed_payments.push_back(ctd);
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -7260,9 +7781,32 @@ void wallet2::rescan_blockchain(bool hard, bool refresh, bool keep_key_images)
     finish_rescan_bc_keep_key_images(transfers_cnt, transfers_hash);
 }
 //----------------------------------------------------------------------------------------------------
+bool wallet2::transfer_details::set_tx_data(const cryptonote::transaction_prefix &tx, bool keep_input_key_images)
+{
+  if (m_internal_output_index >= tx.vout.size())
+    return false;
+  const cryptonote::tx_out &out = tx.vout[m_internal_output_index];
+  if (!cryptonote::get_output_public_key(out, m_output_public_key))
+    return false;
+  m_view_tag = cryptonote::get_output_view_tag(out);
+  m_unlock_time = tx.unlock_time;
+  m_tx_pub_key = cryptonote::get_tx_pub_key_from_extra(tx, m_pk_index);
+  m_additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(tx);
+
+  // view wallets need those to find which of their txes spent the outputs they import key images for
+  m_input_key_images.clear();
+  if (keep_input_key_images)
+  {
+    for (const cryptonote::txin_v &in: tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key))
+        m_input_key_images.push_back(boost::get<cryptonote::txin_to_key>(in).k_image);
+  }
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(const transfer_details& td)
 {
-  return is_transfer_unlocked(td.m_tx.unlock_time, td.m_block_height);
+  return is_transfer_unlocked(td.m_unlock_time, td.m_block_height);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height)
@@ -9832,8 +10376,8 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
     real_oe.second.dest = rct::pk2rct(td.get_public_key());
     real_oe.second.mask = rct::commit(td.amount(), td.m_mask);
     *it_to_replace = real_oe;
-    src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
-    src.real_out_additional_tx_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    src.real_out_tx_key = td.m_tx_pub_key;
+    src.real_out_additional_tx_keys = td.m_additional_tx_pub_keys;
     src.real_output = it_to_replace - src.outputs.begin();
     src.real_output_in_tx_index = td.m_internal_output_index;
     src.multisig_kLRki = rct::multisig_kLRki({rct::zero(), rct::zero(), rct::zero(), rct::zero()});
@@ -10055,8 +10599,8 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
     real_oe.second.dest = rct::pk2rct(td.get_public_key());
     real_oe.second.mask = rct::commit(td.amount(), td.m_mask);
     *it_to_replace = real_oe;
-    src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
-    src.real_out_additional_tx_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    src.real_out_tx_key = td.m_tx_pub_key;
+    src.real_out_additional_tx_keys = td.m_additional_tx_pub_keys;
     src.real_output = it_to_replace - src.outputs.begin();
     src.real_output_in_tx_index = td.m_internal_output_index;
     src.mask = td.m_mask;
@@ -11985,8 +12529,8 @@ std::string wallet2::get_spend_proof(const crypto::hash &txid, const std::string
     // derive the real output keypair
     const transfer_details& in_td = m_transfers[found->second];
     crypto::public_key in_tx_out_pkey = in_td.get_public_key();
-    const crypto::public_key in_tx_pub_key = get_tx_pub_key_from_extra(in_td.m_tx, in_td.m_pk_index);
-    const std::vector<crypto::public_key> in_additionakl_tx_pub_keys = get_additional_tx_pub_keys_from_extra(in_td.m_tx);
+    const crypto::public_key in_tx_pub_key = in_td.m_tx_pub_key;
+    const std::vector<crypto::public_key> &in_additionakl_tx_pub_keys = in_td.m_additional_tx_pub_keys;
     keypair in_ephemeral;
     crypto::key_image in_img;
     THROW_WALLET_EXCEPTION_IF(!generate_key_image_helper(m_account.get_keys(), m_subaddresses, in_tx_out_pkey, in_tx_pub_key, in_additionakl_tx_pub_keys, in_td.m_internal_output_index, in_ephemeral, in_img, m_account.get_device()),
@@ -12671,9 +13215,9 @@ std::string wallet2::get_reserve_proof(const boost::optional<std::pair<uint32_t,
     subaddr_indices.insert(td.m_subaddr_index);
 
     // get tx pub key 
-    const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
+    const crypto::public_key tx_pub_key = td.m_tx_pub_key;
     THROW_WALLET_EXCEPTION_IF(tx_pub_key == crypto::null_pkey, error::wallet_internal_error, "The tx public key isn't found");
-    const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    const std::vector<crypto::public_key> &additional_tx_pub_keys = td.m_additional_tx_pub_keys;
 
     // determine which tx pub key was used for deriving the output key
     const crypto::public_key *tx_pub_key_used = &tx_pub_key;
@@ -13216,50 +13760,10 @@ bool wallet2::verify_with_public_key(const std::string &data, const crypto::publ
 //----------------------------------------------------------------------------------------------------
 crypto::public_key wallet2::get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td) const
 {
-  std::vector<tx_extra_field> tx_extra_fields;
-  if(!parse_tx_extra(td.m_tx.extra, tx_extra_fields))
-  {
-    // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-  }
-
   // Due to a previous bug, there might be more than one tx pubkey in extra, one being
-  // the result of a previously discarded signature.
-  // For speed, since scanning for outputs is a slow process, we check whether extra
-  // contains more than one pubkey. If not, the first one is returned. If yes, they're
-  // checked for whether they yield at least one output
-  tx_extra_pub_key pub_key_field;
-  THROW_WALLET_EXCEPTION_IF(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 0), error::wallet_internal_error,
-      "Public key wasn't found in the transaction extra");
-  const crypto::public_key tx_pub_key = pub_key_field.pub_key;
-  bool two_found = find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 1);
-  if (!two_found) {
-    // easy case, just one found
-    return tx_pub_key;
-  }
-
-  // more than one, loop and search
-  const cryptonote::account_keys& keys = m_account.get_keys();
-  size_t pk_index = 0;
-  hw::device &hwdev = m_account.get_device();
-
-  while (find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, pk_index++)) {
-    const crypto::public_key tx_pub_key = pub_key_field.pub_key;
-    crypto::key_derivation derivation;
-    bool r = hwdev.generate_key_derivation(tx_pub_key, keys.m_view_secret_key, derivation);
-    THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key derivation");
-
-    for (size_t i = 0; i < td.m_tx.vout.size(); ++i)
-    {
-      tx_scan_info_t tx_scan_info;
-      check_acc_out_precomp(td.m_tx.vout[i], derivation, {}, i, tx_scan_info);
-      if (!tx_scan_info.error && tx_scan_info.received)
-        return tx_pub_key;
-    }
-  }
-
-  // we found no key yielding an output, but it might be in the additional
-  // tx pub keys only, which we do not need to check, so return the first one
-  return tx_pub_key;
+  // the result of a previously discarded signature. The one yielding this output was
+  // picked when it was received
+  return td.m_tx_pub_key;
 }
 
 bool wallet2::export_key_images(const std::string &filename, bool all) const
@@ -13313,14 +13817,8 @@ std::pair<uint64_t, std::vector<std::pair<crypto::key_image, crypto::signature>>
     const crypto::public_key pkey = td.get_public_key();
 
     // get tx pub key
-    std::vector<tx_extra_field> tx_extra_fields;
-    if(!parse_tx_extra(td.m_tx.extra, tx_extra_fields))
-    {
-      // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
-    }
-
     crypto::public_key tx_pub_key = get_tx_pub_key_from_received_outs(td);
-    const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    const std::vector<crypto::public_key> &additional_tx_pub_keys = td.m_additional_tx_pub_keys;
 
     // generate ephemeral secret key
     crypto::key_image ki;
@@ -13403,6 +13901,9 @@ uint64_t wallet2::import_key_images(const std::string &filename, uint64_t &spent
 uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_image, crypto::signature>> &signed_key_images, size_t offset, uint64_t &spent, uint64_t &unspent, bool check_spent)
 {
   PERF_TIMER(import_key_images_lots);
+  // this can drop payments and add outgoing txes below the chain tip, which the
+  // cache journal has no way to record
+  m_cache_journal.reset();
   COMMAND_RPC_IS_KEY_IMAGE_SPENT::request req = AUTO_VAL_INIT(req);
   COMMAND_RPC_IS_KEY_IMAGE_SPENT::response daemon_resp = AUTO_VAL_INIT(daemon_resp);
 
@@ -13474,6 +13975,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       transfer_details &td = m_transfers[n + offset];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
     }
+    reset_indices();
   }
   spent = 0;
   unspent = 0;
@@ -13485,11 +13987,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
   PERF_TIMER_START(import_key_images_C);
   for (const transfer_details &td: m_transfers)
   {
-    for (const cryptonote::txin_v& in : td.m_tx.vin)
-    {
-      if (in.type() == typeid(cryptonote::txin_to_key))
-        spent_key_images.insert(std::make_pair(boost::get<cryptonote::txin_to_key>(in).k_image, td.m_txid));
-    }
+    for (const crypto::key_image &ki: td.m_input_key_images)
+      spent_key_images.insert(std::make_pair(ki, td.m_txid));
   }
   PERF_TIMER_STOP(import_key_images_C);
 
@@ -13520,7 +14019,8 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     LOG_PRINT_L2("Transfer " << i << ": " << print_money(amount) << " (" << td.m_global_output_index << "): "
         << (td.m_spent ? "spent" : "unspent") << " (key image " << req.key_images[i] << ")");
 
-    if (i < daemon_resp.spent_status.size() && daemon_resp.spent_status[i] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN)
+    // wallets which can generate key images saw their spends when scanning, and keep no input key images
+    if (keeps_input_key_images() && i < daemon_resp.spent_status.size() && daemon_resp.spent_status[i] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN)
     {
       const std::unordered_map<crypto::key_image, crypto::hash>::const_iterator skii = spent_key_images.find(td.m_key_image);
       if (skii == spent_key_images.end())
@@ -13649,6 +14149,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
         if (j->second.m_tx_hash == *spent_txid)
         {
           m_payments.erase(j);
+          invalidate_history_index();
           break;
         }
       }
@@ -13668,6 +14169,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       const crypto::hash &spent_txid = crypto::null_hash; // spent txid is unknown
       m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
     }
+    invalidate_history_index();
     PERF_TIMER_STOP(import_key_images_G);
   }
 
@@ -13756,6 +14258,7 @@ void wallet2::process_background_cache(const background_sync_data_t &background_
   // We expect the spend key to be in a decrypted state while
   // m_processing_background_cache is true
   m_processing_background_cache = true;
+  m_cache_journal.reset();
   auto done_processing = epee::misc_utils::create_scope_leave_handler([&, this]() {
     m_processing_background_cache = false;
   });
@@ -14135,6 +14638,8 @@ wallet2::payment_container wallet2::export_payments() const
 }
 void wallet2::import_payments(const payment_container &payments)
 {
+  m_cache_journal.reset();
+  reset_indices();
   m_payments.clear();
   for (auto const &p : payments)
   {
@@ -14143,6 +14648,8 @@ void wallet2::import_payments(const payment_container &payments)
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
+  m_cache_journal.reset();
+  reset_indices();
   m_confirmed_txs.clear();
   for (auto const &p : confirmed_payments)
   {
@@ -14164,6 +14671,8 @@ std::tuple<size_t,crypto::hash,std::vector<crypto::hash>> wallet2::export_blockc
 
 void wallet2::import_blockchain(const std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> &bc)
 {
+  m_cache_journal.reset();
+  reset_indices();
   m_blockchain.clear();
   if (std::get<0>(bc))
   {
@@ -14210,7 +14719,7 @@ std::tuple<uint64_t, uint64_t, std::vector<tools::wallet2::exported_transfer_det
 
     exported_transfer_details etd;
     etd.m_pubkey = td.get_public_key();
-    etd.m_tx_pubkey = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
+    etd.m_tx_pubkey = td.m_tx_pub_key;
     etd.m_internal_output_index = td.m_internal_output_index;
     etd.m_global_output_index = td.m_global_output_index;
     etd.m_flags.flags = 0;
@@ -14221,7 +14730,7 @@ std::tuple<uint64_t, uint64_t, std::vector<tools::wallet2::exported_transfer_det
     etd.m_flags.m_key_image_request = td.m_key_image_request;
     etd.m_flags.m_key_image_partial = td.m_key_image_partial;
     etd.m_amount = td.m_amount;
-    etd.m_additional_tx_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    etd.m_additional_tx_keys = td.m_additional_tx_pub_keys;
     etd.m_subaddr_index_major = td.m_subaddr_index.major;
     etd.m_subaddr_index_minor = td.m_subaddr_index.minor;
 
@@ -14256,6 +14765,8 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
 
   THROW_WALLET_EXCEPTION_IF(m_has_ever_refreshed_from_node, error::wallet_internal_error,
       "Hot wallets cannot import outputs");
+  m_cache_journal.reset();
+  reset_indices();
 
   // we can now import piecemeal
   const size_t offset = std::get<0>(outputs);
@@ -14289,9 +14800,10 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
       CMPF(m_txid);
       CMPF(m_key_image);
       CMPF(m_internal_output_index);
+      CMPF(m_output_public_key);
+      CMPF(m_tx_pub_key);
+      CMPF(m_additional_tx_pub_keys);
 #undef CMPF
-      if (!(get_transaction_prefix_hash(td.m_tx) == get_transaction_prefix_hash(org_td.m_tx)))
-        goto process;
 
       // copy anyway, since the comparison does not include ancillary fields which may have changed
       m_transfers[i + offset] = std::move(td);
@@ -14303,12 +14815,9 @@ process:
     // the hot wallet wouldn't have known about key images (except if we already exported them)
     cryptonote::keypair in_ephemeral;
 
-    THROW_WALLET_EXCEPTION_IF(td.m_tx.vout.empty(), error::wallet_internal_error, "tx with no outputs at index " + boost::lexical_cast<std::string>(i + offset));
     crypto::public_key tx_pub_key = get_tx_pub_key_from_received_outs(td);
-    const std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+    const std::vector<crypto::public_key> &additional_tx_pub_keys = td.m_additional_tx_pub_keys;
 
-    THROW_WALLET_EXCEPTION_IF(td.m_internal_output_index >= td.m_tx.vout.size(),
-        error::wallet_internal_error, "Internal index is out of range");
     crypto::public_key out_key = td.get_public_key();
     if (should_expand(td.m_subaddr_index))
       create_one_off_subaddress(td.m_subaddr_index);
@@ -14336,6 +14845,8 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
 
   THROW_WALLET_EXCEPTION_IF(m_has_ever_refreshed_from_node, error::wallet_internal_error,
       "Hot wallets cannot import outputs");
+  m_cache_journal.reset();
+  reset_indices();
 
   // we can now import piecemeal
   const size_t offset = std::get<0>(outputs);
@@ -14390,23 +14901,16 @@ size_t wallet2::import_outputs(const std::tuple<uint64_t, uint64_t, std::vector<
         continue;
     }
 
-    // construct a synthetix tx prefix that has the info we'll need: the output with its pubkey, the tx pubkey in extra
-    td.m_tx = {};
-
+    // we only get what we need from the tx: the output pubkey, the tx pubkeys
     THROW_WALLET_EXCEPTION_IF(etd.m_internal_output_index >= 65536, error::wallet_internal_error, "internal output index seems outrageously high, rejecting");
     td.m_internal_output_index = etd.m_internal_output_index;
-    cryptonote::txout_to_key tk;
-    tk.key = etd.m_pubkey;
-    cryptonote::tx_out out;
-    out.amount = etd.m_amount;
-    out.target = tk;
-    td.m_tx.vout.resize(etd.m_internal_output_index);
-    td.m_tx.vout.push_back(out);
-
+    td.m_output_public_key = etd.m_pubkey;
+    td.m_view_tag = boost::none;
+    td.m_unlock_time = 0;
     td.m_pk_index = 0;
-    add_tx_pub_key_to_extra(td.m_tx, etd.m_tx_pubkey);
-    if (!etd.m_additional_tx_keys.empty())
-      add_additional_tx_pub_keys_to_extra(td.m_tx.extra, etd.m_additional_tx_keys);
+    td.m_tx_pub_key = etd.m_tx_pubkey;
+    td.m_additional_tx_pub_keys = etd.m_additional_tx_keys;
+    td.m_input_key_images.clear();
 
     // the hot wallet wouldn't have known about key images (except if we already exported them)
     cryptonote::keypair in_ephemeral;
@@ -14487,10 +14991,16 @@ size_t wallet2::import_outputs_from_str(const std::string &outputs_st)
     std::tuple<uint64_t, uint64_t, std::vector<tools::wallet2::transfer_details>> outputs;
     if (!loaded) try
     {
+      std::tuple<uint64_t, uint64_t, std::vector<tools::wallet2::legacy_transfer_details>> legacy_outputs;
       binary_archive<false> ar{epee::strspan<std::uint8_t>(body)};
-      if (::serialization::serialize(ar, outputs))
+      if (::serialization::serialize(ar, legacy_outputs))
         if (::serialization::check_stream_state(ar))
+        {
+          std::get<0>(outputs) = std::get<0>(legacy_outputs);
+          std::get<1>(outputs) = std::get<1>(legacy_outputs);
+          std::get<2>(outputs).assign(std::get<2>(legacy_outputs).begin(), std::get<2>(legacy_outputs).end());
           loaded = true;
+        }
     }
     catch (...) {}
 
@@ -14615,7 +15125,7 @@ crypto::key_image wallet2::get_multisig_composite_key_image(size_t n) const
 
   const transfer_details &td = m_transfers[n];
   const crypto::public_key tx_key = get_tx_pub_key_from_received_outs(td);
-  const std::vector<crypto::public_key> additional_tx_keys = cryptonote::get_additional_tx_pub_keys_from_extra(td.m_tx);
+  const std::vector<crypto::public_key> &additional_tx_keys = td.m_additional_tx_pub_keys;
   crypto::key_image ki;
   std::vector<crypto::key_image> pkis;
   for (const auto &info: td.m_multisig_info)
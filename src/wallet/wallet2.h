@@ -86,6 +86,7 @@
 
 class Serialization_portability_wallet_Test;
 class wallet_accessor_test;
+class wallet_cache_accessor;
 namespace multisig { class multisig_account; }
 
 namespace tools
@@ -226,6 +227,7 @@ private:
   {
     friend class ::Serialization_portability_wallet_Test;
     friend class ::wallet_accessor_test;
+    friend class ::wallet_cache_accessor;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
   public:
@@ -341,7 +343,6 @@ private:
     struct transfer_details
     {
       uint64_t m_block_height;
-      cryptonote::transaction_prefix m_tx;
       crypto::hash m_txid;
       uint64_t m_internal_output_index;
       uint64_t m_global_output_index;
@@ -360,17 +361,64 @@ private:
       std::vector<rct::key> m_multisig_k;
       std::vector<multisig_info> m_multisig_info; // one per other participant
       std::vector<std::pair<uint64_t, crypto::hash>> m_uses;
+      // what we keep of the transaction the output was received in
+      crypto::public_key m_output_public_key;
+      boost::optional<crypto::view_tag> m_view_tag;
+      uint64_t m_unlock_time;
+      crypto::public_key m_tx_pub_key; // the one at m_pk_index
+      std::vector<crypto::public_key> m_additional_tx_pub_keys;
+      std::vector<crypto::key_image> m_input_key_images; // only kept by wallets which can't generate key images
 
       bool is_rct() const { return m_rct; }
       uint64_t amount() const { return m_amount; }
-      const crypto::public_key get_public_key() const {
-        crypto::public_key output_public_key;
-        THROW_WALLET_EXCEPTION_IF(m_tx.vout.size() <= m_internal_output_index,
-          error::wallet_internal_error, "Too few outputs, outputs may be corrupted");
-        THROW_WALLET_EXCEPTION_IF(!get_output_public_key(m_tx.vout[m_internal_output_index], output_public_key),
-          error::wallet_internal_error, "Unable to get output public key from output");
-        return output_public_key;
-      };
+      const crypto::public_key get_public_key() const { return m_output_public_key; }
+      bool set_tx_data(const cryptonote::transaction_prefix &tx, bool keep_input_key_images);
+
+      BEGIN_SERIALIZE_OBJECT()
+        VERSION_FIELD(0)
+        FIELD(m_block_height)
+        FIELD(m_txid)
+        FIELD(m_internal_output_index)
+        FIELD(m_global_output_index)
+        FIELD(m_spent)
+        FIELD(m_frozen)
+        FIELD(m_spent_height)
+        FIELD(m_key_image)
+        FIELD(m_mask)
+        FIELD(m_amount)
+        FIELD(m_rct)
+        FIELD(m_key_image_known)
+        FIELD(m_key_image_request)
+        FIELD(m_pk_index)
+        FIELD(m_subaddr_index)
+        FIELD(m_key_image_partial)
+        FIELD(m_multisig_k)
+        FIELD(m_multisig_info)
+        FIELD(m_uses)
+        FIELD(m_output_public_key)
+        bool has_view_tag = m_view_tag != boost::none;
+        FIELD(has_view_tag)
+        if (has_view_tag)
+        {
+          if (!m_view_tag)
+            m_view_tag = crypto::view_tag{};
+          FIELD_N("m_view_tag", *m_view_tag)
+        }
+        else
+          m_view_tag = boost::none;
+        VARINT_FIELD(m_unlock_time)
+        FIELD(m_tx_pub_key)
+        FIELD(m_additional_tx_pub_keys)
+        FIELD(m_input_key_images)
+      END_SERIALIZE()
+    };
+
+    // transfer_details as stored before they were made compact, with the
+    // whole prefix of the transaction the output was received in. The wallet
+    // only loads these, storing needs m_tx to be set.
+    struct legacy_transfer_details: transfer_details
+    {
+      cryptonote::transaction_prefix m_tx;
 
       BEGIN_SERIALIZE_OBJECT()
         FIELD(m_block_height)
@@ -393,6 +441,8 @@ private:
         FIELD(m_multisig_k)
         FIELD(m_multisig_info)
         FIELD(m_uses)
+        if (!W && !set_tx_data(m_tx, true))
+          return false;
       END_SERIALIZE()
     };
 
@@ -698,11 +748,11 @@ private:
         FIELD(txes)
         if (version == 0)
         {
-          std::pair<size_t, wallet2::transfer_container> v0_transfers;
+          std::pair<size_t, std::vector<wallet2::legacy_transfer_details>> v0_transfers;
           FIELD(v0_transfers);
           std::get<0>(transfers) = std::get<0>(v0_transfers);
           std::get<1>(transfers) = std::get<0>(v0_transfers) + std::get<1>(v0_transfers).size();
-          std::get<2>(transfers) = std::get<1>(v0_transfers);
+          std::get<2>(transfers).assign(std::get<1>(v0_transfers).begin(), std::get<1>(v0_transfers).end());
           return true;
         }
         if (version == 1)
@@ -766,6 +816,60 @@ private:
       END_SERIALIZE()
     };
 
+    // One append to the cache journal: the state that changed since the
+    // previous store, replayed over the cache file it was started from
+    struct cache_journal_record
+    {
+      crypto::chacha_iv base_iv;
+      uint64_t blockchain_from;
+      uint64_t blockchain_offset;
+      std::vector<crypto::hash> blocks;
+      uint64_t transfers_size;
+      std::vector<uint64_t> transfer_indices;
+      std::vector<transfer_details> transfers;
+      std::vector<std::pair<crypto::key_image, size_t>> key_images;
+      std::vector<std::pair<crypto::public_key, size_t>> pub_keys;
+      std::vector<std::pair<crypto::hash, payment_details>> payments;
+      std::vector<std::pair<crypto::hash, confirmed_transfer_details>> confirmed_txs;
+      std::string wallet_data; // empty if unchanged
+
+      BEGIN_SERIALIZE_OBJECT()
+        VERSION_FIELD(1)
+        FIELD(base_iv)
+        VARINT_FIELD(blockchain_from)
+        VARINT_FIELD(blockchain_offset)
+        FIELD(blocks)
+        VARINT_FIELD(transfers_size)
+        FIELD(transfer_indices)
+        if (version < 1)
+        {
+          std::vector<legacy_transfer_details> legacy_transfers;
+          FIELD_N("transfers", legacy_transfers)
+          transfers.assign(legacy_transfers.begin(), legacy_transfers.end());
+        }
+        else
+          FIELD(transfers)
+        FIELD(key_images)
+        FIELD(pub_keys)
+        FIELD(payments)
+        FIELD(confirmed_txs)
+        FIELD(wallet_data)
+      END_SERIALIZE()
+    };
+
+    struct cache_journal_entry
+    {
+      crypto::chacha_iv iv;
+      std::string data;
+      crypto::hash checksum;
+
+      BEGIN_SERIALIZE_OBJECT()
+        FIELD(iv)
+        FIELD(data)
+        FIELD(checksum)
+      END_SERIALIZE()
+    };
+
     // GUI Address book
     struct address_book_row
     {
@@ -1373,9 +1477,16 @@ private:
 
     BEGIN_SERIALIZE_OBJECT()
       MAGIC_FIELD("monero wallet cache")
-      VERSION_FIELD(2)
+      VERSION_FIELD(3)
       FIELD(m_blockchain)
-      FIELD(m_transfers)
+      if (version < 3)
+      {
+        std::vector<legacy_transfer_details> legacy_transfers;
+        FIELD_N("m_transfers", legacy_transfers)
+        m_transfers.assign(legacy_transfers.begin(), legacy_transfers.end());
+      }
+      else
+        FIELD(m_transfers)
       FIELD(m_account_public_address)
       FIELD(m_key_images)
       FIELD(m_unconfirmed_txs)
@@ -1429,6 +1540,7 @@ private:
     static bool wallet_valid_path_format(const std::string& file_path);
     static std::string make_background_wallet_file_name(const std::string &wallet_file);
     static std::string make_background_keys_file_name(const std::string &wallet_file);
+    static std::string make_cache_journal_file_name(const std::string &wallet_file);
     static bool parse_long_payment_id(const std::string& payment_id_str, crypto::hash& payment_id);
     static bool parse_short_payment_id(const std::string& payment_id_str, crypto::hash8& payment_id);
     static bool parse_payment_id(const std::string& payment_id_str, crypto::hash& payment_id);
@@ -1470,11 +1582,13 @@ private:
     bool ignore_fractional_outputs() const { return m_ignore_fractional_outputs; }
     void ignore_fractional_outputs(bool value) { m_ignore_fractional_outputs = value; }
     uint64_t ignore_outputs_above() const { return m_ignore_outputs_above; }
-    void ignore_outputs_above(uint64_t value) { m_ignore_outputs_above = value; }
+    void ignore_outputs_above(uint64_t value) { m_ignore_outputs_above = value; reset_indices(); }
     uint64_t ignore_outputs_below() const { return m_ignore_outputs_below; }
-    void ignore_outputs_below(uint64_t value) { m_ignore_outputs_below = value; }
+    void ignore_outputs_below(uint64_t value) { m_ignore_outputs_below = value; reset_indices(); }
     bool track_uses() const { return m_track_uses; }
     void track_uses(bool value) { m_track_uses = value; }
+    bool journal_cache() const { return m_journal_cache; }
+    void journal_cache(bool value) { m_journal_cache = value; }
     BackgroundSyncType background_sync_type() const { return m_background_sync_type; }
     void setup_background_sync(BackgroundSyncType background_sync_type, const epee::wipeable_string &wallet_password, const boost::optional<epee::wipeable_string> &background_cache_password);
     bool is_background_syncing() const { return m_background_syncing; }
@@ -1804,6 +1918,11 @@ private:
     bool load_keys_buf(const std::string& keys_buf, const epee::wipeable_string& password);
     bool load_keys_buf(const std::string& keys_buf, const epee::wipeable_string& password, boost::optional<crypto::chacha_key>& keys_to_encrypt);
     void load_wallet_cache(const bool use_fs, const std::string& cache_buf = "");
+    void load_cache_journal(const crypto::chacha_iv &base_iv, size_t base_size);
+    void reset_cache_journal(const crypto::chacha_iv &base_iv, size_t base_size, uint64_t journal_size);
+    bool append_cache_journal();
+    bool get_cache_journal_wallet_data(std::string &wallet_data);
+    template<typename F> void set_aside_journaled_containers(F f);
     void process_new_transaction(const crypto::hash &txid, const cryptonote::transaction& tx, const std::vector<uint64_t> &o_indices, uint64_t height, uint8_t block_version, uint64_t ts, bool miner_tx, bool pool, bool double_spend_seen, const tx_cache_data &tx_cache_data, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL, bool ignore_callbacks = false);
     bool should_skip_block(const cryptonote::block &b, uint64_t height) const;
     void process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, const std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
@@ -1854,6 +1973,16 @@ private:
     void set_unspent(size_t idx);
     bool is_spent(const transfer_details &td, bool strict = true) const;
     bool is_spent(size_t idx, bool strict = true) const;
+    bool keeps_input_key_images() const { return m_watch_only || m_multisig || m_background_syncing; }
+    void index_transfer_balance(size_t idx) const;
+    void unindex_transfer_balance(size_t idx) const;
+    void update_balance_index(size_t idx);
+    void rebuild_balance_index() const;
+    void index_payment(const payment_container::value_type &payment);
+    void index_confirmed_tx(const std::unordered_map<crypto::hash, confirmed_transfer_details>::value_type &ctd);
+    void rebuild_history_index() const;
+    void reset_indices();
+    void invalidate_history_index();
     void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, bool rct, std::unordered_set<crypto::public_key> &valid_public_keys_cache);
     void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, std::vector<uint64_t> &rct_offsets, std::unordered_set<crypto::public_key> &valid_public_keys_cache);
     bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key& tx_public_key, const rct::key& mask, uint64_t real_index, bool unlocked, std::unordered_set<crypto::public_key> &valid_public_keys_cache) const;
@@ -1999,6 +2128,7 @@ private:
     uint64_t m_ignore_outputs_above;
     uint64_t m_ignore_outputs_below;
     bool m_track_uses;
+    bool m_journal_cache;
     bool m_is_background_wallet;
     BackgroundSyncType m_background_sync_type;
     bool m_show_wallet_name_when_locked;
@@ -2036,6 +2166,57 @@ private:
     crypto::secret_key m_original_view_secret_key;
 
     crypto::chacha_key m_cache_key;
+
+    // What the cache file plus journal on disk hold, to find what the next
+    // journal record needs. Inactive until the wallet is loaded or stored,
+    // and reset by anything that changes state the journal can't express.
+    struct cache_journal_state
+    {
+      bool active = false;
+      crypto::chacha_iv base_iv;
+      uint64_t base_size = 0;
+      uint64_t journal_size = 0;
+      uint64_t blockchain_size = 0;
+      uint64_t blockchain_offset = 0;
+      uint64_t detached_height = std::numeric_limits<uint64_t>::max();
+      std::vector<uint64_t> transfer_fingerprints;
+      crypto::hash wallet_data_hash = crypto::null_hash;
+      void reset() { *this = cache_journal_state{}; }
+    } m_cache_journal;
+
+    // Running per subaddress totals of m_transfers, and m_payments and
+    // m_confirmed_txs ordered by height, so balance and history queries do
+    // not walk the whole wallet. Kept up to date as outputs are received,
+    // spent, frozen and thawed; anything else rewriting those containers
+    // resets it, and the next query rebuilds what it needs. Queries may run
+    // alongside a refresh, so it is only touched with m_indices_lock held.
+    struct wallet_indices
+    {
+      struct transfer_entry
+      {
+        cryptonote::subaddress_index subaddr_index;
+        uint64_t amount = 0;
+        bool unspent = false;
+        bool unspent_strict = false;
+      };
+      struct subaddress_totals
+      {
+        uint64_t amount = 0;
+        uint64_t amount_strict = 0;
+        size_t outputs = 0;
+        size_t outputs_strict = 0;
+      };
+      bool balances_valid = false;
+      std::vector<transfer_entry> transfers; // what each transfer is counted as
+      std::unordered_map<uint32_t, std::map<uint32_t, subaddress_totals>> balances;
+      std::unordered_map<uint32_t, std::set<size_t>> maybe_locked; // counted transfers not yet seen unlocked
+      bool history_valid = false;
+      std::multimap<uint64_t, const payment_container::value_type*> payments;
+      std::multimap<uint64_t, const std::unordered_map<crypto::hash, confirmed_transfer_details>::value_type*> confirmed_txs;
+      void reset() { *this = wallet_indices{}; }
+    };
+    mutable wallet_indices m_indices;
+    mutable boost::mutex m_indices_lock;
     boost::optional<crypto::chacha_key> m_custom_background_key = boost::none;
     std::shared_ptr<wallet_keys_unlocker> m_encrypt_keys_after_refresh;
 
@@ -2093,16 +2274,16 @@ namespace boost
     }
 
     template <class Archive>
-    inline typename std::enable_if<!Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    inline typename std::enable_if<!Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const cryptonote::transaction_prefix &tx, const boost::serialization::version_type ver)
     {
     }
     template <class Archive>
-    inline typename std::enable_if<Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    inline typename std::enable_if<Archive::is_loading::value, void>::type initialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, const cryptonote::transaction_prefix &tx, const boost::serialization::version_type ver)
     {
         if (ver < 1)
         {
           x.m_mask = rct::identity();
-          x.m_amount = x.m_tx.vout[x.m_internal_output_index].amount;
+          x.m_amount = tx.vout[x.m_internal_output_index].amount;
         }
         if (ver < 2)
         {
@@ -2110,7 +2291,7 @@ namespace boost
         }
         if (ver < 4)
         {
-          x.m_rct = x.m_tx.vout[x.m_internal_output_index].amount == 0;
+          x.m_rct = tx.vout[x.m_internal_output_index].amount == 0;
         }
         if (ver < 6)
         {
@@ -2141,53 +2322,53 @@ namespace boost
     }
 
     template <class Archive>
-    inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    inline void serialize_transfer_details(Archive &a, tools::wallet2::transfer_details &x, cryptonote::transaction_prefix &tx, const boost::serialization::version_type ver)
     {
       a & x.m_block_height;
       a & x.m_global_output_index;
       a & x.m_internal_output_index;
       if (ver < 3)
       {
-        cryptonote::transaction tx;
-        a & tx;
-        x.m_tx = (const cryptonote::transaction_prefix&)tx;
-        x.m_txid = cryptonote::get_transaction_hash(tx);
+        cryptonote::transaction full_tx;
+        a & full_tx;
+        tx = (const cryptonote::transaction_prefix&)full_tx;
+        x.m_txid = cryptonote::get_transaction_hash(full_tx);
       }
       else
       {
-        a & x.m_tx;
+        a & tx;
       }
       a & x.m_spent;
       a & x.m_key_image;
       if (ver < 1)
       {
         // ensure mask and amount are set
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_mask;
       a & x.m_amount;
       if (ver < 2)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_spent_height;
       if (ver < 3)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_txid;
       if (ver < 4)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_rct;
       if (ver < 5)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       if (ver < 6)
@@ -2201,19 +2382,19 @@ namespace boost
       a & x.m_key_image_known;
       if (ver < 7)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_pk_index;
       if (ver < 8)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_subaddr_index;
       if (ver < 9)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_multisig_info;
@@ -2221,24 +2402,36 @@ namespace boost
       a & x.m_key_image_partial;
       if (ver < 10)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_key_image_request;
       if (ver < 11)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_uses;
       if (ver < 12)
       {
-        initialize_transfer_details(a, x, ver);
+        initialize_transfer_details(a, x, tx, ver);
         return;
       }
       a & x.m_frozen;
     }
 
+    template <class Archive>
+    inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    {
+      // boost archives only come from older wallets, which kept the whole transaction prefix
+      if (typename Archive::is_saving())
+        throw std::runtime_error("Boost serialization not supported for transfer_details");
+      cryptonote::transaction_prefix tx;
+      serialize_transfer_details(a, x, tx, ver);
+      if (!x.set_tx_data(tx, true))
+        throw std::runtime_error("Invalid transfer_details");
+    }
+
     template <class Archive>
     inline void serialize(Archive &a, tools::wallet2::multisig_info::LR &x, const boost::serialization::version_type ver)
     {
@@ -30,6 +30,7 @@
 
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread/thread_only.hpp>
+#include <algorithm>
 #include <limits>
 #include "string_tools.h"
 
@@ -635,3 +636,185 @@ bool txpool_stem_loop::generate(std::vector<test_event_entry>& events) const
 
   return true;
 }
+
+txpool_block_template::txpool_block_template()
+  : test_chain_unit_base()
+  , m_last_tx(crypto::null_hash)
+  , m_template()
+{
+  REGISTER_CALLBACK_METHOD(txpool_block_template, check_block_template);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, check_last_tx_mined);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, check_last_tx_not_mined);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, take_best_tx);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, mine_stem_txes);
+  REGISTER_CALLBACK_METHOD(txpool_block_template, stem_last_tx);
+}
+
+bool txpool_block_template::fill_template(cryptonote::core& c, bool from_scratch, std::vector<crypto::hash> &tx_hashes, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward)
+{
+  cryptonote::Blockchain& bc = c.get_blockchain_storage();
+  const uint64_t height = bc.get_current_blockchain_height();
+  const uint64_t already_generated_coins = bc.get_db().get_block_already_generated_coins(height - 1);
+  // the chain is still on v1, but the template is only kept between calls from v5
+  const uint8_t version = 16;
+
+  if (from_scratch)
+    c.get_pool().on_blockchain_inc(height, bc.get_tail_id());
+
+  cryptonote::block b{};
+  if (!c.get_pool().fill_block_template(b, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, already_generated_coins, total_weight, fee, expected_reward, version))
+  {
+    MERROR("Failed to fill block template");
+    return false;
+  }
+  tx_hashes = std::move(b.tx_hashes);
+  return true;
+}
+
+bool txpool_block_template::check_block_template(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<crypto::hash> incremental, scratch;
+  size_t incremental_weight = 0, scratch_weight = 0;
+  uint64_t incremental_fee = 0, scratch_fee = 0;
+  uint64_t incremental_reward = 0, scratch_reward = 0;
+
+  if (!fill_template(c, false, incremental, incremental_weight, incremental_fee, incremental_reward))
+    return false;
+  if (!fill_template(c, true, scratch, scratch_weight, scratch_fee, scratch_reward))
+    return false;
+
+  if (incremental != scratch)
+  {
+    MERROR("Incremental template has " << incremental.size() << " txes, but " << scratch.size() << " when built from scratch");
+    for (const crypto::hash &hash: incremental)
+      MERROR("  incremental: " << hash);
+    for (const crypto::hash &hash: scratch)
+      MERROR("  from scratch: " << hash);
+    return false;
+  }
+  if (incremental_weight != scratch_weight || incremental_fee != scratch_fee || incremental_reward != scratch_reward)
+  {
+    MERROR("Incremental template has weight " << incremental_weight << ", fee " << incremental_fee << ", reward " << incremental_reward
+        << ", but weight " << scratch_weight << ", fee " << scratch_fee << ", reward " << scratch_reward << " when built from scratch");
+    return false;
+  }
+
+  m_template = std::move(scratch);
+  return true;
+}
+
+bool txpool_block_template::check_last_tx_mined(cryptonote::core& /*c*/, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (std::find(m_template.begin(), m_template.end(), m_last_tx) == m_template.end())
+  {
+    MERROR("Tx " << m_last_tx << " is not in the block template");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_block_template::check_last_tx_not_mined(cryptonote::core& /*c*/, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (std::find(m_template.begin(), m_template.end(), m_last_tx) != m_template.end())
+  {
+    MERROR("Tx " << m_last_tx << " should not be in the block template");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_block_template::take_best_tx(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  if (m_template.empty())
+  {
+    MERROR("Block template is empty");
+    return false;
+  }
+
+  cryptonote::transaction tx;
+  cryptonote::blobdata txblob;
+  size_t tx_weight;
+  uint64_t fee;
+  bool relayed, do_not_relay, double_spend_seen, pruned;
+  if (!c.get_pool().take_tx(m_template.front(), tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen, pruned))
+  {
+    MERROR("Failed to take tx " << m_template.front() << " from the pool");
+    return false;
+  }
+  return true;
+}
+
+bool txpool_block_template::mine_stem_txes(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  return c.get_pool().init(0, true);
+}
+
+bool txpool_block_template::stem_last_tx(cryptonote::core& c, size_t /*ev_index*/, const std::vector<test_event_entry>& /*events*/)
+{
+  std::vector<bool> just_broadcasted;
+  c.get_pool().set_relayed(epee::span<const crypto::hash>(&m_last_tx, 1), cryptonote::relay_method::stem, just_broadcasted);
+  return true;
+}
+
+bool txpool_block_template::check_tx_verification_context(const cryptonote::tx_verification_context& tvc, bool tx_added, size_t /*event_idx*/, const cryptonote::transaction& tx)
+{
+  m_last_tx = cryptonote::get_transaction_hash(tx);
+  return !tvc.m_verifivation_failed && tx_added;
+}
+
+bool txpool_block_template::generate(std::vector<test_event_entry>& events) const
+{
+  INIT_MEMPOOL_TEST();
+
+  DO_CALLBACK(events, "check_block_template");
+
+  // a lower fee is tried on top of the current template, a higher one selects again
+  cryptonote::transaction tx_0, tx_1, tx_2, tx_3;
+  construct_tx_to_key(events, tx_0, blk_0r, miner_account, bob_account, send_amount, TESTS_DEFAULT_FEE * 8, 0);
+  events.push_back(tx_0);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+  construct_tx_to_key(events, tx_1, blk_0r, miner_account, bob_account, send_amount, TESTS_DEFAULT_FEE * 2, 0);
+  events.push_back(tx_1);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+  construct_tx_to_key(events, tx_2, blk_0r, miner_account, bob_account, send_amount, TESTS_DEFAULT_FEE * 4, 0);
+  events.push_back(tx_2);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+  construct_tx_to_key(events, tx_3, blk_0r, miner_account, bob_account, send_amount, TESTS_DEFAULT_FEE, 0);
+  events.push_back(tx_3);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+
+  // a selected tx leaving the pool
+  DO_CALLBACK(events, "take_best_tx");
+  DO_CALLBACK(events, "check_block_template");
+
+  // a new block mining one of the txes
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_2);
+  DO_CALLBACK(events, "check_block_template");
+  MAKE_TX(events, tx_4, miner_account, bob_account, send_amount, blk_1);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+
+  // stem txes are only mined once enabled, which changes the cached candidates
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_stem);
+  MAKE_TX(events, tx_5, miner_account, bob_account, send_amount, blk_1);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_not_mined");
+  DO_CALLBACK(events, "mine_stem_txes");
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+
+  // a local tx going to stem becomes minable without being broadcasted
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_local_relay);
+  MAKE_TX(events, tx_6, miner_account, bob_account, send_amount, blk_1);
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_not_mined");
+  DO_CALLBACK(events, "stem_last_tx");
+  DO_CALLBACK(events, "check_block_template");
+  DO_CALLBACK(events, "check_last_tx_mined");
+
+  return true;
+}
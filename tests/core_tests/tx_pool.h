@@ -136,3 +136,25 @@ struct txpool_stem_loop : txpool_double_spend_base
 
   bool generate(std::vector<test_event_entry>& events) const;
 };
+
+class txpool_block_template : public test_chain_unit_base
+{
+  crypto::hash m_last_tx;
+  std::vector<crypto::hash> m_template;
+
+  bool fill_template(cryptonote::core& c, bool from_scratch, std::vector<crypto::hash> &tx_hashes, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward);
+
+public:
+  txpool_block_template();
+
+  bool check_block_template(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_last_tx_mined(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_last_tx_not_mined(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool take_best_tx(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool mine_stem_txes(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool stem_last_tx(cryptonote::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+  bool check_tx_verification_context(const cryptonote::tx_verification_context& tvc, bool tx_added, size_t event_idx, const cryptonote::transaction& tx);
+
+  bool generate(std::vector<test_event_entry>& events) const;
+};
@@ -120,7 +120,7 @@ bool wallet_tools::fill_tx_sources(tools::wallet2 * wallet, std::vector<cryptono
     auto & td = transfers[i];
     if (td.m_spent)
       continue;
-    if (td.m_tx.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_tx.unlock_time > cur_height + 1)
+    if (td.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_unlock_time > cur_height + 1)
       continue;
     if (selected_idx.find((size_t)i) != selected_idx.end()){
       MERROR("Should not happen (selected_idx not found): " << i);
@@ -192,7 +192,7 @@ void wallet_tools::gen_tx_src(size_t mixin, uint64_t cur_height, const tools::wa
 
   cryptonote::tx_source_entry::output_entry &real_oe = src.outputs[real_idx];
   real_oe.first = td.m_global_output_index;
-  real_oe.second.dest = rct::pk2rct(boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key);
+  real_oe.second.dest = rct::pk2rct(td.get_public_key());
   real_oe.second.mask = rct::commit(td.amount(), td.m_mask);
 
   std::sort(src.outputs.begin(), src.outputs.end(), [&](const cryptonote::tx_source_entry::output_entry i0, const cryptonote::tx_source_entry::output_entry i1) {
@@ -207,8 +207,8 @@ void wallet_tools::gen_tx_src(size_t mixin, uint64_t cur_height, const tools::wa
   }
 
   src.mask = td.m_mask;
-  src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx, td.m_pk_index);
-  src.real_out_additional_tx_keys = get_additional_tx_pub_keys_from_extra(td.m_tx);
+  src.real_out_tx_key = td.m_tx_pub_key;
+  src.real_out_additional_tx_keys = td.m_additional_tx_pub_keys;
   src.real_output_in_tx_index = td.m_internal_output_index;
   src.multisig_kLRki = rct::multisig_kLRki({rct::zero(), rct::zero(), rct::zero(), rct::zero()});
 }
@@ -32,6 +32,8 @@
 #include <chrono>
 #include <functional>
 #include <numeric>
+#include <unordered_set>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <vector>
 
@@ -42,6 +44,7 @@
 #include "misc_log_ex.h"
 #include "storages/levin_abstract_invoke2.h"
 #include "common/util.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
 
 #include "net_load_tests.h"
 
@@ -67,6 +70,82 @@ namespace
     return false;
   }
 
+  // Plays a node with several links to the relaying server: each tx is
+  // requested once, however many connections announce it
+  class clt_levin_commands_handler : public test_levin_commands_handler
+  {
+  public:
+    clt_levin_commands_handler()
+      : m_config(nullptr)
+      , m_tx_relay_bytes(0)
+      , m_tx_relay_txs(0)
+    {
+    }
+
+    void set_config(test_levin_protocol_handler_config& config) { m_config = &config; }
+
+    virtual int notify(int command, const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      if (command == cryptonote::NOTIFY_NEW_TRANSACTIONS::ID)
+      {
+        cryptonote::NOTIFY_NEW_TRANSACTIONS::request req;
+        if (epee::serialization::load_t_from_binary(req, in_buff))
+        {
+          m_tx_relay_bytes.fetch_add(sizeof(epee::levin::bucket_head2) + in_buff.size(), std::memory_order_relaxed);
+          m_tx_relay_txs.fetch_add(req.txs.size(), std::memory_order_relaxed);
+        }
+      }
+      else if (command == cryptonote::NOTIFY_TX_POOL_HASH::ID)
+      {
+        cryptonote::NOTIFY_TX_POOL_HASH::request req;
+        if (epee::serialization::load_t_from_binary(req, in_buff))
+        {
+          m_tx_relay_bytes.fetch_add(sizeof(epee::levin::bucket_head2) + in_buff.size(), std::memory_order_relaxed);
+
+          cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::request missing;
+          {
+            boost::unique_lock<boost::mutex> lock(m_requested_txs_mutex);
+            for (const crypto::hash& hash : req.txs)
+            {
+              if (m_requested_txs.insert(hash).second)
+                missing.txs.push_back(hash);
+            }
+          }
+
+          if (!missing.txs.empty() && m_config)
+          {
+            epee::levin::message_writer out;
+            epee::serialization::store_t_to_binary_direct(missing, out.buffer);
+            epee::byte_slice message = out.finalize_notify(cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::ID);
+            m_tx_relay_bytes.fetch_add(message.size(), std::memory_order_relaxed);
+            if (m_config->send(std::move(message), context.m_connection_id) <= 0)
+              LOG_PRINT_L0("Failed to request txs");
+          }
+        }
+      }
+      return test_levin_commands_handler::notify(command, in_buff, context);
+    }
+
+    void reset_tx_relay_statistics()
+    {
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_mutex);
+      m_requested_txs.clear();
+      m_tx_relay_bytes.store(0, std::memory_order_relaxed);
+      m_tx_relay_txs.store(0, std::memory_order_relaxed);
+    }
+
+    //! Bytes exchanged for relay, both received txs/announcements and sent requests
+    size_t tx_relay_bytes() const { return m_tx_relay_bytes.load(std::memory_order_relaxed); }
+    size_t tx_relay_txs() const { return m_tx_relay_txs.load(std::memory_order_relaxed); }
+
+  private:
+    test_levin_protocol_handler_config* m_config;
+    std::atomic<size_t> m_tx_relay_bytes;
+    std::atomic<size_t> m_tx_relay_txs;
+    boost::mutex m_requested_txs_mutex;
+    std::unordered_set<crypto::hash> m_requested_txs;
+  };
+
   class t_connection_opener_1
   {
   public:
@@ -196,6 +275,7 @@ namespace
 
       m_tcp_server.get_config_object().set_handler(&m_commands_handler);
       m_tcp_server.get_config_object().m_invoke_timeout = CONNECTION_TIMEOUT;
+      m_commands_handler.set_config(m_tcp_server.get_config_object());
 
       ASSERT_TRUE(m_tcp_server.init_server(clt_port, "127.0.0.1"));
       ASSERT_TRUE(m_tcp_server.run_server(m_thread_count, false));
@@ -343,7 +423,7 @@ namespace
 
   protected:
     test_tcp_server m_tcp_server;
-    test_levin_commands_handler m_commands_handler;
+    clt_levin_commands_handler m_commands_handler;
     size_t m_thread_count;
     test_connection_context m_context;
   };
@@ -627,6 +707,57 @@ TEST_F(net_load_test_clt, permament_open_and_close_and_connections_closed_by_ser
   ASSERT_EQ(RESERVED_CONN_CNT, m_tcp_server.get_config_object().get_connections_count());
 }
 
+TEST_F(net_load_test_clt, tx_relay_bytes_per_tx_per_peer)
+{
+  static const size_t PEER_COUNT = 8;
+  static const size_t TX_COUNT = 200;
+  static const size_t TX_SIZE = 1500; // about a 2-in/2-out tx
+
+  // Open one connection per simulated peer
+  t_connection_opener_1 connection_opener(m_tcp_server, PEER_COUNT);
+  while (connection_opener.open());
+
+  EXPECT_TRUE(busy_wait_for(DEFAULT_OPERATION_TIMEOUT, [&](){ return PEER_COUNT + RESERVED_CONN_CNT <= m_commands_handler.new_connection_counter() + connection_opener.error_count(); }));
+  ASSERT_EQ(0, connection_opener.error_count());
+
+  CMD_GET_STATISTICS::response srv_stat;
+  ASSERT_TRUE(busy_wait_for_server_statistics(srv_stat, [](const CMD_GET_STATISTICS::response& stat) { return PEER_COUNT + RESERVED_CONN_CNT <= stat.opened_connections_count; }));
+
+  double bytes_per_tx_per_peer[2] = {0, 0};
+  for (const bool announce : {false, true})
+  {
+    m_commands_handler.reset_tx_relay_statistics();
+
+    CMD_START_TX_RELAY_TEST::request req;
+    req.tx_count = TX_COUNT;
+    req.tx_size = TX_SIZE;
+    req.announce = announce;
+    ASSERT_TRUE(epee::net_utils::notify_remote_command2(m_context, CMD_START_TX_RELAY_TEST::ID, req, m_tcp_server.get_config_object()));
+
+    // Pushed txs arrive on every link, announced ones are fetched once
+    const size_t expected_txs = announce ? TX_COUNT : TX_COUNT * PEER_COUNT;
+    EXPECT_TRUE(busy_wait_for(DEFAULT_OPERATION_TIMEOUT, [&](){ return expected_txs <= m_commands_handler.tx_relay_txs(); }));
+    ASSERT_EQ(expected_txs, m_commands_handler.tx_relay_txs());
+
+    // let late announcements arrive, so they are accounted for
+    epee::misc_utils::sleep_no_w(1000);
+
+    bytes_per_tx_per_peer[announce] = double(m_commands_handler.tx_relay_bytes()) / (TX_COUNT * PEER_COUNT);
+    LOG_PRINT_L0((announce ? "announce" : "push") << " relay: " << m_commands_handler.tx_relay_bytes() << " bytes, " <<
+      bytes_per_tx_per_peer[announce] << " bytes per tx per peer");
+  }
+
+  ASSERT_LT(bytes_per_tx_per_peer[true], bytes_per_tx_per_peer[false]);
+
+  // Close connections, and wait for server to see it
+  for (size_t i = 0; i < PEER_COUNT; ++i)
+    connection_opener.close(i);
+
+  EXPECT_TRUE(busy_wait_for(DEFAULT_OPERATION_TIMEOUT, [&](){ return m_commands_handler.new_connection_counter() - RESERVED_CONN_CNT <= m_commands_handler.close_connection_counter(); }));
+  busy_wait_for_server_statistics(srv_stat, [](const CMD_GET_STATISTICS::response& stat) { return stat.opened_connections_count <= RESERVED_CONN_CNT; });
+  ASSERT_EQ(RESERVED_CONN_CNT, srv_stat.opened_connections_count);
+}
+
 int main(int argc, char** argv)
 {
   TRY_ENTRY();
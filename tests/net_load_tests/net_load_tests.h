@@ -226,7 +226,8 @@ namespace net_load_tests
     cmd_reset_statistics_id,
     cmd_shutdown_id,
     cmd_send_data_requests_id,
-    cmd_data_request_id
+    cmd_data_request_id,
+    cmd_start_tx_relay_test_id
   };
 
   struct CMD_CLOSE_ALL_CONNECTIONS
@@ -360,4 +361,24 @@ namespace net_load_tests
       END_KV_SERIALIZE_MAP()
     };
   };
+
+  // Server relays `tx_count` txs of `tx_size` bytes to every other connection,
+  // either pushing the blobs or announcing their hashes (NOTIFY_TX_POOL_HASH)
+  struct CMD_START_TX_RELAY_TEST
+  {
+    const static int ID = cmd_start_tx_relay_test_id;
+
+    struct request
+    {
+      uint64_t tx_count;
+      uint64_t tx_size;
+      bool announce;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(tx_count)
+        KV_SERIALIZE(tx_size)
+        KV_SERIALIZE(announce)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
 }
@@ -28,6 +28,8 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <cstring>
+#include <unordered_map>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
@@ -35,6 +37,8 @@
 #include "misc_log_ex.h"
 #include "storages/levin_abstract_invoke2.h"
 #include "common/util.h"
+#include "crypto/hash.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
 
 #include "net_load_tests.h"
 
@@ -86,6 +90,8 @@ namespace
       HANDLE_NOTIFY_T2(CMD_CLOSE_ALL_CONNECTIONS, &srv_levin_commands_handler::handle_close_all_connections)
       HANDLE_NOTIFY_T2(CMD_SHUTDOWN, &srv_levin_commands_handler::handle_shutdown)
       HANDLE_NOTIFY_T2(CMD_SEND_DATA_REQUESTS, &srv_levin_commands_handler::handle_send_data_requests)
+      HANDLE_NOTIFY_T2(CMD_START_TX_RELAY_TEST, &srv_levin_commands_handler::handle_start_tx_relay_test)
+      HANDLE_NOTIFY_T2(cryptonote::NOTIFY_REQUEST_TX_POOL_TXS, &srv_levin_commands_handler::handle_request_tx_pool_txs)
       HANDLE_INVOKE_T2(CMD_GET_STATISTICS, &srv_levin_commands_handler::handle_get_statistics)
       HANDLE_INVOKE_T2(CMD_RESET_STATISTICS, &srv_levin_commands_handler::handle_reset_statistics)
       HANDLE_INVOKE_T2(CMD_START_OPEN_CLOSE_TEST, &srv_levin_commands_handler::handle_start_open_close_test)
@@ -163,6 +169,64 @@ namespace
       return 1;
     }
 
+    int handle_start_tx_relay_test(int /*command*/, const CMD_START_TX_RELAY_TEST::request& req, test_connection_context& context)
+    {
+      LOG_PRINT_L0("Start tx relay test (" << req.tx_count << ", " << req.tx_size << ", " << (req.announce ? "announce" : "push") << ")");
+
+      cryptonote::NOTIFY_TX_POOL_HASH::request announcement;
+      cryptonote::NOTIFY_NEW_TRANSACTIONS::request push;
+      push.dandelionpp_fluff = true;
+      {
+        boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+        m_tx_relay_pool.clear();
+        for (uint64_t i = 0; i < req.tx_count; ++i)
+        {
+          std::string blob(req.tx_size, '\0');
+          std::memcpy(&blob[0], &i, std::min<size_t>(sizeof(i), blob.size()));
+          const crypto::hash hash = crypto::cn_fast_hash(blob.data(), blob.size());
+          if (req.announce)
+            announcement.txs.push_back(hash);
+          else
+            push.txs.push_back(blob);
+          m_tx_relay_pool.emplace(hash, std::move(blob));
+        }
+      }
+
+      boost::uuids::uuid cmd_conn_id = context.m_connection_id;
+      m_tcp_server.get_config_object().foreach_connection([&](test_connection_context& ctx) {
+        if (ctx.m_connection_id != cmd_conn_id)
+        {
+          bool r = req.announce ?
+            epee::net_utils::notify_remote_command2(ctx, cryptonote::NOTIFY_TX_POOL_HASH::ID, announcement, m_tcp_server.get_config_object()) :
+            epee::net_utils::notify_remote_command2(ctx, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID, push, m_tcp_server.get_config_object());
+          if (!r)
+            LOG_PRINT_L0("Failed to relay txs");
+        }
+        return true;
+      });
+
+      return 1;
+    }
+
+    int handle_request_tx_pool_txs(int /*command*/, const cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::request& req, test_connection_context& context)
+    {
+      cryptonote::NOTIFY_NEW_TRANSACTIONS::request rsp;
+      rsp.dandelionpp_fluff = true;
+      {
+        boost::unique_lock<boost::mutex> lock(m_tx_relay_mutex);
+        for (const crypto::hash& hash : req.txs)
+        {
+          const auto tx = m_tx_relay_pool.find(hash);
+          if (tx != m_tx_relay_pool.end())
+            rsp.txs.push_back(tx->second);
+        }
+      }
+
+      if (!epee::net_utils::notify_remote_command2(context, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID, rsp, m_tcp_server.get_config_object()))
+        LOG_PRINT_L0("Failed to send requested txs");
+      return 1;
+    }
+
   private:
     void close_connections(boost::uuids::uuid cmd_conn_id)
     {
@@ -211,6 +275,9 @@ namespace
     boost::uuids::uuid m_open_close_test_conn_id;
     boost::mutex m_open_close_test_mutex;
     std::unique_ptr<open_close_test_helper> m_open_close_test_helper;
+
+    boost::mutex m_tx_relay_mutex;
+    std::unordered_map<crypto::hash, std::string> m_tx_relay_pool;
   };
 }
 
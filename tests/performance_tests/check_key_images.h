@@ -0,0 +1,123 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <memory>
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/hardfork.h"
+
+// Checks the key images of a batch of incoming two input transactions against
+// a chain with 200k spent key images, as the pool does when admitting them,
+// with or without the in-memory key image filter in front of the db
+template<bool filtered>
+class test_check_key_images
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t num_blocks = 20;
+  static const size_t key_images_per_block = 10000;
+  static const size_t num_txes = 1000;
+  static const size_t inputs_per_tx = 2;
+
+  ~test_check_key_images()
+  {
+    if (m_db)
+    {
+      m_db->close();
+      m_hardfork.reset();
+      m_db.reset();
+      boost::filesystem::remove_all(m_path);
+    }
+  }
+
+  bool init()
+  {
+    m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    m_db.reset(new cryptonote::BlockchainLMDB());
+    m_db->open(m_path);
+    m_hardfork.reset(new cryptonote::HardFork(*m_db, 1, 0));
+    m_hardfork->init();
+    m_db->set_hard_fork(m_hardfork.get());
+
+    {
+      cryptonote::db_wtxn_guard guard(m_db.get());
+      crypto::hash prev_id = crypto::null_hash;
+      for (size_t h = 0; h < num_blocks; ++h)
+      {
+        cryptonote::transaction tx;
+        tx.version = 2;
+        tx.rct_signatures.type = rct::RCTTypeNull;
+        for (size_t i = 0; i < key_images_per_block; ++i)
+        {
+          cryptonote::txin_to_key in;
+          in.amount = 0;
+          in.key_offsets.push_back(i);
+          in.k_image = crypto::rand<crypto::key_image>();
+          tx.vin.push_back(in);
+        }
+        std::vector<std::pair<cryptonote::transaction, cryptonote::blobdata>> txs;
+        txs.push_back(std::make_pair(tx, cryptonote::tx_to_blob(tx)));
+
+        cryptonote::block b;
+        b.major_version = 1;
+        b.minor_version = 0;
+        b.timestamp = h;
+        b.prev_id = prev_id;
+        b.miner_tx.version = 2;
+        b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+        b.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+        m_db->add_block(std::make_pair(b, cryptonote::block_to_blob(b)), 0, 0, h + 1, 0, txs);
+        prev_id = cryptonote::get_block_hash(b);
+      }
+    }
+
+    m_db->enable_key_image_filter(filtered);
+
+    m_key_images.resize(num_txes * inputs_per_tx);
+    for (auto &ki: m_key_images)
+      ki = crypto::rand<crypto::key_image>();
+    return true;
+  }
+
+  bool test()
+  {
+    for (const auto &ki: m_key_images)
+      if (m_db->has_key_image(ki))
+        return false;
+    return true;
+  }
+
+private:
+  std::string m_path;
+  std::unique_ptr<cryptonote::BlockchainLMDB> m_db;
+  std::unique_ptr<cryptonote::HardFork> m_hardfork;
+  std::vector<crypto::key_image> m_key_images;
+};
@@ -142,3 +142,24 @@ private:
   ge_cached cached;
   ge_dsmp precomp0, precomp1, precomp2;
 };
+
+template<test_op op, crypto_ops_backend backend>
+class test_crypto_ops_backend: public test_crypto_ops<op>
+{
+public:
+  ~test_crypto_ops_backend()
+  {
+    crypto_ops_set_backend(saved_backend);
+  }
+
+  bool init()
+  {
+    saved_backend = crypto_ops_get_backend();
+    if (!crypto_ops_set_backend(backend))
+      return false;
+    return test_crypto_ops<op>::init();
+  }
+
+private:
+  crypto_ops_backend saved_backend;
+};
@@ -0,0 +1,86 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <string>
+#include "byte_stream.h"
+#include "cryptonote_config.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+// Loads or stores a span of blocks, as sent in NOTIFY_RESPONSE_GET_OBJECTS
+// while syncing, either through a portable_storage tree or directly
+template<bool direct, bool store>
+class test_epee_block_span
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t txes_per_block = 20;
+  static const size_t tx_size = 2500;
+
+  bool init()
+  {
+    for (size_t b = 0; b < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; ++b)
+    {
+      cryptonote::block_complete_entry entry;
+      entry.block.assign(100 + 32 * txes_per_block, char(b));
+      entry.block_weight = txes_per_block * tx_size;
+      for (size_t t = 0; t < txes_per_block; ++t)
+        entry.txs.push_back({std::string(tx_size, char(t)), crypto::null_hash});
+      m_span.blocks.push_back(std::move(entry));
+    }
+    m_span.current_blockchain_height = 3000000;
+    return epee::serialization::store_t_to_binary(m_span, m_blob);
+  }
+
+  bool test()
+  {
+    if (store)
+    {
+      epee::byte_stream out;
+      out.reserve(256 * 1024);
+      if (direct)
+        return epee::serialization::store_t_to_binary_direct(m_span, out);
+      return epee::serialization::store_t_to_binary(m_span, out);
+    }
+
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request span;
+    bool r;
+    if (direct)
+      r = epee::serialization::load_t_from_binary_direct(span, epee::to_span(m_blob));
+    else
+      r = epee::serialization::load_t_from_binary(span, epee::to_span(m_blob));
+    return r && span.blocks.size() == BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+  }
+
+private:
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request m_span;
+  epee::byte_slice m_blob;
+};
@@ -32,6 +32,7 @@
 
 #include "crypto/crypto.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "ringct/rctOps.h"
 
 #include "single_tx_test_base.h"
 
@@ -47,3 +48,30 @@ public:
     return true;
   }
 };
+
+template<size_t batch_size>
+class test_generate_key_derivations : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 10000 / batch_size;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    for (size_t i = 0; i < batch_size; ++i)
+      m_tx_pub_keys.push_back(rct::rct2pk(rct::pkGen()));
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<crypto::key_derivation> recv_derivations;
+    std::vector<bool> valid;
+    return crypto::generate_key_derivations(m_tx_pub_keys, m_bob.get_keys().m_view_secret_key, recv_derivations, valid);
+  }
+
+private:
+  std::vector<crypto::public_key> m_tx_pub_keys;
+};
@@ -0,0 +1,128 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <random>
+#include <set>
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/hardfork.h"
+
+// Looks up the ring members of a block spending 10k inputs with rings of 16,
+// either one call per ring, like check_tx_inputs, or one call for the whole
+// block, like the block preparation pass, which takes the sorted batched path
+template<bool batched>
+class test_get_output_key
+{
+public:
+  static const size_t loop_count = 10;
+  static const size_t num_blocks = 10;
+  static const size_t outputs_per_block = 10000;
+  static const size_t num_inputs = 10000;
+  static const size_t ring_size = 16;
+
+  ~test_get_output_key()
+  {
+    if (m_db)
+    {
+      m_db->close();
+      m_hardfork.reset();
+      m_db.reset();
+      boost::filesystem::remove_all(m_path);
+    }
+  }
+
+  bool init()
+  {
+    m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    m_db.reset(new cryptonote::BlockchainLMDB());
+    m_db->open(m_path);
+    m_hardfork.reset(new cryptonote::HardFork(*m_db, 1, 0));
+    m_hardfork->init();
+    m_db->set_hard_fork(m_hardfork.get());
+
+    cryptonote::db_wtxn_guard guard(m_db.get());
+    crypto::hash prev_id = crypto::null_hash;
+    for (size_t h = 0; h < num_blocks; ++h)
+    {
+      cryptonote::block b;
+      b.major_version = 1;
+      b.minor_version = 0;
+      b.timestamp = h;
+      b.prev_id = prev_id;
+      b.miner_tx.version = 2;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+      for (size_t i = 0; i < outputs_per_block; ++i)
+        b.miner_tx.vout.push_back(cryptonote::tx_out{1, cryptonote::txout_to_key(crypto::rand<crypto::public_key>())});
+      m_db->add_block(std::make_pair(b, cryptonote::block_to_blob(b)), 0, 0, h + 1, 0, {});
+      prev_id = cryptonote::get_block_hash(b);
+    }
+
+    const uint64_t num_outputs = m_db->get_num_outputs(0);
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<uint64_t> dist(0, num_outputs - 1);
+    m_rings.resize(num_inputs);
+    for (auto &ring: m_rings)
+    {
+      std::set<uint64_t> members;
+      while (members.size() < ring_size)
+        members.insert(dist(rng));
+      ring.assign(members.begin(), members.end());
+      m_offsets.insert(m_offsets.end(), ring.begin(), ring.end());
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    const uint64_t amount = 0;
+    std::vector<cryptonote::output_data_t> outputs;
+    if (batched)
+    {
+      m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), m_offsets, outputs);
+      return outputs.size() == m_offsets.size();
+    }
+    for (const auto &ring: m_rings)
+    {
+      m_db->get_output_key(epee::span<const uint64_t>(&amount, 1), ring, outputs);
+      if (outputs.size() != ring.size())
+        return false;
+    }
+    return true;
+  }
+
+private:
+  std::string m_path;
+  std::unique_ptr<cryptonote::BlockchainLMDB> m_db;
+  std::unique_ptr<cryptonote::HardFork> m_hardfork;
+  std::vector<std::vector<uint64_t>> m_rings;
+  std::vector<uint64_t> m_offsets;
+};
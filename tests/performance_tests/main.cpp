@@ -65,6 +65,11 @@
 #include "multiexp.h"
 #include "sig_mlsag.h"
 #include "sig_clsag.h"
+#include "threadpool.h"
+#include "get_output_key.h"
+#include "check_key_images.h"
+#include "epee_serialization.h"
+#include "wallet_transfers.h"
 
 namespace po = boost::program_options;
 
@@ -203,6 +208,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(filter, p, test_out_can_be_to_acc, true, true); // use view tag, owned
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
   TEST_PERFORMANCE0(filter, p, test_generate_key_derivation);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 1);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 64);
+  TEST_PERFORMANCE1(filter, p, test_generate_key_derivations, 256);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image);
   TEST_PERFORMANCE0(filter, p, test_derive_public_key);
   TEST_PERFORMANCE0(filter, p, test_derive_secret_key);
@@ -316,6 +324,44 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitUncached);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_zeroCommitCached);
 
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_scalarmultBase, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_scalarmultBase, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_scalarmultKey, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_scalarmultKey, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_double_scalarmult_base_vartime, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_double_scalarmult_base_vartime, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_triple_scalarmult_base_vartime, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_triple_scalarmult_base_vartime, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_double_scalarmult_precomp_vartime2, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_double_scalarmult_precomp_vartime2, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_triple_scalarmult_precomp_vartime, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_ge_triple_scalarmult_precomp_vartime, CRYPTO_OPS_BACKEND_FE51);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_isInMainSubgroup, CRYPTO_OPS_BACKEND_REF10);
+  TEST_PERFORMANCE2(filter, p, test_crypto_ops_backend, op_isInMainSubgroup, CRYPTO_OPS_BACKEND_FE51);
+
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 1, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 2, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 4, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 8, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 16, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 32, 4096);
+  TEST_PERFORMANCE2(filter, p, test_threadpool, 64, 4096);
+
+  TEST_PERFORMANCE1(filter, p, test_get_output_key, false);
+  TEST_PERFORMANCE1(filter, p, test_get_output_key, true);
+
+  TEST_PERFORMANCE1(filter, p, test_check_key_images, false);
+  TEST_PERFORMANCE1(filter, p, test_check_key_images, true);
+
+  TEST_PERFORMANCE2(filter, p, test_epee_block_span, false, false);
+  TEST_PERFORMANCE2(filter, p, test_epee_block_span, true, false);
+  TEST_PERFORMANCE2(filter, p, test_epee_block_span, false, true);
+  TEST_PERFORMANCE2(filter, p, test_epee_block_span, true, true);
+
+  TEST_PERFORMANCE1(filter, p, test_wallet2_load_transfers, transfers_compact);
+  TEST_PERFORMANCE1(filter, p, test_wallet2_load_transfers, transfers_migrated);
+  TEST_PERFORMANCE1(filter, p, test_wallet2_load_transfers, transfers_legacy);
+
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 2);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 4);
   TEST_PERFORMANCE2(filter, p, test_multiexp, multiexp_bos_coster, 8);
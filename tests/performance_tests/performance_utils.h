@@ -60,6 +60,59 @@ void set_process_affinity(int core)
 #endif
 }
 
+// Lets threads started while it lives run on any core, and restores the
+// affinity of the calling thread when it goes out of scope
+class scoped_unset_process_affinity
+{
+public:
+  scoped_unset_process_affinity()
+  {
+#if defined (__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__NetBSD__) || defined(__sun)
+    return;
+#elif defined(BOOST_WINDOWS)
+    DWORD_PTR system_mask;
+    m_saved = ::GetProcessAffinityMask(::GetCurrentProcess(), &m_process_mask, &system_mask);
+    if (m_saved)
+      ::SetProcessAffinityMask(::GetCurrentProcess(), system_mask);
+#elif defined(BOOST_HAS_PTHREADS)
+    m_saved = 0 == ::pthread_getaffinity_np(::pthread_self(), sizeof(m_cpuset), &m_cpuset);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int i = 0; i < CPU_SETSIZE; ++i)
+      CPU_SET(i, &cpuset);
+    if (0 != ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset))
+    {
+      std::cout << "pthread_setaffinity_np - ERROR" << std::endl;
+    }
+#endif
+  }
+
+  ~scoped_unset_process_affinity()
+  {
+#if defined (__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__NetBSD__) || defined(__sun)
+    return;
+#elif defined(BOOST_WINDOWS)
+    if (m_saved)
+      ::SetProcessAffinityMask(::GetCurrentProcess(), m_process_mask);
+#elif defined(BOOST_HAS_PTHREADS)
+    if (m_saved && 0 != ::pthread_setaffinity_np(::pthread_self(), sizeof(m_cpuset), &m_cpuset))
+    {
+      std::cout << "pthread_setaffinity_np - ERROR" << std::endl;
+    }
+#endif
+  }
+
+private:
+#if defined (__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__NetBSD__) || defined(__sun)
+#elif defined(BOOST_WINDOWS)
+  bool m_saved;
+  DWORD_PTR m_process_mask;
+#elif defined(BOOST_HAS_PTHREADS)
+  bool m_saved;
+  cpu_set_t m_cpuset;
+#endif
+};
+
 void set_thread_high_priority()
 {
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(_NetBSD_) || defined(__sun)
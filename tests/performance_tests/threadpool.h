@@ -0,0 +1,69 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "common/threadpool.h"
+#include "performance_utils.h"
+
+// Submits a batch of tiny jobs and waits for them, like wallet scanning and
+// block verification do, to measure job throughput against thread count
+template<unsigned int threads, size_t jobs>
+class test_threadpool
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    // threads inherit the affinity of main, which pins us to one core, so
+    // unpin main while they start and pin it back for the other tests
+    scoped_unset_process_affinity unpinned;
+    m_tpool.reset(tools::threadpool::getNewForUnitTests(threads));
+    return true;
+  }
+
+  bool test()
+  {
+    std::atomic<uint64_t> sum(0);
+    tools::threadpool::waiter waiter(*m_tpool);
+    for (size_t n = 0; n < jobs; ++n)
+      m_tpool->submit(&waiter, [&sum, n](){
+        uint64_t x = n;
+        for (int i = 0; i < 64; ++i)
+          x = x * 6364136223846793005ull + 1442695040888963407ull;
+        sum += x;
+      });
+    return waiter.wait();
+  }
+
+private:
+  std::unique_ptr<tools::threadpool> m_tpool;
+};
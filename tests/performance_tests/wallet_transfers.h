@@ -0,0 +1,204 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "crypto/crypto.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "serialization/binary_utils.h"
+#include "wallet/wallet2.h"
+
+enum wallet_transfers_layout
+{
+  transfers_compact, // current cache, current records
+  transfers_migrated, // old cache, current records
+  transfers_legacy, // old cache, old records
+};
+
+// Loads the transfers of a synthetic wallet which received 500k outputs, each
+// in a separate 2 in/2 out tx, from their cache serialization. The memory they
+// take once loaded (not counting allocator overhead) is printed beforehand.
+template<wallet_transfers_layout layout>
+class test_wallet2_load_transfers
+{
+public:
+  static const size_t loop_count = 1;
+  static const size_t num_transfers = 500000;
+
+  bool init()
+  {
+    if (layout == transfers_compact)
+    {
+      std::vector<tools::wallet2::transfer_details> transfers(num_transfers);
+      for (size_t n = 0; n < num_transfers; ++n)
+      {
+        cryptonote::transaction_prefix tx;
+        make_tx(tx);
+        fill_transfer(transfers[n], n);
+        if (!transfers[n].set_tx_data(tx, false))
+          return false;
+      }
+      if (!::serialization::dump_binary(transfers, m_blob))
+        return false;
+    }
+    else
+    {
+      std::vector<tools::wallet2::legacy_transfer_details> transfers(num_transfers);
+      for (size_t n = 0; n < num_transfers; ++n)
+      {
+        make_tx(transfers[n].m_tx);
+        fill_transfer(transfers[n], n);
+      }
+      if (!::serialization::dump_binary(transfers, m_blob))
+        return false;
+    }
+
+    size_t footprint = 0;
+    if (!load(footprint))
+      return false;
+    std::cout << "  " << num_transfers << " transfers: " << footprint / (1024 * 1024) << " MB in memory, "
+        << m_blob.size() / (1024 * 1024) << " MB serialized" << std::endl;
+    return true;
+  }
+
+  bool test()
+  {
+    size_t footprint;
+    return load(footprint);
+  }
+
+private:
+  bool load(size_t &footprint)
+  {
+    switch (layout)
+    {
+      case transfers_compact:
+      {
+        std::vector<tools::wallet2::transfer_details> transfers;
+        if (!::serialization::parse_binary(m_blob, transfers))
+          return false;
+        footprint = get_footprint(transfers);
+        return transfers.size() == num_transfers;
+      }
+      case transfers_migrated:
+      {
+        std::vector<tools::wallet2::legacy_transfer_details> legacy_transfers;
+        if (!::serialization::parse_binary(m_blob, legacy_transfers))
+          return false;
+        const std::vector<tools::wallet2::transfer_details> transfers(legacy_transfers.begin(), legacy_transfers.end());
+        footprint = get_footprint(transfers);
+        return transfers.size() == num_transfers;
+      }
+      case transfers_legacy:
+      {
+        std::vector<tools::wallet2::legacy_transfer_details> transfers;
+        if (!::serialization::parse_binary(m_blob, transfers))
+          return false;
+        footprint = get_footprint(transfers);
+        return transfers.size() == num_transfers;
+      }
+    }
+    return false;
+  }
+
+  static void make_tx(cryptonote::transaction_prefix &tx)
+  {
+    tx.version = 2;
+    tx.unlock_time = 0;
+    for (size_t i = 0; i < 2; ++i)
+    {
+      cryptonote::txin_to_key in;
+      in.amount = 0;
+      for (size_t j = 0; j < 16; ++j)
+        in.key_offsets.push_back(crypto::rand_idx<uint64_t>(j ? 1000000 : 100000000));
+      in.k_image = crypto::rand<crypto::key_image>();
+      tx.vin.push_back(in);
+    }
+    for (size_t i = 0; i < 2; ++i)
+    {
+      cryptonote::tx_out out;
+      out.amount = 0;
+      out.target = cryptonote::txout_to_tagged_key(crypto::rand<crypto::public_key>(), crypto::rand<crypto::view_tag>());
+      tx.vout.push_back(out);
+    }
+    cryptonote::add_tx_pub_key_to_extra(tx, crypto::rand<crypto::public_key>());
+    std::string extra_nonce;
+    cryptonote::set_encrypted_payment_id_to_tx_extra_nonce(extra_nonce, crypto::rand<crypto::hash8>());
+    cryptonote::add_extra_nonce_to_tx_extra(tx.extra, extra_nonce);
+  }
+
+  template<typename T>
+  static void fill_transfer(T &td, size_t n)
+  {
+    td.m_block_height = 2000000 + n / 4;
+    td.m_txid = crypto::rand<crypto::hash>();
+    td.m_internal_output_index = n % 2;
+    td.m_global_output_index = 80000000 + n;
+    td.m_spent = n % 3 == 0;
+    td.m_frozen = false;
+    td.m_spent_height = td.m_spent ? td.m_block_height + 100 : 0;
+    td.m_key_image = crypto::rand<crypto::key_image>();
+    td.m_mask = crypto::rand<rct::key>();
+    td.m_amount = crypto::rand_idx<uint64_t>(1000000000000);
+    td.m_rct = true;
+    td.m_key_image_known = true;
+    td.m_key_image_request = false;
+    td.m_pk_index = 0;
+    td.m_subaddr_index = {0, (uint32_t)(n % 50)};
+    td.m_key_image_partial = false;
+  }
+
+  static size_t get_heap_size(const tools::wallet2::transfer_details &td)
+  {
+    return td.m_additional_tx_pub_keys.capacity() * sizeof(crypto::public_key) + td.m_input_key_images.capacity() * sizeof(crypto::key_image);
+  }
+
+  static size_t get_heap_size(const tools::wallet2::legacy_transfer_details &td)
+  {
+    size_t size = td.m_tx.vin.capacity() * sizeof(cryptonote::txin_v) + td.m_tx.vout.capacity() * sizeof(cryptonote::tx_out) + td.m_tx.extra.capacity();
+    for (const cryptonote::txin_v &in: td.m_tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key))
+        size += boost::get<cryptonote::txin_to_key>(in).key_offsets.capacity() * sizeof(uint64_t);
+    return size;
+  }
+
+  template<typename T>
+  static size_t get_footprint(const std::vector<T> &transfers)
+  {
+    size_t size = transfers.capacity() * sizeof(T);
+    for (const T &td: transfers)
+      size += get_heap_size(td);
+    return size;
+  }
+
+  std::string m_blob;
+};
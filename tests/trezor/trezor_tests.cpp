@@ -492,19 +492,7 @@ static void add_top_hfork(std::vector<test_event_entry>& events, const v_hardfor
 
 static crypto::public_key get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td)
 {
-  std::vector<tx_extra_field> tx_extra_fields;
-  parse_tx_extra(td.m_tx.extra, tx_extra_fields);
-
-  tx_extra_pub_key pub_key_field;
-  THROW_WALLET_EXCEPTION_IF(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 0), tools::error::wallet_internal_error,
-                            "Public key wasn't found in the transaction extra");
-  const crypto::public_key tx_pub_key = pub_key_field.pub_key;
-  bool two_found = find_tx_extra_field_by_type(tx_extra_fields, pub_key_field, 1);
-  if (!two_found) {
-    return tx_pub_key;
-  } else {
-    throw std::runtime_error("Unsupported tx pub resolution");
-  }
+  return td.m_tx_pub_key;
 }
 
 static void generate_tx_block(std::vector<test_event_entry>& events, std::list<cryptonote::transaction> &txs_lst, cryptonote::block & head,
@@ -87,3 +87,24 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1(), na);
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, get_span)
+{
+  cryptonote::block_queue bq;
+  epee::net_utils::network_address na;
+  std::vector<cryptonote::block_complete_entry> bcel;
+
+  bq.add_blocks(0, 200, uuid1(), na);
+  bq.add_blocks(200, 200, uuid2(), na);
+  ASSERT_FALSE(bq.get_span(0, bcel));
+  ASSERT_FALSE(bq.get_span(200, bcel));
+
+  std::vector<cryptonote::block_complete_entry> blocks(200);
+  blocks.back().block = "last";
+  bq.add_blocks(200, blocks, uuid2(), na, 1.0f, 1000);
+  ASSERT_FALSE(bq.get_span(0, bcel));
+  ASSERT_FALSE(bq.get_span(100, bcel));
+  ASSERT_TRUE(bq.get_span(200, bcel));
+  ASSERT_EQ(bcel.size(), 200);
+  ASSERT_EQ(bcel.back().block, "last");
+}
@@ -31,6 +31,7 @@
 #include <cstdio>
 #include <iostream>
 #include <chrono>
+#include <random>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -38,6 +39,8 @@
 #include "string_tools.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/lmdb/db_lmdb.h"
+#include "blockchain_db/tx_blob_codec.h"
+#include "common/pruning.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 
 using namespace cryptonote;
@@ -149,6 +152,98 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+// reads the version property of a closed db directly
+uint32_t get_db_version(const std::string& path)
+{
+  uint32_t version = 0;
+  MDB_env *env;
+  CHECK_AND_ASSERT_THROW_MES(!mdb_env_create(&env), "Failed to create LMDB environment");
+  mdb_env_set_maxdbs(env, 32);
+  if (!mdb_env_open(env, path.c_str(), MDB_RDONLY, 0644))
+  {
+    MDB_txn *txn;
+    if (!mdb_txn_begin(env, NULL, MDB_RDONLY, &txn))
+    {
+      MDB_dbi dbi;
+      if (!mdb_dbi_open(txn, "properties", 0, &dbi) && !mdb_set_compare(txn, dbi, BlockchainLMDB::compare_string))
+      {
+        MDB_val k = {sizeof("version"), (void*)"version"}, v;
+        if (!mdb_get(txn, dbi, &k, &v) && v.mv_size == sizeof(version))
+          memcpy(&version, v.mv_data, sizeof(version));
+      }
+      mdb_txn_abort(txn);
+    }
+  }
+  mdb_env_close(env);
+  return version;
+}
+
+// reads the map size recorded in a closed db directly
+uint64_t get_db_mapsize(const std::string& path)
+{
+  uint64_t mapsize = 0;
+  MDB_env *env;
+  CHECK_AND_ASSERT_THROW_MES(!mdb_env_create(&env), "Failed to create LMDB environment");
+  if (!mdb_env_open(env, path.c_str(), MDB_RDONLY, 0644))
+  {
+    MDB_envinfo mei;
+    if (!mdb_env_info(env, &mei))
+      mapsize = mei.me_mapsize;
+  }
+  mdb_env_close(env);
+  return mapsize;
+}
+
+// blocks on top of parent with only a v2 miner tx each, enough to go past the pruning tip
+std::vector<std::pair<block, blobdata>> make_chain(const block& parent, size_t count)
+{
+  std::vector<std::pair<block, blobdata>> blocks;
+  crypto::hash prev_id = get_block_hash(parent);
+  for (size_t i = 0; i < count; ++i)
+  {
+    block b;
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = parent.timestamp + i + 1;
+    b.prev_id = prev_id;
+    b.nonce = 0;
+    b.miner_tx.version = 2;
+    b.miner_tx.unlock_time = i + 1 + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    b.miner_tx.vin.push_back(txin_gen{i + 1});
+    tx_out out;
+    out.amount = 1000 + i;
+    out.target = txout_to_key(crypto::rand<crypto::public_key>());
+    b.miner_tx.vout.push_back(out);
+    b.miner_tx.rct_signatures.type = rct::RCTTypeNull;
+    prev_id = get_block_hash(b);
+    blocks.push_back(std::make_pair(b, block_to_blob(b)));
+  }
+  return blocks;
+}
+
+// a block on top of parent with one v1 tx spending count new key images
+std::pair<block, blobdata> make_spending_block(const block& parent, size_t count, std::vector<std::pair<transaction, blobdata>> &txs, std::vector<crypto::key_image> &key_images)
+{
+  transaction tx;
+  tx.version = 1;
+  tx.unlock_time = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.push_back(0);
+    in.k_image = crypto::rand<crypto::key_image>();
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(1));
+    key_images.push_back(in.k_image);
+  }
+  txs.push_back(std::make_pair(tx, tx_to_blob(tx)));
+
+  block b = make_chain(parent, 1)[0].first;
+  b.tx_hashes.push_back(get_transaction_hash(tx));
+  return std::make_pair(b, block_to_blob(b));
+}
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -341,4 +436,335 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, GetOutputKeyBatched)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  db_wtxn_guard guard(this->m_db);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  std::set<uint64_t> amounts;
+  for (const auto &b: this->m_blocks)
+    for (const auto &o: b.first.miner_tx.vout)
+      amounts.insert(o.amount);
+  for (const auto &txs: this->m_txs)
+    for (const auto &tx: txs)
+      for (const auto &o: tx.first.vout)
+        amounts.insert(o.amount);
+
+  // every output a few times over, in random order, to go over the batching threshold
+  std::vector<uint64_t> req_amounts, req_offsets;
+  for (int pass = 0; pass < 16; ++pass)
+    for (uint64_t amount: amounts)
+      for (uint64_t i = 0; i < this->m_db->get_num_outputs(amount); ++i)
+      {
+        req_amounts.push_back(amount);
+        req_offsets.push_back(i);
+      }
+  ASSERT_GE(req_offsets.size(), 64);
+  std::vector<size_t> order(req_offsets.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::shuffle(order.begin(), order.end(), std::mt19937(0));
+  std::vector<uint64_t> shuffled_amounts, shuffled_offsets;
+  for (size_t i: order)
+  {
+    shuffled_amounts.push_back(req_amounts[i]);
+    shuffled_offsets.push_back(req_offsets[i]);
+  }
+
+  std::vector<output_data_t> outputs;
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(shuffled_amounts.data(), shuffled_amounts.size()), shuffled_offsets, outputs));
+  ASSERT_EQ(shuffled_offsets.size(), outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i)
+  {
+    const output_data_t od = this->m_db->get_output_key(shuffled_amounts[i], shuffled_offsets[i]);
+    ASSERT_HASH_EQ(od.pubkey, outputs[i].pubkey);
+    ASSERT_EQ(od.unlock_time, outputs[i].unlock_time);
+    ASSERT_EQ(od.height, outputs[i].height);
+    ASSERT_HASH_EQ(od.commitment, outputs[i].commitment);
+  }
+
+  // a missing output truncates a partial result at its position in request order
+  const size_t missing = shuffled_offsets.size() / 2;
+  shuffled_offsets[missing] = this->m_db->get_num_outputs(shuffled_amounts[missing]);
+  ASSERT_NO_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(shuffled_amounts.data(), shuffled_amounts.size()), shuffled_offsets, outputs, true));
+  ASSERT_EQ(missing, outputs.size());
+  ASSERT_THROW(this->m_db->get_output_key(epee::span<const uint64_t>(shuffled_amounts.data(), shuffled_amounts.size()), shuffled_offsets, outputs), OUTPUT_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, KeyImageFilter)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  std::vector<crypto::key_image> key_images;
+  for (const auto &txs: this->m_txs)
+    for (const auto &tx: txs)
+      for (const auto &in: tx.first.vin)
+        key_images.push_back(boost::get<txin_to_key>(in).k_image);
+  ASSERT_FALSE(key_images.empty());
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  ASSERT_FALSE(this->m_db->has_key_image(crypto::rand<crypto::key_image>()));
+
+  // reopening loads the filter stored on close
+  const std::string filter_filename = (tempPath / "spent_keys.filter").string();
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_TRUE(boost::filesystem::exists(filter_filename));
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+
+  // an empty filter stored for another chain state is rebuilt from the db
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_TRUE(key_image_filter(1).store(filter_filename, key_images.size(), crypto::null_hash));
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+}
+
+TYPED_TEST(BlockchainDBTest, KeyImageFilterRebuild)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+  BlockchainLMDB *db = dynamic_cast<BlockchainLMDB*>(this->m_db);
+  ASSERT_TRUE(db != nullptr);
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // rebuilt as small as it gets, so one block can go past its capacity
+  ASSERT_NO_THROW(db->enable_key_image_filter(false));
+  ASSERT_EQ(0, db->get_key_image_filter_capacity());
+  ASSERT_NO_THROW(db->enable_key_image_filter(true, 1));
+  const uint64_t capacity = db->get_key_image_filter_capacity();
+  ASSERT_GT(capacity, 0);
+
+  // the filter is rebuilt at twice the size within the write txn, and keeps
+  // the key images that txn added before the rebuild
+  std::vector<std::pair<transaction, blobdata>> txs;
+  std::vector<crypto::key_image> key_images;
+  const std::pair<block, blobdata> blk = make_spending_block(this->m_blocks[1].first, capacity + 1, txs, key_images);
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(blk, t_sizes[1], t_sizes[1], t_diffs[1] + 1, t_coins[1], txs));
+  }
+  ASSERT_EQ(capacity * 2, db->get_key_image_filter_capacity());
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+
+  // during a batch, only the writer can turn it on, and it sees the key
+  // images the batch has not committed yet
+  ASSERT_NO_THROW(db->enable_key_image_filter(false));
+  ASSERT_TRUE(this->m_db->batch_start());
+  txs.clear();
+  key_images.clear();
+  const std::pair<block, blobdata> batch_blk = make_spending_block(blk.first, 10, txs, key_images);
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(batch_blk, t_sizes[1], t_sizes[1], t_diffs[1] + 2, t_coins[1], txs));
+  }
+  bool other_thread_threw = false;
+  std::thread other_thread([&]() {
+    try { db->enable_key_image_filter(true, 1); }
+    catch (const DB_ERROR_TXN_START &) { other_thread_threw = true; }
+  });
+  other_thread.join();
+  ASSERT_TRUE(other_thread_threw);
+  ASSERT_EQ(0, db->get_key_image_filter_capacity());
+  ASSERT_NO_THROW(db->enable_key_image_filter(true, 1));
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  for (const auto &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+}
+
+TYPED_TEST(BlockchainDBTest, ReserveMap)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+  const std::string defaultPath = (tempPath / "default").string();
+  const std::string reservedPath = (tempPath / "reserved").string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(defaultPath));
+  this->get_filenames();
+  ASSERT_NO_THROW(this->m_db->close());
+  const uint64_t default_mapsize = get_db_mapsize(defaultPath);
+  ASSERT_GT(default_mapsize, 0);
+  ASSERT_LT(default_mapsize, 1ull << 40);
+
+  // the whole map is reserved at open, without the file taking that much
+  ASSERT_NO_THROW(this->m_db->open(reservedPath, DBF_RESERVE_MAP));
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_EQ(1ull << 40, get_db_mapsize(reservedPath));
+}
+
+TEST(BlockchainLMDB, ResizedMapsize)
+{
+  static const uint64_t GB = 1ull << 30;
+  static const uint64_t page_size = 4096;
+  static const uint64_t lots = std::numeric_limits<uint64_t>::max();
+
+  // small maps grow by 1GB, large ones by a quarter of their size
+  ASSERT_EQ(2 * GB, BlockchainLMDB::get_resized_mapsize(GB, page_size, 0, lots));
+  ASSERT_EQ(5 * GB, BlockchainLMDB::get_resized_mapsize(4 * GB, page_size, 0, lots));
+  ASSERT_EQ(50 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 0, lots));
+
+  // a larger increase asked for is a lower bound
+  ASSERT_EQ(3 * GB, BlockchainLMDB::get_resized_mapsize(GB, page_size, 2 * GB, lots));
+  ASSERT_EQ(50 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 2 * GB, lots));
+  ASSERT_EQ(60 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 20 * GB, lots));
+
+  // the free space is checked against the real increase, falling back to
+  // the least one when the geometric one does not fit
+  ASSERT_EQ(50 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 0, 10 * GB));
+  ASSERT_EQ(41 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 0, 10 * GB - 1));
+  ASSERT_EQ(42 * GB, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 2 * GB, 3 * GB));
+  ASSERT_EQ(0, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 0, GB - 1));
+  ASSERT_EQ(0, BlockchainLMDB::get_resized_mapsize(40 * GB, page_size, 2 * GB, 2 * GB - 1));
+}
+
+TYPED_TEST(BlockchainDBTest, CompressedTxData)
+{
+  if (!tx_blob_codec::available())
+    return;
+
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+  const std::string compressedPath = (tempPath / "compressed").string();
+  const std::string rewrittenPath = (tempPath / "rewritten").string();
+
+  this->set_prefix(dirPath);
+
+  const std::vector<std::pair<block, blobdata>> chain = make_chain(this->m_blocks[0].first, CRYPTONOTE_PRUNING_TIP_BLOCKS + 100);
+  const std::vector<std::pair<transaction, blobdata>> no_txs;
+  const crypto::hash v1_txid = this->m_blocks[0].first.tx_hashes[0];
+  const blobdata &v1_blob = this->m_txs[0][0].second;
+  const crypto::hash first_miner_txid = get_transaction_hash(this->m_blocks[0].first.miner_tx);
+
+  auto add_chain = [&]() {
+    db_wtxn_guard guard(this->m_db);
+    this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]);
+    for (size_t i = 0; i < chain.size(); ++i)
+      this->m_db->add_block(chain[i], t_sizes[1], t_sizes[1], t_diffs[0] + i + 1, t_coins[0], no_txs);
+  };
+
+  // all the ways to read tx data give back what was added
+  auto check_tx_data = [&]() {
+    blobdata bd, pruned, prunable;
+    ASSERT_TRUE(this->m_db->get_tx_blob(v1_txid, bd));
+    ASSERT_EQ(v1_blob, bd);
+    ASSERT_TRUE(this->m_db->get_pruned_tx_blob(v1_txid, pruned));
+    ASSERT_TRUE(this->m_db->get_prunable_tx_blob(v1_txid, prunable));
+    ASSERT_EQ(v1_blob, pruned + prunable);
+    for (const auto &b: chain)
+    {
+      ASSERT_TRUE(this->m_db->get_tx_blob(get_transaction_hash(b.first.miner_tx), bd));
+      ASSERT_EQ(tx_to_blob(b.first.miner_tx), bd);
+    }
+
+    std::vector<blobdata> bds;
+    ASSERT_TRUE(this->m_db->get_pruned_tx_blobs_from(first_miner_txid, 3, bds));
+    ASSERT_EQ(3, bds.size());
+    ASSERT_TRUE(this->m_db->get_pruned_tx_blob(first_miner_txid, bd));
+    ASSERT_EQ(bd, bds[0]);
+    ASSERT_EQ(pruned, bds[1]);
+    ASSERT_TRUE(this->m_db->get_pruned_tx_blob(get_transaction_hash(chain[0].first.miner_tx), bd));
+    ASSERT_EQ(bd, bds[2]);
+
+    std::vector<std::pair<std::pair<blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, blobdata>>>> blocks;
+    ASSERT_TRUE(this->m_db->get_blocks_from(0, 1, 1, 100, 1024 * 1024, blocks, false, true, false));
+    ASSERT_EQ(1, blocks.size());
+    ASSERT_EQ(1, blocks[0].second.size());
+    ASSERT_HASH_EQ(v1_txid, blocks[0].second[0].first);
+    ASSERT_EQ(v1_blob, blocks[0].second[0].second);
+    ASSERT_TRUE(this->m_db->get_blocks_from(0, 1, 1, 100, 1024 * 1024, blocks, true, true, false));
+    ASSERT_EQ(1, blocks.size());
+    ASSERT_EQ(1, blocks[0].second.size());
+    ASSERT_EQ(pruned, blocks[0].second[0].second);
+  };
+
+  // compressing new txes: the version only changes once compressed data is written
+  ASSERT_NO_THROW(this->m_db->open(compressedPath, DBF_COMPRESS));
+  this->get_filenames();
+  this->init_hard_fork();
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_EQ(5, get_db_version(compressedPath));
+
+  ASSERT_NO_THROW(this->m_db->open(compressedPath, DBF_COMPRESS));
+  ASSERT_NO_THROW(add_chain());
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_EQ(6, get_db_version(compressedPath));
+
+  ASSERT_NO_THROW(this->m_db->open(compressedPath));
+  check_tx_data();
+
+  // pruning drops the compressed prunable records of old v2 txes only
+  const crypto::hash pruned_txid = get_transaction_hash(chain[0].first.miner_tx);
+  const crypto::hash tip_txid = get_transaction_hash(chain.back().first.miner_tx);
+  blobdata bd, pruned_bd;
+  ASSERT_TRUE(this->m_db->get_pruned_tx_blob(pruned_txid, pruned_bd));
+  ASSERT_TRUE(this->m_db->prune_blockchain(tools::make_pruning_seed(2, CRYPTONOTE_PRUNING_LOG_STRIPES)));
+  ASSERT_FALSE(this->m_db->get_tx_blob(pruned_txid, bd));
+  ASSERT_TRUE(this->m_db->get_pruned_tx_blob(pruned_txid, bd));
+  ASSERT_EQ(pruned_bd, bd);
+  ASSERT_TRUE(this->m_db->get_tx_blob(tip_txid, bd));
+  ASSERT_EQ(tx_to_blob(chain.back().first.miner_tx), bd);
+  ASSERT_TRUE(this->m_db->get_tx_blob(v1_txid, bd));
+  ASSERT_EQ(v1_blob, bd);
+  ASSERT_NO_THROW(this->m_db->close());
+
+  // rewriting existing txes in place
+  ASSERT_NO_THROW(this->m_db->open(rewrittenPath));
+  this->init_hard_fork();
+  ASSERT_NO_THROW(add_chain());
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_EQ(5, get_db_version(rewrittenPath));
+
+  ASSERT_NO_THROW(this->m_db->open(rewrittenPath));
+  ASSERT_NO_THROW(dynamic_cast<BlockchainLMDB*>(this->m_db)->compress_tx_data(3, 0, false));
+  check_tx_data();
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_EQ(6, get_db_version(rewrittenPath));
+
+  ASSERT_NO_THROW(this->m_db->open(rewrittenPath));
+  check_tx_data();
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
 }  // anonymous namespace
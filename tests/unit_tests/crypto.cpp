@@ -26,11 +26,13 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <cstdint>
 #include <gtest/gtest.h>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 extern "C"
 {
@@ -41,6 +43,7 @@ extern "C"
 #include "cryptonote_basic/merge_mining.h"
 #include "ringct/rctOps.h"
 #include "ringct/rctTypes.h"
+#include "misc_language.h"
 
 namespace
 {
@@ -345,3 +348,171 @@ TEST(Crypto, generator_consistency)
   // ringct/rctTypes.h
   ASSERT_TRUE(memcmp(H.data, rct::H.bytes, 32) == 0);
 }
+
+TEST(Crypto, generate_key_derivations)
+{
+  const crypto::secret_key view_sec = rct::rct2sk(rct::skGen());
+  std::vector<crypto::public_key> pubs;
+  for (size_t i = 0; i < 2 * GE_TOBYTES_BATCH + 3; ++i)
+    pubs.push_back(rct::rct2pk(rct::pkGen()));
+  // not a point
+  memset(pubs[5].data, 0, sizeof(pubs[5].data));
+  pubs[5].data[0] = 2;
+  std::vector<crypto::public_key> valid_pubs = pubs;
+  valid_pubs.erase(valid_pubs.begin() + 5);
+
+  const crypto_ops_backend saved_backend = crypto_ops_get_backend();
+  const auto restore_backend = epee::misc_utils::create_scope_leave_handler([saved_backend](){
+    crypto_ops_set_backend(saved_backend);
+  });
+  std::vector<std::vector<crypto::key_derivation>> per_backend;
+  for (const crypto_ops_backend backend: {CRYPTO_OPS_BACKEND_REF10, CRYPTO_OPS_BACKEND_FE51})
+  {
+    if (!crypto_ops_set_backend(backend))
+      continue;
+    std::vector<crypto::key_derivation> derivations, single;
+    std::vector<bool> valid, single_valid;
+    ASSERT_FALSE(crypto::generate_key_derivations(pubs, view_sec, derivations, valid));
+    ASSERT_FALSE(crypto::generate_key_derivations_each(pubs, single, single_valid, [&view_sec](const crypto::public_key &pub, crypto::key_derivation &derivation) {
+      return crypto::generate_key_derivation(pub, view_sec, derivation);
+    }));
+    ASSERT_EQ(derivations.size(), pubs.size());
+    ASSERT_EQ(single.size(), pubs.size());
+    ASSERT_EQ(valid, single_valid);
+    ASSERT_FALSE(memcmp(derivations.data(), single.data(), pubs.size() * sizeof(crypto::key_derivation)));
+    ASSERT_FALSE(valid[5]);
+    per_backend.push_back(derivations);
+
+    ASSERT_TRUE(crypto::generate_key_derivations(valid_pubs, view_sec, derivations, valid));
+  }
+  for (size_t i = 1; i < per_backend.size(); ++i)
+    ASSERT_FALSE(memcmp(per_backend[0].data(), per_backend[i].data(), pubs.size() * sizeof(crypto::key_derivation)));
+}
+
+TEST(Crypto, rx_slow_hash_batch)
+{
+  crypto::hash seed_hash;
+  memset(seed_hash.data, 0x42, sizeof(seed_hash.data));
+
+  std::vector<std::string> blobs;
+  for (size_t i = 0; i < 5; ++i)
+    blobs.push_back(std::string(76 + i, (char)i));
+
+  std::vector<const void*> data;
+  std::vector<size_t> lengths;
+  for (const auto &blob: blobs)
+  {
+    data.push_back(blob.data());
+    lengths.push_back(blob.size());
+  }
+
+  std::vector<crypto::hash> batched(blobs.size());
+  crypto::rx_slow_hash_batch(seed_hash.data, data.data(), lengths.data(), blobs.size(), batched[0].data);
+  for (size_t i = 0; i < blobs.size(); ++i)
+  {
+    crypto::hash single;
+    crypto::rx_slow_hash(seed_hash.data, blobs[i].data(), blobs[i].size(), single.data);
+    ASSERT_EQ(single, batched[i]);
+  }
+  ASSERT_NE(batched[0], batched[1]);
+
+  crypto::rx_slow_hash_free_state();
+}
+
+namespace
+{
+  crypto::hash rx_seed(size_t n)
+  {
+    crypto::hash seed_hash;
+    memset(seed_hash.data, 0, sizeof(seed_hash.data));
+    memcpy(seed_hash.data, "rx light cache test", 19);
+    seed_hash.data[31] = n;
+    return seed_hash;
+  }
+
+  crypto::hash rx_test_hash(const crypto::hash &seed_hash)
+  {
+    static const char blob[] = "RandomX light cache test blob";
+    crypto::hash res;
+    crypto::rx_slow_hash(seed_hash.data, blob, sizeof(blob), res.data);
+    return res;
+  }
+
+  std::vector<crypto::hash> rx_light_cache_seeds()
+  {
+    std::vector<crypto::hash> seeds(8);
+    seeds.resize(crypto::rx_get_light_cache_seedhashes(seeds[0].data, seeds.size()));
+    return seeds;
+  }
+}
+
+TEST(Crypto, rx_light_cache_lru)
+{
+  // hash with more seed hashes than there can be caches, so all of them are ours
+  std::vector<crypto::hash> hashes;
+  for (size_t n = 0; n < 9; ++n)
+    hashes.push_back(rx_test_hash(rx_seed(n)));
+  std::vector<crypto::hash> seeds = rx_light_cache_seeds();
+  const size_t num_caches = seeds.size();
+  ASSERT_GE(num_caches, 2);
+  ASSERT_LT(num_caches, 9);
+  for (size_t i = 0; i < num_caches; ++i)
+    ASSERT_EQ(seeds[i], rx_seed(9 - num_caches + i));
+
+  // using the least recently used one makes it the most recently used
+  const size_t oldest = 9 - num_caches;
+  ASSERT_EQ(rx_test_hash(rx_seed(oldest)), hashes[oldest]);
+  seeds = rx_light_cache_seeds();
+  ASSERT_EQ(seeds.size(), num_caches);
+  ASSERT_EQ(seeds.back(), rx_seed(oldest));
+  ASSERT_EQ(seeds.front(), rx_seed(oldest + 1));
+
+  // so a new seed hash evicts the next one
+  const crypto::hash new_hash = rx_test_hash(rx_seed(9));
+  seeds = rx_light_cache_seeds();
+  ASSERT_EQ(seeds.size(), num_caches);
+  ASSERT_EQ(seeds.back(), rx_seed(9));
+  ASSERT_EQ(std::find(seeds.begin(), seeds.end(), rx_seed(oldest + 1)), seeds.end());
+  ASSERT_NE(std::find(seeds.begin(), seeds.end(), rx_seed(oldest)), seeds.end());
+
+  // and rebuilding an evicted one gives the same hashes
+  ASSERT_EQ(rx_test_hash(rx_seed(oldest + 1)), hashes[oldest + 1]);
+  ASSERT_EQ(rx_test_hash(rx_seed(0)), hashes[0]);
+  ASSERT_NE(new_hash, hashes[0]);
+
+  crypto::rx_slow_hash_free_state();
+}
+
+TEST(Crypto, rx_next_seedhash)
+{
+  const crypto::hash main_seed = rx_seed(20), next_seed = rx_seed(21);
+  const crypto::hash main_hash = rx_test_hash(main_seed);
+  const crypto::hash next_hash = rx_test_hash(next_seed);
+  ASSERT_NE(next_hash, main_hash);
+
+  // evict both
+  for (size_t n = 0; n < 9; ++n)
+    rx_test_hash(rx_seed(30 + n));
+  std::vector<crypto::hash> seeds = rx_light_cache_seeds();
+  ASSERT_EQ(std::find(seeds.begin(), seeds.end(), next_seed), seeds.end());
+
+  // the light cache for the next seed hash is built in the background, before the switch
+  crypto::rx_set_main_seedhash(main_seed.data, 1);
+  crypto::rx_set_next_seedhash(next_seed.data, 1);
+  for (int i = 0; i < 300; ++i)
+  {
+    seeds = rx_light_cache_seeds();
+    if (std::find(seeds.begin(), seeds.end(), next_seed) != seeds.end())
+      break;
+    epee::misc_utils::sleep_no_w(100);
+  }
+  ASSERT_NE(std::find(seeds.begin(), seeds.end(), next_seed), seeds.end());
+  ASSERT_EQ(rx_test_hash(next_seed), next_hash);
+
+  // after the switch, both seed hashes still hash the same
+  crypto::rx_set_main_seedhash(next_seed.data, 1);
+  ASSERT_EQ(rx_test_hash(next_seed), next_hash);
+  ASSERT_EQ(rx_test_hash(main_seed), main_hash);
+
+  crypto::rx_slow_hash_free_state();
+}
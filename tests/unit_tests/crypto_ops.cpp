@@ -0,0 +1,312 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+#include <array>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+#include "crypto/crypto-ops.h"
+}
+#include "crypto/crypto.h"
+#include "misc_language.h"
+#include "string_tools.h"
+
+namespace
+{
+  typedef std::array<unsigned char, 32> bytes32;
+  typedef std::vector<std::pair<std::string, std::string>> op_results;
+
+  bytes32 from_hex(const char *hex)
+  {
+    bytes32 res;
+    EXPECT_TRUE(epee::string_tools::hex_to_pod(hex, res));
+    return res;
+  }
+
+  // identity, the other small order points and some invalid encodings
+  const char *const edge_points[] = {
+    "0100000000000000000000000000000000000000000000000000000000000000",
+    "ecffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f",
+    "0000000000000000000000000000000000000000000000000000000000000000",
+    "0000000000000000000000000000000000000000000000000000000000000080",
+    "26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc05",
+    "26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc85",
+    "c7176a703d4dd84fba3c0b760d10670f2a2053fa2c39ccc64ec7fd7792ac037a",
+    "c7176a703d4dd84fba3c0b760d10670f2a2053fa2c39ccc64ec7fd7792ac03fa",
+    "0100000000000000000000000000000000000000000000000000000000000080",
+    "0200000000000000000000000000000000000000000000000000000000000000",
+    "edffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f",
+    "eeffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f",
+    "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+  };
+
+  // zero, one, eight, l - 1, l and the largest value ge_scalarmult accepts
+  const char *const edge_scalars[] = {
+    "0000000000000000000000000000000000000000000000000000000000000000",
+    "0100000000000000000000000000000000000000000000000000000000000000",
+    "0800000000000000000000000000000000000000000000000000000000000000",
+    "ecd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010",
+    "edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010",
+    "ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f",
+  };
+
+  struct test_inputs
+  {
+    std::vector<bytes32> points;
+    std::vector<bytes32> scalars;
+  };
+
+  test_inputs make_inputs()
+  {
+    test_inputs inputs;
+    for (const char *hex: edge_points)
+      inputs.points.push_back(from_hex(hex));
+    for (const char *hex: edge_scalars)
+      inputs.scalars.push_back(from_hex(hex));
+    for (size_t i = 0; i < 24; ++i)
+    {
+      // random valid points, and random bytes which are about half invalid
+      bytes32 s = crypto::rand<bytes32>();
+      sc_reduce32(s.data());
+      ge_p3 P;
+      ge_scalarmult_base(&P, s.data());
+      bytes32 p;
+      ge_p3_tobytes(p.data(), &P);
+      inputs.points.push_back(p);
+      inputs.points.push_back(crypto::rand<bytes32>());
+    }
+    for (size_t i = 0; i < 8; ++i)
+    {
+      bytes32 s = crypto::rand<bytes32>();
+      sc_reduce32(s.data());
+      inputs.scalars.push_back(s);
+    }
+    return inputs;
+  }
+
+  void add(op_results &results, const std::string &label, const unsigned char *data, size_t size)
+  {
+    results.emplace_back(label, std::string(reinterpret_cast<const char*>(data), size));
+  }
+
+  void add_p2(op_results &results, const std::string &label, const ge_p2 *p)
+  {
+    unsigned char s[32];
+    ge_tobytes(s, p);
+    add(results, label, s, sizeof(s));
+
+    // feed the result to ref10 only code, which relies on the limb ranges left by fe_mul
+    ge_p1p1 q;
+    ge_p2 r;
+    ge_mul8(&q, p);
+    ge_p1p1_to_p2(&r, &q);
+    ge_tobytes(s, &r);
+    add(results, label + "/mul8", s, sizeof(s));
+  }
+
+  void add_p3(op_results &results, const std::string &label, const ge_p3 *p)
+  {
+    unsigned char s[32];
+    ge_p3_tobytes(s, p);
+    add(results, label, s, sizeof(s));
+
+    ge_cached c;
+    ge_p1p1 q;
+    ge_p3 r;
+    ge_p3_to_cached(&c, p);
+    ge_add(&q, p, &c);
+    ge_p1p1_to_p3(&r, &q);
+    ge_p3_tobytes(s, &r);
+    add(results, label + "/dbl", s, sizeof(s));
+
+    ge_p2 p2;
+    ge_p3_to_p2(&p2, p);
+    add_p2(results, label + "/p2", &p2);
+  }
+
+  // runs every entry point the backend dispatches on all combinations of the inputs
+  op_results run_ops(const test_inputs &inputs)
+  {
+    op_results results;
+    std::vector<ge_p3> valid;
+    for (size_t i = 0; i < inputs.points.size(); ++i)
+    {
+      const std::string label = "point " + std::to_string(i);
+      ge_p3 P;
+      const int r = ge_frombytes_vartime(&P, inputs.points[i].data());
+      add(results, label + " frombytes", reinterpret_cast<const unsigned char*>(&r), sizeof(r));
+      if (r == 0)
+      {
+        add_p3(results, label + " frombytes", &P);
+        valid.push_back(P);
+      }
+
+      ge_p2 h;
+      ge_fromfe_frombytes_vartime(&h, inputs.points[i].data());
+      add_p2(results, label + " fromfe_frombytes", &h);
+    }
+
+    ge_p3 G;
+    ge_scalarmult_base(&G, inputs.scalars[1].data());
+    ge_dsmp Gi;
+    ge_dsm_precomp(Gi, &G);
+
+    for (size_t i = 0; i < valid.size(); ++i)
+    {
+      const ge_p3 &A = valid[i];
+      const ge_p3 &B = valid[(i + 1) % valid.size()];
+      ge_dsmp Ai, Bi;
+      ge_dsm_precomp(Ai, &A);
+      ge_dsm_precomp(Bi, &B);
+      for (size_t j = 0; j < inputs.scalars.size(); ++j)
+      {
+        const std::string label = "valid point " + std::to_string(i) + " scalar " + std::to_string(j);
+        const unsigned char *a = inputs.scalars[j].data();
+        const unsigned char *b = inputs.scalars[(j + 1) % inputs.scalars.size()].data();
+        const unsigned char *c = inputs.scalars[(j + 2) % inputs.scalars.size()].data();
+        ge_p2 r2;
+        ge_p3 r3;
+
+        ge_scalarmult(&r2, a, &A);
+        add_p2(results, label + " scalarmult", &r2);
+        ge_scalarmult_p3(&r3, a, &A);
+        add_p3(results, label + " scalarmult_p3", &r3);
+        ge_double_scalarmult_base_vartime(&r2, a, &A, b);
+        add_p2(results, label + " double_scalarmult_base_vartime", &r2);
+        ge_double_scalarmult_base_vartime_p3(&r3, a, &A, b);
+        add_p3(results, label + " double_scalarmult_base_vartime_p3", &r3);
+        ge_double_scalarmult_precomp_vartime(&r2, a, &A, b, Bi);
+        add_p2(results, label + " double_scalarmult_precomp_vartime", &r2);
+        ge_double_scalarmult_precomp_vartime2(&r2, a, Ai, b, Bi);
+        add_p2(results, label + " double_scalarmult_precomp_vartime2", &r2);
+        ge_double_scalarmult_precomp_vartime2_p3(&r3, a, Ai, b, Bi);
+        add_p3(results, label + " double_scalarmult_precomp_vartime2_p3", &r3);
+        ge_triple_scalarmult_base_vartime(&r2, a, b, Ai, c, Bi);
+        add_p2(results, label + " triple_scalarmult_base_vartime", &r2);
+        ge_triple_scalarmult_precomp_vartime(&r2, a, Ai, b, Bi, c, Gi);
+        add_p2(results, label + " triple_scalarmult_precomp_vartime", &r2);
+      }
+    }
+
+    for (size_t j = 0; j < inputs.scalars.size(); ++j)
+    {
+      ge_p3 r3;
+      ge_scalarmult_base(&r3, inputs.scalars[j].data());
+      add_p3(results, "scalar " + std::to_string(j) + " scalarmult_base", &r3);
+
+      // more points than GE_TOBYTES_BATCH, so the batch is split
+      std::vector<unsigned char> points, out(32 * 2 * inputs.points.size());
+      std::vector<int> ok(2 * inputs.points.size());
+      for (size_t n = 0; n < 2; ++n)
+        for (const bytes32 &p: inputs.points)
+          points.insert(points.end(), p.begin(), p.end());
+      ge_scalarmult8_tobytes_batch(out.data(), ok.data(), inputs.scalars[j].data(), points.data(), ok.size());
+      add(results, "scalar " + std::to_string(j) + " scalarmult8_tobytes_batch", out.data(), out.size());
+      add(results, "scalar " + std::to_string(j) + " scalarmult8_tobytes_batch ok",
+        reinterpret_cast<const unsigned char*>(ok.data()), ok.size() * sizeof(int));
+    }
+
+    return results;
+  }
+}
+
+TEST(crypto_ops, backends_identical)
+{
+  const crypto_ops_backend saved_backend = crypto_ops_get_backend();
+  const auto restore_backend = epee::misc_utils::create_scope_leave_handler([saved_backend](){
+    crypto_ops_set_backend(saved_backend);
+  });
+  if (!crypto_ops_set_backend(CRYPTO_OPS_BACKEND_FE51))
+    return;
+
+  const test_inputs inputs = make_inputs();
+  ASSERT_GT(2 * inputs.points.size(), GE_TOBYTES_BATCH);
+
+  ASSERT_TRUE(crypto_ops_set_backend(CRYPTO_OPS_BACKEND_REF10));
+  const op_results ref10 = run_ops(inputs);
+  ASSERT_TRUE(crypto_ops_set_backend(CRYPTO_OPS_BACKEND_FE51));
+  const op_results fe51 = run_ops(inputs);
+
+  ASSERT_EQ(ref10.size(), fe51.size());
+  for (size_t i = 0; i < ref10.size(); ++i)
+  {
+    ASSERT_EQ(ref10[i].first, fe51[i].first);
+    EXPECT_EQ(epee::string_tools::buff_to_hex_nodelimer(ref10[i].second), epee::string_tools::buff_to_hex_nodelimer(fe51[i].second))
+      << ref10[i].first;
+  }
+}
+
+TEST(crypto_ops, backends_edge_cases)
+{
+  const crypto_ops_backend saved_backend = crypto_ops_get_backend();
+  const auto restore_backend = epee::misc_utils::create_scope_leave_handler([saved_backend](){
+    crypto_ops_set_backend(saved_backend);
+  });
+
+  for (const crypto_ops_backend backend: {CRYPTO_OPS_BACKEND_REF10, CRYPTO_OPS_BACKEND_FE51})
+  {
+    if (!crypto_ops_set_backend(backend))
+      continue;
+
+    // the identity and the other small order points decode, and are killed by 8
+    for (size_t i = 0; i < 8; ++i)
+    {
+      const bytes32 p = from_hex(edge_points[i]);
+      ge_p3 P;
+      ASSERT_EQ(ge_frombytes_vartime(&P, p.data()), 0) << i;
+      bytes32 s;
+      ge_p3_tobytes(s.data(), &P);
+      if (i != 3)
+        ASSERT_EQ(s, p) << i;
+
+      ge_p2 r;
+      ge_scalarmult(&r, from_hex(edge_scalars[2]).data(), &P);
+      ge_tobytes(s.data(), &r);
+      ASSERT_EQ(s, from_hex(edge_points[0])) << i;
+    }
+
+    // x = 0 with the sign bit set, not on the curve, y = p
+    ge_p3 P;
+    ASSERT_NE(ge_frombytes_vartime(&P, from_hex(edge_points[8]).data()), 0);
+    ASSERT_NE(ge_frombytes_vartime(&P, from_hex(edge_points[9]).data()), 0);
+    ASSERT_NE(ge_frombytes_vartime(&P, from_hex(edge_points[10]).data()), 0);
+
+    // l * G is the identity
+    bytes32 s;
+    ge_scalarmult_base(&P, from_hex(edge_scalars[4]).data());
+    ge_p3_tobytes(s.data(), &P);
+    ASSERT_EQ(s, from_hex(edge_points[0]));
+    ge_p3_tobytes(s.data(), &ge_p3_identity);
+    ASSERT_EQ(s, from_hex(edge_points[0]));
+  }
+}
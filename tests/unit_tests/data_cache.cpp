@@ -0,0 +1,84 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include "gtest/gtest.h"
+#include "common/data_cache.h"
+
+TEST(sharded_data_cache, add_has)
+{
+  tools::sharded_data_cache<uint64_t> cache(64, 4);
+  ASSERT_FALSE(cache.has(1));
+  cache.add(1);
+  cache.add(1);
+  ASSERT_TRUE(cache.has(1));
+  ASSERT_FALSE(cache.has(2));
+
+  const auto stats = cache.get_stats();
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 2);
+  ASSERT_EQ(stats.evictions, 0);
+  ASSERT_EQ(stats.size, 1);
+  ASSERT_EQ(stats.max_size, 64);
+}
+
+TEST(sharded_data_cache, evicts_oldest)
+{
+  // a single shard makes the eviction order deterministic
+  tools::sharded_data_cache<uint64_t> cache(16, 1);
+  for (uint64_t n = 0; n < 24; ++n)
+    cache.add(n);
+  for (uint64_t n = 0; n < 8; ++n)
+    ASSERT_FALSE(cache.has(n));
+  for (uint64_t n = 8; n < 24; ++n)
+    ASSERT_TRUE(cache.has(n));
+
+  const auto stats = cache.get_stats();
+  ASSERT_EQ(stats.evictions, 8);
+  ASSERT_EQ(stats.size, 16);
+}
+
+TEST(sharded_data_cache, bounded)
+{
+  tools::sharded_data_cache<uint64_t> cache(1000, 16);
+  for (uint64_t n = 0; n < 100000; ++n)
+    cache.add(n);
+  const auto stats = cache.get_stats();
+  ASSERT_LE(stats.size, stats.max_size);
+  ASSERT_GE(stats.max_size, 1000);
+  ASSERT_TRUE(cache.has(99999));
+}
+
+TEST(sharded_data_cache, resize)
+{
+  tools::sharded_data_cache<uint64_t> cache(16);
+  cache.add(1);
+  cache.resize(4096);
+  ASSERT_FALSE(cache.has(1));
+  ASSERT_EQ(cache.get_stats().max_size, 4096);
+}
@@ -652,3 +652,25 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_short_
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+TEST(levin_traffic_counter, labels_known_commands_only)
+{
+  // looked up once, then served from the cache
+  epee::metrics::counter &handshake_out = levin_traffic_counter(1001, true);
+  ASSERT_EQ(&handshake_out, &levin_traffic_counter(1001, true));
+  ASSERT_NE(&handshake_out, &levin_traffic_counter(1001, false));
+  ASSERT_NE(&handshake_out, &levin_traffic_counter(2001, true));
+
+  // ids outside the command pools all share one counter per direction
+  epee::metrics::counter &other_in = levin_traffic_counter(0, false);
+  ASSERT_EQ(&other_in, &levin_traffic_counter(1000, false));
+  ASSERT_EQ(&other_in, &levin_traffic_counter(1999, false));
+  ASSERT_EQ(&other_in, &levin_traffic_counter(2999, false));
+  ASSERT_EQ(&other_in, &levin_traffic_counter(-5, false));
+  ASSERT_NE(&other_in, &levin_traffic_counter(1999, true));
+
+  const std::string dump = epee::metrics::dump();
+  ASSERT_NE(std::string::npos, dump.find("monero_levin_bytes_total{command=\"1001\",direction=\"out\"}"));
+  ASSERT_NE(std::string::npos, dump.find("monero_levin_bytes_total{command=\"other\",direction=\"in\"}"));
+  ASSERT_EQ(std::string::npos, dump.find("command=\"1999\""));
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/thread/thread.hpp>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+TEST(epee_metrics, counter)
+{
+  epee::metrics::counter &c = epee::metrics::get_counter("test_counter_total", "a counter");
+  EXPECT_EQ(&c, &epee::metrics::get_counter("test_counter_total", "a counter"));
+  EXPECT_NE(&c, &epee::metrics::get_counter("test_counter_total", "a counter", "k=\"v\""));
+  EXPECT_EQ(0u, c.value());
+
+  std::vector<boost::thread> threads;
+  for (int i = 0; i < 4; ++i)
+    threads.emplace_back([&c]{ for (int n = 0; n < 1000; ++n) c.inc(); c.inc(5); });
+  for (boost::thread &t: threads)
+    t.join();
+  EXPECT_EQ(4 * 1005u, c.value());
+}
+
+TEST(epee_metrics, gauge)
+{
+  epee::metrics::gauge &g = epee::metrics::get_gauge("test_gauge", "a gauge");
+  g.set(10);
+  g.add(5);
+  g.sub(20);
+  EXPECT_EQ(-5, g.value());
+}
+
+TEST(epee_metrics, histogram)
+{
+  epee::metrics::histogram &h = epee::metrics::get_histogram("test_histogram_seconds", "a histogram");
+  h.observe_ns(0);
+  h.observe_ns(10000);
+  h.observe_ns(10001);
+  h.observe_ns(20000000000);
+
+  const epee::metrics::histogram::snapshot s = h.get();
+  EXPECT_EQ(4u, s.count);
+  EXPECT_EQ(20000020001u, s.sum_ns);
+  EXPECT_EQ(2u, s.buckets[0]);
+  EXPECT_EQ(1u, s.buckets[1]);
+  EXPECT_EQ(1u, s.buckets[epee::metrics::histogram_bucket_count - 1]);
+}
+
+TEST(epee_metrics, type_mismatch)
+{
+  epee::metrics::get_counter("test_mismatch", "a counter");
+  EXPECT_THROW(epee::metrics::get_gauge("test_mismatch", "a gauge"), std::logic_error);
+  EXPECT_THROW(epee::metrics::get_histogram("test_mismatch", "a histogram"), std::logic_error);
+}
+
+TEST(epee_metrics, dump)
+{
+  epee::metrics::get_counter("test_dump_total", "dumped counter", "a=\"1\"").inc(3);
+  epee::metrics::get_gauge("test_dump_gauge", "dumped gauge").set(-2);
+  epee::metrics::histogram &h = epee::metrics::get_histogram("test_dump_seconds", "dumped histogram", "a=\"2\"");
+  h.observe_ns(60000);
+  h.observe_ns(1500000000);
+
+  const std::string out = epee::metrics::dump();
+  const auto has = [&out](const char *line) { return out.find(line) != std::string::npos; };
+  EXPECT_TRUE(has("# HELP test_dump_total dumped counter\n# TYPE test_dump_total counter\ntest_dump_total{a=\"1\"} 3\n"));
+  EXPECT_TRUE(has("# TYPE test_dump_gauge gauge\ntest_dump_gauge -2\n"));
+  EXPECT_TRUE(has("# TYPE test_dump_seconds histogram\ntest_dump_seconds_bucket{a=\"2\",le=\"0.00001\"} 0\n"));
+  EXPECT_TRUE(has("test_dump_seconds_bucket{a=\"2\",le=\"0.0001\"} 1\n"));
+  EXPECT_TRUE(has("test_dump_seconds_bucket{a=\"2\",le=\"1.0\"} 1\n"));
+  EXPECT_TRUE(has("test_dump_seconds_bucket{a=\"2\",le=\"5.0\"} 2\n"));
+  EXPECT_TRUE(has("test_dump_seconds_bucket{a=\"2\",le=\"+Inf\"} 2\n"));
+  EXPECT_TRUE(has("test_dump_seconds_sum{a=\"2\"} 1.50006\n"));
+  EXPECT_TRUE(has("test_dump_seconds_count{a=\"2\"} 2\n"));
+}
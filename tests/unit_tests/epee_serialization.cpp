@@ -29,11 +29,17 @@
 
 #include <cstdint>
 #include <gtest/gtest.h>
+#include <list>
+#include <string>
 #include <vector>
 
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_reader.h"
 #include "storages/portable_storage_template_helper.h"
+#include "storages/portable_storage_writer.h"
+#include "byte_slice.h"
+#include "byte_stream.h"
 #include "span.h"
 
 TEST(epee_binary, two_keys)
@@ -45,6 +51,9 @@ TEST(epee_binary, two_keys)
 
   epee::serialization::portable_storage storage{};
   EXPECT_TRUE(storage.load_from_binary(data));
+
+  epee::serialization::portable_storage_reader reader{};
+  EXPECT_TRUE(reader.load_from_binary(data));
 }
 
 TEST(epee_binary, duplicate_key)
@@ -56,6 +65,9 @@ TEST(epee_binary, duplicate_key)
 
   epee::serialization::portable_storage storage{};
   EXPECT_FALSE(storage.load_from_binary(data));
+
+  epee::serialization::portable_storage_reader reader{};
+  EXPECT_FALSE(reader.load_from_binary(data));
 }
 
 namespace
@@ -77,6 +89,72 @@ struct ObjOfInts
     KV_SERIALIZE(x)
   END_KV_SERIALIZE_MAP()
 };
+
+struct Inner
+{
+  std::string s;
+  uint32_t n;
+  std::vector<uint64_t> v;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(s)
+    KV_SERIALIZE(n)
+    KV_SERIALIZE(v)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct Outer
+{
+  uint64_t a;
+  int8_t b;
+  bool c;
+  double d;
+  std::string e;
+  std::vector<std::string> strings;
+  std::vector<uint32_t> blob;
+  std::vector<Inner> inners;
+  Inner inner;
+  std::list<bool> flags;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(a)
+    KV_SERIALIZE(b)
+    KV_SERIALIZE(c)
+    KV_SERIALIZE(d)
+    KV_SERIALIZE(e)
+    KV_SERIALIZE(strings)
+    KV_SERIALIZE_CONTAINER_POD_AS_BLOB(blob)
+    KV_SERIALIZE(inners)
+    KV_SERIALIZE(inner)
+    KV_SERIALIZE(flags)
+  END_KV_SERIALIZE_MAP()
+};
+
+Outer make_outer()
+{
+  Outer o{};
+  o.a = 0x0123456789abcdef;
+  o.b = -7;
+  o.c = true;
+  o.d = 1.5;
+  o.e = std::string(70000, 'e');
+  for (unsigned i = 0; i < 100; ++i)
+    o.strings.push_back(std::string(i, 'a' + i % 26));
+  for (unsigned i = 0; i < 20; ++i)
+    o.blob.push_back(i * 0x01010101);
+  for (unsigned i = 0; i < 70; ++i)
+    o.inners.push_back({std::string(i * 5, 'x'), i, std::vector<uint64_t>(i, i)});
+  o.inner = {"inner", 42, {1, 2, 3}};
+  o.flags = {true, false, true};
+  return o;
+}
+
+epee::byte_slice store_dom(Outer& o)
+{
+  epee::byte_slice out;
+  EXPECT_TRUE(epee::serialization::store_t_to_binary(o, out));
+  return out;
+}
 }
 
 TEST(epee_binary, any_empty_seq)
@@ -141,3 +219,91 @@ TEST(epee_binary, any_empty_seq)
   EXPECT_TRUE(epee::serialization::load_t_from_binary(i, epee::span<const std::uint8_t>(data_empty_object)));
   EXPECT_EQ(0, i.x.size());
 }
+
+TEST(epee_binary, direct_any_empty_seq)
+{
+  static constexpr const std::uint8_t data_empty_object[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x04, 0x01, 'x', 0x8C /*array of objects*/, 0x00 /*length 0*/
+  };
+  static constexpr const std::uint8_t data_empty_string[] = {
+    0x01, 0x11, 0x01, 0x1, 0x01, 0x01, 0x02, 0x1, 0x1, 0x04, 0x01, 'x', 0x8A /*array of strings*/, 0x00 /*length 0*/
+  };
+
+  ObjOfObjs o;
+  EXPECT_TRUE(epee::serialization::load_t_from_binary_direct(o, epee::span<const std::uint8_t>(data_empty_object)));
+  EXPECT_EQ(0, o.x.size());
+  EXPECT_TRUE(epee::serialization::load_t_from_binary_direct(o, epee::span<const std::uint8_t>(data_empty_string)));
+  EXPECT_EQ(0, o.x.size());
+
+  ObjOfInts i;
+  EXPECT_TRUE(epee::serialization::load_t_from_binary_direct(i, epee::span<const std::uint8_t>(data_empty_object)));
+  EXPECT_EQ(0, i.x.size());
+  EXPECT_TRUE(epee::serialization::load_t_from_binary_direct(i, epee::span<const std::uint8_t>(data_empty_string)));
+  EXPECT_EQ(0, i.x.size());
+}
+
+TEST(epee_binary, direct_load)
+{
+  Outer in = make_outer();
+  const epee::byte_slice expected = store_dom(in);
+
+  Outer out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary_direct(out, epee::to_span(expected)));
+  const epee::byte_slice actual = store_dom(out);
+  ASSERT_EQ(expected.size(), actual.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), actual.begin()));
+}
+
+TEST(epee_binary, direct_store)
+{
+  Outer in = make_outer();
+  const epee::byte_slice expected = store_dom(in);
+
+  epee::byte_slice direct;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary_direct(in, direct));
+  EXPECT_EQ(expected.size(), direct.size());
+
+  Outer out{};
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(out, epee::to_span(direct)));
+  const epee::byte_slice actual = store_dom(out);
+  ASSERT_EQ(expected.size(), actual.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), actual.begin()));
+
+  // the direct writer must also work after data already in the stream
+  epee::byte_stream prefixed;
+  prefixed.put_n(0xff, 33);
+  ASSERT_TRUE(epee::serialization::store_t_to_binary_direct(in, prefixed));
+  ASSERT_EQ(33 + direct.size(), prefixed.size());
+  EXPECT_TRUE(std::equal(direct.begin(), direct.end(), prefixed.data() + 33));
+}
+
+TEST(epee_binary, direct_truncated)
+{
+  Outer in = make_outer();
+  in.e.resize(100);
+  in.strings.resize(10);
+  in.inners.resize(3);
+  const epee::byte_slice full = store_dom(in);
+
+  for (std::size_t i = 0; i < full.size(); ++i)
+  {
+    const epee::span<const std::uint8_t> part{full.data(), i};
+    epee::serialization::portable_storage storage{};
+    epee::serialization::portable_storage_reader reader{};
+    EXPECT_EQ(storage.load_from_binary(part), reader.load_from_binary(part)) << "size " << i;
+  }
+}
+
+TEST(epee_binary, direct_limits)
+{
+  Outer in = make_outer();
+  const epee::byte_slice blob = store_dom(in);
+
+  static constexpr const epee::serialization::portable_storage::limits_t few_strings = {
+    std::numeric_limits<std::size_t>::max(), std::numeric_limits<std::size_t>::max(), 10
+  };
+  epee::serialization::portable_storage storage{};
+  epee::serialization::portable_storage_reader reader{};
+  EXPECT_FALSE(storage.load_from_binary(epee::to_span(blob), &few_strings));
+  EXPECT_FALSE(reader.load_from_binary(epee::to_span(blob), &few_strings));
+}
@@ -39,6 +39,7 @@
 #include "byte_slice.h"
 #include "crypto/crypto.h"
 #include "cryptonote_basic/connection_context.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_config.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/i_core_events.h"
@@ -202,6 +203,11 @@ namespace
         {
             return context_.m_is_income;
         }
+
+        void set_support_flags(const std::uint32_t flags) noexcept
+        {
+            context_.support_flags = flags;
+        }
     };
 
     struct received_message
@@ -2276,6 +2282,134 @@ TEST_F(levin_notify, fluff_with_duplicate)
 
 }
 
+TEST_F(levin_notify, fluff_tx_relay_v2)
+{
+    std::shared_ptr<cryptonote::levin::notify> notifier_ptr = make_notifier(0, true, false);
+    auto &notifier = *notifier_ptr;
+
+    for (unsigned count = 0; count < 10; ++count)
+    {
+        add_connection(count % 2 == 0);
+        if (count % 3 == 0)
+            contexts_.back().set_support_flags(P2P_SUPPORT_FLAGS);
+    }
+
+    notifier.new_out_connection();
+    io_service_.poll();
+
+    std::vector<cryptonote::blobdata> txs;
+    std::vector<crypto::hash> hashes;
+    for (unsigned count = 0; count < 2; ++count)
+    {
+        cryptonote::transaction tx{};
+        tx.version = 1;
+        tx.unlock_time = count;
+        txs.push_back(cryptonote::t_serializable_object_to_blob(tx));
+    }
+    std::sort(txs.begin(), txs.end());
+    for (const auto& blob : txs)
+    {
+        cryptonote::transaction tx{};
+        hashes.emplace_back();
+        ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, tx, hashes.back()));
+    }
+
+    ASSERT_EQ(10u, contexts_.size());
+    {
+        auto context = contexts_.begin();
+        EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), cryptonote::relay_method::fluff));
+
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        notifier.run_fluff();
+        ASSERT_LT(0u, io_service_.poll());
+
+        EXPECT_EQ(0u, context->process_send_queue());
+        for (unsigned count = 1; count < 10; ++count)
+        {
+            ++context;
+            EXPECT_EQ(1u, context->process_send_queue());
+            ASSERT_EQ(1u, receiver_.notified_size());
+            if (count % 3 == 0)
+            {
+                auto notification = receiver_.get_notification<cryptonote::NOTIFY_TX_POOL_HASH>();
+                EXPECT_EQ(context->get_id(), notification.first);
+                EXPECT_EQ(hashes, notification.second.txs);
+            }
+            else
+            {
+                auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>();
+                EXPECT_EQ(context->get_id(), notification.first);
+                EXPECT_EQ(txs, notification.second.txs);
+                EXPECT_TRUE(notification.second.dandelionpp_fluff);
+            }
+        }
+
+        EXPECT_EQ(txs, events_.take_relayed(cryptonote::relay_method::fluff));
+    }
+}
+
+TEST_F(levin_notify, fluff_tx_relay_v2_split)
+{
+    std::shared_ptr<cryptonote::levin::notify> notifier_ptr = make_notifier(0, true, false);
+    auto &notifier = *notifier_ptr;
+
+    for (unsigned count = 0; count < 2; ++count)
+    {
+        add_connection(true);
+        contexts_.back().set_support_flags(P2P_SUPPORT_FLAGS);
+    }
+
+    notifier.new_out_connection();
+    io_service_.poll();
+
+    // more hashes than a peer accepts in one announcement
+    std::vector<cryptonote::blobdata> txs;
+    std::vector<crypto::hash> hashes;
+    for (unsigned count = 0; count < 2 * CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT + 1; ++count)
+    {
+        cryptonote::transaction tx{};
+        tx.version = 1;
+        tx.unlock_time = count;
+        txs.push_back(cryptonote::t_serializable_object_to_blob(tx));
+    }
+    std::sort(txs.begin(), txs.end());
+    for (const auto& blob : txs)
+    {
+        cryptonote::transaction tx{};
+        hashes.emplace_back();
+        ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, tx, hashes.back()));
+    }
+
+    ASSERT_EQ(2u, contexts_.size());
+    {
+        auto context = contexts_.begin();
+        EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), cryptonote::relay_method::fluff));
+
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        notifier.run_fluff();
+        ASSERT_LT(0u, io_service_.poll());
+
+        EXPECT_EQ(0u, context->process_send_queue());
+        ++context;
+        EXPECT_EQ(3u, context->process_send_queue());
+        ASSERT_EQ(3u, receiver_.notified_size());
+
+        std::vector<crypto::hash> announced;
+        for (unsigned count = 0; count < 3; ++count)
+        {
+            auto notification = receiver_.get_notification<cryptonote::NOTIFY_TX_POOL_HASH>();
+            EXPECT_EQ(context->get_id(), notification.first);
+            EXPECT_GE(CURRENCY_PROTOCOL_MAX_TX_HASH_COUNT, notification.second.txs.size());
+            announced.insert(announced.end(), notification.second.txs.begin(), notification.second.txs.end());
+        }
+        EXPECT_EQ(hashes, announced);
+
+        EXPECT_EQ(txs, events_.take_relayed(cryptonote::relay_method::fluff));
+    }
+}
+
 TEST_F(levin_notify, noise)
 {
     for (unsigned count = 0; count < 10; ++count)
@@ -72,6 +72,7 @@ public:
   bool get_test_drop_download_height() const {return true;}
   bool prepare_handle_incoming_blocks(const std::vector<cryptonote::block_complete_entry>  &blocks_entry, std::vector<cryptonote::block> &blocks) { return true; }
   bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+  size_t prehash_incoming_blocks(uint64_t height, const std::vector<cryptonote::block_complete_entry> &blocks_entry, const std::vector<crypto::hash> &parent_hashes) { return 0; }
   bool update_checkpoints(const bool skip_dns = false) { return true; }
   uint64_t get_target_blockchain_height() const { return 1; }
   size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
@@ -79,6 +80,9 @@ public:
   cryptonote::network_type get_nettype() const { return cryptonote::MAINNET; }
   bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx_blob, cryptonote::relay_category tx_category) const { return false; }
   bool pool_has_tx(const crypto::hash &txid) const { return false; }
+  bool have_tx(const crypto::hash &txid) const { return false; }
+  void get_pool_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const {}
+  bool check_block_header_pow(const cryptonote::block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id) { return true; }
   bool get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata, cryptonote::block>>& blocks, std::vector<cryptonote::blobdata>& txs) const { return false; }
   bool get_transactions(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::transaction>& txs, std::vector<crypto::hash>& missed_txs) const { return false; }
   bool get_block_by_hash(const crypto::hash &h, cryptonote::block &blk, bool *orphan = NULL) const { return false; }
@@ -95,6 +99,7 @@ public:
   bool is_within_compiled_block_hash_area(uint64_t height) const { return false; }
   bool has_block_weights(uint64_t height, uint64_t nblocks) const { return false; }
   bool get_txpool_complement(const std::vector<crypto::hash> &hashes, std::vector<cryptonote::blobdata> &txes) { return false; }
+  bool get_txpool_complement(const cryptonote::txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes) { return false; }
   bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const { return false; }
   crypto::hash get_block_id_by_height(uint64_t height) const { return crypto::null_hash; }
   void stop() {}
@@ -1170,5 +1175,413 @@ TEST(node_server, race_condition)
   remove_tree(dir);
 }
 
+// serves its txpool and PoW check from test members; the handler calls these instead of test_core's
+class compact_block_core : public test_core
+{
+public:
+  std::unordered_map<crypto::hash, cryptonote::blobdata> pool;
+  std::unordered_map<crypto::hash, crypto::hash> impostors;  //!< tx -> pool tx its short id wrongly resolves to
+  std::unordered_set<crypto::hash> chain;
+  bool header_pow_ok = true;
+  size_t header_pow_checks = 0;
+  mutable size_t index_builds = 0;
+  std::vector<cryptonote::blobdata> incoming_blocks;
+
+  bool check_block_header_pow(const cryptonote::block &b, const crypto::hash &tx_tree_root, uint64_t tx_count, const crypto::hash &id) { ++header_pow_checks; return header_pow_ok; }
+  void get_pool_short_id_index(uint64_t salt, std::unordered_map<uint64_t, crypto::hash> &index) const
+  {
+    ++index_builds;
+    index.clear();
+    for (const auto &tx: pool)
+      index.emplace(cryptonote::get_compact_short_id(tx.first, salt), tx.first);
+    for (const auto &tx: impostors)
+      index[cryptonote::get_compact_short_id(tx.first, salt)] = tx.second;
+  }
+  bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx_blob, cryptonote::relay_category tx_category) const
+  {
+    const auto it = pool.find(id);
+    if (it == pool.end())
+      return false;
+    tx_blob = it->second;
+    return true;
+  }
+  bool pool_has_tx(const crypto::hash &txid) const { return pool.count(txid) != 0; }
+  bool have_tx(const crypto::hash &txid) const { return chain.count(txid) != 0; }
+  bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes = true) const
+  {
+    txs.clear();
+    for (const auto &tx: pool)
+      txs.push_back(tx.first);
+    return true;
+  }
+  using test_core::get_txpool_complement;
+  bool get_txpool_complement(const cryptonote::txpool_sketch &sketch, std::vector<cryptonote::blobdata> &txes) { txes.clear(); return true; }
+  bool handle_incoming_block(const cryptonote::blobdata& block_blob, const cryptonote::block *block, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate = true) { incoming_blocks.push_back(block_blob); return true; }
+};
+
+struct compact_block_p2p : public nodetool::p2p_endpoint_stub<cryptonote::cryptonote_connection_context>
+{
+  std::vector<std::pair<int, std::string>> notifications;
+  size_t drops = 0;
+
+  virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context) override
+  {
+    const epee::byte_slice blob = message.finalize_notify(command);
+    const size_t header_size = sizeof(epee::levin::bucket_head2);
+    notifications.emplace_back(command, std::string(reinterpret_cast<const char*>(blob.data()) + header_size, blob.size() - header_size));
+    return true;
+  }
+  virtual bool drop_connection(const epee::net_utils::connection_context_base& context) override
+  {
+    ++drops;
+    return true;
+  }
+};
+
+typedef cryptonote::t_cryptonote_protocol_handler<compact_block_core> compact_block_protocol;
+
+static cryptonote::block make_block(const std::vector<crypto::hash> &tx_hashes)
+{
+  cryptonote::block b;
+  b.major_version = 1;
+  b.minor_version = 0;
+  b.timestamp = 1;
+  b.prev_id = crypto::null_hash; // test_core's top
+  b.nonce = 0;
+  b.miner_tx.version = 1;
+  b.miner_tx.unlock_time = 1 + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+  b.miner_tx.vin.push_back(cryptonote::txin_gen{1});
+  b.tx_hashes = tx_hashes;
+  return b;
+}
+
+// as relay_block sends it
+static cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request make_compact_block(cryptonote::block b)
+{
+  cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request arg = AUTO_VAL_INIT(arg);
+  arg.block_hash = cryptonote::get_block_hash(b);
+  arg.tx_tree_root = cryptonote::get_tx_tree_hash(b);
+  arg.salt = cryptonote::get_compact_block_salt(arg.block_hash, 0);
+  for (const crypto::hash &tx_hash: b.tx_hashes)
+  {
+    const uint64_t id = cryptonote::get_compact_short_id(tx_hash, arg.salt);
+    for (size_t j = 0; j < cryptonote::compact_short_id_size; ++j)
+      arg.short_ids.push_back(char(id >> (8 * j)));
+  }
+  b.tx_hashes.clear();
+  b.invalidate_hashes();
+  arg.block = cryptonote::block_to_blob(b);
+  arg.current_blockchain_height = 2;
+  return arg;
+}
+
+static cryptonote::cryptonote_connection_context make_peer(uint8_t n)
+{
+  cryptonote::cryptonote_connection_context context;
+  static_cast<epee::net_utils::connection_context_base&>(context) =
+    epee::net_utils::connection_context_base(boost::uuids::random_generator()(), MAKE_IPV4_ADDRESS(1,2,3,n), false, false);
+  context.m_state = cryptonote::cryptonote_connection_context::state_normal;
+  return context;
+}
+
+template<typename T>
+static void notify(compact_block_protocol &protocol, typename T::request arg, cryptonote::cryptonote_connection_context &context)
+{
+  epee::byte_slice blob;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(arg, blob));
+  epee::byte_stream out;
+  bool handled = false;
+  protocol.handle_invoke_map(true, T::ID, epee::to_span(blob), out, context, handled);
+  ASSERT_TRUE(handled);
+}
+
+static void notify_compact_block(compact_block_protocol &protocol, cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request arg, cryptonote::cryptonote_connection_context &context)
+{
+  notify<cryptonote::NOTIFY_NEW_COMPACT_BLOCK>(protocol, std::move(arg), context);
+}
+
+static cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request get_missing_tx_request(const compact_block_p2p &p2p, size_t n)
+{
+  cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request req;
+  EXPECT_EQ(p2p.notifications[n].first, cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::ID);
+  EXPECT_TRUE(epee::serialization::load_t_from_binary(req, p2p.notifications[n].second));
+  return req;
+}
+
+TEST(compact_block, full_reconstruction)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  std::vector<crypto::hash> tx_hashes;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    tx_hashes.push_back(crypto::rand<crypto::hash>());
+    core.pool[tx_hashes.back()] = "tx";
+  }
+  core.pool[crypto::rand<crypto::hash>()] = "unrelated tx";
+  const cryptonote::block b = make_block(tx_hashes);
+
+  cryptonote::cryptonote_connection_context context = make_peer(1);
+  notify_compact_block(protocol, make_compact_block(b), context);
+
+  EXPECT_EQ(core.header_pow_checks, 1);
+  EXPECT_EQ(core.index_builds, 1);
+  EXPECT_TRUE(p2p.notifications.empty());
+  EXPECT_EQ(p2p.drops, 0);
+  ASSERT_EQ(core.incoming_blocks.size(), 1);
+  EXPECT_EQ(core.incoming_blocks[0], cryptonote::block_to_blob(b));
+}
+
+TEST(compact_block, partial_reconstruction)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  std::vector<crypto::hash> tx_hashes;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    tx_hashes.push_back(crypto::rand<crypto::hash>());
+    if (i % 2 == 0)
+      core.pool[tx_hashes.back()] = "tx";
+  }
+  const cryptonote::block b = make_block(tx_hashes);
+  const cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request arg = make_compact_block(b);
+
+  cryptonote::cryptonote_connection_context context = make_peer(1);
+  notify_compact_block(protocol, arg, context);
+
+  EXPECT_TRUE(core.incoming_blocks.empty());
+  ASSERT_EQ(p2p.notifications.size(), 1);
+  cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request req = get_missing_tx_request(p2p, 0);
+  EXPECT_EQ(req.block_hash, arg.block_hash);
+  EXPECT_EQ(req.missing_tx_indices, std::vector<uint64_t>({1, 3}));
+
+  // the same block from another peer reuses the txpool index
+  cryptonote::cryptonote_connection_context other = make_peer(2);
+  notify_compact_block(protocol, arg, other);
+  EXPECT_EQ(core.header_pow_checks, 2);
+  EXPECT_EQ(core.index_builds, 1);
+  ASSERT_EQ(p2p.notifications.size(), 2);
+  req = get_missing_tx_request(p2p, 1);
+  EXPECT_EQ(req.missing_tx_indices, std::vector<uint64_t>({1, 3}));
+
+  // a new block indexes again
+  notify_compact_block(protocol, make_compact_block(make_block({tx_hashes[0]})), context);
+  EXPECT_EQ(core.index_builds, 2);
+  EXPECT_EQ(core.incoming_blocks.size(), 1);
+  EXPECT_EQ(p2p.drops, 0);
+}
+
+TEST(compact_block, short_id_collision)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  std::vector<crypto::hash> tx_hashes;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    tx_hashes.push_back(crypto::rand<crypto::hash>());
+    core.pool[tx_hashes.back()] = "tx";
+  }
+  // a different pool tx answers to the short id of the second one
+  const crypto::hash impostor = crypto::rand<crypto::hash>();
+  core.pool[impostor] = "impostor tx";
+  core.impostors[tx_hashes[1]] = impostor;
+  const cryptonote::NOTIFY_NEW_COMPACT_BLOCK::request arg = make_compact_block(make_block(tx_hashes));
+
+  cryptonote::cryptonote_connection_context context = make_peer(1);
+  notify_compact_block(protocol, arg, context);
+
+  // the block hash gives the mismatch away, the full hashes are asked for instead
+  EXPECT_TRUE(core.incoming_blocks.empty());
+  EXPECT_EQ(p2p.drops, 0);
+  ASSERT_EQ(p2p.notifications.size(), 1);
+  const cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX::request req = get_missing_tx_request(p2p, 0);
+  EXPECT_EQ(req.block_hash, arg.block_hash);
+  EXPECT_TRUE(req.missing_tx_indices.empty());
+}
+
+TEST(compact_block, bad_header_pow)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  const crypto::hash tx_hash = crypto::rand<crypto::hash>();
+  core.pool[tx_hash] = "tx";
+  core.header_pow_ok = false;
+
+  cryptonote::cryptonote_connection_context context = make_peer(1);
+  notify_compact_block(protocol, make_compact_block(make_block({tx_hash})), context);
+
+  // dropped before any txpool work
+  EXPECT_EQ(core.header_pow_checks, 1);
+  EXPECT_EQ(core.index_builds, 0);
+  EXPECT_EQ(p2p.drops, 1);
+  EXPECT_TRUE(p2p.notifications.empty());
+  EXPECT_TRUE(core.incoming_blocks.empty());
+}
+
+// also knows its peers, so the handler can get back to them, and who it sent what
+struct tx_request_p2p : public compact_block_p2p
+{
+  std::map<boost::uuids::uuid, cryptonote::cryptonote_connection_context*> connections;
+  std::vector<boost::uuids::uuid> notified;
+
+  virtual bool invoke_notify_to_peer(int command, epee::levin::message_writer message, const epee::net_utils::connection_context_base& context) override
+  {
+    notified.push_back(context.m_connection_id);
+    return compact_block_p2p::invoke_notify_to_peer(command, std::move(message), context);
+  }
+  virtual bool for_connection(const boost::uuids::uuid &id, std::function<bool(cryptonote::cryptonote_connection_context&, nodetool::peerid_type, uint32_t)> f) override
+  {
+    const auto it = connections.find(id);
+    if (it == connections.end())
+      return false;
+    return f(*it->second, 0, 0);
+  }
+};
+
+static cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::request get_tx_request(const tx_request_p2p &p2p, size_t n)
+{
+  cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::request req;
+  EXPECT_EQ(p2p.notifications[n].first, cryptonote::NOTIFY_REQUEST_TX_POOL_TXS::ID);
+  EXPECT_TRUE(epee::serialization::load_t_from_binary(req, p2p.notifications[n].second));
+  return req;
+}
+
+TEST(tx_request, timeout)
+{
+  compact_block_core core;
+  tx_request_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  cryptonote::cryptonote_connection_context a = make_peer(1), b = make_peer(2), c = make_peer(3);
+  for (cryptonote::cryptonote_connection_context *context: {&a, &b, &c})
+    p2p.connections[context->m_connection_id] = context;
+  const crypto::hash tx0 = crypto::rand<crypto::hash>(), tx1 = crypto::rand<crypto::hash>(), tx2 = crypto::rand<crypto::hash>();
+
+  // asked from the first announcer only
+  cryptonote::NOTIFY_TX_POOL_HASH::request announce;
+  announce.txs = {tx0, tx1};
+  notify<cryptonote::NOTIFY_TX_POOL_HASH>(protocol, announce, a);
+  ASSERT_EQ(p2p.notifications.size(), 1);
+  EXPECT_EQ(p2p.notified[0], a.m_connection_id);
+  EXPECT_EQ(get_tx_request(p2p, 0).txs, std::vector<crypto::hash>({tx0, tx1}));
+  notify<cryptonote::NOTIFY_TX_POOL_HASH>(protocol, announce, b);
+  announce.txs = {tx2};
+  notify<cryptonote::NOTIFY_TX_POOL_HASH>(protocol, announce, c);
+  ASSERT_EQ(p2p.notifications.size(), 2);
+  EXPECT_EQ(p2p.notified[1], c.m_connection_id);
+
+  // nothing happens before the timeout
+  const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+  protocol.prune_requested_txs(now);
+  EXPECT_EQ(p2p.notifications.size(), 2);
+
+  // tx1 and tx2 got mined, a and c had nothing left to send for those
+  core.chain.insert(tx1);
+  core.chain.insert(tx2);
+  const boost::posix_time::ptime timeout = now + boost::posix_time::seconds(31);
+  protocol.prune_requested_txs(timeout);
+  EXPECT_EQ(a.m_score, -1);
+  EXPECT_EQ(b.m_score, 0);
+  EXPECT_EQ(c.m_score, 0);
+  ASSERT_EQ(p2p.notifications.size(), 3);
+  EXPECT_EQ(p2p.notified[2], b.m_connection_id);
+  EXPECT_EQ(get_tx_request(p2p, 2).txs, std::vector<crypto::hash>({tx0}));
+
+  // b does not answer either, and there is nobody left to ask
+  protocol.prune_requested_txs(timeout + boost::posix_time::seconds(31));
+  EXPECT_EQ(a.m_score, -1);
+  EXPECT_EQ(b.m_score, -1);
+  EXPECT_EQ(p2p.notifications.size(), 3);
+  protocol.prune_requested_txs(timeout + boost::posix_time::seconds(62));
+  EXPECT_EQ(b.m_score, -1);
+  EXPECT_EQ(p2p.drops, 0);
+}
+
+TEST(txpool_sketch, failed_then_full_hash_list)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  // 200 hashes: the first two sketch sizes are smaller than the hash list, the third is not
+  for (size_t i = 0; i < 200; ++i)
+    core.pool[crypto::rand<crypto::hash>()] = "tx";
+  cryptonote::cryptonote_connection_context context = make_peer(1);
+  context.m_txpool_sketch_cells = CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS; // as sent once synchronized
+
+  cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED::request failed;
+  failed.cells = CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS / 2;
+  notify<cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED>(protocol, failed, context);
+  EXPECT_TRUE(p2p.notifications.empty());
+
+  // retried with twice the cells
+  failed.cells = CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS;
+  notify<cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED>(protocol, failed, context);
+  ASSERT_EQ(p2p.notifications.size(), 1);
+  ASSERT_EQ(p2p.notifications[0].first, cryptonote::NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::ID);
+  cryptonote::NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::request sketch_req;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(sketch_req, p2p.notifications[0].second));
+  cryptonote::txpool_sketch sketch{0, sketch_req.salt};
+  ASSERT_TRUE(sketch.from_blob(sketch_req.sketch));
+  EXPECT_EQ(sketch.cells(), 2 * CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS);
+  EXPECT_EQ(context.m_txpool_sketch_cells, sketch.cells());
+
+  // then with the full hash list, once it is the smaller one
+  failed.cells = sketch.cells();
+  notify<cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED>(protocol, failed, context);
+  ASSERT_EQ(p2p.notifications.size(), 2);
+  ASSERT_EQ(p2p.notifications[1].first, cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::ID);
+  cryptonote::NOTIFY_GET_TXPOOL_COMPLEMENT::request req;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(req, p2p.notifications[1].second));
+  EXPECT_EQ(req.hashes.size(), 200);
+  EXPECT_EQ(context.m_txpool_sketch_cells, 0);
+
+  notify<cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED>(protocol, failed, context);
+  EXPECT_EQ(p2p.notifications.size(), 2);
+  EXPECT_EQ(p2p.drops, 0);
+}
+
+TEST(txpool_sketch, reconciled)
+{
+  compact_block_core core;
+  compact_block_p2p p2p;
+  compact_block_protocol protocol(core, &p2p, true);
+
+  // the reply names the sketch it answers
+  cryptonote::cryptonote_connection_context responder = make_peer(1);
+  cryptonote::NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT::request sketch_req;
+  sketch_req.salt = crypto::rand<uint64_t>();
+  sketch_req.sketch = cryptonote::txpool_sketch{CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS, sketch_req.salt}.to_blob();
+  notify<cryptonote::NOTIFY_GET_TXPOOL_SKETCH_COMPLEMENT>(protocol, sketch_req, responder);
+  ASSERT_EQ(p2p.notifications.size(), 1);
+  ASSERT_EQ(p2p.notifications[0].first, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID);
+  cryptonote::NOTIFY_NEW_TRANSACTIONS::request reply;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(reply, p2p.notifications[0].second));
+  EXPECT_EQ(reply.txpool_sketch_cells, CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS);
+
+  // txes relayed in the meantime are not the answer
+  cryptonote::cryptonote_connection_context context = make_peer(2);
+  context.m_txpool_sketch_cells = CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS;
+  notify<cryptonote::NOTIFY_NEW_TRANSACTIONS>(protocol, cryptonote::NOTIFY_NEW_TRANSACTIONS::request{}, context);
+  EXPECT_EQ(context.m_txpool_sketch_cells, CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS);
+
+  // once answered, a late failure no longer makes us ask again
+  notify<cryptonote::NOTIFY_NEW_TRANSACTIONS>(protocol, reply, context);
+  EXPECT_EQ(context.m_txpool_sketch_cells, 0);
+  cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED::request failed;
+  failed.cells = CURRENCY_PROTOCOL_TXPOOL_SKETCH_MIN_CELLS;
+  notify<cryptonote::NOTIFY_TXPOOL_SKETCH_FAILED>(protocol, failed, context);
+  EXPECT_EQ(p2p.notifications.size(), 1);
+  EXPECT_EQ(p2p.drops, 0);
+}
+
 namespace nodetool { template class node_server<cryptonote::t_cryptonote_protocol_handler<test_core>>; }
 namespace cryptonote { template class t_cryptonote_protocol_handler<test_core>; }
@@ -178,3 +178,22 @@ TEST(output_distribution, part_noncumulative)
   ASSERT_EQ(res->distribution.size(), 5);
   ASSERT_EQ(res->distribution, std::vector<uint64_t>({0, 1, 5, 1, 4}));
 }
+
+TEST(output_distribution, different_from_heights)
+{
+  boost::optional<cryptonote::rpc::output_distribution_data> res;
+
+  for (uint64_t from = 0; from < test_distribution_size; ++from)
+  {
+    res = cryptonote::rpc::RpcHandler::get_output_distribution(::get_output_distribution, 0, from, test_distribution_size - 1, ::get_block_hash, false, test_distribution_size);
+    ASSERT_TRUE(res != boost::none);
+    ASSERT_EQ(res->start_height, from);
+    ASSERT_EQ(res->distribution.size(), test_distribution_size - from);
+    uint64_t base = 0;
+    for (size_t i = 0; i < from; ++i)
+      base += test_distribution[i];
+    ASSERT_EQ(res->base, base);
+    for (size_t i = from; i < test_distribution_size; ++i)
+      ASSERT_EQ(res->distribution[i - from], test_distribution[i]);
+  }
+}
@@ -44,6 +44,7 @@
 #include "serialization/variant.h"
 #include "serialization/containers.h"
 #include "serialization/binary_utils.h"
+#include "storages/portable_storage_template_helper.h"
 #include "wallet/wallet2.h"
 #include "gtest/gtest.h"
 #include "unit_tests_utils.h"
@@ -1304,3 +1305,123 @@ TEST(Serialization, tuple_many_tuples)
 
   EXPECT_EQ(tupler, tupler_recovered);
 }
+
+TEST(Serialization, wallet_transfer_details_migration)
+{
+  cryptonote::transaction_prefix tx;
+  tx.version = 2;
+  tx.unlock_time = 1234567;
+  cryptonote::txin_to_key in;
+  in.amount = 0;
+  in.key_offsets = {100, 20, 3};
+  in.k_image = crypto::rand<crypto::key_image>();
+  tx.vin.push_back(in);
+  const crypto::public_key out_key = crypto::rand<crypto::public_key>();
+  const crypto::view_tag view_tag = crypto::rand<crypto::view_tag>();
+  for (size_t n = 0; n < 2; ++n)
+  {
+    cryptonote::tx_out out;
+    out.amount = 0;
+    out.target = cryptonote::txout_to_tagged_key(n ? out_key : crypto::rand<crypto::public_key>(), view_tag);
+    tx.vout.push_back(out);
+  }
+  const crypto::public_key tx_pub_key = crypto::rand<crypto::public_key>();
+  ASSERT_TRUE(cryptonote::add_tx_pub_key_to_extra(tx, tx_pub_key));
+  const std::vector<crypto::public_key> additional_tx_pub_keys{crypto::rand<crypto::public_key>(), crypto::rand<crypto::public_key>()};
+  ASSERT_TRUE(cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_pub_keys));
+
+  tools::wallet2::legacy_transfer_details old_td{};
+  old_td.m_tx = tx;
+  old_td.m_block_height = 42;
+  old_td.m_txid = crypto::rand<crypto::hash>();
+  old_td.m_internal_output_index = 1;
+  old_td.m_global_output_index = 1000;
+  old_td.m_key_image = crypto::rand<crypto::key_image>();
+  old_td.m_amount = 5;
+  old_td.m_rct = true;
+  old_td.m_key_image_known = true;
+  old_td.m_uses.push_back(std::make_pair(50, crypto::rand<crypto::hash>()));
+  std::vector<tools::wallet2::legacy_transfer_details> old_transfers{old_td};
+  std::string blob;
+  ASSERT_TRUE(::serialization::dump_binary(old_transfers, blob));
+
+  const auto check = [&](const tools::wallet2::transfer_details &td)
+  {
+    ASSERT_EQ(td.m_block_height, 42);
+    ASSERT_EQ(td.m_txid, old_td.m_txid);
+    ASSERT_EQ(td.m_internal_output_index, 1);
+    ASSERT_EQ(td.m_global_output_index, 1000);
+    ASSERT_EQ(td.m_key_image, old_td.m_key_image);
+    ASSERT_EQ(td.m_amount, 5);
+    ASSERT_EQ(td.m_uses, old_td.m_uses);
+    ASSERT_EQ(td.get_public_key(), out_key);
+    ASSERT_TRUE(td.m_view_tag && *td.m_view_tag == view_tag);
+    ASSERT_EQ(td.m_unlock_time, 1234567);
+    ASSERT_EQ(td.m_tx_pub_key, tx_pub_key);
+    ASSERT_EQ(td.m_additional_tx_pub_keys, additional_tx_pub_keys);
+    ASSERT_EQ(td.m_input_key_images, std::vector<crypto::key_image>{in.k_image});
+  };
+
+  std::vector<tools::wallet2::legacy_transfer_details> legacy_transfers;
+  ASSERT_TRUE(::serialization::parse_binary(blob, legacy_transfers));
+  ASSERT_EQ(legacy_transfers.size(), 1);
+  check(legacy_transfers[0]);
+
+  std::vector<tools::wallet2::transfer_details> transfers(legacy_transfers.begin(), legacy_transfers.end());
+  ASSERT_TRUE(::serialization::dump_binary(transfers, blob));
+  transfers.clear();
+  ASSERT_TRUE(::serialization::parse_binary(blob, transfers));
+  ASSERT_EQ(transfers.size(), 1);
+  check(transfers[0]);
+
+  transfers[0].m_view_tag = boost::none;
+  ASSERT_TRUE(::serialization::dump_binary(transfers, blob));
+  transfers.clear();
+  ASSERT_TRUE(::serialization::parse_binary(blob, transfers));
+  ASSERT_EQ(transfers.size(), 1);
+  ASSERT_FALSE(transfers[0].m_view_tag);
+  ASSERT_EQ(transfers[0].get_public_key(), out_key);
+}
+
+TEST(Serialization, get_blocks_fast_shared_span)
+{
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+  res.start_height = 10;
+  res.current_height = 12;
+  res.top_block_hash = crypto::rand<crypto::hash>();
+  for (size_t n = 0; n < 2; ++n)
+  {
+    cryptonote::block_complete_entry entry;
+    entry.pruned = n;
+    entry.block = std::string(100 + n, 'b');
+    entry.txs.push_back({std::string(200 + n, 't'), n ? crypto::rand<crypto::hash>() : crypto::null_hash});
+    res.blocks.push_back(entry);
+    res.output_indices.push_back({{{{n, n + 1}}, {{n + 2}}}});
+  }
+
+  // a response sharing the span is stored the same as one holding a copy
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response shared_res = res;
+  shared_res.shared_blocks = std::make_shared<const std::vector<cryptonote::block_complete_entry>>(res.blocks);
+  shared_res.shared_output_indices = std::make_shared<const std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>>(res.output_indices);
+  shared_res.blocks.clear();
+  shared_res.output_indices.clear();
+
+  epee::byte_slice blob, shared_blob;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(res, blob));
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(shared_res, shared_blob));
+  ASSERT_EQ(std::string((const char*)blob.data(), blob.size()), std::string((const char*)shared_blob.data(), shared_blob.size()));
+
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response loaded;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(loaded, epee::to_span(shared_blob)));
+  ASSERT_FALSE(loaded.shared_blocks);
+  ASSERT_EQ(loaded.blocks.size(), 2);
+  ASSERT_EQ(loaded.output_indices.size(), 2);
+  for (size_t n = 0; n < 2; ++n)
+  {
+    ASSERT_EQ(loaded.blocks[n].block, res.blocks[n].block);
+    ASSERT_EQ(loaded.blocks[n].txs.size(), 1);
+    ASSERT_EQ(loaded.blocks[n].txs[0].blob, res.blocks[n].txs[0].blob);
+    ASSERT_EQ(loaded.output_indices[n].indices.size(), 2);
+    ASSERT_EQ(loaded.output_indices[n].indices[0].indices, res.output_indices[n].indices[0].indices);
+  }
+}
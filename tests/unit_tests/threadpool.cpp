@@ -145,3 +145,19 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait();
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, recycle_keeps_jobs)
+{
+  // no worker thread, so the jobs wait in the queues until waiter::wait
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(1));
+  tools::threadpool::waiter waiter(*tpool);
+
+  std::atomic<unsigned int> counter(0);
+  for (size_t n = 0; n < 16; ++n)
+    tpool->submit(&waiter, [&counter](){++counter;});
+  ASSERT_EQ(tpool->get_queue_depth(), 16);
+  tpool->recycle();
+  ASSERT_EQ(tpool->get_queue_depth(), 16);
+  waiter.wait();
+  ASSERT_EQ(counter, 16);
+}
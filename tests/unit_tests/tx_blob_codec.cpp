@@ -0,0 +1,194 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/tx_blob_codec.h"
+
+using cryptonote::tx_blob_codec;
+
+namespace
+{
+  std::mt19937 rng;
+
+  std::string random_bytes(size_t n)
+  {
+    std::string s(n, '\0');
+    for (char &c: s)
+      c = rng();
+    return s;
+  }
+
+  // somewhat tx shaped: a repeated structure with keys from a small set
+  std::string make_blob(size_t n_outputs)
+  {
+    static const std::vector<std::string> keys{random_bytes(32), random_bytes(32), random_bytes(32), random_bytes(32)};
+    std::string blob("\x02\x00\x01\x02\x00\x0b", 6);
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      blob += std::string("\x00\x03", 2);
+      blob += keys[rng() % keys.size()];
+      blob += std::string("\x8e\x21\x01", 3);
+    }
+    blob += std::string("\x01\x00\x02\x09\x01", 5);
+    return blob;
+  }
+
+  std::string round_trip(const tx_blob_codec &codec, tx_blob_codec::table t, const std::string &blob)
+  {
+    std::string record, out;
+    codec.encode(t, epee::strspan<char>(blob), record);
+    const MDB_val v{record.size(), (void*)record.data()};
+    if (t == tx_blob_codec::table::pruned)
+    {
+      EXPECT_TRUE(tx_blob_codec::is_encoded(v));
+    }
+    codec.decode(t, v, true, out);
+    return out;
+  }
+}
+
+TEST(tx_blob_codec, not_encoded)
+{
+  tx_blob_codec codec;
+  const std::string blob = make_blob(2);
+  const MDB_val v{blob.size(), (void*)blob.data()};
+  ASSERT_FALSE(tx_blob_codec::is_encoded(v));
+  ASSERT_FALSE(tx_blob_codec::is_encoded(MDB_val{0, NULL}));
+
+  std::string out = "x";
+  codec.decode(tx_blob_codec::table::pruned, v, false, out);
+  ASSERT_EQ("x" + blob, out);
+}
+
+TEST(tx_blob_codec, raw)
+{
+  tx_blob_codec codec;
+  ASSERT_EQ(0, codec.level());
+  for (const tx_blob_codec::table t: {tx_blob_codec::table::pruned, tx_blob_codec::table::prunable})
+  {
+    const std::string blob = make_blob(3);
+    std::string record;
+    codec.encode(t, epee::strspan<char>(blob), record);
+    ASSERT_EQ(blob.size() + (t == tx_blob_codec::table::pruned ? 2 : 1), record.size());
+    ASSERT_EQ(blob, round_trip(codec, t, blob));
+    ASSERT_EQ("", round_trip(codec, t, ""));
+  }
+}
+
+TEST(tx_blob_codec, invalid)
+{
+  tx_blob_codec codec;
+  std::string out;
+  ASSERT_THROW(codec.decode(tx_blob_codec::table::pruned, MDB_val{1, (void*)"\x00"}, true, out), cryptonote::DB_ERROR);
+  ASSERT_THROW(codec.decode(tx_blob_codec::table::prunable, MDB_val{0, (void*)""}, true, out), cryptonote::DB_ERROR);
+  ASSERT_THROW(codec.decode(tx_blob_codec::table::prunable, MDB_val{2, (void*)"\x7f\x00"}, true, out), cryptonote::DB_ERROR);
+}
+
+TEST(tx_blob_codec, compressed)
+{
+  if (!tx_blob_codec::available())
+    return;
+
+  tx_blob_codec codec;
+  codec.set_level(3);
+  for (const tx_blob_codec::table t: {tx_blob_codec::table::pruned, tx_blob_codec::table::prunable})
+  {
+    const std::string blob = make_blob(16) + std::string(200, 'm');
+    std::string record;
+    codec.encode(t, epee::strspan<char>(blob), record);
+    ASSERT_LT(record.size(), blob.size());
+    ASSERT_EQ(blob, round_trip(codec, t, blob));
+
+    // random data does not compress, and is stored raw
+    const std::string noise = random_bytes(32);
+    codec.encode(t, epee::strspan<char>(noise), record);
+    ASSERT_EQ(noise.size() + (t == tx_blob_codec::table::pruned ? 2 : 1), record.size());
+    ASSERT_EQ(noise, round_trip(codec, t, noise));
+  }
+}
+
+TEST(tx_blob_codec, dictionary)
+{
+  if (!tx_blob_codec::available())
+    return;
+
+  std::vector<std::string> samples;
+  for (size_t i = 0; i < 2000; ++i)
+    samples.push_back(make_blob(1 + i % 4));
+  std::string dict = tx_blob_codec::train(samples, 4096);
+  ASSERT_FALSE(dict.empty());
+
+  tx_blob_codec codec;
+  codec.set_level(3);
+  const uint32_t id = codec.add_dictionary(tx_blob_codec::table::pruned, dict);
+  ASSERT_NE(0u, id);
+  ASSERT_EQ(id, codec.dictionary(tx_blob_codec::table::pruned));
+  ASSERT_EQ(0u, codec.dictionary(tx_blob_codec::table::prunable));
+
+  const std::string blob = make_blob(2);
+  std::string record;
+  codec.encode(tx_blob_codec::table::pruned, epee::strspan<char>(blob), record);
+  ASSERT_LT(record.size(), blob.size());
+  ASSERT_EQ(blob, round_trip(codec, tx_blob_codec::table::pruned, blob));
+
+  // a codec which does not know the dictionary cannot decode the record
+  tx_blob_codec other;
+  std::string out;
+  const MDB_val v{record.size(), (void*)record.data()};
+  ASSERT_THROW(other.decode(tx_blob_codec::table::pruned, v, true, out), cryptonote::DB_ERROR);
+
+  // but can once it loaded it from a tx_dicts table
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(boost::filesystem::create_directory(dir));
+  MDB_env *env;
+  ASSERT_EQ(0, mdb_env_create(&env));
+  ASSERT_EQ(0, mdb_env_set_maxdbs(env, 1));
+  ASSERT_EQ(0, mdb_env_open(env, dir.string().c_str(), 0, 0664));
+  MDB_txn *txn;
+  MDB_dbi dbi;
+  ASSERT_EQ(0, mdb_txn_begin(env, NULL, 0, &txn));
+  ASSERT_EQ(0, mdb_dbi_open(txn, "tx_dicts", MDB_INTEGERKEY | MDB_CREATE, &dbi));
+  MDB_val k{sizeof(id), (void*)&id}, dv{dict.size(), (void*)dict.data()};
+  ASSERT_EQ(0, mdb_put(txn, dbi, &k, &dv, 0));
+  other.load(txn, dbi);
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+  boost::filesystem::remove_all(dir);
+
+  other.decode(tx_blob_codec::table::pruned, v, true, out);
+  ASSERT_EQ(blob, out);
+  ASSERT_EQ(0u, other.dictionary(tx_blob_codec::table::pruned));
+  other.use_dictionary(tx_blob_codec::table::pruned, id);
+  ASSERT_EQ(id, other.dictionary(tx_blob_codec::table::pruned));
+}
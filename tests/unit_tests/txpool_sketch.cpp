@@ -0,0 +1,156 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/txpool_sketch.h"
+
+using cryptonote::txpool_sketch;
+
+namespace
+{
+  // decoding is probabilistic, keep the inputs fixed so results are repeatable
+  std::mt19937 rng;
+
+  std::vector<crypto::hash> make_txids(size_t n)
+  {
+    std::vector<crypto::hash> txids(n);
+    for (crypto::hash &txid: txids)
+      for (char &c: txid.data)
+        c = rng();
+    return txids;
+  }
+
+  txpool_sketch make_sketch(size_t cells, uint64_t salt, const std::vector<crypto::hash> &txids)
+  {
+    txpool_sketch sketch{cells, salt};
+    for (const crypto::hash &txid: txids)
+      sketch.insert(txid);
+    return sketch;
+  }
+
+  std::vector<uint64_t> short_ids(const std::vector<crypto::hash> &txids, uint64_t salt)
+  {
+    std::vector<uint64_t> ids;
+    for (const crypto::hash &txid: txids)
+      ids.push_back(txpool_sketch::short_id(txid, salt));
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  }
+}
+
+TEST(txpool_sketch, short_id_is_salted)
+{
+  const crypto::hash txid = make_txids(1).front();
+  EXPECT_EQ(txpool_sketch::short_id(txid, 1), txpool_sketch::short_id(txid, 1));
+  EXPECT_NE(txpool_sketch::short_id(txid, 1), txpool_sketch::short_id(txid, 2));
+}
+
+TEST(txpool_sketch, identical_pools)
+{
+  const std::vector<crypto::hash> txids = make_txids(5000);
+  txpool_sketch local = make_sketch(30, 42, txids);
+  ASSERT_TRUE(local.subtract(make_sketch(30, 42, txids)));
+
+  std::vector<uint64_t> only_local, only_remote;
+  ASSERT_TRUE(local.decode(only_local, only_remote));
+  EXPECT_TRUE(only_local.empty());
+  EXPECT_TRUE(only_remote.empty());
+}
+
+TEST(txpool_sketch, small_difference_in_large_pools)
+{
+  const std::vector<crypto::hash> common = make_txids(10000);
+  const std::vector<crypto::hash> extra_local = make_txids(20);
+  const std::vector<crypto::hash> extra_remote = make_txids(15);
+
+  std::vector<crypto::hash> local_txids = common, remote_txids = common;
+  local_txids.insert(local_txids.end(), extra_local.begin(), extra_local.end());
+  remote_txids.insert(remote_txids.end(), extra_remote.begin(), extra_remote.end());
+
+  // the remote sketch goes over the wire, only the cells travel with the blob
+  const uint64_t salt = 0x0123456789abcdef;
+  txpool_sketch received{1, salt};
+  ASSERT_TRUE(received.from_blob(make_sketch(150, salt, remote_txids).to_blob()));
+
+  txpool_sketch local = make_sketch(150, salt, local_txids);
+  ASSERT_TRUE(local.subtract(received));
+
+  std::vector<uint64_t> only_local, only_remote;
+  ASSERT_TRUE(local.decode(only_local, only_remote));
+  std::sort(only_local.begin(), only_local.end());
+  std::sort(only_remote.begin(), only_remote.end());
+  EXPECT_EQ(short_ids(extra_local, salt), only_local);
+  EXPECT_EQ(short_ids(extra_remote, salt), only_remote);
+}
+
+TEST(txpool_sketch, difference_too_large)
+{
+  txpool_sketch local = make_sketch(30, 7, make_txids(200));
+  ASSERT_TRUE(local.subtract(make_sketch(30, 7, make_txids(200))));
+
+  std::vector<uint64_t> only_local, only_remote;
+  EXPECT_FALSE(local.decode(only_local, only_remote));
+}
+
+TEST(txpool_sketch, mismatched)
+{
+  txpool_sketch local{30, 1};
+  EXPECT_FALSE(local.subtract(txpool_sketch{60, 1}));
+  EXPECT_FALSE(local.subtract(txpool_sketch{30, 2}));
+}
+
+TEST(txpool_sketch, blob)
+{
+  const txpool_sketch sketch = make_sketch(32, 3, make_txids(10));
+  EXPECT_EQ(33u, sketch.cells());
+  EXPECT_EQ(33u * txpool_sketch::cell_blob_size, sketch.to_blob().size());
+
+  txpool_sketch copy{1, 3};
+  ASSERT_TRUE(copy.from_blob(sketch.to_blob()));
+  EXPECT_EQ(sketch.to_blob(), copy.to_blob());
+
+  EXPECT_FALSE(copy.from_blob({}));
+  EXPECT_FALSE(copy.from_blob(std::string(txpool_sketch::cell_blob_size * 3 + 1, '\0')));
+  EXPECT_FALSE(copy.from_blob(std::string(txpool_sketch::cell_blob_size * 2, '\0')));
+}
+
+TEST(txpool_sketch, compact_short_id)
+{
+  const std::vector<crypto::hash> txids = make_txids(2);
+  const uint64_t id = cryptonote::get_compact_short_id(txids[0], 5);
+  EXPECT_EQ(0u, id >> (8 * cryptonote::compact_short_id_size));
+  EXPECT_EQ(txpool_sketch::short_id(txids[0], 5) & 0xffffffffffff, id);
+  EXPECT_EQ(id, cryptonote::get_compact_short_id(txids[0], 5));
+  EXPECT_NE(id, cryptonote::get_compact_short_id(txids[0], 6));
+  EXPECT_NE(id, cryptonote::get_compact_short_id(txids[1], 5));
+}
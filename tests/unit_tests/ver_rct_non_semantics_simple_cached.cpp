@@ -243,7 +243,7 @@ TEST(verRctNonSemanticsSimple, tx1_preconditions)
     // If this unit test fails, something changed about transaction deserialization / expansion or
     // something changed about RingCT signature verification.
 
-    cryptonote::rct_ver_cache_t rct_ver_cache;
+    cryptonote::rct_ver_cache_t rct_ver_cache(cryptonote::RCT_VER_CACHE_SIZE);
 
     cryptonote::transaction tx = expand_transaction_from_bin_file_and_pubkeys
         (tx1_file_name, tx1_input_pubkeys);
@@ -276,6 +276,11 @@ TEST(verRctNonSemanticsSimple, tx1_preconditions)
     EXPECT_TRUE(rct::verRctSimple(rs));
     EXPECT_TRUE(cryptonote::ver_rct_non_semantics_simple_cached(tx, tx1_input_pubkeys, rct_ver_cache, rct::RCTTypeBulletproofPlus));
     EXPECT_TRUE(cryptonote::ver_rct_non_semantics_simple_cached(tx, tx1_input_pubkeys, rct_ver_cache, rct::RCTTypeBulletproofPlus));
+    const cryptonote::rct_ver_cache_t::stats_t stats = rct_ver_cache.get_stats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(0, stats.evictions);
+    EXPECT_EQ(1, stats.size);
 }
 
 #define SERIALIZABLE_SIG_CHANGES_SUBTEST(fieldmodifyclause)                                    \
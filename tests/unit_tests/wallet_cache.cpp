@@ -0,0 +1,488 @@
+// Copyright (c) 2024, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "unit_tests_utils.h"
+#include "gtest/gtest.h"
+
+#include "file_io_utils.h"
+#include "common/util.h"
+#include "crypto/crypto.h"
+#include "wallet/wallet2.h"
+#include "serialization/binary_utils.h"
+
+// drives wallet2 state directly, without a daemon or real transactions
+class wallet_cache_accessor
+{
+public:
+  static void generate(tools::wallet2 &w)
+  {
+    w.generate("", "", crypto::secret_key(), false, false);
+  }
+
+  static void add_blocks(tools::wallet2 &w, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i)
+      w.m_blockchain.push_back(crypto::rand<crypto::hash>());
+  }
+
+  // an output received in the top block, along with its payment
+  static size_t receive(tools::wallet2 &w, uint64_t amount, const cryptonote::subaddress_index &subaddr, uint64_t unlock_time = 0)
+  {
+    tools::wallet2::transfer_details td = tools::wallet2::transfer_details();
+    td.m_block_height = w.m_blockchain.size() - 1;
+    td.m_txid = crypto::rand<crypto::hash>();
+    td.m_amount = amount;
+    td.m_rct = true;
+    td.m_key_image = crypto::rand<crypto::key_image>();
+    td.m_key_image_known = true;
+    td.m_subaddr_index = subaddr;
+    td.m_output_public_key = crypto::rand<crypto::public_key>();
+    td.m_unlock_time = unlock_time;
+    const size_t idx = w.m_transfers.size();
+    w.m_transfers.push_back(td);
+    w.m_key_images[td.m_key_image] = idx;
+    w.m_pub_keys[td.m_output_public_key] = idx;
+    w.update_balance_index(idx);
+
+    tools::wallet2::payment_details pd = tools::wallet2::payment_details();
+    pd.m_tx_hash = td.m_txid;
+    pd.m_amount = amount;
+    pd.m_block_height = td.m_block_height;
+    pd.m_unlock_time = unlock_time;
+    pd.m_subaddr_index = subaddr;
+    w.index_payment(*w.m_payments.emplace(crypto::rand<crypto::hash>(), pd));
+    return idx;
+  }
+
+  // spends an output in the top block, or only marks it spent by a pool tx
+  static void spend(tools::wallet2 &w, size_t idx, bool in_block)
+  {
+    const tools::wallet2::transfer_details &td = w.m_transfers[idx];
+    const uint64_t height = w.m_blockchain.size() - 1;
+    w.set_spent(idx, in_block ? height : 0);
+    if (!in_block)
+      return;
+    tools::wallet2::confirmed_transfer_details ctd;
+    ctd.m_amount_in = td.amount();
+    ctd.m_amount_out = td.amount();
+    ctd.m_change = 0;
+    ctd.m_block_height = height;
+    ctd.m_subaddr_account = td.m_subaddr_index.major;
+    ctd.m_subaddr_indices.insert(td.m_subaddr_index.minor);
+    w.index_confirmed_tx(*w.m_confirmed_txs.insert(std::make_pair(crypto::rand<crypto::hash>(), ctd)).first);
+  }
+
+  static void detach(tools::wallet2 &w, uint64_t height)
+  {
+    w.detach_blockchain(height);
+  }
+
+  static void clear_user_data(tools::wallet2 &w)
+  {
+    w.clear_user_data();
+  }
+
+  template<typename T>
+  static std::string to_blob(const T &t)
+  {
+    std::string blob;
+    EXPECT_TRUE(::serialization::dump_binary(const_cast<T&>(t), blob));
+    return blob;
+  }
+
+  static uint64_t height(const tools::wallet2 &w)
+  {
+    return w.m_blockchain.size();
+  }
+
+  static const tools::wallet2::payment_container &payments(const tools::wallet2 &w)
+  {
+    return w.m_payments;
+  }
+
+  static const std::unordered_map<crypto::hash, tools::wallet2::confirmed_transfer_details> &confirmed_txs(const tools::wallet2 &w)
+  {
+    return w.m_confirmed_txs;
+  }
+
+  // writes the whole cache, as store_to does when the journal is off
+  static void store_full_cache(tools::wallet2 &w, const std::string &path)
+  {
+    const boost::optional<tools::wallet2::cache_file_data> cache_file_data = w.get_cache_file_data();
+    ASSERT_TRUE(cache_file_data != boost::none);
+    std::string blob;
+    ASSERT_TRUE(::serialization::dump_binary(const_cast<tools::wallet2::cache_file_data&>(cache_file_data.get()), blob));
+    ASSERT_TRUE(epee::file_io_utils::save_string_to_file(path, blob));
+  }
+
+  // compares what the journal covers, regardless of the order of hashed containers
+  static void check_same_cache(const tools::wallet2 &expected, const tools::wallet2 &w)
+  {
+    EXPECT_EQ(expected.m_blockchain.genesis(), w.m_blockchain.genesis());
+    EXPECT_EQ(expected.m_blockchain.offset(), w.m_blockchain.offset());
+    ASSERT_EQ(expected.m_blockchain.size(), w.m_blockchain.size());
+    for (uint64_t height = expected.m_blockchain.offset(); height < expected.m_blockchain.size(); ++height)
+      EXPECT_EQ(expected.m_blockchain[height], w.m_blockchain[height]);
+
+    ASSERT_EQ(expected.m_transfers.size(), w.m_transfers.size());
+    for (size_t i = 0; i < expected.m_transfers.size(); ++i)
+      EXPECT_EQ(to_blob(expected.m_transfers[i]), to_blob(w.m_transfers[i])) << "transfer " << i;
+    EXPECT_TRUE(expected.m_key_images == w.m_key_images);
+    EXPECT_TRUE(expected.m_pub_keys == w.m_pub_keys);
+
+    std::multiset<std::string> expected_payments, payments;
+    for (const auto &p: expected.m_payments)
+      expected_payments.insert(epee::string_tools::pod_to_hex(p.first) + to_blob(p.second));
+    for (const auto &p: w.m_payments)
+      payments.insert(epee::string_tools::pod_to_hex(p.first) + to_blob(p.second));
+    EXPECT_EQ(expected_payments, payments);
+
+    std::unordered_map<crypto::hash, std::string> expected_txs, txs;
+    for (const auto &c: expected.m_confirmed_txs)
+      expected_txs[c.first] = to_blob(c.second);
+    for (const auto &c: w.m_confirmed_txs)
+      txs[c.first] = to_blob(c.second);
+    EXPECT_TRUE(expected_txs == txs);
+    EXPECT_TRUE(expected.m_tx_notes == w.m_tx_notes);
+  }
+
+  // what balance_per_subaddress returned before it was indexed
+  static std::map<uint32_t, uint64_t> scan_balance(const tools::wallet2 &w, uint32_t index_major, bool strict)
+  {
+    std::map<uint32_t, uint64_t> amount_per_subaddr;
+    for (const auto &td: w.m_transfers)
+    {
+      if (td.amount() > w.m_ignore_outputs_above || td.amount() < w.m_ignore_outputs_below)
+        continue;
+      if (td.m_subaddr_index.major == index_major && !w.is_spent(td, strict) && !td.m_frozen)
+        amount_per_subaddr[td.m_subaddr_index.minor] += td.amount();
+    }
+    return amount_per_subaddr;
+  }
+
+  // what unlocked_balance_per_subaddress returned before it was indexed
+  static std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> scan_unlocked_balance(tools::wallet2 &w, uint32_t index_major, bool strict)
+  {
+    std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> amount_per_subaddr;
+    const uint64_t blockchain_height = w.get_blockchain_current_height();
+    for (const auto &td: w.m_transfers)
+    {
+      if (td.amount() > w.m_ignore_outputs_above || td.amount() < w.m_ignore_outputs_below)
+        continue;
+      if (td.m_subaddr_index.major != index_major || w.is_spent(td, strict) || td.m_frozen)
+        continue;
+      uint64_t amount = 0, blocks_to_unlock = 0;
+      if (w.is_transfer_unlocked(td))
+        amount = td.amount();
+      else
+      {
+        uint64_t unlock_height = td.m_block_height + std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+        if (td.m_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_unlock_time > unlock_height)
+          unlock_height = td.m_unlock_time;
+        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
+      }
+      auto &found = amount_per_subaddr[td.m_subaddr_index.minor];
+      found.first += amount;
+      found.second.first = std::max(found.second.first, blocks_to_unlock);
+    }
+    return amount_per_subaddr;
+  }
+};
+
+namespace
+{
+  const uint32_t num_accounts = 3;
+
+  std::unordered_multiset<crypto::hash> payment_txids(const std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> &payments)
+  {
+    std::unordered_multiset<crypto::hash> txids;
+    for (const auto &p: payments)
+      txids.insert(p.second.m_tx_hash);
+    return txids;
+  }
+
+  std::unordered_multiset<crypto::hash> confirmed_txids(const std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> &txs)
+  {
+    std::unordered_multiset<crypto::hash> txids;
+    for (const auto &c: txs)
+      txids.insert(c.first);
+    return txids;
+  }
+
+  void check_indices(tools::wallet2 &w)
+  {
+    for (uint32_t major = 0; major < num_accounts; ++major)
+    {
+      for (bool strict: {false, true})
+      {
+        EXPECT_EQ(wallet_cache_accessor::scan_balance(w, major, strict), w.balance_per_subaddress(major, strict));
+        const auto unlocked = wallet_cache_accessor::scan_unlocked_balance(w, major, strict);
+        EXPECT_EQ(unlocked, w.unlocked_balance_per_subaddress(major, strict));
+        // twice, as the first query forgets outputs it sees unlocked
+        EXPECT_EQ(unlocked, w.unlocked_balance_per_subaddress(major, strict));
+      }
+    }
+
+    const uint64_t height = wallet_cache_accessor::height(w);
+    const std::vector<std::pair<uint64_t, uint64_t>> ranges = {{0, (uint64_t)-1}, {0, height / 3}, {height / 3, 2 * height / 3}, {height / 2, height}, {5, 5}, {7, 8}};
+    for (const auto &range: ranges)
+    {
+      for (uint32_t major = 0; major <= num_accounts; ++major)
+      {
+        const boost::optional<uint32_t> account = major < num_accounts ? boost::optional<uint32_t>(major) : boost::none;
+
+        std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> expected_payments, payments;
+        for (const auto &p: wallet_cache_accessor::payments(w))
+          if (range.first < p.second.m_block_height && range.second >= p.second.m_block_height && (!account || *account == p.second.m_subaddr_index.major))
+            expected_payments.push_back(p);
+        w.get_payments(payments, range.first, range.second, account);
+        EXPECT_EQ(payment_txids(expected_payments), payment_txids(payments));
+
+        std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> expected_txs, txs;
+        for (const auto &c: wallet_cache_accessor::confirmed_txs(w))
+          if (range.first < c.second.m_block_height && range.second >= c.second.m_block_height && (!account || *account == c.second.m_subaddr_account))
+            expected_txs.push_back(c);
+        w.get_payments_out(txs, range.first, range.second, account);
+        EXPECT_EQ(confirmed_txids(expected_txs), confirmed_txids(txs));
+      }
+    }
+  }
+}
+
+TEST(wallet_cache, indices)
+{
+  tools::wallet2 w;
+  wallet_cache_accessor::generate(w);
+  for (uint32_t major = 1; major < num_accounts; ++major)
+    w.add_subaddress_account("");
+  check_indices(w);
+
+  // receive over a few blocks, some with an unlock time of their own
+  std::vector<size_t> received;
+  for (size_t i = 0; i < 40; ++i)
+  {
+    wallet_cache_accessor::add_blocks(w, 1 + i % 3);
+    const cryptonote::subaddress_index subaddr{(uint32_t)(i % num_accounts), (uint32_t)(i % 4)};
+    const uint64_t unlock_time = i % 5 == 0 ? wallet_cache_accessor::height(w) + 20 : 0;
+    received.push_back(wallet_cache_accessor::receive(w, 1000 * (i + 1), subaddr, unlock_time));
+  }
+  check_indices(w);
+
+  // spend some in blocks, some only in the pool
+  for (size_t i = 0; i < received.size(); i += 3)
+  {
+    wallet_cache_accessor::add_blocks(w, 1);
+    wallet_cache_accessor::spend(w, received[i], i % 2 == 0);
+  }
+  check_indices(w);
+
+  for (size_t i = 1; i < received.size(); i += 4)
+    w.freeze(received[i]);
+  check_indices(w);
+  for (size_t i = 1; i < received.size(); i += 8)
+    w.thaw(received[i]);
+  check_indices(w);
+
+  w.ignore_outputs_above(30000);
+  w.ignore_outputs_below(2000);
+  check_indices(w);
+  w.ignore_outputs_above(MONEY_SUPPLY);
+  w.ignore_outputs_below(0);
+  check_indices(w);
+
+  // enough for everything to unlock
+  wallet_cache_accessor::add_blocks(w, 40);
+  check_indices(w);
+
+  // a reorg drops the recent outputs, spends and payments
+  wallet_cache_accessor::detach(w, wallet_cache_accessor::height(w) / 2);
+  check_indices(w);
+  for (size_t i = 0; i < 10; ++i)
+  {
+    wallet_cache_accessor::add_blocks(w, 1);
+    const size_t idx = wallet_cache_accessor::receive(w, 500 * (i + 1), {(uint32_t)(i % num_accounts), 1});
+    if (i % 3 == 0)
+      wallet_cache_accessor::spend(w, idx, true);
+  }
+  check_indices(w);
+
+  // imports replace the history wholesale
+  tools::wallet2::payment_container payments = wallet_cache_accessor::payments(w);
+  tools::wallet2::payment_details pd = tools::wallet2::payment_details();
+  pd.m_tx_hash = crypto::rand<crypto::hash>();
+  pd.m_amount = 42;
+  pd.m_block_height = 3;
+  pd.m_subaddr_index = {1, 2};
+  payments.emplace(crypto::null_hash, pd);
+  w.import_payments(payments);
+  check_indices(w);
+
+  std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> confirmed;
+  for (const auto &c: wallet_cache_accessor::confirmed_txs(w))
+    if (c.second.m_subaddr_account != 0)
+      confirmed.push_back(c);
+  w.import_payments_out(confirmed);
+  check_indices(w);
+
+  // and the index keeps up with what comes after
+  wallet_cache_accessor::add_blocks(w, 1);
+  wallet_cache_accessor::spend(w, wallet_cache_accessor::receive(w, 12345, {2, 3}), true);
+  check_indices(w);
+
+  // clearing user data thaws everything
+  std::vector<size_t> frozen;
+  for (size_t i = 0; i < w.get_num_transfer_details(); i += 3)
+  {
+    w.freeze(i);
+    frozen.push_back(i);
+  }
+  check_indices(w);
+  wallet_cache_accessor::clear_user_data(w);
+  check_indices(w);
+  for (const size_t i: frozen)
+    ASSERT_FALSE(w.frozen(i));
+}
+
+TEST(wallet_cache, journal)
+{
+  const boost::filesystem::path wallet_file = unit_test::data_dir / "wallet_cache_journal";
+  const boost::filesystem::path full_file = unit_test::data_dir / "wallet_cache_journal_full";
+  const std::string journal_file = wallet_file.string() + ".journal";
+  for (const boost::filesystem::path &path: {wallet_file, full_file})
+    for (const char *suffix: {"", ".keys", ".journal", ".address.txt"})
+      boost::filesystem::remove(path.string() + suffix);
+
+  const epee::wipeable_string password("journal");
+  tools::wallet2 w;
+  w.set_subaddress_lookahead(1, 5);
+  w.generate(wallet_file.string(), password);
+  for (uint32_t major = 1; major < num_accounts; ++major)
+    w.add_subaddress_account("");
+
+  // a long chain keeps the cache well above what the test journals, so it is never compacted
+  wallet_cache_accessor::add_blocks(w, 20000);
+  w.store();
+  w.journal_cache(true);
+  w.rewrite(wallet_file.string(), password);
+  ASSERT_FALSE(boost::filesystem::exists(journal_file));
+  std::string cache_contents;
+  ASSERT_TRUE(epee::file_io_utils::load_file_to_string(wallet_file.string(), cache_contents));
+
+  uint64_t journal_size = 0;
+  const auto store_and_reload = [&]()
+  {
+    w.store();
+
+    // the cache file is left alone, the change goes to the journal
+    std::string contents;
+    ASSERT_TRUE(epee::file_io_utils::load_file_to_string(wallet_file.string(), contents));
+    EXPECT_TRUE(cache_contents == contents);
+    uint64_t size = 0;
+    ASSERT_TRUE(epee::file_io_utils::get_file_size(journal_file, size));
+    EXPECT_GT(size, journal_size);
+    journal_size = size;
+
+    // the cache plus journal must load as the same wallet as the whole cache
+    wallet_cache_accessor::store_full_cache(w, full_file.string());
+    tools::copy_file(wallet_file.string() + ".keys", full_file.string() + ".keys");
+    tools::wallet2 full, journaled;
+    full.load(full_file.string(), password);
+    journaled.load(wallet_file.string(), password);
+    wallet_cache_accessor::check_same_cache(w, full);
+    wallet_cache_accessor::check_same_cache(w, journaled);
+    check_indices(journaled);
+  };
+
+  // new blocks, with outputs and payments
+  std::vector<size_t> received;
+  for (size_t i = 0; i < 20; ++i)
+  {
+    wallet_cache_accessor::add_blocks(w, 1 + i % 2);
+    received.push_back(wallet_cache_accessor::receive(w, 1000 * (i + 1), {(uint32_t)(i % num_accounts), (uint32_t)(i % 3)}));
+  }
+  store_and_reload();
+
+  // transfers changing in place: spent in a block or the pool, frozen
+  for (size_t i = 0; i < received.size(); i += 3)
+  {
+    wallet_cache_accessor::add_blocks(w, 1);
+    wallet_cache_accessor::spend(w, received[i], i % 2 == 0);
+  }
+  w.freeze(received[1]);
+  store_and_reload();
+
+  // only a change to an old transfer
+  w.thaw(received[1]);
+  store_and_reload();
+
+  // the rest of the wallet state is only journaled when it changed
+  for (size_t i = 0; i < 500; ++i)
+    w.set_tx_note(crypto::rand<crypto::hash>(), std::string(100, 'n'));
+  uint64_t previous_size = journal_size;
+  store_and_reload();
+  EXPECT_GT(journal_size - previous_size, 50000);
+  previous_size = journal_size;
+  wallet_cache_accessor::add_blocks(w, 1);
+  store_and_reload();
+  EXPECT_LT(journal_size - previous_size, 1000);
+
+  // a reorg crops the chain and drops transfers, spends and payments above it
+  wallet_cache_accessor::detach(w, wallet_cache_accessor::height(w) - 15);
+  store_and_reload();
+
+  // replacement blocks, reusing the dropped transfer indices
+  for (size_t i = 0; i < 5; ++i)
+  {
+    wallet_cache_accessor::add_blocks(w, 1);
+    const size_t idx = wallet_cache_accessor::receive(w, 700 * (i + 1), {(uint32_t)(i % num_accounts), 2});
+    if (i % 2 == 0)
+      wallet_cache_accessor::spend(w, idx, true);
+  }
+  store_and_reload();
+
+  // a reorg and its replacement in the same journal record
+  wallet_cache_accessor::detach(w, wallet_cache_accessor::height(w) - 3);
+  wallet_cache_accessor::add_blocks(w, 4);
+  wallet_cache_accessor::receive(w, 31337, {1, 1});
+  store_and_reload();
+
+  // switching the journal off folds it back into the cache
+  w.journal_cache(false);
+  w.store();
+  EXPECT_FALSE(boost::filesystem::exists(journal_file));
+  tools::wallet2 reloaded;
+  reloaded.load(wallet_file.string(), password);
+  wallet_cache_accessor::check_same_cache(w, reloaded);
+}
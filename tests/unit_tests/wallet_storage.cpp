@@ -382,3 +382,74 @@ TEST(wallet_storage, change_export_format)
 
     EXPECT_EQ(primary_address_1, primary_address_2);
 }
+
+TEST(wallet_storage, journal_cache)
+{
+    const path target_wallet_file = unit_test::data_dir / "wallet_journal_cache";
+    const std::string journal_file = target_wallet_file.string() + ".journal";
+
+    for (const std::string &file : {target_wallet_file.string(), target_wallet_file.string() + ".keys", journal_file})
+        if (is_file_exist(file))
+            remove(file);
+
+    epee::wipeable_string password("beepbeep4");
+    crypto::hash txid1 = crypto::null_hash, txid2 = crypto::null_hash;
+    txid1.data[0] = 1;
+    txid2.data[0] = 2;
+
+    {
+        tools::wallet2 w;
+        w.generate(target_wallet_file.string(), password);
+        w.journal_cache(true);
+        w.rewrite(target_wallet_file.string(), password);
+
+        std::string cache_contents;
+        ASSERT_TRUE(load_file_to_string(target_wallet_file.string(), cache_contents));
+
+        // the change goes to the journal, the cache file is left alone
+        w.set_tx_note(txid1, "first");
+        w.store();
+        EXPECT_TRUE(is_file_exist(journal_file));
+        std::string new_cache_contents;
+        ASSERT_TRUE(load_file_to_string(target_wallet_file.string(), new_cache_contents));
+        EXPECT_EQ(cache_contents, new_cache_contents);
+    }
+
+    {
+        tools::wallet2 w;
+        w.load(target_wallet_file.string(), password);
+        EXPECT_TRUE(w.journal_cache());
+        EXPECT_EQ("first", w.get_tx_note(txid1));
+        w.set_tx_note(txid2, "second");
+        w.store();
+    }
+
+    // a torn write at the end of the journal only loses that write
+    {
+        std::string journal;
+        load_file_to_string(journal_file, journal);
+        journal += "\x05torn";
+        ASSERT_TRUE(save_string_to_file(journal_file, journal));
+    }
+
+    {
+        tools::wallet2 w;
+        w.load(target_wallet_file.string(), password);
+        EXPECT_EQ("first", w.get_tx_note(txid1));
+        EXPECT_EQ("second", w.get_tx_note(txid2));
+
+        // switching it off folds the journal back into the cache
+        w.journal_cache(false);
+        w.rewrite(target_wallet_file.string(), password);
+        w.store();
+        EXPECT_FALSE(is_file_exist(journal_file));
+    }
+
+    {
+        tools::wallet2 w;
+        w.load(target_wallet_file.string(), password);
+        EXPECT_FALSE(w.journal_cache());
+        EXPECT_EQ("first", w.get_tx_note(txid1));
+        EXPECT_EQ("second", w.get_tx_note(txid2));
+    }
+}